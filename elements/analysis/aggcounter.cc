@@ -21,35 +21,23 @@
 #include <click/args.hh>
 #include <click/error.hh>
 #include <click/packet_anno.hh>
-#include <click/integers.hh>	// for first_bit_set
 #include <click/router.hh>
+#include <click/straccum.hh>
+#if CLICK_USERLEVEL && HAVE_MULTITHREAD
+# include <pthread.h>
+#endif
 CLICK_DECLS
 
 AggregateCounter::AggregateCounter()
-    : _root(0), _free(0), _call_nnz_h(0), _call_count_h(0)
+    : _call_nnz_h(0), _call_count_h(0)
 {
+    memset(_sub, 0, sizeof(_sub));
 }
 
 AggregateCounter::~AggregateCounter()
 {
 }
 
-AggregateCounter::Node *
-AggregateCounter::new_node_block()
-{
-    assert(!_free);
-    int block_size = 1024;
-    Node *block = new Node[block_size];
-    if (!block)
-	return 0;
-    _blocks.push_back(block);
-    for (int i = 1; i < block_size - 1; i++)
-	block[i].child[0] = &block[i+1];
-    block[block_size - 1].child[0] = 0;
-    _free = &block[1];
-    return &block[0];
-}
-
 int
 AggregateCounter::configure(Vector<String> &conf, ErrorHandler *errh)
 {
@@ -62,6 +50,7 @@ AggregateCounter::configure(Vector<String> &conf, ErrorHandler *errh)
     String call_nnz, call_count;
     freeze_nnz = stop_nnz = _call_nnz = (uint32_t)(-1);
     freeze_count = stop_count = _call_count = (uint64_t)(-1);
+    _threads = 1;
 
     if (Args(conf, this, errh)
 	.read("BYTES", bytes)
@@ -74,9 +63,12 @@ AggregateCounter::configure(Vector<String> &conf, ErrorHandler *errh)
 	.read("COUNT_STOP", stop_count)
 	.read("AGGREGATE_CALL", AnyArg(), call_nnz)
 	.read("COUNT_CALL", AnyArg(), call_count)
-	.read("BANNER", _output_banner).complete() < 0)
+	.read("BANNER", _output_banner)
+	.read("THREADS", _threads).complete() < 0)
 	return -1;
 
+    if (_threads < 1)
+	return errh->error("THREADS must be positive");
     _bytes = bytes;
     _ip_bytes = ip_bytes;
     _use_packet_count = packet_count;
@@ -132,84 +124,72 @@ AggregateCounter::initialize(ErrorHandler *errh)
 void
 AggregateCounter::cleanup(CleanupStage)
 {
-    for (int i = 0; i < _blocks.size(); i++)
-	delete[] _blocks[i];
-    _blocks.clear();
+    free_subtrees();
     delete _call_nnz_h;
     delete _call_count_h;
     _call_nnz_h = _call_count_h = 0;
 }
 
-AggregateCounter::Node *
-AggregateCounter::make_peer(uint32_t a, Node *n, bool frozen)
+void
+AggregateCounter::free_subtrees()
 {
-    /*
-     * become a peer
-     * algo: create two nodes, the two peers.  leave orig node as
-     * the parent of the two new ones.
-     */
-
-    if (frozen)
-	return 0;
+    for (Subtree *t = _sub; t != _sub + nsubtrees; ++t)
+	delete[] t->slots;
+    memset(_sub, 0, sizeof(_sub));
+}
 
-    Node *down[2];
-    if (!(down[0] = new_node()))
-	return 0;
-    if (!(down[1] = new_node())) {
-	free_node(down[0]);
-	return 0;
-    }
+bool
+AggregateCounter::grow(Subtree &t)
+{
+    uint32_t ncapacity = t.capacity ? t.capacity * 2 : (uint32_t) initial_capacity;
+    int nshift = 32;
+    for (uint32_t c = ncapacity; c > 1; c >>= 1)
+	--nshift;
+    uint32_t *nslots = new uint32_t[2 * ncapacity];
+    if (!nslots)
+	return false;
+    memset(nslots, 0, sizeof(uint32_t) * 2 * ncapacity);
+
+    for (uint32_t *slot = t.slots; slot != t.slots + 2 * t.capacity; slot += 2)
+	if (slot[1]) {
+	    uint32_t i = (slot[0] * 0x9E3779B1U) >> nshift;
+	    while (nslots[2 * i + 1])
+		i = (i + 1) & (ncapacity - 1);
+	    nslots[2 * i] = slot[0];
+	    nslots[2 * i + 1] = slot[1];
+	}
 
-    // swivel is first bit 'a' and 'old->input' differ
-    int swivel = ffs_msb(a ^ n->aggregate);
-    // bitvalue is the value of that bit of 'a'
-    int bitvalue = (a >> (32 - swivel)) & 1;
-    // mask masks off all bits before swivel
-    uint32_t mask = (swivel == 1 ? 0 : (0xFFFFFFFFU << (33 - swivel)));
-
-    down[bitvalue]->aggregate = a;
-    down[bitvalue]->count = 0;
-    down[bitvalue]->child[0] = down[bitvalue]->child[1] = 0;
-
-    *down[1 - bitvalue] = *n;	/* copy orig node down one level */
-
-    n->aggregate = (down[0]->aggregate & mask);
-    if (down[0]->aggregate == n->aggregate) {
-	n->count = down[0]->count;
-	down[0]->count = 0;
-    } else
-	n->count = 0;
-    n->child[0] = down[0];	/* point to children */
-    n->child[1] = down[1];
-
-    return (n->aggregate == a ? n : down[bitvalue]);
+    delete[] t.slots;
+    t.slots = nslots;
+    t.capacity = ncapacity;
+    t.shift = nshift;
+    return true;
 }
 
-AggregateCounter::Node *
-AggregateCounter::find_node(uint32_t a, bool frozen)
+/** @brief Add a slot for aggregate @a a, which must not have one.
+ *
+ * The caller must store a nonzero count in the returned slot.  Returns null
+ * if memory runs out. */
+uint32_t *
+AggregateCounter::insert_slot(uint32_t a)
 {
-    // straight outta tcpdpriv
-    Node *n = _root;
-    while (n) {
-	if (n->aggregate == a)
-	    return (n->count || !frozen ? n : 0);
-	if (!n->child[0])
-	    n = make_peer(a, n, frozen);
-	else {
-	    // swivel is the first bit in which the two children differ
-	    int swivel = ffs_msb(n->child[0]->aggregate ^ n->child[1]->aggregate);
-	    if (ffs_msb(a ^ n->aggregate) < swivel) // input differs earlier
-		n = make_peer(a, n, frozen);
-	    else if (a & (1 << (32 - swivel)))
-		n = n->child[1];
-	    else
-		n = n->child[0];
-	}
-    }
+    Subtree &t = _sub[a >> subtree_shift];
+    if ((t.size + 1) * 2 > t.capacity && !grow(t))
+	return 0;
+    uint32_t i = (a * 0x9E3779B1U) >> t.shift;
+    while (t.slots[2 * i + 1])
+	i = (i + 1) & (t.capacity - 1);
+    t.slots[2 * i] = a;
+    t.size++;
+    return &t.slots[2 * i + 1];
+}
 
-    if (!frozen)
-	click_chatter("AggregateCounter: out of memory!");
-    return 0;
+static inline void
+add_count(uint32_t *slot, uint32_t amount)
+{
+    uint32_t c = *slot + amount;
+    // Counts saturate, since a zero count marks an empty slot.
+    *slot = (c < amount ? 0xFFFFFFFFU : c);
 }
 
 inline bool
@@ -220,8 +200,8 @@ AggregateCounter::update(Packet *p, bool frozen)
 
     // AGGREGATE_ANNO is already in host byte order!
     uint32_t agg = AGGREGATE_ANNO(p);
-    Node *n = find_node(agg, frozen);
-    if (!n)
+    uint32_t *slot = find_slot(agg);
+    if (!slot && frozen)
 	return false;
 
     uint32_t amount;
@@ -234,17 +214,23 @@ AggregateCounter::update(Packet *p, bool frozen)
     }
 
     // update _num_nonzero; possibly call handler
-    if (amount && !n->count) {
+    if (!slot) {
+	if (!amount)
+	    return true;
 	if (_num_nonzero >= _call_nnz) {
 	    _call_nnz = (uint32_t)(-1);
 	    _call_nnz_h->call_write();
 	    // handler may have changed our state; reupdate
 	    return update(p, frozen || _frozen);
 	}
+	if (!(slot = insert_slot(agg))) {
+	    click_chatter("AggregateCounter: out of memory!");
+	    return false;
+	}
 	_num_nonzero++;
     }
 
-    n->count += amount;
+    add_count(slot, amount);
     _count += amount;
     if (_count >= _call_count) {
 	_call_count = (uint64_t)(-1);
@@ -272,103 +258,177 @@ AggregateCounter::pull(int port)
 
 // CLEAR, REAGGREGATE
 
-void
-AggregateCounter::clear_node(Node *n)
+int
+AggregateCounter::clear(ErrorHandler *)
 {
-    if (n->child[0]) {
-	clear_node(n->child[0]);
-	clear_node(n->child[1]);
-    }
-    free_node(n);
+    free_subtrees();
+    _num_nonzero = 0;
+    _count = 0;
+    return 0;
 }
 
+// Reaggregation and file writing split the subtrees into contiguous ranges
+// holding about the same number of aggregates, one range per thread.
+struct AggregateCounter::Job {
+    const AggregateCounter *ac;
+    int begin;
+    int end;
+    void (*f)(Job *);
+    WriteFormat format;
+    FILE *out;			// if nonnull, flush sa after each subtree
+    StringAccum sa;
+    Vector<uint32_t> hist;	// (count, number of aggregates) pairs
+
+    static void *thread_driver(void *user_data) {
+	Job *j = static_cast<Job *>(user_data);
+	j->f(j);
+	return 0;
+    }
+};
+
 int
-AggregateCounter::clear(ErrorHandler *errh)
+AggregateCounter::split_subtrees(Job *jobs, int njobs) const
 {
-    if (_root)
-	clear_node(_root);
+    uint64_t total = 0, sofar = 0;
+    for (const Subtree *t = _sub; t != _sub + nsubtrees; ++t)
+	total += t->size;
+
+    int j = 0;
+    jobs[0].begin = 0;
+    for (int i = 0; i < nsubtrees - 1 && j < njobs - 1; ++i) {
+	sofar += _sub[i].size;
+	if (sofar * njobs >= total * (j + 1) && sofar) {
+	    jobs[j].end = i + 1;
+	    jobs[++j].begin = i + 1;
+	}
+    }
+    jobs[j].end = nsubtrees;
 
-    if (!(_root = new_node())) {
-	if (errh)
-	    errh->error("out of memory!");
-	return -1;
+    for (int k = 0; k <= j; ++k) {
+	jobs[k].ac = this;
+	jobs[k].out = 0;
     }
-    _root->aggregate = 0;
-    _root->count = 0;
-    _root->child[0] = _root->child[1] = 0;
-    _num_nonzero = 0;
-    _count = 0;
-    return 0;
+    return j + 1;
 }
 
-
 void
-AggregateCounter::reaggregate_node(Node *n)
+AggregateCounter::run_jobs(Job *jobs, int njobs, void (*f)(Job *)) const
 {
-    Node *l = n->child[0], *r = n->child[1];
-    uint32_t count = n->count;
-    free_node(n);
-
-    if ((n = find_node(count, false))) {
-	if (!n->count)
-	    _num_nonzero++;
-	n->count++;
-	_count++;
+    for (int i = 0; i < njobs; ++i)
+	jobs[i].f = f;
+#if CLICK_USERLEVEL && HAVE_MULTITHREAD
+    Vector<pthread_t> threads;
+    for (int i = 1; i < njobs; ++i) {
+	pthread_t p;
+	if (pthread_create(&p, 0, Job::thread_driver, &jobs[i]) != 0)
+	    f(&jobs[i]);
+	else
+	    threads.push_back(p);
     }
+    f(&jobs[0]);
+    for (pthread_t *it = threads.begin(); it != threads.end(); ++it)
+	(void) pthread_join(*it, 0);
+#else
+    for (int i = 0; i < njobs; ++i)
+	f(&jobs[i]);
+#endif
+}
 
-    if (l) {
-	reaggregate_node(l);
-	reaggregate_node(r);
+static int
+uint32_compar(const void *ap, const void *bp, void *)
+{
+    uint32_t a = *static_cast<const uint32_t *>(ap);
+    uint32_t b = *static_cast<const uint32_t *>(bp);
+    return a < b ? -1 : a != b;
+}
+
+static int
+uint64_compar(const void *ap, const void *bp, void *)
+{
+    uint64_t a = *static_cast<const uint64_t *>(ap);
+    uint64_t b = *static_cast<const uint64_t *>(bp);
+    return a < b ? -1 : a != b;
+}
+
+void
+AggregateCounter::histogram_job(Job *j)
+{
+    Vector<uint32_t> counts;
+    for (const Subtree *t = j->ac->_sub + j->begin; t != j->ac->_sub + j->end; ++t)
+	for (uint32_t *slot = t->slots; slot != t->slots + 2 * t->capacity; slot += 2)
+	    if (slot[1])
+		counts.push_back(slot[1]);
+    if (counts.size())
+	click_qsort(counts.begin(), counts.size(), sizeof(uint32_t), uint32_compar);
+
+    for (uint32_t *it = counts.begin(); it != counts.end(); ) {
+	uint32_t *first = it;
+	while (it != counts.end() && *it == *first)
+	    ++it;
+	j->hist.push_back(*first);
+	j->hist.push_back(it - first);
     }
 }
 
 void
 AggregateCounter::reaggregate_counts()
 {
-    Node *old_root = _root;
-    _root = 0;
+    Job *jobs = new Job[_threads];
+    int njobs = split_subtrees(jobs, _threads);
+    run_jobs(jobs, njobs, histogram_job);
+
     clear();
-    reaggregate_node(old_root);
+    for (Job *j = jobs; j != jobs + njobs; ++j)
+	for (uint32_t *it = j->hist.begin(); it != j->hist.end(); it += 2) {
+	    uint32_t *slot = find_slot(it[0]);
+	    if (!slot) {
+		if (!(slot = insert_slot(it[0]))) {
+		    click_chatter("AggregateCounter: out of memory!");
+		    continue;
+		}
+		_num_nonzero++;
+	    }
+	    add_count(slot, it[1]);
+	    _count += it[1];
+	}
+    delete[] jobs;
 }
 
 
 // HANDLERS
 
-static void
-write_batch(FILE *f, AggregateCounter::WriteFormat format,
-	    uint32_t *buffer, int pos, double count, ErrorHandler *)
-{
-    if (format == AggregateCounter::WR_BINARY)
-	ignore_result(fwrite(buffer, sizeof(uint32_t), pos, f));
-    else if (format == AggregateCounter::WR_TEXT_IP)
-	for (int i = 0; i < pos; i += 2)
-	    fprintf(f, "%d.%d.%d.%d %u\n", (buffer[i] >> 24) & 255, (buffer[i] >> 16) & 255, (buffer[i] >> 8) & 255, buffer[i] & 255, buffer[i+1]);
-    else if (format == AggregateCounter::WR_TEXT_PDF)
-	for (int i = 0; i < pos; i += 2)
-	    fprintf(f, "%u %.12g\n", buffer[i], buffer[i+1] / count);
-    else if (format == AggregateCounter::WR_TEXT)
-	for (int i = 0; i < pos; i += 2)
-	    fprintf(f, "%u %u\n", buffer[i], buffer[i+1]);
-}
-
 void
-AggregateCounter::write_nodes(Node *n, FILE *f, WriteFormat format,
-			      uint32_t *buffer, int &pos, int len,
-			      ErrorHandler *errh) const
+AggregateCounter::write_job(Job *j)
 {
-    if (n->count > 0) {
-	buffer[pos++] = n->aggregate;
-	buffer[pos++] = n->count;
-	if (pos == len) {
-	    write_batch(f, format, buffer, pos, _count, errh);
-	    pos = 0;
+    double count = j->ac->_count;
+    Vector<uint64_t> v;
+    for (const Subtree *t = j->ac->_sub + j->begin; t != j->ac->_sub + j->end; ++t) {
+	if (!t->size)
+	    continue;
+	v.clear();
+	for (uint32_t *slot = t->slots; slot != t->slots + 2 * t->capacity; slot += 2)
+	    if (slot[1])
+		v.push_back(((uint64_t) slot[0] << 32) | slot[1]);
+	click_qsort(v.begin(), v.size(), sizeof(uint64_t), uint64_compar);
+
+	for (uint64_t *it = v.begin(); it != v.end(); ++it) {
+	    uint32_t a = *it >> 32, c = (uint32_t) *it;
+	    if (j->format == WR_BINARY) {
+		uint32_t buf[2] = { a, c };
+		j->sa.append(reinterpret_cast<const char *>(buf), sizeof(buf));
+	    } else if (j->format == WR_TEXT_IP)
+		j->sa.snprintf(32, "%d.%d.%d.%d %u\n", (a >> 24) & 255, (a >> 16) & 255, (a >> 8) & 255, a & 255, c);
+	    else if (j->format == WR_TEXT_PDF)
+		j->sa.snprintf(48, "%u %.12g\n", a, c / count);
+	    else
+		j->sa << a << ' ' << c << '\n';
 	}
-    }
 
-    if (n->child[0])
-	write_nodes(n->child[0], f, format, buffer, pos, len, errh);
-    if (n->child[1])
-	write_nodes(n->child[1], f, format, buffer, pos, len, errh);
+	if (j->out) {
+	    ignore_result(fwrite(j->sa.data(), 1, j->sa.length(), j->out));
+	    j->sa.clear();
+	}
+    }
 }
 
 int
@@ -399,11 +459,18 @@ AggregateCounter::write_file(String where, WriteFormat format,
     } else if (format == WR_TEXT_IP)
 	fprintf(f, "!ip\n");
 
-    uint32_t buf[1024];
-    int pos = 0;
-    write_nodes(_root, f, format, buf, pos, 1024, errh);
-    if (pos)
-	write_batch(f, format, buf, pos, _count, errh);
+    // Each thread formats its range into memory; a single thread writes
+    // each subtree as it goes.
+    Job *jobs = new Job[_threads];
+    int njobs = split_subtrees(jobs, _threads);
+    for (int i = 0; i < njobs; ++i)
+	jobs[i].format = format;
+    if (njobs == 1)
+	jobs[0].out = f;
+    run_jobs(jobs, njobs, write_job);
+    for (int i = 0; i < njobs; ++i)
+	ignore_result(fwrite(jobs[i].sa.data(), 1, jobs[i].sa.length(), f));
+    delete[] jobs;
 
     bool had_err = ferror(f);
     if (f != stdout)
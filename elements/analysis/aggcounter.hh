@@ -97,6 +97,12 @@ them.
 String. This banner is written to the head of any output file. It should
 probably begin with a comment character, like '!' or '#'. Default is empty.
 
+=item THREADS
+
+Unsigned. Number of threads used to write files and to recalculate counters
+for C<counts_pdf>. Only useful in multithreaded user-level Click. Default is
+1.
+
 =back
 
 =h write_file write-only
@@ -165,6 +171,10 @@ Returns the number of aggregates that have been seen so far.
 
 =n
 
+Counters are kept in 256 open-addressed hash tables, one for each value of
+the aggregate's most significant byte, so updating a counter usually costs
+one cache miss. Files are written in increasing order of aggregate.
+
 The aggregate identifier is stored in host byte order. Thus, the aggregate ID
 corresponding to IP address 128.0.0.0 is 2147483648.
 
@@ -214,12 +224,18 @@ class AggregateCounter : public Element { public:
 
   private:
 
-    struct Node {
-	uint32_t aggregate;
-	uint32_t count;
-	Node *child[2];
+    // Aggregates with the same most significant byte share a subtree: an
+    // open-addressed table of (aggregate, count) pairs.  A zero count marks
+    // an empty slot.
+    struct Subtree {
+	uint32_t *slots;
+	uint32_t capacity;	// in pairs; 0 or a power of 2
+	uint32_t size;
+	int shift;		// 32 - log2(capacity)
     };
 
+    enum { nsubtrees = 256, subtree_shift = 24, initial_capacity = 16 };
+
     bool _bytes : 1;
     bool _ip_bytes : 1;
     bool _use_packet_count : 1;
@@ -227,11 +243,10 @@ class AggregateCounter : public Element { public:
     bool _frozen;
     bool _active;
 
-    Node *_root;
-    Node *_free;
-    Vector<Node *> _blocks;
+    Subtree _sub[nsubtrees];
     uint32_t _num_nonzero;
     uint64_t _count;
+    int _threads;
 
     uint32_t _call_nnz;
     HandlerCall *_call_nnz_h;
@@ -240,38 +255,39 @@ class AggregateCounter : public Element { public:
 
     String _output_banner;
 
-    Node *new_node();
-    Node *new_node_block();
-    void free_node(Node *);
+    inline uint32_t *find_slot(uint32_t);
+    uint32_t *insert_slot(uint32_t);
+    bool grow(Subtree &);
+    void free_subtrees();
 
-    Node *make_peer(uint32_t, Node *, bool frozen);
-    Node *find_node(uint32_t, bool frozen = false);
-    void reaggregate_node(Node *);
-    void clear_node(Node *);
+    struct Job;
+    void run_jobs(Job *, int njobs, void (*)(Job *)) const;
+    int split_subtrees(Job *, int njobs) const;
+    static void histogram_job(Job *);
+    static void write_job(Job *);
 
-    void write_nodes(Node *, FILE *, WriteFormat, uint32_t *, int &, int, ErrorHandler *) const;
     static int write_file_handler(const String &, Element *, void *, ErrorHandler *);
     static String read_handler(Element *, void *);
     static int write_handler(const String &, Element *, void *, ErrorHandler *);
 
 };
 
-inline AggregateCounter::Node *
-AggregateCounter::new_node()
-{
-    if (_free) {
-	Node *n = _free;
-	_free = n->child[0];
-	return n;
-    } else
-	return new_node_block();
-}
-
-inline void
-AggregateCounter::free_node(Node *n)
+/** @brief Return the count for aggregate @a a, or null if it has none. */
+inline uint32_t *
+AggregateCounter::find_slot(uint32_t a)
 {
-    n->child[0] = _free;
-    _free = n;
+    Subtree &t = _sub[a >> subtree_shift];
+    if (!t.size)
+	return 0;
+    uint32_t i = (a * 0x9E3779B1U) >> t.shift;
+    while (1) {
+	uint32_t *slot = &t.slots[2 * i];
+	if (slot[1] == 0)
+	    return 0;
+	if (slot[0] == a)
+	    return &slot[1];
+	i = (i + 1) & (t.capacity - 1);
+    }
 }
 
 CLICK_ENDDECLS
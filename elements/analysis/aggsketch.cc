@@ -0,0 +1,305 @@
+/*
+ * aggsketch.{cc,hh} -- base class for fixed-memory aggregate sketches
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "aggsketch.hh"
+#include <click/handlercall.hh>
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/packet_anno.hh>
+#include <click/master.hh>
+CLICK_DECLS
+
+AggregateSketch::AggregateSketch()
+    : _nshards(0), _shards(0), _timer(this), _epoch_call_h(0)
+{
+}
+
+AggregateSketch::~AggregateSketch()
+{
+}
+
+int
+AggregateSketch::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    bool bytes = false;
+    bool ip_bytes = false;
+    bool packet_count = true;
+    bool extra_length = true;
+    String epoch_call;
+    _epoch = Timestamp();
+
+    if (Args(conf, this, errh)
+	.read("BYTES", bytes)
+	.read("IP_BYTES", ip_bytes)
+	.read("MULTIPACKET", packet_count)
+	.read("EXTRA_LENGTH", extra_length)
+	.read("EPOCH", _epoch)
+	.read("EPOCH_CALL", AnyArg(), epoch_call)
+	.read("BANNER", _output_banner).complete() < 0)
+	return -1;
+
+    _bytes = bytes;
+    _ip_bytes = ip_bytes;
+    _use_packet_count = packet_count;
+    _use_extra_length = extra_length;
+
+    if (epoch_call && !_epoch)
+	return errh->error("EPOCH_CALL requires EPOCH");
+    if (epoch_call)
+	_epoch_call_h = new HandlerCall(epoch_call);
+    return 0;
+}
+
+int
+AggregateSketch::initialize(ErrorHandler *errh)
+{
+    if (_epoch_call_h && _epoch_call_h->initialize_write(this, errh) < 0)
+	return -1;
+
+    _nshards = master()->nthreads();
+    if (_nshards < 1)
+	_nshards = 1;
+    _shards = new Shard[_nshards];
+    if (initialize_shards(errh) < 0)
+	return -1;
+    clear();
+
+    _active = true;
+    _timer.initialize(this);
+    if (_epoch)
+	_timer.schedule_after(_epoch);
+    return 0;
+}
+
+void
+AggregateSketch::cleanup(CleanupStage)
+{
+    delete[] _shards;
+    _shards = 0;
+    delete _epoch_call_h;
+    _epoch_call_h = 0;
+}
+
+inline void
+AggregateSketch::count_packet(Packet *p)
+{
+    if (!_active)
+	return;
+
+    uint32_t amount;
+    if (!_bytes)
+	amount = 1 + (_use_packet_count ? EXTRA_PACKETS_ANNO(p) : 0);
+    else {
+	amount = p->length() + (_use_extra_length ? EXTRA_LENGTH_ANNO(p) : 0);
+	if (_ip_bytes && p->has_network_header())
+	    amount -= p->network_header_offset();
+    }
+
+    int i = click_current_shard(_nshards);
+    Shard &sh = _shards[i];
+    sh.lock.acquire();
+    update(i, p, amount);
+    sh.count += amount;
+    sh.lock.release();
+}
+
+void
+AggregateSketch::push(int, Packet *p)
+{
+    count_packet(p);
+    output(0).push(p);
+}
+
+Packet *
+AggregateSketch::pull(int)
+{
+    Packet *p = input(0).pull();
+    if (p)
+	count_packet(p);
+    return p;
+}
+
+void
+AggregateSketch::run_timer(Timer *)
+{
+    if (_epoch_call_h)
+	(void) _epoch_call_h->call_write();
+    clear();
+    _timer.reschedule_after(_epoch);
+}
+
+void
+AggregateSketch::lock_all()
+{
+    for (int i = 0; i < _nshards; ++i)
+	_shards[i].lock.acquire();
+}
+
+void
+AggregateSketch::unlock_all()
+{
+    for (int i = _nshards - 1; i >= 0; --i)
+	_shards[i].lock.release();
+}
+
+void
+AggregateSketch::clear()
+{
+    lock_all();
+    for (int i = 0; i < _nshards; ++i) {
+	clear_shard(i);
+	_shards[i].count = 0;
+    }
+    unlock_all();
+}
+
+
+// HANDLERS
+
+static int
+record_compar(const void *ap, const void *bp, void *)
+{
+    uint32_t a = static_cast<const AggregateSketch::Record *>(ap)->aggregate;
+    uint32_t b = static_cast<const AggregateSketch::Record *>(bp)->aggregate;
+    return a < b ? -1 : a != b;
+}
+
+int
+AggregateSketch::write_file(String where, WriteFormat format,
+			    ErrorHandler *errh)
+{
+    Vector<Record> records;
+    lock_all();
+    collect(records);
+    unlock_all();
+    if (records.size())
+	click_qsort(records.begin(), records.size(), sizeof(Record), record_compar);
+
+    FILE *f;
+    if (where == "-")
+	f = stdout;
+    else
+	f = fopen(where.c_str(), (format == WR_BINARY ? "wb" : "w"));
+    if (!f)
+	return errh->error("%s: %s", where.c_str(), strerror(errno));
+
+    // same format as AggregateCounter
+    fprintf(f, "!IPAggregate 1.0\n");
+    ignore_result(fwrite(_output_banner.data(), 1, _output_banner.length(), f));
+    if (_output_banner.length() && _output_banner.back() != '\n')
+	fputc('\n', f);
+    fprintf(f, "!num_nonzero %d\n", records.size());
+    if (format == WR_BINARY) {
+#if CLICK_BYTE_ORDER == CLICK_BIG_ENDIAN
+	fprintf(f, "!packed_be\n");
+#elif CLICK_BYTE_ORDER == CLICK_LITTLE_ENDIAN
+	fprintf(f, "!packed_le\n");
+#else
+	format = WR_TEXT;
+#endif
+    } else if (format == WR_TEXT_IP)
+	fprintf(f, "!ip\n");
+
+    for (Record *r = records.begin(); r != records.end(); ++r) {
+	uint32_t a = r->aggregate;
+	uint32_t c = r->count > 0xFFFFFFFFU ? 0xFFFFFFFFU : (uint32_t) r->count;
+	if (format == WR_BINARY) {
+	    uint32_t buf[2] = { a, c };
+	    ignore_result(fwrite(buf, sizeof(uint32_t), 2, f));
+	} else if (format == WR_TEXT_IP)
+	    fprintf(f, "%d.%d.%d.%d %u\n", (a >> 24) & 255, (a >> 16) & 255, (a >> 8) & 255, a & 255, c);
+	else
+	    fprintf(f, "%u %u\n", a, c);
+    }
+
+    bool had_err = ferror(f);
+    if (f != stdout)
+	fclose(f);
+    else
+	fflush(f);
+    if (had_err)
+	return errh->error("%s: file error", where.c_str());
+    else
+	return 0;
+}
+
+int
+AggregateSketch::write_file_handler(const String &data, Element *e, void *thunk, ErrorHandler *errh)
+{
+    AggregateSketch *as = static_cast<AggregateSketch *>(e);
+    String fn;
+    if (!FilenameArg().parse(cp_uncomment(data), fn))
+	return errh->error("argument should be filename");
+    int int_thunk = (intptr_t)thunk;
+    return as->write_file(fn, (WriteFormat)int_thunk, errh);
+}
+
+enum { AS_BANNER, AS_CLEAR, AS_COUNT };
+
+String
+AggregateSketch::read_handler(Element *e, void *thunk)
+{
+    AggregateSketch *as = static_cast<AggregateSketch *>(e);
+    switch ((intptr_t)thunk) {
+      case AS_BANNER:
+	return as->_output_banner;
+      case AS_COUNT: {
+	  uint64_t count = 0;
+	  for (int i = 0; i < as->_nshards; ++i)
+	      count += as->_shards[i].count;
+	  return String(count);
+      }
+      default:
+	return "<error>";
+    }
+}
+
+int
+AggregateSketch::write_handler(const String &data, Element *e, void *thunk, ErrorHandler *errh)
+{
+    AggregateSketch *as = static_cast<AggregateSketch *>(e);
+    switch ((intptr_t)thunk) {
+      case AS_BANNER:
+	as->_output_banner = data;
+	if (data && data.back() != '\n')
+	    as->_output_banner += '\n';
+	else if (data && data.length() == 1)
+	    as->_output_banner = "";
+	return 0;
+      case AS_CLEAR:
+	as->clear();
+	return 0;
+      default:
+	return errh->error("internal error");
+    }
+}
+
+void
+AggregateSketch::add_handlers()
+{
+    add_write_handler("write_text_file", write_file_handler, WR_TEXT);
+    add_write_handler("write_ascii_file", write_file_handler, WR_TEXT);
+    add_write_handler("write_file", write_file_handler, WR_BINARY);
+    add_write_handler("write_ip_file", write_file_handler, WR_TEXT_IP);
+    add_data_handlers("active", Handler::OP_READ | Handler::OP_WRITE | Handler::CHECKBOX, &_active);
+    add_read_handler("banner", read_handler, AS_BANNER);
+    add_write_handler("banner", write_handler, AS_BANNER, Handler::RAW);
+    add_write_handler("clear", write_handler, AS_CLEAR, Handler::BUTTON);
+    add_read_handler("count", read_handler, AS_COUNT);
+}
+
+ELEMENT_REQUIRES(userlevel int64)
+ELEMENT_PROVIDES(AggregateSketch)
+CLICK_ENDDECLS
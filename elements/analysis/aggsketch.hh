@@ -0,0 +1,185 @@
+#ifndef CLICK_AGGSKETCH_HH
+#define CLICK_AGGSKETCH_HH
+#include <click/element.hh>
+#include <click/timer.hh>
+#include <click/sync.hh>
+#include <click/hashtable.hh>
+#include <click/hashcode.hh>
+#include <click/heap.hh>
+CLICK_DECLS
+class HandlerCall;
+
+/** @class AggregateSketch
+ * @brief Base class for fixed-memory aggregate sketches.
+ *
+ * AggregateSketch implements the parts shared by CountMinSketch,
+ * HyperLogLog, and HeavyHitters: packet and byte accounting as in
+ * AggregateCounter, one shard of sketch state per thread, periodic epochs,
+ * and dump handlers that write AggregateCounter's file formats.
+ *
+ * Subclasses keep one sketch per shard.  update() is called with the
+ * calling thread's shard locked; collect() and clear_shard() are called with
+ * every shard locked, and collect() must merge the shards' states.  Locks
+ * are uncontended on the packet path, since each thread has its own
+ * shard. */
+class AggregateSketch : public Element { public:
+
+    AggregateSketch();
+    ~AggregateSketch();
+
+    const char *port_count() const	{ return PORTS_1_1; }
+
+    int configure(Vector<String> &, ErrorHandler *);
+    int initialize(ErrorHandler *);
+    void cleanup(CleanupStage);
+    void add_handlers();
+
+    void push(int, Packet *);
+    Packet *pull(int);
+    void run_timer(Timer *);
+
+    struct Record {
+	uint32_t aggregate;
+	uint64_t count;
+    };
+
+    enum WriteFormat { WR_TEXT = 0, WR_BINARY = 1, WR_TEXT_IP = 2 };
+    int write_file(String, WriteFormat, ErrorHandler *);
+    void clear();
+
+  protected:
+
+    int _nshards;
+
+    virtual int initialize_shards(ErrorHandler *) = 0;
+    virtual void clear_shard(int shard) = 0;
+    virtual void update(int shard, Packet *p, uint32_t amount) = 0;
+    virtual void collect(Vector<Record> &) = 0;
+
+    void lock_all();
+    void unlock_all();
+
+    static inline uint32_t hashcode(uint32_t x, uint32_t seed) {
+	return hash_mix32((x ^ seed) * 0x9E3779B1U);
+    }
+
+  private:
+
+    struct Shard {
+	Spinlock lock;
+	uint64_t count;
+    } CLICK_ALIGNED(CLICK_CACHE_LINE_SIZE);
+
+    Shard *_shards;
+    bool _bytes : 1;
+    bool _ip_bytes : 1;
+    bool _use_packet_count : 1;
+    bool _use_extra_length : 1;
+    bool _active;
+
+    Timestamp _epoch;
+    Timer _timer;
+    HandlerCall *_epoch_call_h;
+    String _output_banner;
+
+    inline void count_packet(Packet *p);
+
+    static int write_file_handler(const String &, Element *, void *, ErrorHandler *);
+    static String read_handler(Element *, void *);
+    static int write_handler(const String &, Element *, void *, ErrorHandler *);
+
+};
+
+/** @class SketchTopK
+ * @brief The K aggregates with the largest counts, in a min-heap.
+ *
+ * HeavyHitters uses SketchTopK as a Space-Saving summary, and
+ * CountMinSketch uses it to remember the aggregates with the largest
+ * estimates. */
+class SketchTopK { public:
+
+    struct Entry {
+	uint32_t key;
+	uint64_t count;
+	uint64_t error;
+    };
+
+    SketchTopK()
+	: _pos(-1), _k(0) {
+    }
+
+    void reset(int k) {
+	_heap.clear();
+	_pos.clear();
+	_k = k;
+    }
+
+    int size() const {
+	return _heap.size();
+    }
+    bool full() const {
+	return _heap.size() >= _k;
+    }
+    const Entry &min() const {
+	return _heap[0];
+    }
+    const Vector<Entry> &entries() const {
+	return _heap;
+    }
+
+    Entry *find(uint32_t key) {
+	int i = _pos.get(key);
+	return i < 0 ? 0 : &_heap[i];
+    }
+
+    /** @brief Add @a key, replacing the minimum entry if the heap is full.
+     * @pre find(@a key) == 0 */
+    void insert(uint32_t key, uint64_t count, uint64_t error) {
+	if (_k <= 0)
+	    return;
+	if (full()) {
+	    _pos.erase(_heap[0].key);
+	    _heap[0].key = key;
+	    _heap[0].count = count;
+	    _heap[0].error = error;
+	    changed(_heap.begin());
+	} else {
+	    Entry e;
+	    e.key = key;
+	    e.count = count;
+	    e.error = error;
+	    _heap.push_back(e);
+	    push_heap(_heap.begin(), _heap.end(), heap_less(), heap_place(&_pos));
+	}
+    }
+
+    /** @brief Restore heap order after @a e's count increased. */
+    void changed(Entry *e) {
+	change_heap(_heap.begin(), _heap.end(), e, heap_less(), heap_place(&_pos));
+    }
+
+  private:
+
+    Vector<Entry> _heap;
+    HashTable<uint32_t, int> _pos;
+    int _k;
+
+    struct heap_less {
+	bool operator()(const Entry &a, const Entry &b) const {
+	    return a.count < b.count;
+	}
+    };
+    struct heap_place {
+	HashTable<uint32_t, int> *pos;
+	heap_place(HashTable<uint32_t, int> *p)
+	    : pos(p) {
+	}
+	void operator()(Entry *begin, Entry *it) {
+	    pos->set(it->key, it - begin);
+	}
+    };
+
+};
+
+CLICK_ENDDECLS
+#endif
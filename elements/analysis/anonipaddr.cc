@@ -25,7 +25,10 @@
 #include <clicknet/udp.h>
 #include <clicknet/icmp.h>
 #include <click/llrpc.h>
+#include <click/straccum.hh>
+#include <click/ipaddress.hh>
 #include <click/integers.hh>	// for first_bit_set
+#include <click/master.hh>
 #ifdef CLICK_USERLEVEL
 # include <unistd.h>
 # include <time.h>
@@ -33,7 +36,7 @@
 CLICK_DECLS
 
 AnonymizeIPAddr::AnonymizeIPAddr()
-    : _root(0), _free(0)
+    : _root(0), _free(0), _top(0), _cache(0)
 {
 }
 
@@ -67,16 +70,35 @@ int
 AnonymizeIPAddr::configure(Vector<String> &conf, ErrorHandler *errh)
 {
     _preserve_class = 0;
-    String preserve_8;
-    bool seed_ignored;
+    String preserve_8, key;
+    bool seed_ignored, cryptopan_set;
+    _cryptopan = false;
+    _cache_size = 65536;
 
     if (Args(conf, this, errh)
 	.read("CLASS", _preserve_class)
 	.read("PRESERVE_8", AnyArg(), preserve_8)
 	.read("SEED", seed_ignored)
+	.read("CRYPTOPAN", _cryptopan).read_status(cryptopan_set)
+	.read("KEY", StringArg(), key)
+	.read("CACHE", _cache_size)
 	.complete() < 0)
 	return -1;
 
+    if (key) {
+	if (cryptopan_set && !_cryptopan)
+	    return errh->error("KEY requires CRYPTOPAN");
+	if (key.length() != CryptoPAn::key_size)
+	    return errh->error("KEY must be %d bytes long", CryptoPAn::key_size);
+	_cryptopan = true;
+	_cp.set_key(reinterpret_cast<const unsigned char *>(key.data()));
+    } else if (_cryptopan) {
+	unsigned char random_key[CryptoPAn::key_size];
+	for (int i = 0; i < CryptoPAn::key_size; ++i)
+	    random_key[i] = click_random(0, 255);
+	_cp.set_key(random_key);
+    }
+
     // check CLASS value
     if (_preserve_class == 99)	// allow 99 as synonym for 32
 	_preserve_class = 32;
@@ -101,6 +123,9 @@ AnonymizeIPAddr::configure(Vector<String> &conf, ErrorHandler *errh)
 int
 AnonymizeIPAddr::initialize(ErrorHandler *errh)
 {
+    if (_cryptopan)
+	return initialize_cryptopan(errh);
+
     if (!(_root = new_node()))
 	return errh->error("out of memory!");
     _root->input = 1;		// use 1 instead of 0 b/c 0.0.0.0 is special
@@ -144,6 +169,10 @@ AnonymizeIPAddr::cleanup(CleanupStage)
     for (int i = 0; i < _blocks.size(); i++)
 	delete[] _blocks[i];
     _blocks.clear();
+    delete[] _top;
+    delete[] _cache;
+    _top = 0;
+    _cache = 0;
 }
 
 uint32_t
@@ -227,15 +256,110 @@ AnonymizeIPAddr::find_node(uint32_t a)
     return 0;
 }
 
+inline bool
+AnonymizeIPAddr::forced_zero(uint32_t a, int pos) const
+{
+    // CLASS preserves leading one bits
+    if (pos < _preserve_class && (pos == 0 || (~a >> (32 - pos)) == 0))
+	return true;
+    // PRESERVE_8 preserves every prefix of the listed nets
+    if (pos < 8)
+	for (const uint32_t *it = _preserve_8.begin(); it != _preserve_8.end(); ++it)
+	    if (pos == 0 || (*it >> (8 - pos)) == (a >> (32 - pos)))
+		return true;
+    return false;
+}
+
+int
+AnonymizeIPAddr::initialize_cryptopan(ErrorHandler *errh)
+{
+    // Flip bit p depends only on the first p bits, so each prefix shorter
+    // than 16 bits costs one encryption.
+    if (!(_top = new uint16_t[65536]))
+	return errh->error("out of memory!");
+    memset(_top, 0, sizeof(uint16_t) * 65536);
+    for (int pos = 0; pos < 16; ++pos)
+	for (uint32_t v = 0; v < (1U << pos); ++v) {
+	    uint32_t a = (pos ? v << (32 - pos) : 0);
+	    if (forced_zero(a, pos) || !_cp.flip(a, pos))
+		continue;
+	    uint32_t first = v << (16 - pos), last = (v + 1) << (16 - pos);
+	    for (uint32_t x = first; x != last; ++x)
+		_top[x] |= 0x8000 >> pos;
+	}
+
+#if SIZEOF_VOID_P == 4 && HAVE_MULTITHREAD
+    // A 32-bit target may split a cache entry's 64-bit store in two, so
+    // another thread could read half of an old entry and half of a new one.
+    if (master()->nthreads() > 1)
+	_cache_size = 0;
+#endif
+    _cache_shift = 32;
+    if (_cache_size) {
+	uint32_t n = 1;
+	while (n < _cache_size && n < 0x10000000U)
+	    n <<= 1, --_cache_shift;
+	_cache_size = n;
+	if (!(_cache = new uint64_t[n]))
+	    return errh->error("out of memory!");
+	memset(_cache, 0, sizeof(uint64_t) * n);
+    }
+    return 0;
+}
+
+uint32_t
+AnonymizeIPAddr::cryptopan_addr(uint32_t a)
+{
+    // 0.0.0.0 and 255.255.255.255 map to themselves, unlike in the
+    // reference implementation, and 0 marks an empty cache slot
+    if (a == 0 || a == 0xFFFFFFFFU)
+	return a;
+
+    uint64_t *slot = 0;
+    if (_cache) {
+	slot = &_cache[(uint32_t) (a * 0x9E3779B1U) >> _cache_shift];
+	uint64_t e = *slot;
+	if ((uint32_t) (e >> 32) == a)
+	    return (uint32_t) e;
+    }
+
+    uint32_t flips = (uint32_t) _top[a >> 16] << 16;
+    for (int pos = 16; pos < 32; ++pos)
+	if (!forced_zero(a, pos) && _cp.flip(a, pos))
+	    flips |= 0x80000000U >> pos;
+    uint32_t out = a ^ flips;
+
+    // a single store, so threads sharing the cache see whole entries on
+    // 64-bit targets; see initialize_cryptopan()
+    if (slot)
+	*slot = ((uint64_t) a << 32) | out;
+    return out;
+}
+
 inline uint32_t
 AnonymizeIPAddr::anonymize_addr(uint32_t a)
 {
-    if (Node *n = find_node(ntohl(a)))
+    if (_cryptopan)
+	return htonl(cryptopan_addr(ntohl(a)));
+    else if (Node *n = find_node(ntohl(a)))
 	return htonl(n->output);
     else
 	return 0;
 }
 
+void
+AnonymizeIPAddr::anonymize_addrs(uint32_t *a, int n)
+{
+    uint32_t last_in = 0, last_out = 0;
+    for (uint32_t *end = a + n; a != end; ++a)
+	if (*a == last_in)
+	    *a = last_out;
+	else {
+	    last_in = *a;
+	    *a = last_out = anonymize_addr(last_in);
+	}
+}
+
 void
 AnonymizeIPAddr::handle_icmp(WritablePacket *q)
 {
@@ -314,5 +438,33 @@ AnonymizeIPAddr::llrpc(unsigned command, void *data)
 	return Element::llrpc(command, data);
 }
 
+int
+AnonymizeIPAddr::map_handler(int, String &s, Element *e, const Handler *, ErrorHandler *errh)
+{
+    AnonymizeIPAddr *a = static_cast<AnonymizeIPAddr *>(e);
+    Vector<String> words;
+    cp_spacevec(s, words);
+    Vector<uint32_t> addrs(words.size(), 0);
+    for (int i = 0; i < words.size(); ++i) {
+	IPAddress addr;
+	if (!IPAddressArg().parse(words[i], addr, a))
+	    return errh->error("expected IP addresses");
+	addrs[i] = addr.addr();
+    }
+    a->anonymize_addrs(addrs.begin(), addrs.size());
+    StringAccum sa;
+    for (int i = 0; i < addrs.size(); ++i)
+	sa << (i ? " " : "") << IPAddress(addrs[i]);
+    s = sa.take_string();
+    return 0;
+}
+
+void
+AnonymizeIPAddr::add_handlers()
+{
+    set_handler("map", Handler::OP_READ | Handler::READ_PARAM, map_handler);
+}
+
 CLICK_ENDDECLS
+ELEMENT_REQUIRES(CryptoPAn)
 EXPORT_ELEMENT(AnonymizeIPAddr)
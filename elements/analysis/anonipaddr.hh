@@ -2,6 +2,7 @@
 #ifndef CLICK_ANONIPADDR_HH
 #define CLICK_ANONIPADDR_HH
 #include <click/element.hh>
+#include "cryptopan.hh"
 CLICK_DECLS
 
 /*
@@ -23,7 +24,7 @@ p-bit prefix. AnonymizeIPAddr was based on Greg Minshall's tcpdpriv(1); see
 L<http://ita.ee.lbl.gov/html/contrib/tcpdpriv.html|http://ita.ee.lbl.gov/html/contrib/tcpdpriv.html>.
 
 The special IP addresses 0.0.0.0 and 255.255.255.255 are always mapped to
-themselves, independent of any other mapping.
+themselves, independent of any other mapping, even with CRYPTOPAN.
 
 AnonymizeIPAddr also incrementally updates the IP header checksum, so the new
 header is correct iff the old header was correct.
@@ -46,6 +47,22 @@ preserves classes A, B, C, and D. The CLASS flag works by preserving leading
 one bits; higher CLASSes, up to 32, preserve more one bits. Default CLASS is 0
 E<lparen>no preservation).
 
+=item CRYPTOPAN
+
+Boolean. If true, use Crypto-PAn anonymization instead of tcpdpriv's; see
+below. Default is true if KEY is given and false otherwise.
+
+=item KEY
+
+String. The 32-byte Crypto-PAn key; see the example below. Implies CRYPTOPAN.
+Default is a random key.
+
+=item CACHE
+
+Unsigned. Number of Crypto-PAn results to cache, rounded up to a power of two.
+0 disables the cache. Default is 65536. On 32-bit targets, the cache is
+disabled when Click runs more than one thread; see below.
+
 =item PRESERVE_8
 
 Space-separated list of integers. Preserve the listed 8-bit prefixes. For
@@ -74,7 +91,27 @@ to each other. Here is the complete list:
 
 =n
 
-AnonymizeIPAddr's anonymization corresponds to tcpdpriv's -A50 option.
+AnonymizeIPAddr's default anonymization corresponds to tcpdpriv's -A50 option.
+It grows a randomized tree as new addresses arrive, so its mapping depends on
+the order in which addresses are seen, and it must not be used by more than
+one thread at a time.
+
+With CRYPTOPAN, AnonymizeIPAddr instead implements Crypto-PAn (Xu, Fan, Ammar,
+and Moon, "Prefix-Preserving IP Address Anonymization", ICNP 2002). The
+mapping is a deterministic function of KEY: two runs, or two
+AnonymizeIPAddr elements, with the same KEY and options anonymize every
+address the same way, and without CLASS or PRESERVE_8 the mapping matches the
+Crypto-PAn reference implementation, except for 0.0.0.0 and
+255.255.255.255, which the reference anonymizes like any other address. Each
+output bit costs one AES
+encryption, so AnonymizeIPAddr precomputes the bits for every 16-bit prefix
+at initialization (65536 encryptions and 128 kB), and caches the results for
+recently seen addresses. Crypto-PAn state is read-only after initialization,
+apart from the cache, so several threads can anonymize packets through one
+AnonymizeIPAddr at once. Each cache entry is written with a single 64-bit
+store, which other threads see whole only on 64-bit targets; 32-bit targets
+may split the store, so there the cache is disabled when Click runs more than
+one thread.
 
 Prefix-preserving anonymization is not foolproof. The L<http://ita.ee.lbl.gov/html/contrib/tcpdpriv.html|tcpdpriv distribution> contains a paper describing the possible attack. Tatu Ylonen closes that document by saying: "If you are
 very concerned about leaking your network topology, I would not
@@ -87,6 +124,22 @@ Argument is a pointer to an IP address. An IP address is read from that
 location; the corresponding anonymized IP address is then stored into that
 location.
 
+=h map read-only
+
+Takes a space-separated list of IP addresses and returns the corresponding
+anonymized addresses. Like the llrpc, this handler extends the tcpdpriv-style
+mapping as a side effect.
+
+=e
+
+Anonymize a trace with a fixed Crypto-PAn key, using Click's hex string
+syntax:
+
+   FromDump(in.pcap, STOP true, FORCE_IP true)
+      -> AnonymizeIPAddr(KEY "\<15 22 17 8d 33 a4 cf 80 13 0a 5b 16 49 90 7d 10
+                              d8 98 8f 83 79 79 65 27 62 57 4c 2d 2a 84 22 02>")
+      -> ToDump(out.pcap);
+
 =a
 
 tcpdpriv(1) */
@@ -103,10 +156,19 @@ class AnonymizeIPAddr : public Element { public:
     int initialize(ErrorHandler *);
     void cleanup(CleanupStage);
 
+    void add_handlers();
+
     Packet *simple_action(Packet *);
 
     int llrpc(unsigned, void *);
 
+    /** @brief Anonymize the @a n addresses at @a a in place.
+     *
+     * Addresses are in network byte order.  This is cheaper than anonymizing
+     * addresses one at a time when the array contains runs of equal
+     * addresses, as traces do. */
+    void anonymize_addrs(uint32_t *a, int n);
+
   private:
 
     struct Node {
@@ -123,6 +185,14 @@ class AnonymizeIPAddr : public Element { public:
     int _preserve_class;
     Vector<uint32_t> _preserve_8;
 
+    bool _cryptopan;
+    CryptoPAn _cp;
+    uint16_t *_top;		// flip bits for each 16-bit prefix
+    uint64_t *_cache;		// (input << 32) | output; 0 is empty, since
+				// 0.0.0.0 is never looked up
+    uint32_t _cache_size;
+    int _cache_shift;
+
     Node *new_node();
     Node *new_node_block();
     void free_node(Node *);
@@ -132,6 +202,12 @@ class AnonymizeIPAddr : public Element { public:
     Node *find_node(uint32_t);
     inline uint32_t anonymize_addr(uint32_t);
 
+    int initialize_cryptopan(ErrorHandler *);
+    inline bool forced_zero(uint32_t, int) const;
+    uint32_t cryptopan_addr(uint32_t);
+
+    static int map_handler(int, String &, Element *, const Handler *, ErrorHandler *);
+
     void handle_icmp(WritablePacket *);
 
 };
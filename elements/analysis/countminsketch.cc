@@ -0,0 +1,181 @@
+/*
+ * countminsketch.{cc,hh} -- estimate per-aggregate counts with a Count-Min
+ * sketch
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "countminsketch.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/packet_anno.hh>
+#include <click/ipaddress.hh>
+CLICK_DECLS
+
+CountMinSketch::CountMinSketch()
+{
+}
+
+CountMinSketch::~CountMinSketch()
+{
+}
+
+int
+CountMinSketch::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    uint32_t width = 2048;
+    _depth = 4;
+    _topk = 100;
+    _conservative = true;
+    if (Args(this, errh).bind(conf)
+	.read("WIDTH", width)
+	.read("DEPTH", _depth)
+	.read("TOPK", _topk)
+	.read("CONSERVATIVE", _conservative)
+	.consume() < 0)
+	return -1;
+    if (width == 0 || width > 0x10000000U)
+	return errh->error("WIDTH out of range");
+    if (_depth < 1 || _depth > max_depth)
+	return errh->error("DEPTH must be between 1 and %d", (int) max_depth);
+    if (_topk < 0)
+	return errh->error("TOPK must be nonnegative");
+    for (_width = 1; _width < width; _width <<= 1)
+	/* nada */;
+    return AggregateSketch::configure(conf, errh);
+}
+
+int
+CountMinSketch::initialize_shards(ErrorHandler *errh)
+{
+    _shards.resize(_nshards);
+    for (Shard *s = _shards.begin(); s != _shards.end(); ++s)
+	if (!(s->counters = new uint64_t[_width * _depth]))
+	    return errh->error("out of memory");
+    return 0;
+}
+
+void
+CountMinSketch::cleanup(CleanupStage stage)
+{
+    for (Shard *s = _shards.begin(); s != _shards.end(); ++s)
+	delete[] s->counters;
+    _shards.clear();
+    AggregateSketch::cleanup(stage);
+}
+
+void
+CountMinSketch::clear_shard(int shard)
+{
+    Shard &s = _shards[shard];
+    memset(s.counters, 0, sizeof(uint64_t) * _width * _depth);
+    s.topk.reset(_topk);
+}
+
+void
+CountMinSketch::update(int shard, Packet *p, uint32_t amount)
+{
+    Shard &s = _shards[shard];
+    uint32_t agg = AGGREGATE_ANNO(p);
+    uint64_t *c[max_depth];
+    uint64_t est = ~(uint64_t) 0;
+    for (int row = 0; row < _depth; ++row) {
+	c[row] = &s.counters[row * _width + (hashcode(agg, row) & (_width - 1))];
+	if (*c[row] < est)
+	    est = *c[row];
+    }
+    est += amount;
+    for (int row = 0; row < _depth; ++row)
+	if (!_conservative)
+	    *c[row] += amount;
+	else if (*c[row] < est)
+	    *c[row] = est;
+    if (!_conservative) {
+	est = ~(uint64_t) 0;
+	for (int row = 0; row < _depth; ++row)
+	    if (*c[row] < est)
+		est = *c[row];
+    }
+
+    if (SketchTopK::Entry *e = s.topk.find(agg)) {
+	e->count = est;
+	s.topk.changed(e);
+    } else if (!s.topk.full() || est > s.topk.min().count)
+	s.topk.insert(agg, est, 0);
+}
+
+uint64_t
+CountMinSketch::estimate(uint32_t agg)
+{
+    // The merged sketch is the sum of the shards' sketches.
+    uint64_t est = ~(uint64_t) 0;
+    for (int row = 0; row < _depth; ++row) {
+	uint32_t i = row * _width + (hashcode(agg, row) & (_width - 1));
+	uint64_t sum = 0;
+	for (Shard *s = _shards.begin(); s != _shards.end(); ++s)
+	    sum += s->counters[i];
+	if (sum < est)
+	    est = sum;
+    }
+    return est;
+}
+
+void
+CountMinSketch::collect(Vector<Record> &records)
+{
+    SketchTopK top;
+    top.reset(_topk);
+    for (Shard *s = _shards.begin(); s != _shards.end(); ++s)
+	for (const SketchTopK::Entry *e = s->topk.entries().begin();
+	     e != s->topk.entries().end(); ++e)
+	    if (!top.find(e->key)) {
+		uint64_t est = estimate(e->key);
+		if (!top.full() || est > top.min().count)
+		    top.insert(e->key, est, 0);
+	    }
+    for (const SketchTopK::Entry *e = top.entries().begin();
+	 e != top.entries().end(); ++e) {
+	Record r;
+	r.aggregate = e->key;
+	r.count = e->count;
+	records.push_back(r);
+    }
+}
+
+int
+CountMinSketch::estimate_handler(int, String &str, Element *e, const Handler *, ErrorHandler *errh)
+{
+    CountMinSketch *cms = static_cast<CountMinSketch *>(e);
+    uint32_t agg;
+    IPAddress addr;
+    if (IntArg().parse(str, agg))
+	/* nada */;
+    else if (IPAddressArg().parse(str, addr, cms))
+	agg = ntohl(addr.addr());
+    else
+	return errh->error("expected aggregate");
+    cms->lock_all();
+    str = String(cms->estimate(agg));
+    cms->unlock_all();
+    return 0;
+}
+
+void
+CountMinSketch::add_handlers()
+{
+    AggregateSketch::add_handlers();
+    set_handler("estimate", Handler::OP_READ | Handler::READ_PARAM, estimate_handler);
+}
+
+ELEMENT_REQUIRES(AggregateSketch userlevel int64)
+EXPORT_ELEMENT(CountMinSketch)
+CLICK_ENDDECLS
@@ -0,0 +1,160 @@
+#ifndef CLICK_COUNTMINSKETCH_HH
+#define CLICK_COUNTMINSKETCH_HH
+#include "aggsketch.hh"
+CLICK_DECLS
+
+/*
+=c
+
+CountMinSketch([I<KEYWORDS>])
+
+=s aggregates
+
+estimates packets per aggregate annotation in fixed memory
+
+=d
+
+CountMinSketch estimates how many packets or bytes it has seen for each
+aggregate annotation value, using a Count-Min sketch of DEPTH rows of WIDTH
+counters.  Unlike AggregateCounter, its memory use does not depend on the
+number of distinct aggregates.  Estimates never fall below the true counts,
+and exceed them by at most about e/WIDTH of the total count with probability
+1-e^-DEPTH.
+
+CountMinSketch also remembers the TOPK aggregates with the largest
+estimates.  Its C<write_file>, C<write_text_file>, and C<write_ip_file>
+handlers write those aggregates and their estimated counts, in
+AggregateCounter's formats.  The C<estimate> handler returns the estimate
+for any aggregate.
+
+Each thread that passes packets through CountMinSketch updates its own
+sketch; handlers merge them.  If EPOCH is set, CountMinSketch calls
+EPOCH_CALL, then clears its state, every EPOCH.
+
+Keyword arguments are:
+
+=over 8
+
+=item WIDTH
+
+Unsigned integer.  Counters per row, rounded up to a power of two.  Default
+is 2048.
+
+=item DEPTH
+
+Unsigned integer between 1 and 16.  Number of rows.  Default is 4.
+
+=item TOPK
+
+Unsigned integer.  Number of aggregates with largest estimates to remember.
+Default is 100.
+
+=item CONSERVATIVE
+
+Boolean.  If true, use conservative update, which increments only the
+smallest of a key's counters.  This reduces overestimation.  Default is
+true.
+
+=item BYTES, IP_BYTES, MULTIPACKET, EXTRA_LENGTH, BANNER
+
+As for AggregateCounter.
+
+=item EPOCH
+
+Time value.  If set, clear the sketch every EPOCH.
+
+=item EPOCH_CALL
+
+Argument is 'I<HANDLER> [I<VALUE>]'.  Call the given write handler at the end
+of each EPOCH, just before the sketch is cleared.  For example,
+'C<EPOCH_CALL cms.write_text_file counts.txt>' dumps each epoch's heavy
+aggregates.
+
+=back
+
+=h estimate "read with parameter"
+
+The parameter is an aggregate value, given as an unsigned integer or an IP
+address.  Returns its estimated count.
+
+=h write_file write-only
+
+=h write_text_file write-only
+
+=h write_ip_file write-only
+
+Write the TOPK aggregates and their estimated counts, as for
+AggregateCounter.
+
+=h count read-only
+
+Returns the total count.
+
+=h clear write-only
+
+Clears the sketch.
+
+=h active read/write
+
+As for AggregateCounter.
+
+=n
+
+Only available in user-level processes.
+
+=e
+
+  FromDump(trace.pcap, STOP true)
+	-> CheckIPHeader(14)
+	-> AggregateIP(ip src)
+	-> cms :: CountMinSketch(BYTES true, TOPK 20)
+	-> Discard;
+
+  DriverManager(wait, write cms.write_ip_file -);
+
+=a AggregateCounter, HeavyHitters, HyperLogLog
+
+Graham Cormode and S. Muthukrishnan.  I<An Improved Data Stream Summary: The
+Count-Min Sketch and its Applications>.  Journal of Algorithms 55(1), 2005. */
+
+class CountMinSketch : public AggregateSketch { public:
+
+    CountMinSketch();
+    ~CountMinSketch();
+
+    const char *class_name() const	{ return "CountMinSketch"; }
+
+    int configure(Vector<String> &, ErrorHandler *);
+    void cleanup(CleanupStage);
+    void add_handlers();
+
+    uint64_t estimate(uint32_t aggregate);
+
+  protected:
+
+    int initialize_shards(ErrorHandler *);
+    void clear_shard(int shard);
+    void update(int shard, Packet *p, uint32_t amount);
+    void collect(Vector<Record> &);
+
+  private:
+
+    enum { max_depth = 16 };
+
+    struct Shard {
+	uint64_t *counters;	// _depth rows of _width
+	SketchTopK topk;
+    };
+
+    uint32_t _width;
+    int _depth;
+    int _topk;
+    bool _conservative;
+    Vector<Shard> _shards;
+
+    static int estimate_handler(int, String &, Element *, const Handler *, ErrorHandler *);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,154 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * cryptopan.{cc,hh} -- Crypto-PAn prefix-preserving address anonymization
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "cryptopan.hh"
+CLICK_DECLS
+
+// AES-128 encryption tables, computed by static_initialize().  te[k][x] is
+// te[0][x] rotated right by 8*k bits.
+static uint8_t sbox[256];
+static uint32_t te[4][256];
+
+static inline uint8_t
+xtime(uint8_t x)
+{
+    return (x << 1) ^ (x & 0x80 ? 0x1B : 0);
+}
+
+static inline uint8_t
+rotl8(uint8_t x, int n)
+{
+    return (x << n) | (x >> (8 - n));
+}
+
+void
+CryptoPAn::static_initialize()
+{
+    // Walk p through the multiplicative group by powers of 3, keeping
+    // q = 1/p, and apply the affine transform to q.
+    uint8_t p = 1, q = 1;
+    do {
+	p = p ^ xtime(p);
+	q ^= q << 1;
+	q ^= q << 2;
+	q ^= q << 4;
+	if (q & 0x80)
+	    q ^= 0x09;
+	sbox[p] = q ^ rotl8(q, 1) ^ rotl8(q, 2) ^ rotl8(q, 3) ^ rotl8(q, 4) ^ 0x63;
+    } while (p != 1);
+    sbox[0] = 0x63;
+
+    for (int x = 0; x < 256; ++x) {
+	uint8_t s = sbox[x], s2 = xtime(s);
+	uint32_t t = ((uint32_t) s2 << 24) | ((uint32_t) s << 16)
+	    | ((uint32_t) s << 8) | (uint8_t) (s2 ^ s);
+	for (int k = 0; k < 4; ++k) {
+	    te[k][x] = t;
+	    t = (t >> 8) | (t << 24);
+	}
+    }
+}
+
+CryptoPAn::CryptoPAn()
+{
+    memset(_rk, 0, sizeof(_rk));
+    memset(_pad, 0, sizeof(_pad));
+}
+
+static inline uint32_t
+load_be32(const unsigned char *p)
+{
+    return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16)
+	| ((uint32_t) p[2] << 8) | p[3];
+}
+
+static inline uint32_t
+sub_word(uint32_t w)
+{
+    return ((uint32_t) sbox[w >> 24] << 24) | ((uint32_t) sbox[(w >> 16) & 255] << 16)
+	| ((uint32_t) sbox[(w >> 8) & 255] << 8) | sbox[w & 255];
+}
+
+void
+CryptoPAn::set_key(const unsigned char *key)
+{
+    // AES-128 key schedule on the first half of the key
+    for (int i = 0; i < 4; ++i)
+	_rk[i] = load_be32(key + 4 * i);
+    uint8_t rcon = 1;
+    for (int i = 4; i < 44; ++i) {
+	uint32_t t = _rk[i - 1];
+	if (i % 4 == 0) {
+	    t = sub_word((t << 8) | (t >> 24)) ^ ((uint32_t) rcon << 24);
+	    rcon = xtime(rcon);
+	}
+	_rk[i] = _rk[i - 4] ^ t;
+    }
+
+    // the pad is the encrypted second half
+    uint32_t in[4];
+    for (int i = 0; i < 4; ++i)
+	in[i] = load_be32(key + 16 + 4 * i);
+    encrypt(in, _pad);
+}
+
+#define AES_ROUND(o, i, rk)						\
+    o[0] = te[0][i[0] >> 24] ^ te[1][(i[1] >> 16) & 255]		\
+	^ te[2][(i[2] >> 8) & 255] ^ te[3][i[3] & 255] ^ (rk)[0];	\
+    o[1] = te[0][i[1] >> 24] ^ te[1][(i[2] >> 16) & 255]		\
+	^ te[2][(i[3] >> 8) & 255] ^ te[3][i[0] & 255] ^ (rk)[1];	\
+    o[2] = te[0][i[2] >> 24] ^ te[1][(i[3] >> 16) & 255]		\
+	^ te[2][(i[0] >> 8) & 255] ^ te[3][i[1] & 255] ^ (rk)[2];	\
+    o[3] = te[0][i[3] >> 24] ^ te[1][(i[0] >> 16) & 255]		\
+	^ te[2][(i[1] >> 8) & 255] ^ te[3][i[2] & 255] ^ (rk)[3]
+
+void
+CryptoPAn::encrypt(const uint32_t in[4], uint32_t out[4]) const
+{
+    uint32_t s[4], t[4];
+    for (int i = 0; i < 4; ++i)
+	s[i] = in[i] ^ _rk[i];
+    for (int r = 1; r < 9; r += 2) {
+	AES_ROUND(t, s, _rk + 4 * r);
+	AES_ROUND(s, t, _rk + 4 * r + 4);
+    }
+    AES_ROUND(t, s, _rk + 36);
+    for (int i = 0; i < 4; ++i)
+	out[i] = (((uint32_t) sbox[t[i] >> 24] << 24)
+		  | ((uint32_t) sbox[(t[(i + 1) & 3] >> 16) & 255] << 16)
+		  | ((uint32_t) sbox[(t[(i + 2) & 3] >> 8) & 255] << 8)
+		  | sbox[t[(i + 3) & 3] & 255]) ^ _rk[40 + i];
+}
+
+bool
+CryptoPAn::encrypt_msb(uint32_t first) const
+{
+    uint32_t in[4] = { first, _pad[1], _pad[2], _pad[3] }, s[4], t[4];
+    for (int i = 0; i < 4; ++i)
+	s[i] = in[i] ^ _rk[i];
+    for (int r = 1; r < 9; r += 2) {
+	AES_ROUND(t, s, _rk + 4 * r);
+	AES_ROUND(s, t, _rk + 4 * r + 4);
+    }
+    AES_ROUND(t, s, _rk + 36);
+    // only the first output byte matters
+    return (sbox[t[0] >> 24] ^ (_rk[40] >> 24)) & 0x80;
+}
+
+#undef AES_ROUND
+
+ELEMENT_PROVIDES(CryptoPAn)
+CLICK_ENDDECLS
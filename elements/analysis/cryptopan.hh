@@ -0,0 +1,59 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_CRYPTOPAN_HH
+#define CLICK_CRYPTOPAN_HH
+#include <click/glue.hh>
+CLICK_DECLS
+
+/** @class CryptoPAn
+ * @brief Crypto-PAn prefix-preserving IPv4 address anonymization.
+ *
+ * CryptoPAn implements the scheme of Xu, Fan, Ammar, and Moon, "Prefix-
+ * Preserving IP Address Anonymization" (ICNP 2002), compatibly with their
+ * reference implementation.  The mapping is a pure function of a 32-byte
+ * key: bit @a i of an address is flipped iff the most significant bit of
+ * AES-128(pad with the address's first @a i bits) is set.  A CryptoPAn
+ * object is read-only once its key is set, so any number of threads may use
+ * it at once, and two runs with the same key produce the same mapping.
+ *
+ * Addresses are in host byte order. */
+class CryptoPAn { public:
+
+    enum { key_size = 32 };
+
+    CryptoPAn();
+
+    static void static_initialize();
+
+    /** @brief Set the key to the @a key_size bytes at @a key. */
+    void set_key(const unsigned char *key);
+
+    /** @brief Return the flip bit for position @a pos of address @a a.
+     * @pre 0 <= @a pos < 32
+     *
+     * The result depends only on the first @a pos bits of @a a. */
+    bool flip(uint32_t a, int pos) const {
+	uint32_t first = (pos ? (a >> (32 - pos)) << (32 - pos) : 0)
+	    | ((_pad[0] << pos) >> pos);
+	return encrypt_msb(first);
+    }
+
+    /** @brief Return the anonymized version of address @a a. */
+    uint32_t anonymize(uint32_t a) const {
+	uint32_t flips = 0;
+	for (int pos = 0; pos < 32; ++pos)
+	    flips |= (uint32_t) flip(a, pos) << (31 - pos);
+	return a ^ flips;
+    }
+
+  private:
+
+    uint32_t _rk[44];		// AES-128 round keys
+    uint32_t _pad[4];
+
+    bool encrypt_msb(uint32_t first) const;
+    void encrypt(const uint32_t in[4], uint32_t out[4]) const;
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,164 @@
+/*
+ * heavyhitters.{cc,hh} -- track the largest aggregates with Space-Saving
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "heavyhitters.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/straccum.hh>
+#include <click/packet_anno.hh>
+CLICK_DECLS
+
+HeavyHitters::HeavyHitters()
+{
+}
+
+HeavyHitters::~HeavyHitters()
+{
+}
+
+int
+HeavyHitters::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    _capacity = 1000;
+    if (Args(this, errh).bind(conf)
+	.read("CAPACITY", _capacity)
+	.consume() < 0)
+	return -1;
+    if (_capacity < 1)
+	return errh->error("CAPACITY must be positive");
+    return AggregateSketch::configure(conf, errh);
+}
+
+int
+HeavyHitters::initialize_shards(ErrorHandler *)
+{
+    _shards.resize(_nshards);
+    return 0;
+}
+
+void
+HeavyHitters::cleanup(CleanupStage stage)
+{
+    _shards.clear();
+    AggregateSketch::cleanup(stage);
+}
+
+void
+HeavyHitters::clear_shard(int shard)
+{
+    _shards[shard].reset(_capacity);
+}
+
+void
+HeavyHitters::update(int shard, Packet *p, uint32_t amount)
+{
+    SketchTopK &s = _shards[shard];
+    uint32_t agg = AGGREGATE_ANNO(p);
+    if (SketchTopK::Entry *e = s.find(agg)) {
+	e->count += amount;
+	s.changed(e);
+    } else if (!s.full())
+	s.insert(agg, amount, 0);
+    else {
+	// Space-Saving: the new aggregate takes over the smallest counter.
+	uint64_t min = s.min().count;
+	s.insert(agg, min + amount, min);
+    }
+}
+
+void
+HeavyHitters::merge(SketchTopK &top)
+{
+    // Merge as in Agarwal et al., "Mergeable Summaries": an aggregate
+    // missing from a full summary may have had up to that summary's
+    // minimum count.
+    if (_nshards == 1) {
+	top = _shards[0];
+	return;
+    }
+    HashTable<uint32_t, int> seen(0);
+    top.reset(_capacity);
+    for (SketchTopK *s = _shards.begin(); s != _shards.end(); ++s)
+	for (const SketchTopK::Entry *e = s->entries().begin();
+	     e != s->entries().end(); ++e) {
+	    if (seen.get(e->key))
+		continue;
+	    seen.set(e->key, 1);
+	    uint64_t count = 0, error = 0;
+	    for (SketchTopK *t = _shards.begin(); t != _shards.end(); ++t)
+		if (SketchTopK::Entry *x = t->find(e->key)) {
+		    count += x->count;
+		    error += x->error;
+		} else if (t->full()) {
+		    count += t->min().count;
+		    error += t->min().count;
+		}
+	    if (!top.full() || count > top.min().count)
+		top.insert(e->key, count, error);
+	}
+}
+
+void
+HeavyHitters::collect(Vector<Record> &records)
+{
+    SketchTopK top;
+    merge(top);
+    for (const SketchTopK::Entry *e = top.entries().begin();
+	 e != top.entries().end(); ++e) {
+	Record r;
+	r.aggregate = e->key;
+	r.count = e->count;
+	records.push_back(r);
+    }
+}
+
+static int
+entry_compar(const void *ap, const void *bp, void *)
+{
+    const SketchTopK::Entry *a = static_cast<const SketchTopK::Entry *>(ap);
+    const SketchTopK::Entry *b = static_cast<const SketchTopK::Entry *>(bp);
+    if (a->count != b->count)
+	return a->count > b->count ? -1 : 1;
+    return a->key < b->key ? -1 : a->key != b->key;
+}
+
+String
+HeavyHitters::read_handler(Element *e, void *)
+{
+    HeavyHitters *hh = static_cast<HeavyHitters *>(e);
+    SketchTopK top;
+    hh->lock_all();
+    hh->merge(top);
+    hh->unlock_all();
+
+    Vector<SketchTopK::Entry> v(top.entries());
+    if (v.size())
+	click_qsort(v.begin(), v.size(), sizeof(SketchTopK::Entry), entry_compar);
+    StringAccum sa;
+    for (SketchTopK::Entry *x = v.begin(); x != v.end(); ++x)
+	sa << x->key << ' ' << x->count << ' ' << x->error << '\n';
+    return sa.take_string();
+}
+
+void
+HeavyHitters::add_handlers()
+{
+    AggregateSketch::add_handlers();
+    add_read_handler("table", read_handler, 0);
+}
+
+ELEMENT_REQUIRES(AggregateSketch userlevel int64)
+EXPORT_ELEMENT(HeavyHitters)
+CLICK_ENDDECLS
@@ -0,0 +1,123 @@
+#ifndef CLICK_HEAVYHITTERS_HH
+#define CLICK_HEAVYHITTERS_HH
+#include "aggsketch.hh"
+CLICK_DECLS
+
+/*
+=c
+
+HeavyHitters([I<KEYWORDS>])
+
+=s aggregates
+
+tracks the aggregates with the most packets in fixed memory
+
+=d
+
+HeavyHitters finds the aggregate annotation values that account for the most
+packets or bytes, using the Space-Saving algorithm with CAPACITY counters.
+Every aggregate whose true count exceeds 1/CAPACITY of the total is
+guaranteed to be tracked.  A tracked aggregate's count is an overestimate by
+at most its error bound, which the C<table> handler reports.
+
+The C<write_file>, C<write_text_file>, and C<write_ip_file> handlers write
+the tracked aggregates and their counts, in AggregateCounter's formats.
+
+Each thread that passes packets through HeavyHitters updates its own
+summary; handlers merge them.  If EPOCH is set, HeavyHitters calls
+EPOCH_CALL, then clears its state, every EPOCH.
+
+Keyword arguments are:
+
+=over 8
+
+=item CAPACITY
+
+Unsigned integer.  Number of aggregates tracked.  Default is 1000.
+
+=item BYTES, IP_BYTES, MULTIPACKET, EXTRA_LENGTH, BANNER
+
+As for AggregateCounter.
+
+=item EPOCH, EPOCH_CALL
+
+As for CountMinSketch.
+
+=back
+
+=h table read-only
+
+Returns one line per tracked aggregate, in decreasing order of count, with
+the form `I<AGGREGATE> I<COUNT> I<ERROR>'.  The true count lies between
+I<COUNT>-I<ERROR> and I<COUNT>.
+
+=h write_file write-only
+
+=h write_text_file write-only
+
+=h write_ip_file write-only
+
+Write the tracked aggregates and their counts, as for AggregateCounter.
+
+=h count read-only
+
+Returns the total count.
+
+=h clear write-only
+
+Clears the summary.
+
+=h active read/write
+
+As for AggregateCounter.
+
+=n
+
+Only available in user-level processes.
+
+=e
+
+  FromDump(trace.pcap, STOP true)
+	-> CheckIPHeader(14)
+	-> AggregateIP(ip dst/24)
+	-> hh :: HeavyHitters(BYTES true, CAPACITY 100)
+	-> Discard;
+
+  DriverManager(wait, write hh.write_ip_file -);
+
+=a AggregateCounter, CountMinSketch, HyperLogLog
+
+Ahmed Metwally, Divyakant Agrawal, and Amr El Abbadi.  I<Efficient
+Computation of Frequent and Top-k Elements in Data Streams>.  ICDT 2005. */
+
+class HeavyHitters : public AggregateSketch { public:
+
+    HeavyHitters();
+    ~HeavyHitters();
+
+    const char *class_name() const	{ return "HeavyHitters"; }
+
+    int configure(Vector<String> &, ErrorHandler *);
+    void cleanup(CleanupStage);
+    void add_handlers();
+
+  protected:
+
+    int initialize_shards(ErrorHandler *);
+    void clear_shard(int shard);
+    void update(int shard, Packet *p, uint32_t amount);
+    void collect(Vector<Record> &);
+
+  private:
+
+    int _capacity;
+    Vector<SketchTopK> _shards;
+
+    void merge(SketchTopK &);
+
+    static String read_handler(Element *, void *);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,246 @@
+/*
+ * hyperloglog.{cc,hh} -- estimate distinct values per aggregate with
+ * HyperLogLog sketches
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "hyperloglog.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/packet_anno.hh>
+#include <click/ipaddress.hh>
+#include <click/integers.hh>
+#include <clicknet/ip.h>
+#include <math.h>
+CLICK_DECLS
+
+HyperLogLog::HyperLogLog()
+{
+}
+
+HyperLogLog::~HyperLogLog()
+{
+}
+
+int
+HyperLogLog::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    String value = "src";
+    _precision = 10;
+    _limit = 1024;
+    if (Args(this, errh).bind(conf)
+	.read("VALUE", WordArg(), value)
+	.read("PRECISION", _precision)
+	.read("LIMIT", _limit)
+	.consume() < 0)
+	return -1;
+
+    value = value.lower();
+    if (value == "src")
+	_value = value_src;
+    else if (value == "dst")
+	_value = value_dst;
+    else if (value == "flow")
+	_value = value_flow;
+    else
+	return errh->error("bad VALUE, expected %<src%>, %<dst%>, or %<flow%>");
+    if (_precision < 4 || _precision > 16)
+	return errh->error("PRECISION must be between 4 and 16");
+    if (_limit < 1)
+	return errh->error("LIMIT must be positive");
+    return AggregateSketch::configure(conf, errh);
+}
+
+int
+HyperLogLog::initialize_shards(ErrorHandler *)
+{
+    _shards.resize(_nshards);
+    return 0;
+}
+
+void
+HyperLogLog::cleanup(CleanupStage stage)
+{
+    _shards.clear();
+    AggregateSketch::cleanup(stage);
+}
+
+void
+HyperLogLog::clear_shard(int shard)
+{
+    Shard &s = _shards[shard];
+    s.index.clear();
+    s.registers.clear();
+    s.overflow = 0;
+}
+
+inline uint64_t
+HyperLogLog::value_hash(const Packet *p) const
+{
+    const click_ip *iph = p->ip_header();
+    uint64_t v;
+    if (_value == value_src)
+	v = iph->ip_src.s_addr;
+    else if (_value == value_dst)
+	v = iph->ip_dst.s_addr;
+    else {
+	v = ((uint64_t) iph->ip_src.s_addr << 32) | iph->ip_dst.s_addr;
+	v = v * 0x9E3779B97F4A7C15ULL + iph->ip_p;
+	if (IP_FIRSTFRAG(iph)
+	    && (iph->ip_p == IP_PROTO_TCP || iph->ip_p == IP_PROTO_UDP)
+	    && p->transport_length() >= 4)
+	    v = v * 0x9E3779B97F4A7C15ULL
+		+ *reinterpret_cast<const uint32_t *>(p->transport_header());
+    }
+    // SplitMix64 finalizer
+    v = (v ^ (v >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    v = (v ^ (v >> 27)) * 0x94D049BB133111EBULL;
+    return v ^ (v >> 31);
+}
+
+void
+HyperLogLog::update(int shard, Packet *p, uint32_t)
+{
+    if (!p->has_network_header())
+	return;
+
+    Shard &s = _shards[shard];
+    uint32_t agg = AGGREGATE_ANNO(p);
+    int i = s.index.get(agg);
+    if (i < 0) {
+	if (s.index.size() >= (size_t) _limit) {
+	    s.overflow++;
+	    return;
+	}
+	i = s.registers.size() >> _precision;
+	s.index.set(agg, i);
+	s.registers.resize(s.registers.size() + (1 << _precision), 0);
+    }
+
+    // The top PRECISION bits pick a register; the register keeps the
+    // largest position of the first 1 bit in the rest.
+    uint64_t h = value_hash(p);
+    uint32_t reg = h >> (64 - _precision);
+    uint64_t rest = h << _precision;
+    uint8_t rank = rest ? ffs_msb(rest) : 65 - _precision;
+    uint8_t &r = s.registers[(i << _precision) + reg];
+    if (rank > r)
+	r = rank;
+}
+
+bool
+HyperLogLog::merged_registers(uint32_t agg, uint8_t *regs) const
+{
+    int m = 1 << _precision;
+    bool found = false;
+    memset(regs, 0, m);
+    for (const Shard *s = _shards.begin(); s != _shards.end(); ++s) {
+	int i = s->index.get(agg);
+	if (i < 0)
+	    continue;
+	found = true;
+	const uint8_t *x = s->registers.begin() + (i << _precision);
+	for (int j = 0; j < m; ++j)
+	    if (x[j] > regs[j])
+		regs[j] = x[j];
+    }
+    return found;
+}
+
+uint64_t
+HyperLogLog::estimate(const uint8_t *regs) const
+{
+    int m = 1 << _precision;
+    double alpha;
+    if (m == 16)
+	alpha = 0.673;
+    else if (m == 32)
+	alpha = 0.697;
+    else if (m == 64)
+	alpha = 0.709;
+    else
+	alpha = 0.7213 / (1 + 1.079 / m);
+
+    double sum = 0;
+    int zeros = 0;
+    for (int j = 0; j < m; ++j) {
+	sum += ldexp(1.0, -regs[j]);
+	zeros += (regs[j] == 0);
+    }
+    double e = alpha * m * m / sum;
+    // small-range correction: linear counting
+    if (e <= 2.5 * m && zeros)
+	e = m * log((double) m / zeros);
+    return (uint64_t) (e + 0.5);
+}
+
+void
+HyperLogLog::collect(Vector<Record> &records)
+{
+    HashTable<uint32_t, int> seen(0);
+    Vector<uint8_t> regs(1 << _precision, 0);
+    for (const Shard *s = _shards.begin(); s != _shards.end(); ++s)
+	for (HashTable<uint32_t, int>::const_iterator it = s->index.begin(); it; ++it)
+	    if (!seen.get(it.key())) {
+		seen.set(it.key(), 1);
+		merged_registers(it.key(), regs.begin());
+		Record r;
+		r.aggregate = it.key();
+		r.count = estimate(regs.begin());
+		records.push_back(r);
+	    }
+}
+
+String
+HyperLogLog::read_handler(Element *e, void *)
+{
+    HyperLogLog *hll = static_cast<HyperLogLog *>(e);
+    uint64_t overflow = 0;
+    hll->lock_all();
+    for (const Shard *s = hll->_shards.begin(); s != hll->_shards.end(); ++s)
+	overflow += s->overflow;
+    hll->unlock_all();
+    return String(overflow);
+}
+
+int
+HyperLogLog::estimate_handler(int, String &str, Element *e, const Handler *, ErrorHandler *errh)
+{
+    HyperLogLog *hll = static_cast<HyperLogLog *>(e);
+    uint32_t agg;
+    IPAddress addr;
+    if (IntArg().parse(str, agg))
+	/* nada */;
+    else if (IPAddressArg().parse(str, addr, hll))
+	agg = ntohl(addr.addr());
+    else
+	return errh->error("expected aggregate");
+    Vector<uint8_t> regs(1 << hll->_precision, 0);
+    hll->lock_all();
+    bool found = hll->merged_registers(agg, regs.begin());
+    hll->unlock_all();
+    str = String(found ? hll->estimate(regs.begin()) : 0);
+    return 0;
+}
+
+void
+HyperLogLog::add_handlers()
+{
+    AggregateSketch::add_handlers();
+    add_read_handler("overflow", read_handler, 0);
+    set_handler("estimate", Handler::OP_READ | Handler::READ_PARAM, estimate_handler);
+}
+
+ELEMENT_REQUIRES(AggregateSketch userlevel int64)
+EXPORT_ELEMENT(HyperLogLog)
+CLICK_ENDDECLS
@@ -0,0 +1,155 @@
+#ifndef CLICK_HYPERLOGLOG_HH
+#define CLICK_HYPERLOGLOG_HH
+#include "aggsketch.hh"
+CLICK_DECLS
+
+/*
+=c
+
+HyperLogLog([I<KEYWORDS>])
+
+=s aggregates
+
+estimates distinct addresses per aggregate annotation in fixed memory
+
+=d
+
+HyperLogLog estimates how many distinct values of a packet field, such as the
+IP source address, it has seen for each aggregate annotation value.  For
+example, after AggregateIP(ip dst/24), HyperLogLog with VALUE src estimates
+how many distinct sources sent to each destination /24.  Packets with the
+same aggregate annotation share one HyperLogLog sketch of 2^PRECISION
+one-byte registers, whose relative standard error is about
+1.04/sqrt(2^PRECISION).
+
+HyperLogLog keeps sketches for at most LIMIT aggregates.  Packets for other
+aggregates are not counted; the C<overflow> handler reports how many there
+were.
+
+The C<write_file>, C<write_text_file>, and C<write_ip_file> handlers write
+each aggregate and its estimated number of distinct values, in
+AggregateCounter's formats.
+
+Each thread that passes packets through HyperLogLog updates its own
+sketches; handlers merge them.  If EPOCH is set, HyperLogLog calls
+EPOCH_CALL, then clears its state, every EPOCH.
+
+Keyword arguments are:
+
+=over 8
+
+=item VALUE
+
+The field whose distinct values are counted: C<src> (IP source address),
+C<dst> (IP destination address), or C<flow> (IP 5-tuple).  Packets without
+an IP header annotation are not counted.  Default is C<src>.
+
+=item PRECISION
+
+Unsigned integer between 4 and 16.  Base-2 logarithm of the number of
+registers per sketch.  Default is 10.
+
+=item LIMIT
+
+Unsigned integer.  Maximum number of aggregates.  Default is 1024.
+
+=item BANNER, EPOCH, EPOCH_CALL
+
+As for CountMinSketch.
+
+=back
+
+=h estimate "read with parameter"
+
+The parameter is an aggregate value, given as an unsigned integer or an IP
+address.  Returns its estimated number of distinct values.
+
+=h overflow read-only
+
+Returns the number of packets not counted because LIMIT aggregates already
+had sketches.
+
+=h write_file write-only
+
+=h write_text_file write-only
+
+=h write_ip_file write-only
+
+Write the aggregates and their estimated numbers of distinct values, as for
+AggregateCounter.
+
+=h count read-only
+
+Returns the number of packets seen.
+
+=h clear write-only
+
+Clears the sketches.
+
+=n
+
+Only available in user-level processes.
+
+=e
+
+  FromDump(trace.pcap, STOP true)
+	-> CheckIPHeader(14)
+	-> AggregateIP(ip dst/24)
+	-> hll :: HyperLogLog(VALUE src)
+	-> Discard;
+
+  DriverManager(wait, write hll.write_ip_file -);
+
+=a AggregateCounter, CountMinSketch, HeavyHitters
+
+Philippe Flajolet, Eric Fusy, Olivier Gandouet, and Frederic Meunier.
+I<HyperLogLog: the analysis of a near-optimal cardinality estimation
+algorithm>.  AofA 2007. */
+
+class HyperLogLog : public AggregateSketch { public:
+
+    HyperLogLog();
+    ~HyperLogLog();
+
+    const char *class_name() const	{ return "HyperLogLog"; }
+
+    int configure(Vector<String> &, ErrorHandler *);
+    void cleanup(CleanupStage);
+    void add_handlers();
+
+  protected:
+
+    int initialize_shards(ErrorHandler *);
+    void clear_shard(int shard);
+    void update(int shard, Packet *p, uint32_t amount);
+    void collect(Vector<Record> &);
+
+  private:
+
+    enum { value_src, value_dst, value_flow };
+
+    struct Shard {
+	HashTable<uint32_t, int> index;
+	Vector<uint8_t> registers;
+	uint64_t overflow;
+	Shard()
+	    : index(-1) {
+	}
+    };
+
+    int _value;
+    int _precision;
+    int _limit;
+    Vector<Shard> _shards;
+
+    inline uint64_t value_hash(const Packet *p) const;
+    bool merged_registers(uint32_t aggregate, uint8_t *regs) const;
+    uint64_t estimate(const uint8_t *regs) const;
+
+    static String read_handler(Element *, void *);
+    static int estimate_handler(int, String &, Element *, const Handler *, ErrorHandler *);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,55 @@
+// -*- mode: c++; c-basic-offset: 4 -*-
+/*
+ * codel.{cc,hh} -- element implements CoDel active queue management
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "codel.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+CLICK_DECLS
+
+CoDel::CoDel()
+{
+}
+
+int
+CoDel::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    // A CoDel is an FQCoDel with one flow queue.
+    _empty_note.initialize(Notifier::EMPTY_NOTIFIER, router());
+    _target = Timestamp::make_msec(5);
+    _interval = Timestamp::make_msec(100);
+    _limit = 1000;
+    _nflows = 1;
+    _quantum = 1514;
+    _mtu = 1514;
+    _offset = -1;
+    _length = 0;
+    if (Args(conf, this, errh)
+	.read("TARGET", _target)
+	.read("INTERVAL", _interval)
+	.read("LIMIT", _limit)
+	.read("MTU", _mtu)
+	.complete() < 0)
+	return -1;
+    if (!_interval)
+	return errh->error("INTERVAL must be positive");
+    if (_limit == 0)
+	return errh->error("LIMIT must be positive");
+    return 0;
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(FQCoDel)
+EXPORT_ELEMENT(CoDel)
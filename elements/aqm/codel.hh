@@ -0,0 +1,80 @@
+// -*- mode: c++; c-basic-offset: 4 -*-
+#ifndef CLICK_CODEL_HH
+#define CLICK_CODEL_HH
+#include "fqcodel.hh"
+CLICK_DECLS
+
+/*
+=c
+
+CoDel([I<KEYWORDS>])
+
+=s aqm
+
+stores packets in a FIFO queue managed by CoDel
+
+=d
+
+Stores packets in a single first-in-first-out queue and drops packets from
+its head using the CoDel (Controlled Delay) algorithm of RFC 8289.
+
+Each packet is timestamped when it is enqueued.  On dequeue, CoDel compares
+the packet's sojourn time with TARGET: once the sojourn time has stayed above
+TARGET for at least INTERVAL, CoDel starts dropping packets at a rate that
+increases until the sojourn time falls below TARGET again.  Unlike RED and
+PI, CoDel reacts to queueing delay rather than queue length, so TARGET and
+INTERVAL rarely need tuning.
+
+CoDel holds at most LIMIT packets and drops from the head of the queue when
+a new packet would exceed LIMIT.  Dropped packets are emitted on output 1 if
+output 1 exists.
+
+Keyword arguments are:
+
+=over 8
+
+=item TARGET
+
+Time value.  Acceptable standing queue delay.  Default is 5ms.
+
+=item INTERVAL
+
+Time value.  How long sojourn times must stay above TARGET before CoDel
+starts dropping; should be on the order of a worst-case round-trip time.
+Default is 100ms.
+
+=item LIMIT
+
+Unsigned integer.  Maximum number of packets queued.  Default is 1000.
+
+=item MTU
+
+Unsigned integer.  CoDel does not drop when the queue holds at most MTU
+bytes.  Default is 1514.
+
+=back
+
+CoDel has the same handlers as FQCoDel.  Its C<flow_stats> handler reports
+a single flow, numbered 0.
+
+=e
+
+  ... -> BandwidthShaper(10Mbps) -> CoDel -> ToDevice(eth1);
+
+=a FQCoDel, Queue, RED, PI
+
+Kathleen Nichols and Van Jacobson.  I<Controlled Delay Active Queue
+Management>.  RFC 8289, January 2018. */
+
+class CoDel : public FQCoDel { public:
+
+    CoDel();
+
+    const char *class_name() const		{ return "CoDel"; }
+
+    int configure(Vector<String> &, ErrorHandler *);
+
+};
+
+CLICK_ENDDECLS
+#endif
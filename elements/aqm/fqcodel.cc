@@ -0,0 +1,480 @@
+// -*- mode: c++; c-basic-offset: 4 -*-
+/*
+ * fqcodel.{cc,hh} -- element implements FQ-CoDel per-flow queueing with
+ * CoDel active queue management
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "fqcodel.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/straccum.hh>
+#include <click/integers.hh>
+#include <clicknet/ip.h>
+#include <clicknet/udp.h>
+CLICK_DECLS
+
+FQCoDel::FQCoDel()
+    : _slots(0), _flows(0)
+{
+}
+
+FQCoDel::~FQCoDel()
+{
+}
+
+void *
+FQCoDel::cast(const char *n)
+{
+    if (strcmp(n, Notifier::EMPTY_NOTIFIER) == 0)
+	return static_cast<Notifier *>(&_empty_note);
+    else
+	return Element::cast(n);
+}
+
+int
+FQCoDel::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    _empty_note.initialize(Notifier::EMPTY_NOTIFIER, router());
+    _target = Timestamp::make_msec(5);
+    _interval = Timestamp::make_msec(100);
+    _limit = 10240;
+    _nflows = 1024;
+    _quantum = 1514;
+    _mtu = 1514;
+    _offset = -1;
+    _length = 0;
+    if (Args(conf, this, errh)
+	.read("TARGET", _target)
+	.read("INTERVAL", _interval)
+	.read("LIMIT", _limit)
+	.read("FLOWS", _nflows)
+	.read("QUANTUM", _quantum)
+	.read("MTU", _mtu)
+	.read("OFFSET", _offset)
+	.read("LENGTH", _length)
+	.complete() < 0)
+	return -1;
+    if (!_interval)
+	return errh->error("INTERVAL must be positive");
+    if (_limit == 0 || _nflows == 0 || _quantum == 0)
+	return errh->error("LIMIT, FLOWS, and QUANTUM must be positive");
+    if ((_offset >= 0) != (_length > 0))
+	return errh->error("supply both OFFSET and LENGTH, or neither");
+    return 0;
+}
+
+int
+FQCoDel::initialize(ErrorHandler *errh)
+{
+    // One spare slot holds the packet that overflows LIMIT.
+    if (!(_slots = new slot[_limit + 1]) || !(_flows = new flow[_nflows]()))
+	return errh->error("out of memory");
+    for (uint32_t i = 0; i <= _limit; ++i) {
+	_slots[i].p = 0;
+	_slots[i].next = i + 1;
+    }
+    _slots[_limit].next = none;
+    _free = 0;
+    for (uint32_t i = 0; i < _nflows; ++i)
+	_flows[i].head = _flows[i].tail = _flows[i].next = none;
+    _new_flows.head = _new_flows.tail = none;
+    _old_flows.head = _old_flows.tail = none;
+    _qlength = _qbytes = _highwater_length = 0;
+    _codel_drops = _overlimit_drops = 0;
+    return 0;
+}
+
+void
+FQCoDel::cleanup(CleanupStage)
+{
+    if (_flows)
+	for (uint32_t i = 0; i < _nflows; ++i) {
+	    Timestamp enq_time;
+	    while (Packet *p = flow_pop(_flows[i], enq_time))
+		p->kill();
+	}
+    delete[] _slots;
+    delete[] _flows;
+    _slots = 0;
+    _flows = 0;
+}
+
+uint32_t
+FQCoDel::flow_index(const Packet *p) const
+{
+    uint32_t h = 0;
+    if (_offset >= 0) {
+	if ((int) p->length() < _offset + _length)
+	    return 0;
+	const unsigned char *data = p->data() + _offset;
+	for (int i = 0; i < _length; ++i)
+	    h = h * 31 + data[i];
+    } else if (p->has_network_header()
+	       && p->network_length() >= (int) sizeof(click_ip)) {
+	const click_ip *iph = p->ip_header();
+	h = (iph->ip_src.s_addr ^ iph->ip_p) * 0x9E3779B1U;
+	h = (h ^ iph->ip_dst.s_addr) * 0x9E3779B1U;
+	if ((iph->ip_p == IP_PROTO_TCP || iph->ip_p == IP_PROTO_UDP)
+	    && IP_FIRSTFRAG(iph) && p->transport_length() >= 4) {
+	    const click_udp *udph = p->udp_header();
+	    h = (h ^ udph->uh_sport ^ ((uint32_t) udph->uh_dport << 16)) * 0x9E3779B1U;
+	}
+    }
+    h ^= h >> 16;
+    return h % _nflows;
+}
+
+inline void
+FQCoDel::list_push(flow_list &l, uint32_t fi)
+{
+    _flows[fi].next = none;
+    if (l.tail == none)
+	l.head = fi;
+    else
+	_flows[l.tail].next = fi;
+    l.tail = fi;
+}
+
+inline uint32_t
+FQCoDel::list_pop(flow_list &l)
+{
+    uint32_t fi = l.head;
+    l.head = _flows[fi].next;
+    if (l.head == none)
+	l.tail = none;
+    return fi;
+}
+
+inline Packet *
+FQCoDel::flow_pop(flow &f, Timestamp &enq_time)
+{
+    uint32_t si = f.head;
+    if (si == none)
+	return 0;
+    slot &s = _slots[si];
+    Packet *p = s.p;
+    enq_time = s.enq_time;
+    f.head = s.next;
+    if (f.head == none)
+	f.tail = none;
+    s.p = 0;
+    s.next = _free;
+    _free = si;
+    f.length--;
+    f.bytes -= p->length();
+    _qlength--;
+    _qbytes -= p->length();
+    return p;
+}
+
+void
+FQCoDel::drop(flow &f, Packet *p)
+{
+    f.drops++;
+    _codel_drops++;
+    checked_output_push(1, p);
+}
+
+void
+FQCoDel::drop_fattest()
+{
+    // Finding the fattest flow scans every flow, so, as in RFC 8290, drop
+    // up to half of its bytes (at most drop_batch packets) at once.
+    uint32_t fattest = 0;
+    for (uint32_t i = 1; i < _nflows; ++i)
+	if (_flows[i].bytes > _flows[fattest].bytes)
+	    fattest = i;
+    flow &f = _flows[fattest];
+    uint32_t threshold = f.bytes / 2, dropped = 0;
+    Timestamp enq_time;
+    for (int n = 0; n < drop_batch && (n == 0 || dropped < threshold); ++n) {
+	Packet *p = flow_pop(f, enq_time);
+	if (!p)
+	    break;
+	dropped += p->length();
+	f.drops++;
+	_overlimit_drops++;
+	checked_output_push(1, p);
+    }
+}
+
+void
+FQCoDel::push(int, Packet *p)
+{
+    uint32_t fi = flow_index(p);
+    flow &f = _flows[fi];
+
+    uint32_t si = _free;
+    slot &s = _slots[si];
+    _free = s.next;
+    s.p = p;
+    s.enq_time = Timestamp::now_steady();
+    s.next = none;
+    if (f.tail == none)
+	f.head = si;
+    else
+	_slots[f.tail].next = si;
+    f.tail = si;
+    f.length++;
+    f.bytes += p->length();
+    _qlength++;
+    _qbytes += p->length();
+
+    if (f.list == list_none) {
+	f.deficit = _quantum;
+	f.list = list_new;
+	list_push(_new_flows, fi);
+    }
+
+    if (_qlength > _limit)
+	drop_fattest();
+    if (_qlength > _highwater_length)
+	_highwater_length = _qlength;
+    _empty_note.wake();
+}
+
+inline Timestamp
+FQCoDel::control_law(const Timestamp &t, uint32_t count) const
+{
+    // t + INTERVAL/sqrt(count), with sqrt(count) in 8 fractional bits
+    uint32_t c = count < 65536 ? count : 65535;
+    uint64_t usec = int_divide((uint64_t) _interval.usecval() << 8,
+			       int_sqrt(c << 16));
+    return t + Timestamp::make_usec(usec);
+}
+
+Packet *
+FQCoDel::dodequeue(flow &f, const Timestamp &now, bool &ok_to_drop)
+{
+    // Pop a packet and decide whether it could be dropped: the sojourn time
+    // must have stayed above TARGET for at least INTERVAL.
+    Timestamp enq_time;
+    Packet *p = flow_pop(f, enq_time);
+    ok_to_drop = false;
+    if (!p) {
+	f.first_above_time = Timestamp();
+	return 0;
+    }
+
+    Timestamp sojourn = now - enq_time;
+    uint32_t us = sojourn.usecval();
+    f.dequeues++;
+    f.sojourn_sum += us;
+    if (us > f.max_sojourn)
+	f.max_sojourn = us;
+
+    if (sojourn < _target || f.bytes <= _mtu)
+	f.first_above_time = Timestamp();
+    else if (!f.first_above_time)
+	f.first_above_time = now + _interval;
+    else
+	ok_to_drop = now >= f.first_above_time;
+    return p;
+}
+
+Packet *
+FQCoDel::codel_dequeue(flow &f, const Timestamp &now)
+{
+    // See RFC 8289.
+    bool ok_to_drop;
+    Packet *p = dodequeue(f, now, ok_to_drop);
+    if (!p) {
+	f.dropping = false;
+	return 0;
+    }
+
+    if (f.dropping) {
+	if (!ok_to_drop)
+	    f.dropping = false;
+	// drop at an increasing rate until the delay comes down
+	while (f.dropping && now >= f.drop_next) {
+	    drop(f, p);
+	    f.count++;
+	    p = dodequeue(f, now, ok_to_drop);
+	    if (!ok_to_drop)
+		f.dropping = false;
+	    else
+		f.drop_next = control_law(f.drop_next, f.count);
+	}
+    } else if (ok_to_drop) {
+	drop(f, p);
+	p = dodequeue(f, now, ok_to_drop);
+	f.dropping = true;
+	// If we were dropping recently, start from the previous drop rate.
+	uint32_t delta = f.count - f.lastcount;
+	f.count = 1;
+	if (delta > 1
+	    && (now - f.drop_next).usecval() < 16 * _interval.usecval())
+	    f.count = delta;
+	f.drop_next = control_law(now, f.count);
+	f.lastcount = f.count;
+    }
+    return p;
+}
+
+Packet *
+FQCoDel::pull(int)
+{
+    if (!_qlength) {
+	_empty_note.sleep();
+	return 0;
+    }
+
+    Timestamp now = Timestamp::now_steady();
+    while (1) {
+	flow_list *l;
+	if (_new_flows.head != none)
+	    l = &_new_flows;
+	else if (_old_flows.head != none)
+	    l = &_old_flows;
+	else
+	    break;
+
+	uint32_t fi = l->head;
+	flow &f = _flows[fi];
+	if (f.deficit <= 0) {
+	    f.deficit += _quantum;
+	    list_pop(*l);
+	    f.list = list_old;
+	    list_push(_old_flows, fi);
+	} else if (Packet *p = codel_dequeue(f, now)) {
+	    f.deficit -= p->length();
+	    return p;
+	} else {
+	    // An empty new flow goes to the old list so it cannot starve
+	    // old flows by becoming new again immediately.
+	    list_pop(*l);
+	    if (l == &_new_flows && _old_flows.head != none) {
+		f.list = list_old;
+		list_push(_old_flows, fi);
+	    } else
+		f.list = list_none;
+	}
+    }
+
+    _empty_note.sleep();
+    return 0;
+}
+
+enum {
+    h_length, h_bytes, h_highwater_length, h_drops, h_codel_drops,
+    h_overlimit_drops, h_flows, h_flow_stats, h_target, h_interval,
+    h_reset_counts, h_reset
+};
+
+String
+FQCoDel::read_handler(Element *e, void *thunk)
+{
+    FQCoDel *fq = static_cast<FQCoDel *>(e);
+    switch (reinterpret_cast<intptr_t>(thunk)) {
+    case h_length:
+	return String(fq->_qlength);
+    case h_bytes:
+	return String(fq->_qbytes);
+    case h_highwater_length:
+	return String(fq->_highwater_length);
+    case h_drops:
+	return String(fq->_codel_drops + fq->_overlimit_drops);
+    case h_codel_drops:
+	return String(fq->_codel_drops);
+    case h_overlimit_drops:
+	return String(fq->_overlimit_drops);
+    case h_flows: {
+	uint32_t n = 0;
+	for (uint32_t i = 0; i < fq->_nflows; ++i)
+	    n += fq->_flows[i].length != 0;
+	return String(n);
+    }
+    case h_flow_stats: {
+	StringAccum sa;
+	for (uint32_t i = 0; i < fq->_nflows; ++i) {
+	    const flow &f = fq->_flows[i];
+	    if (f.length || f.drops || f.dequeues) {
+		uint64_t mean = f.dequeues ? int_divide(f.sojourn_sum, f.dequeues) : 0;
+		sa << i << ' ' << f.length << ' ' << f.drops << ' '
+		   << mean << ' ' << f.max_sojourn << '\n';
+	    }
+	}
+	return sa.take_string();
+    }
+    case h_target:
+	return fq->_target.unparse_interval();
+    case h_interval:
+	return fq->_interval.unparse_interval();
+    default:
+	return String();
+    }
+}
+
+int
+FQCoDel::write_handler(const String &str, Element *e, void *thunk, ErrorHandler *errh)
+{
+    FQCoDel *fq = static_cast<FQCoDel *>(e);
+    switch (reinterpret_cast<intptr_t>(thunk)) {
+    case h_target:
+    case h_interval: {
+	Timestamp t;
+	if (!TimestampArg().parse(str, t))
+	    return errh->error("syntax error");
+	if (reinterpret_cast<intptr_t>(thunk) == h_target)
+	    fq->_target = t;
+	else if (!t)
+	    return errh->error("INTERVAL must be positive");
+	else
+	    fq->_interval = t;
+	return 0;
+    }
+    case h_reset_counts:
+	fq->_codel_drops = fq->_overlimit_drops = 0;
+	fq->_highwater_length = fq->_qlength;
+	for (uint32_t i = 0; i < fq->_nflows; ++i) {
+	    flow &f = fq->_flows[i];
+	    f.drops = f.dequeues = f.max_sojourn = 0;
+	    f.sojourn_sum = 0;
+	}
+	return 0;
+    case h_reset:
+	for (uint32_t i = 0; i < fq->_nflows; ++i) {
+	    Timestamp enq_time;
+	    while (Packet *p = fq->flow_pop(fq->_flows[i], enq_time))
+		fq->checked_output_push(1, p);
+	}
+	return 0;
+    default:
+	return errh->error("internal error");
+    }
+}
+
+void
+FQCoDel::add_handlers()
+{
+    add_read_handler("length", read_handler, h_length);
+    add_read_handler("bytes", read_handler, h_bytes);
+    add_read_handler("highwater_length", read_handler, h_highwater_length);
+    add_read_handler("drops", read_handler, h_drops);
+    add_read_handler("codel_drops", read_handler, h_codel_drops);
+    add_read_handler("overlimit_drops", read_handler, h_overlimit_drops);
+    add_read_handler("flows", read_handler, h_flows);
+    add_read_handler("flow_stats", read_handler, h_flow_stats);
+    add_read_handler("target", read_handler, h_target, Handler::CALM);
+    add_write_handler("target", write_handler, h_target);
+    add_read_handler("interval", read_handler, h_interval, Handler::CALM);
+    add_write_handler("interval", write_handler, h_interval);
+    add_write_handler("reset_counts", write_handler, h_reset_counts, Handler::BUTTON);
+    add_write_handler("reset", write_handler, h_reset, Handler::BUTTON);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(int64)
+EXPORT_ELEMENT(FQCoDel)
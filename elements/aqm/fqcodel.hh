@@ -0,0 +1,254 @@
+// -*- mode: c++; c-basic-offset: 4 -*-
+#ifndef CLICK_FQCODEL_HH
+#define CLICK_FQCODEL_HH
+#include <click/element.hh>
+#include <click/notifier.hh>
+#include <click/timestamp.hh>
+CLICK_DECLS
+
+/*
+=c
+
+FQCoDel([I<KEYWORDS>])
+
+=s aqm
+
+stores packets in per-flow queues managed by CoDel
+
+=d
+
+Stores packets in a set of per-flow FIFO queues, schedules between the
+queues with deficit round robin, and drops packets from each queue using the
+CoDel (Controlled Delay) algorithm.  This is the FQ-CoDel queue discipline of
+RFC 8290.
+
+Each packet is timestamped when it is enqueued.  On dequeue, CoDel compares
+the packet's sojourn time with TARGET: once the sojourn time has stayed above
+TARGET for at least INTERVAL, CoDel starts dropping packets from the head of
+that flow's queue, at a rate that increases until the sojourn time falls
+below TARGET again.  TARGET and INTERVAL rarely need tuning.
+
+Packets are hashed into one of FLOWS queues.  By default the hash covers the
+IP source and destination addresses, the IP protocol, and the TCP or UDP
+ports; the packet's IP header annotation must be set.  Packets without an IP
+header annotation go to queue 0.  If OFFSET and LENGTH are given, the hash
+covers LENGTH bytes starting OFFSET bytes into the packet, as in HashSwitch.
+
+Newly active flows are served before flows that have been backlogged for a
+while, so sparse flows such as DNS and interactive traffic see little delay.
+Each queue may send up to QUANTUM bytes per round.
+
+FQCoDel holds at most LIMIT packets.  When a new packet would exceed LIMIT,
+FQCoDel finds the flow with the most bytes queued and drops packets from its
+head until it has dropped half of that flow's bytes, or 64 packets.  Dropping
+in batches keeps overload cheap, since finding the flow takes time
+proportional to FLOWS.
+
+Dropped packets are emitted on output 1 if output 1 exists.
+
+Keyword arguments are:
+
+=over 8
+
+=item TARGET
+
+Time value.  Acceptable standing queue delay.  Default is 5ms.
+
+=item INTERVAL
+
+Time value.  How long sojourn times must stay above TARGET before CoDel
+starts dropping; should be on the order of a worst-case round-trip time.
+Default is 100ms.
+
+=item LIMIT
+
+Unsigned integer.  Maximum number of packets queued.  Default is 10240.
+
+=item FLOWS
+
+Unsigned integer.  Number of flow queues.  Default is 1024.
+
+=item QUANTUM
+
+Unsigned integer.  Bytes each flow may send per round.  Default is 1514.
+
+=item MTU
+
+Unsigned integer.  CoDel does not drop from a flow that holds at most MTU
+bytes.  Default is 1514.
+
+=item OFFSET, LENGTH
+
+Unsigned integers.  If given, hash LENGTH bytes at OFFSET to select a flow.
+
+=back
+
+B<Multithreaded Click note:> FQCoDel supports at most one concurrent pusher
+and at most one concurrent puller, and they must not run concurrently.
+
+=h length read-only
+
+Returns the number of packets queued.
+
+=h bytes read-only
+
+Returns the number of bytes queued.
+
+=h highwater_length read-only
+
+Returns the maximum number of packets that have ever been queued at once.
+
+=h drops read-only
+
+Returns the number of packets dropped, both by CoDel and because the queue
+was full.
+
+=h codel_drops read-only
+
+Returns the number of packets dropped by CoDel.
+
+=h overlimit_drops read-only
+
+Returns the number of packets dropped because the queue held LIMIT packets.
+
+=h flows read-only
+
+Returns the number of flow queues that are currently active.
+
+=h flow_stats read-only
+
+Returns one line per flow queue that has seen traffic since the last reset,
+with the form `I<FLOW> I<LENGTH> I<DROPS> I<SOJOURN> I<MAX_SOJOURN>'.
+I<FLOW> is the queue index, I<LENGTH> the number of packets queued, I<DROPS>
+the number of packets dropped from that queue, and I<SOJOURN> and
+I<MAX_SOJOURN> the mean and maximum sojourn times of dequeued packets, in
+microseconds.
+
+=h target read/write
+
+Returns or sets the TARGET parameter.
+
+=h interval read/write
+
+Returns or sets the INTERVAL parameter.
+
+=h reset_counts write-only
+
+Resets the drop counts, C<highwater_length>, and the per-flow statistics.
+
+=h reset write-only
+
+Drops all queued packets.
+
+=e
+
+  FromDevice(eth0) -> ... -> BandwidthShaper(10Mbps)
+    -> FQCoDel -> ToDevice(eth1);
+
+=a CoDel, Queue, RED, DRRSched, HashSwitch
+
+Kathleen Nichols and Van Jacobson.  I<Controlled Delay Active Queue
+Management>.  RFC 8289, January 2018.
+
+Toke Hoeiland-Joergensen et al.  I<The Flow Queue CoDel Packet Scheduler and
+Active Queue Management Algorithm>.  RFC 8290, January 2018. */
+
+class FQCoDel : public Element { public:
+
+    FQCoDel();
+    ~FQCoDel();
+
+    const char *class_name() const		{ return "FQCoDel"; }
+    const char *port_count() const		{ return PORTS_1_1X2; }
+    const char *processing() const		{ return "h/lh"; }
+    void *cast(const char *);
+
+    int configure(Vector<String> &, ErrorHandler *);
+    int initialize(ErrorHandler *);
+    void cleanup(CleanupStage);
+    void add_handlers();
+
+    void push(int port, Packet *);
+    Packet *pull(int port);
+
+  protected:
+
+    enum { none = 0xFFFFFFFFU };
+
+    struct slot {
+	Packet *p;
+	Timestamp enq_time;
+	uint32_t next;
+    };
+
+    struct flow {
+	uint32_t head;
+	uint32_t tail;
+	uint32_t length;
+	uint32_t bytes;
+	int32_t deficit;
+	uint32_t next;		// next flow in new or old list
+	int list;		// list_none, list_new, or list_old
+
+	// CoDel state
+	bool dropping;
+	uint32_t count;
+	uint32_t lastcount;
+	Timestamp first_above_time;
+	Timestamp drop_next;
+
+	// statistics
+	uint32_t drops;
+	uint32_t dequeues;
+	uint64_t sojourn_sum;	// microseconds
+	uint32_t max_sojourn;	// microseconds
+    };
+
+    enum { list_none = 0, list_new = 1, list_old = 2 };
+    enum { drop_batch = 64 };
+
+    struct flow_list {
+	uint32_t head;
+	uint32_t tail;
+    };
+
+    Timestamp _target;
+    Timestamp _interval;
+    uint32_t _limit;
+    uint32_t _nflows;
+    uint32_t _quantum;
+    uint32_t _mtu;
+    int _offset;
+    int _length;
+
+    slot *_slots;
+    uint32_t _free;
+    flow *_flows;
+    flow_list _new_flows;
+    flow_list _old_flows;
+
+    uint32_t _qlength;
+    uint32_t _qbytes;
+    uint32_t _highwater_length;
+    uint32_t _codel_drops;
+    uint32_t _overlimit_drops;
+
+    ActiveNotifier _empty_note;
+
+    uint32_t flow_index(const Packet *p) const;
+    inline void list_push(flow_list &l, uint32_t fi);
+    inline uint32_t list_pop(flow_list &l);
+    inline Packet *flow_pop(flow &f, Timestamp &enq_time);
+    void drop(flow &f, Packet *p);
+    void drop_fattest();
+    Packet *dodequeue(flow &f, const Timestamp &now, bool &ok_to_drop);
+    Packet *codel_dequeue(flow &f, const Timestamp &now);
+    inline Timestamp control_law(const Timestamp &t, uint32_t count) const;
+
+    static String read_handler(Element *, void *);
+    static int write_handler(const String &, Element *, void *, ErrorHandler *);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -54,14 +54,16 @@ ARPQuerier::cast(const char *name)
 int
 ARPQuerier::configure(Vector<String> &conf, ErrorHandler *errh)
 {
-    uint32_t capacity, entry_capacity;
+    uint32_t capacity, entry_capacity, entry_packet_capacity, shards;
     Timestamp timeout, poll_timeout(60);
-    bool have_capacity, have_entry_capacity, have_timeout, have_broadcast,
-	broadcast_poll = false;
+    bool have_capacity, have_entry_capacity, have_entry_packet_capacity,
+	have_shards, have_timeout, have_broadcast, broadcast_poll = false;
     _arpt = 0;
     if (Args(this, errh).bind(conf)
 	.read("CAPACITY", capacity).read_status(have_capacity)
 	.read("ENTRY_CAPACITY", entry_capacity).read_status(have_entry_capacity)
+	.read("ENTRY_PACKET_CAPACITY", entry_packet_capacity).read_status(have_entry_packet_capacity)
+	.read("SHARDS", shards).read_status(have_shards)
 	.read("TIMEOUT", timeout).read_status(have_timeout)
 	.read("BROADCAST", _my_bcast_ip).read_status(have_broadcast)
 	.read("TABLE", ElementCastArg("ARPTable"), _arpt)
@@ -76,12 +78,17 @@ ARPQuerier::configure(Vector<String> &conf, ErrorHandler *errh)
 	    subconf.push_back("CAPACITY " + String(capacity));
 	if (have_entry_capacity)
 	    subconf.push_back("ENTRY_CAPACITY " + String(entry_capacity));
+	if (have_entry_packet_capacity)
+	    subconf.push_back("ENTRY_PACKET_CAPACITY " + String(entry_packet_capacity));
+	if (have_shards)
+	    subconf.push_back("SHARDS " + String(shards));
 	if (have_timeout)
 	    subconf.push_back("TIMEOUT " + timeout.unparse());
 	_arpt = new ARPTable;
 	_arpt->attach_router(router(), -1);
-	_arpt->configure(subconf, errh);
 	_my_arpt = true;
+	if (_arpt->configure(subconf, errh) < 0)
+	    return -1;
     }
 
     IPAddress my_mask;
@@ -111,15 +118,17 @@ ARPQuerier::configure(Vector<String> &conf, ErrorHandler *errh)
 int
 ARPQuerier::live_reconfigure(Vector<String> &conf, ErrorHandler *errh)
 {
-    uint32_t capacity, entry_capacity;
+    uint32_t capacity, entry_capacity, entry_packet_capacity;
     Timestamp timeout, poll_timeout(Timestamp::make_jiffies((click_jiffies_t) _poll_timeout_j));
-    bool have_capacity, have_entry_capacity, have_timeout, have_broadcast,
-	broadcast_poll(_broadcast_poll);
+    bool have_capacity, have_entry_capacity, have_entry_packet_capacity,
+	have_timeout, have_broadcast, broadcast_poll(_broadcast_poll);
     IPAddress my_bcast_ip;
 
     if (Args(this, errh).bind(conf)
 	.read("CAPACITY", capacity).read_status(have_capacity)
 	.read("ENTRY_CAPACITY", entry_capacity).read_status(have_entry_capacity)
+	.read("ENTRY_PACKET_CAPACITY", entry_packet_capacity).read_status(have_entry_packet_capacity)
+	.read_with("SHARDS", AnyArg())
 	.read("TIMEOUT", timeout).read_status(have_timeout)
 	.read("BROADCAST", my_bcast_ip).read_status(have_broadcast)
 	.read_with("TABLE", AnyArg())
@@ -153,6 +162,8 @@ ARPQuerier::live_reconfigure(Vector<String> &conf, ErrorHandler *errh)
 	_arpt->set_capacity(capacity);
     if (_my_arpt && have_entry_capacity)
 	_arpt->set_entry_capacity(entry_capacity);
+    if (_my_arpt && have_entry_packet_capacity)
+	_arpt->set_entry_packet_capacity(entry_packet_capacity);
     if (_my_arpt && have_timeout)
 	_arpt->set_timeout(timeout);
 
@@ -247,7 +258,7 @@ ARPQuerier::send_query_for(const Packet *p, bool ether_dhost_valid)
  * May call p->kill().
  */
 void
-ARPQuerier::handle_ip(Packet *p, bool response)
+ARPQuerier::handle_ip(Packet *p)
 {
     // delete packet if we are not configured
     if (!_my_ip) {
@@ -258,10 +269,7 @@ ARPQuerier::handle_ip(Packet *p, bool response)
 
     // make room for Ethernet header
     WritablePacket *q;
-    if (response) {
-	assert(!p->shared());
-	q = p->uniqueify();
-    } else if (!(q = p->push_mac_header(sizeof(click_ether)))) {
+    if (!(q = p->push_mac_header(sizeof(click_ether)))) {
 	++_drops;
 	return;
     } else
@@ -271,8 +279,8 @@ ARPQuerier::handle_ip(Packet *p, bool response)
     EtherAddress *dst_eth = reinterpret_cast<EtherAddress *>(q->ether_header()->ether_dhost);
     int r;
 
-    // Easy case: requires only read lock
-  retry_read_lock:
+    // Easy case: requires no lock
+  retry_lookup:
     r = _arpt->lookup(dst_ip, dst_eth, _poll_timeout_j);
     if (r >= 0) {
 	assert(!dst_eth->is_broadcast());
@@ -304,10 +312,11 @@ ARPQuerier::handle_ip(Packet *p, bool response)
 	} else {
 	    r = _arpt->append_query(dst_ip, q);
 	    if (r == -EAGAIN)
-		goto retry_read_lock;
+		goto retry_lookup;
 	    if (r > 0)
 		send_query_for(q, false); // q is on the ARP entry's queue
-	    // Do not q->kill() since it is stored in some ARP entry.
+	    // Do not q->kill() since it is stored in some ARP entry, or
+	    // the table has already killed it.
 	}
 	return;
     }
@@ -344,10 +353,19 @@ ARPQuerier::handle_response(Packet *p)
 	Packet *cached_packet;
 	_arpt->insert(ipa, ena, &cached_packet);
 
-	// Send out packets in the order in which they arrived
+	// Send out packets in the order in which they arrived.  They already
+	// have Ethernet headers, and the reply gives their destination, so
+	// there is no need to look each one up again.
 	while (cached_packet) {
 	    Packet *next = cached_packet->next();
-	    handle_ip(cached_packet, true);
+	    assert(!cached_packet->shared());
+	    if (WritablePacket *q = cached_packet->uniqueify()) {
+		click_ether *qethh = q->ether_header();
+		memcpy(qethh->ether_dhost, ena.data(), 6);
+		memcpy(qethh->ether_shost, _my_en.data(), 6);
+		output(0).push(q);
+	    } else
+		++_drops;
 	    cached_packet = next;
 	}
     }
@@ -357,7 +375,7 @@ void
 ARPQuerier::push(int port, Packet *p)
 {
     if (port == 0)
-	handle_ip(p, false);
+	handle_ip(p);
     else {
 	handle_response(p);
 	p->kill();
@@ -384,6 +402,13 @@ ARPQuerier::read_handler(Element *e, void *thunk)
     }
 }
 
+int
+ARPQuerier::table_handler(int op, String &data, Element *e, const Handler *h, ErrorHandler *errh)
+{
+    ARPQuerier *q = (ARPQuerier *) e;
+    return ARPTable::table_handler(op, data, q->_arpt, h, errh);
+}
+
 int
 ARPQuerier::write_handler(const String &str, Element *e, void *thunk, ErrorHandler *errh)
 {
@@ -405,7 +430,7 @@ ARPQuerier::write_handler(const String &str, Element *e, void *thunk, ErrorHandl
 void
 ARPQuerier::add_handlers()
 {
-    add_read_handler("table", read_handler, h_table);
+    set_handler("table", Handler::h_read | Handler::h_read_param | Handler::h_read_chunked, table_handler);
     add_read_handler("stats", read_handler, h_stats);
     add_read_handler("count", read_handler, h_count);
     add_read_handler("length", read_handler, h_length);
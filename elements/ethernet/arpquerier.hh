@@ -55,8 +55,8 @@ Keyword arguments are:
 
 Element.  Names an ARPTable element that holds this element's corresponding
 ARP state.  By default ARPQuerier creates its own internal ARPTable and uses
-that.  If TABLE is specified, CAPACITY, ENTRY_CAPACITY, and TIMEOUT are
-ignored.
+that.  If TABLE is specified, CAPACITY, ENTRY_CAPACITY,
+ENTRY_PACKET_CAPACITY, SHARDS, and TIMEOUT are ignored.
 
 =item CAPACITY
 
@@ -68,6 +68,17 @@ hold at a time.  Default is 2048.
 Unsigned integer.  The maximum number of ARP entries the table will hold
 at a time.  Default is 0, which means unlimited.
 
+=item ENTRY_PACKET_CAPACITY
+
+Unsigned integer.  The maximum number of saved IP packets the table will hold
+for any one IP address; when it is reached, the oldest packet for that
+address is dropped.  Default is 0, which means no per-address limit.
+
+=item SHARDS
+
+Unsigned integer.  The number of independently locked partitions of the
+table; see ARPTable.  Default is 16 in multithreaded Click, 1 otherwise.
+
 =item TIMEOUT
 
 Amount of time before an ARP entry expires.  Defaults to 5 minutes.
@@ -109,7 +120,8 @@ ARPQuerier uses packets' destination IP address annotations, and can destroy
 their next packet annotations.  Generated ARP queries have VLAN TCI
 annotations set from the corresponding input packets.
 
-ARPQuerier will send at most 10 queries a second for any IP address.
+ARPQuerier will send at most 10 queries a second for any IP address.  When
+the reply arrives, all packets saved for that address are sent at once.
 
 =h ipaddr rw
 
@@ -122,7 +134,7 @@ Returns the ARPQuerier's IP broadcast address.
 =h table r
 
 Returns a textual representation of the ARP table.  See ARPTable's table
-handler.
+handler, which this handler resembles, including support for chunked reads.
 
 =h stats r
 
@@ -207,13 +219,14 @@ class ARPQuerier : public Element { public:
 
     void send_query_for(const Packet *p, bool ether_dhost_valid);
 
-    void handle_ip(Packet *p, bool response);
+    void handle_ip(Packet *p);
     void handle_response(Packet *p);
 
     static void expire_hook(Timer *, void *);
     static String read_table(Element *, void *);
     static String read_table_xml(Element *, void *);
     static String read_handler(Element *, void *);
+    static int table_handler(int, String &, Element *, const Handler *, ErrorHandler *);
     static int write_handler(const String &, Element *, void *, ErrorHandler *);
 
     enum { h_table, h_table_xml, h_stats, h_insert, h_delete, h_clear,
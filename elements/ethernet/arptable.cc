@@ -31,9 +31,10 @@
 CLICK_DECLS
 
 ARPTable::ARPTable()
-    : _entry_capacity(0), _packet_capacity(2048), _expire_timer(this)
+    : _entry_capacity(0), _packet_capacity(2048),
+      _entry_packet_capacity(0), _expire_timer(this)
 {
-    _entry_count = _packet_count = _drops = 0;
+    _entry_count = _packet_count = _drops = _age_clock = 0;
 }
 
 ARPTable::~ARPTable()
@@ -44,12 +45,26 @@ int
 ARPTable::configure(Vector<String> &conf, ErrorHandler *errh)
 {
     Timestamp timeout(300);
+#if HAVE_MULTITHREAD
+    uint32_t nshards = _table.initialized() ? shards() : 16;
+#else
+    uint32_t nshards = _table.initialized() ? shards() : 1;
+#endif
     if (Args(conf, this, errh)
 	.read("CAPACITY", _packet_capacity)
 	.read("ENTRY_CAPACITY", _entry_capacity)
+	.read("ENTRY_PACKET_CAPACITY", _entry_packet_capacity)
 	.read("TIMEOUT", timeout)
+	.read("SHARDS", nshards)
 	.complete() < 0)
 	return -1;
+    if (nshards == 0 || nshards > Table::max_shards || (nshards & (nshards - 1)))
+	return errh->error("SHARDS must be a power of two between 1 and %d", Table::max_shards);
+    if (!_table.initialized()) {
+	if (_table.initialize(nshards, initial_buckets) < 0)
+	    return errh->error("out of memory");
+    } else if (nshards != shards())
+	return errh->error("SHARDS cannot change during live reconfiguration");
     set_timeout(timeout);
     if (_timeout_j) {
 	_expire_timer.initialize(this);
@@ -64,80 +79,181 @@ ARPTable::cleanup(CleanupStage)
     clear();
 }
 
+void
+ARPTable::drop_head(ARPEntry *ae)
+{
+    Packet *p = ae->_head;
+    if (!(ae->_head = p->next()))
+	ae->_tail = 0;
+    p->kill();
+    --ae->_npackets;
+    --_packet_count;
+    ++_drops;
+}
+
+void
+ARPTable::free_entry(Shard &sh, ARPEntry *ae)
+{
+    while (ae->_head)
+	drop_head(ae);
+    sh.alloc.deallocate(ae);
+    --_entry_count;
+}
+
 void
 ARPTable::clear()
 {
     // Walk the arp cache table and free any stored packets and arp entries.
-    for (Table::iterator it = _table.begin(); it; ) {
-	ARPEntry *ae = _table.erase(it);
-	while (Packet *p = ae->_head) {
-	    ae->_head = p->next();
-	    p->kill();
-	    ++_drops;
+    if (!_table.initialized())
+	return;
+    for (uint32_t i = 0; i < _table.nshards(); ++i) {
+	Shard &sh = _table.shard_at(i);
+	Table::lock(sh);
+	while (ARPEntry *ae = sh.age.front()) {
+	    sh.age.pop_front();
+	    Table::unlink(sh, ae);
+	    free_entry(sh, ae);
 	}
-	_alloc.deallocate(ae);
+	Table::unlock(sh);
     }
-    _entry_count = _packet_count = 0;
-    _age.__clear();
 }
 
 void
 ARPTable::take_state(Element *e, ErrorHandler *errh)
 {
     ARPTable *arpt = (ARPTable *)e->cast("ARPTable");
-    if (!arpt)
+    if (!arpt || !arpt->_table.initialized())
 	return;
-    if (_table.size() > 0) {
+    if (_entry_count > 0) {
 	errh->error("late take_state");
 	return;
     }
 
-    _table.swap(arpt->_table);
-    _age.swap(arpt->_age);
-    _entry_count = arpt->_entry_count;
-    _packet_count = arpt->_packet_count;
+    // With the same shard layout, take over the whole table in constant
+    // time, so the hotswap pause does not grow with the table.
+    if (arpt->shards() == shards()) {
+	_table.swap(arpt->_table);
+	_entry_count = arpt->_entry_count;
+	_packet_count = arpt->_packet_count;
+	_age_clock = arpt->_age_clock;
+	_drops = arpt->_drops;
+	arpt->_entry_count = 0;
+	arpt->_packet_count = 0;
+	return;
+    }
+
+    // Otherwise move the entries, oldest first, since they may belong to a different
+    // shard here.
+    for (uint32_t i = 0; i < arpt->_table.nshards(); ++i)
+	arpt->_table.shard_at(i).walk = arpt->_table.shard_at(i).age.front();
+    while (Shard *osp = arpt->oldest_walk(0)) {
+	Shard &osh = *osp;
+	ARPEntry *oae = osh.walk;
+	osh.age.pop_front();
+	osh.walk = osh.age.front();
+	Table::unlink(osh, oae);
+	uint32_t h = ARPEntry::hashcode(oae->_ip);
+	Shard &sh = _table.shard(h);
+	void *x = sh.alloc.allocate();
+	if (!x) {
+	    arpt->free_entry(osh, oae);
+	    continue;
+	}
+	ARPEntry *ae = new(x) ARPEntry(oae->_ip);
+	ae->_npackets = oae->_npackets;
+	ae->_eth = oae->_eth;
+	ae->_known = oae->_known;
+	ae->_num_polls_since_reply = oae->_num_polls_since_reply;
+	ae->_live_at_j = oae->_live_at_j;
+	ae->_polled_at_j = oae->_polled_at_j;
+	ae->_head = oae->_head;
+	ae->_tail = oae->_tail;
+	Table::lock(sh);
+	Table::link(sh, ae, h);
+	push_age(sh, ae);
+	Table::unlock(sh);
+	++_entry_count;
+	_packet_count += ae->_npackets;
+	arpt->_packet_count -= ae->_npackets;
+	oae->_head = oae->_tail = 0;
+	arpt->free_entry(osh, oae);
+    }
     _drops = arpt->_drops;
-    _alloc.swap(arpt->_alloc);
+}
 
-    arpt->_entry_count = 0;
-    arpt->_packet_count = 0;
+ARPTable::Shard *
+ARPTable::oldest_walk(const bool *held) const
+{
+    // Return the held shard whose walk cursor is oldest, or null.
+    Shard *o = 0;
+    for (uint32_t i = 0; i < _table.nshards(); ++i)
+	if ((!held || held[i]) && _table.shard_at(i).walk
+	    && (!o || older(_table.shard_at(i).walk, o->walk)))
+	    o = &_table.shard_at(i);
+    return o;
 }
 
 void
-ARPTable::slim(click_jiffies_t now)
+ARPTable::expire(Shard &sh, click_jiffies_t now)
 {
-    ARPEntry *ae;
-
-    // Delete old entries.
-    while ((ae = _age.front())
-	   && (ae->expired(now, _timeout_j)
-	       || (_entry_capacity && _entry_count > _entry_capacity))) {
-	_table.erase(ae->_ip);
-	_age.pop_front();
+    while (ARPEntry *ae = sh.age.front()) {
+	if (!ae->expired(now, _timeout_j))
+	    break;
+	sh.age.pop_front();
+	Table::unlink(sh, ae);
+	free_entry(sh, ae);
+    }
+}
 
-	while (Packet *p = ae->_head) {
-	    ae->_head = p->next();
-	    p->kill();
-	    --_packet_count;
-	    ++_drops;
+void
+ARPTable::reclaim(Shard *sh, click_jiffies_t now, bool entries)
+{
+    // Evict what a single table would: expired entries, then the oldest
+    // entries and packets of the whole table, found by merging the shards'
+    // age lists.  "sh", if set, is locked already; the other shards are
+    // skipped if busy, since waiting for them while holding sh's lock could
+    // deadlock.  With no "sh", wait for every shard, in order.
+    bool held[Table::max_shards];
+    for (uint32_t i = 0; i < _table.nshards(); ++i) {
+	Shard &osh = _table.shard_at(i);
+	if (&osh == sh)
+	    held[i] = true;
+	else if (sh)
+	    held[i] = Table::try_lock(osh);
+	else {
+	    Table::lock(osh);
+	    held[i] = true;
 	}
+	if (held[i] && entries)
+	    expire(osh, now);
+	osh.walk = held[i] ? osh.age.front() : 0;
+    }
 
-	_alloc.deallocate(ae);
-	--_entry_count;
+    Shard *o;
+    while (entries && _entry_capacity && _entry_count > _entry_capacity
+	   && (o = oldest_walk(held))) {
+	ARPEntry *ae = o->walk;
+	o->age.pop_front();
+	Table::unlink(*o, ae);
+	free_entry(*o, ae);
+	o->walk = o->age.front();
     }
 
-    // Mark entries for polling, and delete packets to make space.
-    while (_packet_capacity && _packet_count > _packet_capacity) {
-	while (ae->_head && _packet_count > _packet_capacity) {
-	    Packet *p = ae->_head;
-	    if (!(ae->_head = p->next()))
-		ae->_tail = 0;
-	    p->kill();
-	    --_packet_count;
-	    ++_drops;
+    // Delete packets, oldest entries first.
+    if (_packet_capacity && _packet_count > _packet_capacity) {
+	for (uint32_t i = 0; i < _table.nshards(); ++i)
+	    for (ARPEntry *&w = _table.shard_at(i).walk; w && !w->_head; )
+		w = w->_age_link.next();
+	while (_packet_count > _packet_capacity && (o = oldest_walk(held))) {
+	    drop_head(o->walk);
+	    while (o->walk && !o->walk->_head)
+		o->walk = o->walk->_age_link.next();
 	}
-	ae = ae->_age_link.next();
     }
+
+    for (uint32_t i = 0; i < _table.nshards(); ++i)
+	if (held[i] && &_table.shard_at(i) != sh)
+	    Table::unlock(_table.shard_at(i));
 }
 
 void
@@ -145,46 +261,79 @@ ARPTable::run_timer(Timer *timer)
 {
     // Expire any old entries, and make sure there's room for at least one
     // packet.
-    _lock.acquire_write();
-    slim(click_jiffies());
-    _lock.release_write();
+    reclaim(0, click_jiffies(), true);
     if (_timeout_j)
 	timer->schedule_after_sec(_timeout_j / CLICK_HZ + 1);
 }
 
 ARPTable::ARPEntry *
-ARPTable::ensure(IPAddress ip, click_jiffies_t now)
+ARPTable::ensure(Shard &sh, IPAddress ip, uint32_t h, click_jiffies_t now)
 {
-    _lock.acquire_write();
-    Table::iterator it = _table.find(ip);
-    if (!it) {
-	void *x = _alloc.allocate();
-	if (!x) {
-	    _lock.release_write();
+    // The caller holds sh's lock.
+    ARPEntry *ae = Table::find(sh, ip, h);
+    if (!ae) {
+	void *x = sh.alloc.allocate();
+	if (!x)
 	    return 0;
-	}
 
 	++_entry_count;
-	if (_entry_capacity && _entry_count > _entry_capacity)
-	    slim(now);
+	if (_entry_capacity && _entry_count > _entry_capacity) {
+	    reclaim(&sh, now, true);
+	    if (_entry_count > _entry_capacity) {
+		--_entry_count;
+		sh.alloc.deallocate(x);
+		return 0;
+	    }
+	}
 
-	ARPEntry *ae = new(x) ARPEntry(ip);
+	ae = new(x) ARPEntry(ip);
 	ae->_live_at_j = now;
 	ae->_polled_at_j = ae->_live_at_j - CLICK_HZ;
-	_table.set(it, ae);
+	Table::link(sh, ae, h);
+
+	push_age(sh, ae);
+    }
+    return ae;
+}
 
-	_age.push_back(ae);
+int
+ARPTable::lookup_locked(IPAddress ip, EtherAddress *eth, uint32_t poll_timeout_j)
+{
+    uint32_t h = ARPEntry::hashcode(ip);
+    Shard &sh = _table.shard(h);
+    Table::lock(sh);
+    int r = -1;
+    if (ARPEntry *ae = Table::find(sh, ip, h)) {
+	click_jiffies_t now = click_jiffies();
+	if (ae->known(now, _timeout_j)) {
+	    *eth = ae->_eth;
+	    if (poll_timeout_j
+		&& !click_jiffies_less(now, ae->_live_at_j + poll_timeout_j)
+		&& ae->allow_poll(now)) {
+		ae->mark_poll(now);
+		r = 1;
+	    } else
+		r = 0;
+	}
     }
-    return it.get();
+    Table::unlock(sh);
+    return r;
 }
 
 int
 ARPTable::insert(IPAddress ip, const EtherAddress &eth, Packet **head)
 {
     click_jiffies_t now = click_jiffies();
-    ARPEntry *ae = ensure(ip, now);
-    if (!ae)
+    uint32_t h = ARPEntry::hashcode(ip);
+    Shard &sh = _table.shard(h);
+    Table::lock(sh);
+    ARPEntry *ae = ensure(sh, ip, h, now);
+    if (!ae) {
+	Table::unlock(sh);
+	if (head)
+	    *head = 0;
 	return -ENOMEM;
+    }
 
     ae->_eth = eth;
     ae->_known = !eth.is_broadcast();
@@ -193,33 +342,45 @@ ARPTable::insert(IPAddress ip, const EtherAddress &eth, Packet **head)
     ae->_num_polls_since_reply = 0;
     ae->_polled_at_j = ae->_live_at_j - CLICK_HZ;
 
-    if (ae->_age_link.next()) {
-	_age.erase(ae);
-	_age.push_back(ae);
-    }
+    sh.age.erase(ae);
+    push_age(sh, ae);
 
+    // Hand the whole queue to the caller, which can send it as a batch.
     if (head) {
 	*head = ae->_head;
+	_packet_count -= ae->_npackets;
 	ae->_head = ae->_tail = 0;
-	for (Packet *p = *head; p; p = p->next())
-	    --_packet_count;
+	ae->_npackets = 0;
     }
 
-    _table.balance();
-    _lock.release_write();
+    Table::unlock(sh);
     return 0;
 }
 
+/** @brief Queue @a p until @a ip is resolved.
+ * @return 1 if the caller should send an ARP query for @a ip, 0 if not,
+ * -EAGAIN if @a ip was resolved in the meantime, or -ENOMEM if there is no
+ * room for @a p
+ *
+ * On -EAGAIN, @a p is left to the caller.  Otherwise the table owns @a p;
+ * on -ENOMEM, it has been killed. */
 int
 ARPTable::append_query(IPAddress ip, Packet *p)
 {
     click_jiffies_t now = click_jiffies();
-    ARPEntry *ae = ensure(ip, now);
-    if (!ae)
+    uint32_t h = ARPEntry::hashcode(ip);
+    Shard &sh = _table.shard(h);
+    Table::lock(sh);
+    ARPEntry *ae = ensure(sh, ip, h, now);
+    if (!ae) {
+	Table::unlock(sh);
+	p->kill();
+	++_drops;
 	return -ENOMEM;
+    }
 
     if (ae->known(now, _timeout_j)) {
-	_lock.release_write();
+	Table::unlock(sh);
 	return -EAGAIN;
     }
 
@@ -231,21 +392,35 @@ ARPTable::append_query(IPAddress ip, Packet *p)
 	click_jiffies_t live_at_j_min = now - _timeout_j;
 	if (click_jiffies_less(ae->_live_at_j, live_at_j_min)) {
 	    ae->_live_at_j = live_at_j_min;
+	    ae->_age_order = _age_clock.fetch_and_add(1);
+	    ae->_age_moved = true;
 	    // Now move "ae" to the right position in the list by walking
 	    // forward over other elements (potentially expensive?).
 	    ARPEntry *ae_next = ae->_age_link.next(), *next = ae_next;
 	    while (next && click_jiffies_less(next->_live_at_j, ae->_live_at_j))
 		next = next->_age_link.next();
 	    if (ae_next != next) {
-		_age.erase(ae);
-		_age.insert(next /* might be null */, ae);
+		sh.age.erase(ae);
+		sh.age.insert(next /* might be null */, ae);
 	    }
 	}
     }
 
+    if (_entry_packet_capacity && ae->_npackets >= _entry_packet_capacity)
+	drop_head(ae);
+
+    // Only packets are reclaimed here; deleting entries could delete "ae".
     ++_packet_count;
-    if (_packet_capacity && _packet_count > _packet_capacity)
-	slim(now);
+    if (_packet_capacity && _packet_count > _packet_capacity) {
+	reclaim(&sh, now, false);
+	if (_packet_count > _packet_capacity) {
+	    --_packet_count;
+	    Table::unlock(sh);
+	    p->kill();
+	    ++_drops;
+	    return -ENOMEM;
+	}
+    }
 
     if (ae->_tail)
 	ae->_tail->set_next(p);
@@ -253,6 +428,7 @@ ARPTable::append_query(IPAddress ip, Packet *p)
 	ae->_head = p;
     ae->_tail = p;
     p->set_next(0);
+    ++ae->_npackets;
 
     int r;
     if (ae->allow_poll(now)) {
@@ -261,27 +437,35 @@ ARPTable::append_query(IPAddress ip, Packet *p)
     } else
 	r = 0;
 
-    _table.balance();
-    _lock.release_write();
+    Table::unlock(sh);
     return r;
 }
 
 IPAddress
 ARPTable::reverse_lookup(const EtherAddress &eth)
 {
-    _lock.acquire_read();
-
     IPAddress ip;
-    for (Table::iterator it = _table.begin(); it; ++it)
-	if (it->_eth == eth) {
-	    ip = it->_ip;
-	    break;
-	}
-
-    _lock.release_read();
+    for (uint32_t i = 0; i < _table.nshards() && !ip; ++i) {
+	Shard &sh = _table.shard_at(i);
+	sh.lock.acquire();
+	for (ARPEntry *ae = sh.age.front(); ae; ae = ae->_age_link.next())
+	    if (ae->_eth == eth) {
+		ip = ae->_ip;
+		break;
+	    }
+	sh.lock.release();
+    }
     return ip;
 }
 
+void
+ARPTable::unparse_entry(StringAccum &sa, const ARPEntry *ae, click_jiffies_t now) const
+{
+    int ok = ae->known(now, _timeout_j);
+    sa << ae->_ip << ' ' << ok << ' ' << ae->_eth << ' '
+       << Timestamp::make_jiffies(now - ae->_live_at_j) << '\n';
+}
+
 String
 ARPTable::read_handler(Element *e, void *user_data)
 {
@@ -290,16 +474,55 @@ ARPTable::read_handler(Element *e, void *user_data)
     click_jiffies_t now = click_jiffies();
     switch (reinterpret_cast<uintptr_t>(user_data)) {
     case h_table:
-	for (ARPEntry *ae = arpt->_age.front(); ae; ae = ae->_age_link.next()) {
-	    int ok = ae->known(now, arpt->_timeout_j);
-	    sa << ae->_ip << ' ' << ok << ' ' << ae->_eth << ' '
-	       << Timestamp::make_jiffies(now - ae->_live_at_j) << '\n';
+	// Report entries oldest first, merging the shards' age lists.
+	for (uint32_t i = 0; i < arpt->_table.nshards(); ++i) {
+	    arpt->_table.shard_at(i).lock.acquire();
+	    arpt->_table.shard_at(i).walk = arpt->_table.shard_at(i).age.front();
+	}
+	while (Shard *o = arpt->oldest_walk(0)) {
+	    arpt->unparse_entry(sa, o->walk, now);
+	    o->walk = o->walk->_age_link.next();
 	}
+	for (uint32_t i = 0; i < arpt->_table.nshards(); ++i)
+	    arpt->_table.shard_at(i).lock.release();
 	break;
     }
     return sa.take_string();
 }
 
+struct ARPTable::EntryWriter {
+    StringAccum sa;
+    const ARPTable *arpt;
+    click_jiffies_t now;
+    EntryWriter(const ARPTable *a)
+	: arpt(a), now(click_jiffies()) {
+    }
+    void operator()(const ARPEntry *ae) {
+	arpt->unparse_entry(sa, ae, now);
+    }
+};
+
+int
+ARPTable::table_handler(int, String &data, Element *e, const Handler *, ErrorHandler *errh)
+{
+    ARPTable *arpt = (ARPTable *) e;
+    if (!data) {
+	data = read_handler(e, (void *) (uintptr_t) h_table);
+	return 0;
+    }
+
+    // A chunk cursor is a ShardedSeqlockTable::read_chunk() position.
+    uint32_t max, b = 0;
+    String cursor;
+    if (!Handler::parse_chunk_param(data, max, cursor)
+	|| (cursor && !IntArg().parse(cursor, b)))
+	return errh->error("expected %<CHUNK max [cursor]%>");
+    EntryWriter w(arpt);
+    bool more = arpt->_table.read_chunk(b, max, w);
+    data = Handler::chunk_value(more ? String(b) : String(), w.sa.take_string());
+    return 0;
+}
+
 int
 ARPTable::write_handler(const String &str, Element *e, void *user_data, ErrorHandler *errh)
 {
@@ -336,7 +559,7 @@ ARPTable::write_handler(const String &str, Element *e, void *user_data, ErrorHan
 void
 ARPTable::add_handlers()
 {
-    add_read_handler("table", read_handler, h_table);
+    set_handler("table", Handler::h_read | Handler::h_read_param | Handler::h_read_chunked, table_handler);
     add_data_handlers("drops", Handler::OP_READ, &_drops);
     add_data_handlers("count", Handler::OP_READ, &_entry_count);
     add_data_handlers("length", Handler::OP_READ, &_packet_count);
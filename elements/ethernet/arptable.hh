@@ -2,11 +2,10 @@
 #define CLICK_ARPTABLE_HH
 #include <click/element.hh>
 #include <click/etheraddress.hh>
-#include <click/hashcontainer.hh>
-#include <click/hashallocator.hh>
-#include <click/sync.hh>
+#include <click/hashcode.hh>
 #include <click/timer.hh>
 #include <click/list.hh>
+#include <click/shardedseqlocktable.hh>
 CLICK_DECLS
 
 /*
@@ -40,11 +39,45 @@ hold at a time.  Default is 2048; zero means unlimited.
 Unsigned integer.  The maximum number of ARP entries the ARPTable will hold at
 a time.  Default is zero, which means unlimited.
 
+=item ENTRY_PACKET_CAPACITY
+
+Unsigned integer.  The maximum number of saved IP packets the ARPTable will
+hold for any one ARP entry.  When an entry's queue is full, its oldest packet
+is dropped to make room.  Default is zero, which means unlimited (up to
+CAPACITY).
+
 =item TIMEOUT
 
 Time value.  The amount of time after which an ARP entry will expire.  Default
 is 5 minutes.  Zero means ARP entries never expire.
 
+=item SHARDS
+
+Unsigned integer, a power of two between 1 and 256.  The number of
+independently locked partitions of the table.  Default is 16 in
+multithreaded Click, 1 otherwise.
+
+=back
+
+Lookups do not take any lock.  The table is divided into SHARDS partitions
+by a hash of the IP address; each partition has a lock that serializes
+updates and a sequence counter that lets readers detect concurrent updates
+and retry.  Entry memory is never returned to the system while the table
+exists, so a reader racing with an update never follows a dangling pointer.
+CAPACITY and ENTRY_CAPACITY are global limits, enforced by evicting the
+oldest entries and packets of the whole table, as an unpartitioned table
+would; only partitions whose locks are busy at that moment are passed over.
+
+Packets for an unresolved address are queued on its entry, and at most one
+query per entry is requested every 100 milliseconds (every 2 seconds after
+10 unanswered queries), so a burst of packets towards an unresolved next hop
+causes a single query.  The reply releases the entry's whole queue at once.
+
+When a configuration is hotswapped in, an ARPTable takes over the entries and
+queued packets of the old configuration's ARPTable with the same name.  If
+both have the same number of SHARDS, it takes the whole table in constant
+time.
+
 =h table r
 
 Return a table of the ARP entries.  The returned string has four
@@ -52,6 +85,11 @@ space-separated columns: an IP address, whether the entry is valid (1 means
 valid, 0 means not), the corresponding Ethernet address, and finally, the
 amount of time since the entry was last updated.
 
+Large tables can be read in chunks, for example with ControlSocket's
+READSTREAM command.  Chunks list entries in hash order rather than age order,
+and entries added or removed during a chunked read may be missed or repeated.
+The unchunked table lists entries oldest first.
+
 =h drops r
 
 Return the number of packets dropped because of timeouts or capacity limits.
@@ -94,7 +132,7 @@ class ARPTable : public Element { public:
     void add_handlers();
     void cleanup(CleanupStage);
 
-    int lookup(IPAddress ip, EtherAddress *eth, uint32_t poll_timeout_j);
+    inline int lookup(IPAddress ip, EtherAddress *eth, uint32_t poll_timeout_j);
     EtherAddress lookup(IPAddress ip);
     IPAddress reverse_lookup(const EtherAddress &eth);
     int insert(IPAddress ip, const EtherAddress &en, Packet **head = 0);
@@ -113,6 +151,12 @@ class ARPTable : public Element { public:
     void set_entry_capacity(uint32_t entry_capacity) {
 	_entry_capacity = entry_capacity;
     }
+    uint32_t entry_packet_capacity() const {
+	return _entry_packet_capacity;
+    }
+    void set_entry_packet_capacity(uint32_t entry_packet_capacity) {
+	_entry_packet_capacity = entry_packet_capacity;
+    }
     Timestamp timeout() const {
 	return Timestamp::make_jiffies((click_jiffies_t) _timeout_j);
     }
@@ -122,6 +166,9 @@ class ARPTable : public Element { public:
 	else
 	    _timeout_j = timeout.jiffies();
     }
+    uint32_t shards() const {
+	return _table.nshards();
+    }
 
     uint32_t drops() const {
 	return _drops;
@@ -140,27 +187,35 @@ class ARPTable : public Element { public:
     };
     static String read_handler(Element *e, void *user_data);
     static int write_handler(const String &str, Element *e, void *user_data, ErrorHandler *errh);
+    static int table_handler(int op, String &data, Element *e, const Handler *h, ErrorHandler *errh);
 
-    struct ARPEntry {		// This structure is now larger than I'd like
-	IPAddress _ip;		// (40B) but probably still fine.
-	ARPEntry *_hashnext;
+    struct ARPEntry {
+	typedef IPAddress key_type;
+	typedef IPAddress key_const_reference;
+	IPAddress _ip;		// The allocator's free list overwrites the
+	uint32_t _npackets;	// first word of freed entries, so keep
+	ARPEntry *_hashnext;	// _hashnext elsewhere for lock-free readers.
 	EtherAddress _eth;
 	bool _known;
+	bool _age_moved;	// see ARPTable::older()
 	uint8_t _num_polls_since_reply;
 	click_jiffies_t _live_at_j;
 	click_jiffies_t _polled_at_j;
+	uint32_t _age_order;	// breaks _live_at_j ties
 	Packet *_head;
 	Packet *_tail;
 	List_member<ARPEntry> _age_link;
-	typedef IPAddress key_type;
-	typedef IPAddress key_const_reference;
 	ARPEntry(IPAddress ip)
-	    : _ip(ip), _hashnext(), _eth(EtherAddress::make_broadcast()),
-	      _known(false), _num_polls_since_reply(0), _head(), _tail() {
+	    : _ip(ip), _npackets(0), _hashnext(),
+	      _eth(EtherAddress::make_broadcast()),
+	      _known(false), _age_moved(false), _num_polls_since_reply(0), _head(), _tail() {
 	}
-	key_const_reference hashkey() const {
+	IPAddress hashkey() const {
 	    return _ip;
 	}
+	static uint32_t hashcode(IPAddress ip) {
+	    return hash_mix32(ip.addr());
+	}
 	bool expired(click_jiffies_t now, uint32_t timeout_j) const {
 	    return click_jiffies_less(_live_at_j + timeout_j, now)
 		&& timeout_j;
@@ -182,46 +237,99 @@ class ARPTable : public Element { public:
 
   private:
 
-    ReadWriteLock _lock;
+    typedef List<ARPEntry, &ARPEntry::_age_link> AgeList;
+
+    struct AgeState {
+	AgeList age;
+	ARPEntry *walk;			// merge cursor, used under lock
+    };
+
+    typedef ShardedSeqlockTable<ARPEntry, AgeState> Table;
+    typedef Table::Shard Shard;
+
+    enum { initial_buckets = 16 };
 
-    typedef HashContainer<ARPEntry> Table;
     Table _table;
-    typedef List<ARPEntry, &ARPEntry::_age_link> AgeList;
-    AgeList _age;
     atomic_uint32_t _entry_count;
     atomic_uint32_t _packet_count;
     uint32_t _entry_capacity;
     uint32_t _packet_capacity;
+    uint32_t _entry_packet_capacity;
     uint32_t _timeout_j;
     atomic_uint32_t _drops;
-    SizedHashAllocator<sizeof(ARPEntry)> _alloc;
+    atomic_uint32_t _age_clock;
     Timer _expire_timer;
 
-    ARPEntry *ensure(IPAddress ip, click_jiffies_t now);
-    void slim(click_jiffies_t now);
+    struct EntryReader {
+	bool known;
+	click_jiffies_t live_at_j;
+	EtherAddress eth;
+	void operator()(const ARPEntry *ae) {
+	    known = ae && ae->_known;
+	    if (ae) {
+		live_at_j = ae->_live_at_j;
+		eth = ae->_eth;
+	    }
+	}
+    };
+    struct EntryWriter;
+
+    void free_entry(Shard &sh, ARPEntry *ae);
+    void drop_head(ARPEntry *ae);
+    ARPEntry *ensure(Shard &sh, IPAddress ip, uint32_t h, click_jiffies_t now);
+    void push_age(Shard &sh, ARPEntry *ae) {
+	ae->_age_order = _age_clock.fetch_and_add(1);
+	ae->_age_moved = false;
+	sh.age.push_back(ae);
+    }
+    // Order entries as one table's age list would: by _live_at_j, then by
+    // push_age() order, except that append_query() moves an entry in front
+    // of the entries of its new age.
+    static bool older(const ARPEntry *a, const ARPEntry *b) {
+	if (a->_live_at_j != b->_live_at_j)
+	    return click_jiffies_less(a->_live_at_j, b->_live_at_j);
+	if (a->_age_moved != b->_age_moved)
+	    return a->_age_moved;
+	int32_t d = a->_age_order - b->_age_order;
+	return a->_age_moved ? d > 0 : d < 0;
+    }
+    Shard *oldest_walk(const bool *held) const;
+    void expire(Shard &sh, click_jiffies_t now);
+    void reclaim(Shard *sh, click_jiffies_t now, bool entries);
+    bool over_capacity() const {
+	return (_entry_capacity && _entry_count > _entry_capacity)
+	    || (_packet_capacity && _packet_count > _packet_capacity);
+    }
+    int lookup_locked(IPAddress ip, EtherAddress *eth, uint32_t poll_timeout_j);
+    void unparse_entry(StringAccum &sa, const ARPEntry *ae, click_jiffies_t now) const;
 
 };
 
+/** @brief Look up the Ethernet address for @a ip.
+ * @param[out] eth set to the Ethernet address
+ * @param poll_timeout_j if nonzero, request a poll for entries older than
+ * this many jiffies
+ * @return -1 if @a ip has no valid entry, 1 if it has a valid entry that
+ * should be polled (the caller should send an ARP query), 0 otherwise
+ *
+ * Does not take a lock unless the entry must be marked as polled. */
 inline int
 ARPTable::lookup(IPAddress ip, EtherAddress *eth, uint32_t poll_timeout_j)
 {
-    _lock.acquire_read();
-    int r = -1;
-    if (Table::iterator it = _table.find(ip)) {
+    EntryReader r;
+    if (_table.read(ip, ARPEntry::hashcode(ip), r)) {
 	click_jiffies_t now = click_jiffies();
-	if (it->known(now, _timeout_j)) {
-	    *eth = it->_eth;
-	    if (poll_timeout_j
-		&& !click_jiffies_less(now, it->_live_at_j + poll_timeout_j)
-		&& it->allow_poll(now)) {
-		it->mark_poll(now);
-		r = 1;
-	    } else
-		r = 0;
+	if (!r.known
+	    || (_timeout_j && click_jiffies_less(r.live_at_j + _timeout_j, now)))
+	    return -1;
+	if (!poll_timeout_j
+	    || click_jiffies_less(now, r.live_at_j + poll_timeout_j)) {
+	    *eth = r.eth;
+	    return 0;
 	}
+	// might poll: must lock
     }
-    _lock.release_read();
-    return r;
+    return lookup_locked(ip, eth, poll_timeout_j);
 }
 
 inline EtherAddress
@@ -26,21 +26,139 @@
 CLICK_DECLS
 
 EtherSwitch::EtherSwitch()
-    : _table(AddrInfo(-1, Timestamp())), _timeout(300)
+    : _nshards(1), _timeout(300), _vlan(false), _capacity(0), _tick(0),
+      _timer(this)
 {
+    _count = 0;
 }
 
 EtherSwitch::~EtherSwitch()
 {
-    _table.clear();
 }
 
 int
 EtherSwitch::configure(Vector<String> &conf, ErrorHandler *errh)
 {
-    return Args(conf, this, errh)
+#if HAVE_MULTITHREAD
+    uint32_t nshards = 16;
+#else
+    uint32_t nshards = 1;
+#endif
+    if (Args(conf, this, errh)
 	.read("TIMEOUT", SecondsArg(), _timeout)
-	.complete();
+	.read("VLAN", _vlan)
+	.read("CAPACITY", _capacity)
+	.read("SHARDS", nshards)
+	.complete() < 0)
+	return -1;
+    if (nshards == 0 || nshards > Table::max_shards || (nshards & (nshards - 1)))
+	return errh->error("SHARDS must be a power of two between 1 and %d", Table::max_shards);
+    _nshards = nshards;
+    return 0;
+}
+
+int
+EtherSwitch::initialize(ErrorHandler *errh)
+{
+    if (_table.initialize(_nshards, initial_buckets) < 0)
+	return errh->error("out of memory");
+    _timer.initialize(this);
+    schedule_tick();
+    return 0;
+}
+
+void
+EtherSwitch::cleanup(CleanupStage)
+{
+    clear();
+}
+
+void
+EtherSwitch::clear()
+{
+    if (!_table.initialized())
+	return;
+    for (uint32_t i = 0; i < _table.nshards(); ++i) {
+	Shard &sh = _table.shard_at(i);
+	Table::lock(sh);
+	for (int w = 0; w < wheel_size; ++w)
+	    while (Entry *e = sh.wheel[w].front()) {
+		sh.wheel[w].pop_front();
+		Table::unlink(sh, e);
+		sh.alloc.deallocate(e);
+		--_count;
+	    }
+	Table::unlock(sh);
+    }
+}
+
+void
+EtherSwitch::schedule_tick()
+{
+    // An association is dropped wheel_size - 1 to wheel_size ticks after
+    // its last refresh.
+    if (_timeout)
+	_timer.schedule_after(Timestamp(_timeout, 0) / (int) (wheel_size - 1));
+    else
+	_timer.unschedule();
+}
+
+void
+EtherSwitch::run_timer(Timer *)
+{
+    // Empty the wheel slot about to be reused.  Its associations were last
+    // refreshed wheel_size ticks ago.
+    uint32_t tick = _tick + 1;
+    for (uint32_t i = 0; i < _table.nshards(); ++i) {
+	Shard &sh = _table.shard_at(i);
+	WheelList &slot = sh.wheel[tick % wheel_size];
+	if (slot.empty())
+	    continue;
+	Table::lock(sh);
+	while (Entry *e = slot.front()) {
+	    slot.pop_front();
+	    Table::unlink(sh, e);
+	    sh.alloc.deallocate(e);
+	    --_count;
+	}
+	Table::unlock(sh);
+    }
+    _tick = tick;
+    schedule_tick();
+}
+
+void
+EtherSwitch::learn(uint64_t key, uint32_t h, int port)
+{
+    Shard &sh = _table.shard(h);
+    Table::lock(sh);
+    uint32_t tick = _tick;
+    WheelList &slot = sh.wheel[tick % wheel_size];
+    if (Entry *e = Table::find(sh, key, h)) {
+	e->_port = port;
+	if (e->_tick != tick) {
+	    sh.wheel[e->_tick % wheel_size].erase(e);
+	    slot.push_back(e);
+	    e->_tick = tick;
+	}
+	Table::unlock(sh);
+	return;
+    }
+
+    void *x;
+    if ((_capacity && _count >= _capacity) || !(x = sh.alloc.allocate())) {
+	Table::unlock(sh);
+	return;
+    }
+
+    Entry *e = new(x) Entry;
+    e->_key = key;
+    e->_port = port;
+    e->_tick = tick;
+    slot.push_back(e);
+    Table::link(sh, e, h);
+    ++_count;
+    Table::unlock(sh);
 }
 
 void
@@ -61,25 +179,7 @@ EtherSwitch::broadcast(int source, Packet *p)
 void
 EtherSwitch::push(int source, Packet *p)
 {
-    click_ether* e = (click_ether*) p->data();
-    int outport = -1;		// Broadcast
-
-    // 0 timeout means dumb switch
-    if (_timeout != 0) {
-	_table.set(EtherAddress(e->ether_shost), AddrInfo(source, p->timestamp_anno()));
-
-	// Set outport if dst is unicast, we have info about it, and the
-	// info is still valid.
-	EtherAddress dst(e->ether_dhost);
-	if (!dst.is_group()) {
-	    if (Table::iterator dst_info = _table.find(dst)) {
-		if (p->timestamp_anno() < dst_info.value().stamp + Timestamp(_timeout, 0))
-		    outport = dst_info.value().port;
-		else
-		    _table.erase(dst_info);
-	    }
-	}
-    }
+  int outport = switch_port(source, p);
 
   if (outport < 0)
     broadcast(source, p);
@@ -94,35 +194,72 @@ EtherSwitch::reader(Element* f, void *thunk)
 {
     EtherSwitch* sw = (EtherSwitch*)f;
     switch ((intptr_t) thunk) {
-    case 0: {
-	StringAccum sa;
-	for (Table::iterator iter = sw->_table.begin(); iter.live(); iter++)
-	    sa << iter.key() << ' ' << iter.value().port << '\n';
-	return sa.take_string();
-    }
     case 1:
 	return String(sw->_timeout);
+    case 2:
+	return String(sw->_count.value());
     default:
 	return String();
     }
 }
 
+struct EtherSwitch::TableWriter {
+    StringAccum sa;
+    bool vlan;
+    TableWriter(bool v)
+	: vlan(v) {
+    }
+    void operator()(const Entry *e) {
+	uint8_t mac[6];
+	uint64_t k = e->_key;
+	for (int j = 5; j >= 0; --j, k >>= 8)
+	    mac[j] = k;
+	sa << EtherAddress(mac) << ' ' << e->_port;
+	if (vlan)
+	    sa << ' ' << (uint32_t) k;
+	sa << '\n';
+    }
+};
+
+int
+EtherSwitch::table_handler(int, String &data, Element *e, const Handler *, ErrorHandler *errh)
+{
+    EtherSwitch *sw = (EtherSwitch *) e;
+    // A chunk cursor is a ShardedSeqlockTable::read_chunk() position.
+    uint32_t max = 0xFFFFFFFFU, b = 0;
+    String cursor;
+    bool chunked = data;
+    if (chunked && (!Handler::parse_chunk_param(data, max, cursor)
+		    || (cursor && !IntArg().parse(cursor, b))))
+	return errh->error("expected %<CHUNK max [cursor]%>");
+    TableWriter w(sw->_vlan);
+    bool more = sw->_table.read_chunk(b, max, w);
+    if (chunked)
+	data = Handler::chunk_value(more ? String(b) : String(), w.sa.take_string());
+    else
+	data = w.sa.take_string();
+    return 0;
+}
+
 int
 EtherSwitch::writer(const String &s, Element *e, void *, ErrorHandler *errh)
 {
     EtherSwitch *sw = (EtherSwitch *) e;
     if (!SecondsArg().parse_saturating(s, sw->_timeout))
 	return errh->error("expected timeout (integer)");
+    sw->schedule_tick();
     return 0;
 }
 
 void
 EtherSwitch::add_handlers()
 {
-    add_read_handler("table", reader, 0);
+    set_handler("table", Handler::h_read | Handler::h_read_param | Handler::h_read_chunked, table_handler);
     add_read_handler("timeout", reader, 1);
+    add_read_handler("count", reader, 2);
     add_write_handler("timeout", writer, 0);
 }
 
 EXPORT_ELEMENT(EtherSwitch)
+ELEMENT_MT_SAFE(EtherSwitch)
 CLICK_ENDDECLS
@@ -2,13 +2,18 @@
 #define CLICK_ETHERSWITCH_HH
 #include <click/element.hh>
 #include <click/etheraddress.hh>
-#include <click/hashtable.hh>
+#include <click/timer.hh>
+#include <click/hashcode.hh>
+#include <click/list.hh>
+#include <click/shardedseqlocktable.hh>
+#include <click/packet_anno.hh>
+#include <clicknet/ether.h>
 CLICK_DECLS
 
 /*
 =c
 
-EtherSwitch([I<keywords> TIMEOUT])
+EtherSwitch([I<keywords> TIMEOUT, VLAN, CAPACITY, SHARDS])
 
 =s ethernet
 
@@ -39,16 +44,50 @@ The timeout for port associations, in seconds.  Any port mapping (i.e.,
 binding between an address and a port number) is dropped after TIMEOUT seconds
 of inactivity.  If 0, the element acts like a dumb hub.  Default is 300.
 
+=item VLAN
+
+Boolean.  If true, then associations are learned separately for each VLAN:
+the VLAN ID in a packet's VLAN_TCI annotation, as set by VLANDecap or
+SetVLANAnno, is part of the key, so an address can be associated with
+different ports on different VLANs.  Flooding is not restricted by VLAN.
+Default is false.
+
+=item CAPACITY
+
+Unsigned integer.  The maximum number of port associations.  When the table
+is full, new addresses are not learned, and packets to them are flooded,
+until old associations time out.  Default is 0, which means unlimited.
+
+=item SHARDS
+
+Unsigned integer, a power of two between 1 and 256.  The number of
+independently locked partitions of the association table.  Default is 16 in
+multithreaded Click, 1 otherwise.
+
 =back
 
-=n
+Associations are aged by a timing wheel, so expiring them takes constant
+time per association, independent of table size.  An association is dropped
+between TIMEOUT and 8/7 TIMEOUT seconds after the last packet from its
+address.  Ages are measured by the router's clock, not packets' timestamp
+annotations.
 
-The EtherSwitch element has no limit on the memory consumed by cached Ethernet
-addresses.
+EtherSwitch may be used from several threads at once.  Looking up an address,
+and refreshing an association that has not changed, take no locks.  Learning
+a new or moved address locks one of SHARDS partitions of the table, chosen
+by a hash of the address.
 
 =h table read-only
 
-Returns the current port association table.
+Returns the current port association table, one `C<ADDR PORT>' line per
+association (`C<ADDR PORT VLAN>' if VLAN is true).  Large tables can be read
+in chunks, for example with ControlSocket's READSTREAM command; associations
+learned or dropped while a chunked read is in progress may be missed or
+repeated.
+
+=h count read-only
+
+Returns the number of port associations.
 
 =h timeout read/write
 
@@ -56,7 +95,7 @@ Returns or sets the TIMEOUT argument.
 
 =a
 
-ListenEtherSwitch, EtherSpanTree
+ListenEtherSwitch, EtherSpanTree, VLANDecap, SetVLANAnno
 */
 
 class EtherSwitch : public Element { public:
@@ -70,34 +109,124 @@ class EtherSwitch : public Element { public:
   const char *flow_code() const			{ return "#/[^#]"; }
 
     int configure(Vector<String> &, ErrorHandler *);
+    int initialize(ErrorHandler *);
+    void cleanup(CleanupStage);
     void add_handlers();
 
   void push(int port, Packet* p);
 
-    struct AddrInfo {
-	int port;
-	Timestamp stamp;
-	inline AddrInfo(int p, const Timestamp &t);
-    };
+    void run_timer(Timer *);
+
+  protected:
+
+    inline int switch_port(int source, Packet *p);
+    void broadcast(int source, Packet*);
 
   private:
 
-    typedef HashTable<EtherAddress, AddrInfo> Table;
+    struct Entry {
+	typedef uint64_t key_type;
+	typedef uint64_t key_const_reference;
+	uint64_t _key;		// MAC address and VLAN ID; see make_key()
+	Entry *_hashnext;
+	int _port;
+	uint32_t _tick;		// wheel tick of the last refresh
+	List_member<Entry> _wheel_link;
+	uint64_t hashkey() const {
+	    return _key;
+	}
+	static uint32_t hashcode(uint64_t k) {
+	    return hash_mix64(k);
+	}
+    };
+
+    enum { wheel_size = 8, initial_buckets = 32 };
+
+    typedef List<Entry, &Entry::_wheel_link> WheelList;
+
+    struct Wheel {
+	WheelList wheel[wheel_size];
+    };
+
+    typedef ShardedSeqlockTable<Entry, Wheel> Table;
+    typedef Table::Shard Shard;
+
     Table _table;
+    uint32_t _nshards;
     uint32_t _timeout;
+    bool _vlan;
+    uint32_t _capacity;
+    atomic_uint32_t _count;
+    volatile uint32_t _tick;
+    Timer _timer;
+
+    static uint64_t make_key(const uint8_t *mac, uint16_t vlan) {
+	uint64_t k = vlan;
+	for (int i = 0; i < 6; ++i)
+	    k = (k << 8) | mac[i];
+	return k;
+    }
+    struct PortReader {
+	int port;
+	uint32_t tick;
+	void operator()(const Entry *e) {
+	    port = e ? e->_port : -1;
+	    tick = e ? e->_tick : 0;
+	}
+    };
+    struct TableWriter;
 
-    void broadcast(int source, Packet*);
+    inline int find_port(uint64_t key, uint32_t h, uint32_t *tick);
+    void learn(uint64_t key, uint32_t h, int port);
+    void clear();
+    void schedule_tick();
 
     static String reader(Element *, void *);
+    static int table_handler(int, String &, Element *, const Handler *, ErrorHandler *);
     static int writer(const String &, Element *, void *, ErrorHandler *);
-    friend class ListenEtherSwitch;
 
 };
 
-inline
-EtherSwitch::AddrInfo::AddrInfo(int p, const Timestamp& s)
-    : port(p), stamp(s)
+/** @brief Return the port associated with @a key, or -1 if none.
+ * @param[out] tick set to the association's last refresh tick
+ *
+ * Takes no locks; retries if the shard changes during the lookup. */
+inline int
+EtherSwitch::find_port(uint64_t key, uint32_t h, uint32_t *tick)
+{
+    PortReader r;
+    if (!_table.read(key, h, r)) {
+	Shard &sh = _table.shard(h);
+	sh.lock.acquire();
+	r(Table::find(sh, key, h));
+	sh.lock.release();
+    }
+    *tick = r.tick;
+    return r.port;
+}
+
+/** @brief Learn @a p's source address on @a source and return the output
+ * port for its destination, or -1 to flood. */
+inline int
+EtherSwitch::switch_port(int source, Packet *p)
 {
+    // 0 timeout means dumb switch
+    if (_timeout == 0)
+	return -1;
+
+    const click_ether *e = reinterpret_cast<const click_ether *>(p->data());
+    uint16_t vlan = _vlan ? ntohs(VLAN_TCI_ANNO(p)) & 0x0FFF : 0;
+
+    // Refreshing an unchanged association in the current tick is read-only.
+    uint64_t key = make_key(e->ether_shost, vlan);
+    uint32_t h = Entry::hashcode(key), tick;
+    if (find_port(key, h, &tick) != source || tick != _tick)
+	learn(key, h, source);
+
+    if (e->ether_dhost[0] & 1)	// group address
+	return -1;
+    key = make_key(e->ether_dhost, vlan);
+    return find_port(key, Entry::hashcode(key), &tick);
 }
 
 CLICK_ENDDECLS
@@ -162,11 +162,13 @@ Packet *
 CheckIPHeader::simple_action(Packet *p)
 {
   const click_ip *ip = reinterpret_cast<const click_ip *>(p->data() + _offset);
-  unsigned plen = p->length() - _offset;
+  unsigned hdrlen = p->length() - _offset;
+  unsigned plen = p->total_length() - _offset;
   unsigned hlen, len;
 
-  // cast to int so very large plen is interpreted as negative
-  if ((int)plen < (int)sizeof(click_ip))
+  // cast to int so very large hdrlen is interpreted as negative; the IP
+  // header must fit in the packet's first segment
+  if ((int)hdrlen < (int)sizeof(click_ip))
     return drop(MINISCULE_PACKET, p);
 
   if (ip->ip_v != 4)
@@ -179,6 +181,8 @@ CheckIPHeader::simple_action(Packet *p)
   len = ntohs(ip->ip_len);
   if (len > plen || len < hlen)
     return drop(BAD_IP_LEN, p);
+  if (hlen > hdrlen)
+    return drop(BAD_HLEN, p);
 
   if (_checksum) {
     int val;
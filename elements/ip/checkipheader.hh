@@ -112,7 +112,7 @@ class CheckIPHeader : public Element { public:
   const char *class_name() const		{ return "CheckIPHeader"; }
   const char *port_count() const		{ return PORTS_1_1X2; }
   const char *processing() const		{ return PROCESSING_A_AH; }
-  const char *flags() const			{ return "A"; }
+  const char *flags() const			{ return "A G"; }
 
   int configure(Vector<String> &, ErrorHandler *);
   void add_handlers();
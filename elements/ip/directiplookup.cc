@@ -24,6 +24,11 @@
 #include <click/straccum.hh>
 #include <click/router.hh>
 #include <click/error.hh>
+#include <click/args.hh>
+#include <click/integers.hh>
+#if CLICK_USERLEVEL && ALLOW_MMAP
+# include <sys/mman.h>
+#endif
 CLICK_DECLS
 
 
@@ -32,33 +37,91 @@ CLICK_DECLS
 // The DirectIPLookup table must be stored in a sub-object in the Linux
 // kernel, because it's too large to be allocated all at once.
 
+// The lookup tables, _tbl_0_23 and _tbl_24_31, may be backed by huge pages
+// at user level.  Explicitly reserved huge pages are tried first, then
+// transparent huge pages, then ordinary memory.  Huge pages are rounded up
+// to a whole page, so _tbl_24_31 only uses them once it fills at least one
+// page; otherwise a 1 GB page would be spent on a few kilobytes.
+
+void *
+DirectIPLookup::Table::lookup_alloc(size_t size, uint8_t &alloc, bool huge) const
+{
+#if CLICK_USERLEVEL && ALLOW_MMAP && defined(MAP_ANONYMOUS)
+    if (_huge_page_size && (huge || size >= _huge_page_size)) {
+	size_t map_size = (size + _huge_page_size - 1) & ~((size_t) _huge_page_size - 1);
+	void *p;
+# ifdef MAP_HUGETLB
+	int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB;
+#  ifdef MAP_HUGE_SHIFT
+	flags |= (ffs_lsb(_huge_page_size) - 1) << MAP_HUGE_SHIFT;
+#  endif
+	p = mmap(0, map_size, PROT_READ | PROT_WRITE, flags, -1, 0);
+	if (p != MAP_FAILED) {
+	    alloc = ALLOC_HUGETLB;
+	    return p;
+	}
+# endif
+# if HAVE_MADVISE && defined(MADV_HUGEPAGE)
+	p = mmap(0, map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (p != MAP_FAILED) {
+	    (void) madvise(p, map_size, MADV_HUGEPAGE);
+	    alloc = ALLOC_TRANSPARENT;
+	    return p;
+	}
+# endif
+    }
+#endif
+    alloc = ALLOC_NORMAL;
+    return CLICK_LALLOC(size);
+}
+
+void
+DirectIPLookup::Table::lookup_free(void *p, size_t size, uint8_t alloc) const
+{
+#if CLICK_USERLEVEL && ALLOW_MMAP && defined(MAP_ANONYMOUS)
+    if (p && alloc != ALLOC_NORMAL) {
+	size_t map_size = (size + _huge_page_size - 1) & ~((size_t) _huge_page_size - 1);
+	munmap(p, map_size);
+	return;
+    }
+#else
+    (void) alloc;
+#endif
+    CLICK_LFREE(p, size);
+}
+
 int
-DirectIPLookup::Table::initialize()
+DirectIPLookup::Table::initialize(uint32_t huge_page_size)
 {
     assert(!_tbl_0_23 && !_tbl_24_31 && !_vport && !_rtable && !_rt_hashtbl
 	   && !_tbl_0_23_plen && !_tbl_24_31_plen);
 
+    _huge_page_size = huge_page_size;
     _tbl_24_31_capacity = 4096;
     _vport_capacity = 1024;
     _rtable_capacity = 2048;
 
-    if ((_tbl_0_23 = (uint16_t *) CLICK_LALLOC((sizeof(uint16_t) + sizeof(uint8_t)) * (1 << 24)))
-	&& (_tbl_24_31 = (uint16_t *) CLICK_LALLOC((sizeof(uint16_t) + sizeof(uint8_t)) * _tbl_24_31_capacity))
+    if ((_tbl_0_23 = (uint16_t *) lookup_alloc(sizeof(uint16_t) * (1 << 24), _tbl_0_23_alloc, true))
+	&& (_tbl_24_31 = (uint16_t *) lookup_alloc(sizeof(uint16_t) * _tbl_24_31_capacity, _tbl_24_31_alloc))
+	&& (_tbl_0_23_plen = (uint8_t *) CLICK_LALLOC(sizeof(uint8_t) * (1 << 24)))
+	&& (_tbl_24_31_plen = (uint8_t *) CLICK_LALLOC(sizeof(uint8_t) * _tbl_24_31_capacity))
 	&& (_vport = (VirtualPort *) CLICK_LALLOC(sizeof(VirtualPort) * _vport_capacity))
 	&& (_rtable = (CleartextEntry *) CLICK_LALLOC(sizeof(CleartextEntry) * _rtable_capacity))
-	&& (_rt_hashtbl = (int *) CLICK_LALLOC(sizeof(int) * PREF_HASHSIZE))) {
-	_tbl_0_23_plen = (uint8_t *) (_tbl_0_23 + (1 << 24));
-	_tbl_24_31_plen = (uint8_t *) (_tbl_24_31 + _tbl_24_31_capacity);
+	&& (_rt_hashtbl = (int *) CLICK_LALLOC(sizeof(int) * PREF_HASHSIZE)))
 	return 0;
-    } else
+    else
 	return -ENOMEM;
 }
 
 void
 DirectIPLookup::Table::cleanup()
 {
-    CLICK_LFREE(_tbl_0_23, (sizeof(uint16_t) + sizeof(uint8_t)) * (1 << 24));
-    CLICK_LFREE(_tbl_24_31, (sizeof(uint16_t) + sizeof(uint8_t)) * _tbl_24_31_capacity);
+    if (_tbl_0_23)
+	lookup_free(_tbl_0_23, sizeof(uint16_t) * (1 << 24), _tbl_0_23_alloc);
+    if (_tbl_24_31)
+	lookup_free(_tbl_24_31, sizeof(uint16_t) * _tbl_24_31_capacity, _tbl_24_31_alloc);
+    CLICK_LFREE(_tbl_0_23_plen, sizeof(uint8_t) * (1 << 24));
+    CLICK_LFREE(_tbl_24_31_plen, sizeof(uint8_t) * _tbl_24_31_capacity);
     CLICK_LFREE(_vport, sizeof(VirtualPort) * _vport_capacity);
     CLICK_LFREE(_rtable, sizeof(CleartextEntry) * _rtable_capacity);
     CLICK_LFREE(_rt_hashtbl, sizeof(int) * PREF_HASHSIZE);
@@ -67,6 +130,33 @@ DirectIPLookup::Table::cleanup()
     _rtable = 0;
     _tbl_0_23_plen = _tbl_24_31_plen = 0;
     _rt_hashtbl = 0;
+    _vport_index.clear();
+}
+
+void
+DirectIPLookup::Table::swap(Table &x)
+{
+    click_swap(_tbl_0_23, x._tbl_0_23);
+    click_swap(_tbl_24_31, x._tbl_24_31);
+    click_swap(_vport, x._vport);
+    click_swap(_rtable, x._rtable);
+    click_swap(_rt_hashtbl, x._rt_hashtbl);
+    click_swap(_tbl_0_23_plen, x._tbl_0_23_plen);
+    click_swap(_tbl_24_31_plen, x._tbl_24_31_plen);
+    click_swap(_huge_page_size, x._huge_page_size);
+    click_swap(_tbl_0_23_alloc, x._tbl_0_23_alloc);
+    click_swap(_tbl_24_31_alloc, x._tbl_24_31_alloc);
+    click_swap(_rtable_size, x._rtable_size);
+    click_swap(_tbl_24_31_size, x._tbl_24_31_size);
+    click_swap(_vport_size, x._vport_size);
+    click_swap(_rt_empty_head, x._rt_empty_head);
+    click_swap(_tbl_24_31_empty_head, x._tbl_24_31_empty_head);
+    click_swap(_vport_head, x._vport_head);
+    click_swap(_vport_empty_head, x._vport_empty_head);
+    click_swap(_rtable_capacity, x._rtable_capacity);
+    click_swap(_tbl_24_31_capacity, x._tbl_24_31_capacity);
+    click_swap(_vport_capacity, x._vport_capacity);
+    _vport_index.swap(x._vport_index);
 }
 
 
@@ -96,6 +186,7 @@ DirectIPLookup::Table::flush()
     _vport[0].port = DISCARD_PORT;
     _vport_size = 1;
     _vport_empty_head = -1;
+    _vport_index.clear();
 
     // _rtable[0] is the default route entry
     _rt_hashtbl[prefix_hash(0, 0)] = 0;
@@ -108,7 +199,8 @@ DirectIPLookup::Table::flush()
     _rt_empty_head = -1;
 
     // Bzeroed lookup tables resolve 0.0.0.0/0 to _vport[0]
-    memset(_tbl_0_23, 0, (sizeof(uint16_t) + sizeof(uint8_t)) * (1 << 24));
+    memset(_tbl_0_23, 0, sizeof(uint16_t) * (1 << 24));
+    memset(_tbl_0_23_plen, 0, sizeof(uint8_t) * (1 << 24));
 
     _tbl_24_31_size = 0;
     _tbl_24_31_empty_head = 0x8000;
@@ -129,12 +221,39 @@ DirectIPLookup::Table::dump() const
     return sa.take_string();
 }
 
+String
+DirectIPLookup::Table::dump(uint32_t &pos, uint32_t max) const
+{
+    // pos is a hash bucket; a chunk always ends at a bucket boundary
+    StringAccum sa;
+    uint32_t i = pos, n = 0;
+    for (; i < PREF_HASHSIZE && n < max; i++)
+	for (int rt_i = _rt_hashtbl[i]; rt_i >= 0; rt_i = _rtable[rt_i].ll_next) {
+	    const CleartextEntry &rt = _rtable[rt_i];
+	    if (_vport[rt.vport].port != -1) {
+		IPRoute route = IPRoute(IPAddress(htonl(rt.prefix)), IPAddress::make_prefix(rt.plen), _vport[rt.vport].gw, _vport[rt.vport].port);
+		route.unparse(sa, true) << '\n';
+		++n;
+	    }
+	}
+    pos = (i < PREF_HASHSIZE ? i : 0);
+    return sa.take_string();
+}
+
+size_t
+DirectIPLookup::Table::memory_usage() const
+{
+    return (sizeof(uint16_t) + sizeof(uint8_t)) * ((1 << 24) + _tbl_24_31_capacity)
+	+ sizeof(VirtualPort) * _vport_capacity
+	+ sizeof(CleartextEntry) * _rtable_capacity
+	+ sizeof(int) * PREF_HASHSIZE;
+}
+
 int
 DirectIPLookup::Table::vport_find(IPAddress gw, int16_t port)
 {
-    for (int vp = _vport_head; vp >= 0; vp = _vport[vp].ll_next)
-	if (_vport[vp].gw == gw && _vport[vp].port == port)
-	    return vp;
+    if (const int *vp = _vport_index.get_pointer(vport_key(gw, port)))
+	return *vp;
     if (_vport_empty_head < 0 && _vport_size == _vport_capacity) {
 	if (_vport_capacity == vport_capacity_limit)
 	    return -ENOMEM;
@@ -161,6 +280,11 @@ DirectIPLookup::Table::vport_unref(uint16_t vport_i)
     if (--_vport[vport_i].refcount == 0) {
 	int16_t prev, next;
 
+	// Drop the entry from the index
+	HashTable<uint64_t, int>::iterator it = _vport_index.find(vport_key(_vport[vport_i].gw, _vport[vport_i].port));
+	if (it && it.value() == vport_i)
+	    _vport_index.erase(it);
+
 	// Prune our entry from the vport list
 	prev = _vport[vport_i].ll_prev;
 	next = _vport[vport_i].ll_next;
@@ -249,14 +373,22 @@ DirectIPLookup::Table::add_route(const IPRoute& route, bool allow_replace, IPRou
 	    && _tbl_24_31_capacity >= tbl_24_31_capacity_limit)
 	    return -ENOMEM;
 	if (_tbl_24_31_size == _tbl_24_31_capacity) {
-	    uint16_t *new_tbl = (uint16_t *) CLICK_LALLOC((sizeof(uint16_t) + sizeof(uint8_t)) * 2 * _tbl_24_31_capacity);
-	    if (!new_tbl)
+	    uint8_t new_alloc;
+	    uint16_t *new_tbl = (uint16_t *) lookup_alloc(sizeof(uint16_t) * 2 * _tbl_24_31_capacity, new_alloc);
+	    uint8_t *new_plen = (uint8_t *) CLICK_LALLOC(sizeof(uint8_t) * 2 * _tbl_24_31_capacity);
+	    if (!new_tbl || !new_plen) {
+		if (new_tbl)
+		    lookup_free(new_tbl, sizeof(uint16_t) * 2 * _tbl_24_31_capacity, new_alloc);
+		CLICK_LFREE(new_plen, sizeof(uint8_t) * 2 * _tbl_24_31_capacity);
 		return -ENOMEM;
+	    }
 	    memcpy(new_tbl, _tbl_24_31, sizeof(uint16_t) * _tbl_24_31_capacity);
-	    memcpy(new_tbl + _tbl_24_31_capacity, _tbl_24_31_plen, sizeof(uint8_t) * _tbl_24_31_capacity);
-	    CLICK_LFREE(_tbl_24_31, (sizeof(uint16_t) + sizeof(uint8_t)) * _tbl_24_31_capacity);
+	    memcpy(new_plen, _tbl_24_31_plen, sizeof(uint8_t) * _tbl_24_31_capacity);
+	    lookup_free(_tbl_24_31, sizeof(uint16_t) * _tbl_24_31_capacity, _tbl_24_31_alloc);
+	    CLICK_LFREE(_tbl_24_31_plen, sizeof(uint8_t) * _tbl_24_31_capacity);
 	    _tbl_24_31 = new_tbl;
-	    _tbl_24_31_plen = (uint8_t *) (new_tbl + 2 * _tbl_24_31_capacity);
+	    _tbl_24_31_alloc = new_alloc;
+	    _tbl_24_31_plen = new_plen;
 	    _tbl_24_31_capacity *= 2;
 	}
 	_tbl_24_31_empty_head = _tbl_24_31_size >> 8;
@@ -292,6 +424,7 @@ DirectIPLookup::Table::add_route(const IPRoute& route, bool allow_replace, IPRou
 	if (_vport_head >= 0)
 	    _vport[_vport_head].ll_prev = vport_i;
 	_vport_head = vport_i;
+	_vport_index.set(vport_key(route.gw, route.port), vport_i);
     }
     ++_vport[vport_i].refcount;
     _rtable[rt_i].vport = vport_i;
@@ -364,6 +497,31 @@ DirectIPLookup::Table::add_route(const IPRoute& route, bool allow_replace, IPRou
     return 0;
 }
 
+int
+DirectIPLookup::Table::add_routes(const Vector<IPRoute> &routes, ErrorHandler *errh)
+{
+    // Grow _rtable once up front rather than doubling it repeatedly.
+    uint32_t capacity = _rtable_capacity;
+    while (capacity < _rtable_size + routes.size())
+	capacity *= 2;
+    if (capacity != _rtable_capacity) {
+	CleartextEntry *new_rtable = (CleartextEntry *) CLICK_LALLOC(sizeof(CleartextEntry) * capacity);
+	if (!new_rtable)
+	    return -ENOMEM;
+	memcpy(new_rtable, _rtable, sizeof(CleartextEntry) * _rtable_capacity);
+	CLICK_LFREE(_rtable, sizeof(CleartextEntry) * _rtable_capacity);
+	_rtable = new_rtable;
+	_rtable_capacity = capacity;
+    }
+
+    for (const IPRoute *r = routes.begin(); r != routes.end(); ++r) {
+	int x = add_route(*r, true, 0, errh);
+	if (x < 0)
+	    return x;
+    }
+    return 0;
+}
+
 int
 DirectIPLookup::Table::remove_route(const IPRoute& route, IPRoute* old_route, ErrorHandler *errh)
 {
@@ -498,8 +656,31 @@ DirectIPLookup::~DirectIPLookup()
 int
 DirectIPLookup::configure(Vector<String> &conf, ErrorHandler *errh)
 {
+    String huge_pages;
+    if (Args(this, errh).bind(conf)
+	.read("HUGE_PAGES", AnyArg(), huge_pages)
+	.consume() < 0)
+	return -1;
+
+    uint32_t huge_page_size = 0;
+    bool b;
+    if (!huge_pages || (BoolArg().parse(huge_pages, b) && !b))
+	/* no huge pages */;
+    else if (BoolArg().parse(huge_pages, b) || huge_pages.equals("2MB", -1))
+	huge_page_size = 1 << 21;
+    else if (huge_pages.equals("1GB", -1))
+	huge_page_size = 1 << 30;
+    else
+	return errh->error("HUGE_PAGES should be %<true%>, %<false%>, %<2MB%>, or %<1GB%>");
+#if !CLICK_USERLEVEL
+    if (huge_page_size) {
+	errh->warning("HUGE_PAGES not supported in this driver");
+	huge_page_size = 0;
+    }
+#endif
+
     int r;
-    if ((r = _t.initialize()) < 0)
+    if ((r = _t.initialize(huge_page_size)) < 0)
 	return r;
     _t.flush();
     return IPRouteTable::configure(conf, errh);
@@ -511,6 +692,13 @@ DirectIPLookup::cleanup(CleanupStage)
     _t.cleanup();
 }
 
+void
+DirectIPLookup::take_state(Element *e, ErrorHandler *)
+{
+    if (e == router()->hotswap_unchanged_element(this))
+	_t.swap(static_cast<DirectIPLookup *>(e)->_t);
+}
+
 void
 DirectIPLookup::push(int, Packet *p)
 {
@@ -538,12 +726,54 @@ DirectIPLookup::lookup_route(IPAddress dest, IPAddress &gw) const
     return _t._vport[vport_i].port;
 }
 
+void
+DirectIPLookup::lookup_routes(const IPAddress *dst, int n, int *ports, IPAddress *gws) const
+{
+    // Work on groups of addresses in stages, prefetching each stage's table
+    // entries for the whole group before reading any of them, so the cache
+    // misses of different lookups overlap.
+    enum { GROUP = 16 };
+    uint32_t index[GROUP];
+    for (int base = 0; base < n; base += GROUP) {
+	const IPAddress *d = dst + base;
+	int m = (n - base < GROUP ? n - base : GROUP);
+
+	for (int k = 0; k < m; ++k) {
+	    index[k] = ntohl(d[k].addr()) >> 8;
+	    CLICK_PREFETCH(&_t._tbl_0_23[index[k]]);
+	}
+	for (int k = 0; k < m; ++k) {
+	    uint16_t vport_i = _t._tbl_0_23[index[k]];
+	    if (vport_i & 0x8000) {
+		index[k] = ((vport_i & 0x7fff) << 8) | (ntohl(d[k].addr()) & 0xff);
+		CLICK_PREFETCH(&_t._tbl_24_31[index[k]]);
+		index[k] |= 0x80000000U;
+	    } else
+		index[k] = vport_i;
+	}
+	for (int k = 0; k < m; ++k) {
+	    uint16_t vport_i = index[k];
+	    if (index[k] & 0x80000000U)
+		vport_i = _t._tbl_24_31[index[k] & 0x7fffffffU];
+	    ports[base + k] = _t._vport[vport_i].port;
+	    gws[base + k] = _t._vport[vport_i].gw;
+	}
+    }
+}
+
 int
 DirectIPLookup::add_route(const IPRoute& route, bool allow_replace, IPRoute* old_route, ErrorHandler *errh)
 {
     return _t.add_route(route, allow_replace, old_route, errh);
 }
 
+int
+DirectIPLookup::add_routes(Vector<IPRoute> &routes, ErrorHandler *errh)
+{
+    sort_routes(routes);
+    return _t.add_routes(routes, errh);
+}
+
 int
 DirectIPLookup::remove_route(const IPRoute& route, IPRoute* old_route, ErrorHandler *errh)
 {
@@ -565,11 +795,38 @@ DirectIPLookup::dump_routes()
     return _t.dump();
 }
 
+String
+DirectIPLookup::dump_routes_chunk(uint32_t &pos, uint32_t max)
+{
+    return _t.dump(pos, max);
+}
+
+size_t
+DirectIPLookup::memory_usage() const
+{
+    return _t._tbl_0_23 ? _t.memory_usage() : 0;
+}
+
+String
+DirectIPLookup::huge_pages_handler(Element *e, void *)
+{
+    DirectIPLookup *t = static_cast<DirectIPLookup *>(e);
+    if (t->_t._tbl_0_23_alloc == ALLOC_TRANSPARENT)
+	return String::make_stable("transparent");
+    else if (t->_t._tbl_0_23_alloc != ALLOC_HUGETLB)
+	return String::make_stable("false");
+    else if (t->_t._huge_page_size == (1U << 30))
+	return String::make_stable("1GB");
+    else
+	return String::make_stable("2MB");
+}
+
 void
 DirectIPLookup::add_handlers()
 {
     IPRouteTable::add_handlers();
     add_write_handler("flush", flush_handler, 0, Handler::BUTTON);
+    add_read_handler("huge_pages", huge_pages_handler, 0);
 }
 
 CLICK_ENDDECLS
@@ -1,13 +1,14 @@
 // -*- c-basic-offset: 4 -*-
 #ifndef CLICK_DIRECTIPLOOKUP_HH
 #define CLICK_DIRECTIPLOOKUP_HH
+#include <click/hashtable.hh>
 #include "iproutetable.hh"
 CLICK_DECLS
 
 /*
 =c
 
-DirectIPLookup(ADDR1/MASK1 [GW1] OUT1, ADDR2/MASK2 [GW2] OUT2, ...)
+DirectIPLookup(ADDR1/MASK1 [GW1] OUT1, ADDR2/MASK2 [GW2] OUT2, ..., I<keywords> HUGE_PAGES)
 
 =s iproute
 
@@ -33,13 +34,35 @@ relatively low CPU overhead, allowing for high update rates.
 DirectIPLookup implements the I<DIR-24-8-BASIC> lookup scheme described by
 Gupta, Lin, and McKeown in the paper cited below.
 
+The lookup tables hold only next-hop indexes.  The prefix lengths needed to
+update them are kept in separate arrays that lookups never touch, so the
+32 MB first-level table is the only large structure on the lookup path.
+
+Keyword arguments are:
+
+=over 8
+
+=item HUGE_PAGES
+
+Back the lookup tables with huge pages to reduce TLB misses.  Values are
+`false' (the default), `true' or `2MB' for 2 MB pages, and `1GB' for 1 GB
+pages.  The first-level table always uses huge pages; the second-level table
+uses them only once it is at least one page long.  If the system has no huge
+pages of that size reserved, DirectIPLookup falls back to transparent huge
+pages where available, and otherwise to ordinary memory.  Only available at
+user level.
+
+=back
+
 =h table read-only
 
-Outputs a human-readable version of the current routing table.
+Outputs a human-readable version of the current routing table.  Large tables
+can be read in chunks; see IPRouteTable's B<dump_routes_chunk>.
 
 =h lookup read-only, requires parameters
 
-Reports the OUTput port and GW corresponding to an address.
+Reports the OUTput port and GW corresponding to an address.  Given several
+space-separated addresses, reports one `C<ADDR OUT [GW]>' line per address.
 
 =h add write-only
 
@@ -61,10 +84,31 @@ add a route, and `C<remove ADDR/MASK>' to remove a route. You can supply
 multiple commands, one per line; all commands are executed as one atomic
 operation.
 
+=h huge_pages read-only
+
+Reports how the first-level lookup table is backed: `2MB' or `1GB' for
+huge pages, `transparent' for transparent huge pages, or `false'.
+
 =h flush write-only
 
 Clears the entire routing table in a single atomic operation.
 
+=h load write-only
+
+Loads routes from a text or binary route file, setting each route whether
+or not a route for the same prefix already exists. See IPRouteTable for the
+file formats. Routes can also be loaded at configuration time with a
+`C<LOAD FILENAME>' argument.
+
+=h save write-only
+
+Writes the current routing table to a file in binary route file format.
+
+=h load_info read-only
+
+Reports the number of routes read by the most recent load, the time taken
+to parse and insert them, and the memory used by the lookup tables.
+
 =n
 
 See IPRouteTable for a performance comparison of the various IP routing
@@ -74,6 +118,11 @@ DirectIPLookup's data structures are inherently limited: at most 2^16 /24
 networks can contain routes for /25-or-smaller subnetworks, no matter how much
 memory you have.  If you need more than this, try RangeIPLookup.
 
+When a configuration is hotswapped in, a DirectIPLookup whose name,
+configuration, and connections are unchanged takes over the old element's
+tables in constant time, including any routes added or removed through
+handlers.
+
 =a IPRouteTable, RangeIPLookup, RadixIPLookup, StaticIPLookup, LinearIPLookup,
 SortedIPLookup, LinuxIPLookup
 
@@ -95,16 +144,22 @@ class DirectIPLookup : public IPRouteTable { public:
 
     int configure(Vector<String> &conf, ErrorHandler *errh);
     void cleanup(CleanupStage stage);
+    void take_state(Element *old_element, ErrorHandler *errh);
     void add_handlers();
 
     void push(int port, Packet* p);
 
     int add_route(const IPRoute&, bool, IPRoute*, ErrorHandler *);
+    int add_routes(Vector<IPRoute>&, ErrorHandler *);
     int remove_route(const IPRoute&, IPRoute*, ErrorHandler *);
     int lookup_route(IPAddress, IPAddress&) const;
+    void lookup_routes(const IPAddress *, int, int *, IPAddress *) const;
     String dump_routes();
+    String dump_routes_chunk(uint32_t &pos, uint32_t max);
+    size_t memory_usage() const;
 
     static int flush_handler(const String &, Element *, void *, ErrorHandler *);
+    static String huge_pages_handler(Element *, void *);
 
     enum {
 	RT_SIZE_MAX = 256 * 1024, // accomodate a full BGP view and more
@@ -114,6 +169,11 @@ class DirectIPLookup : public IPRouteTable { public:
 	DISCARD_PORT = -1
     };
 
+    // How a lookup table's memory was obtained
+    enum {
+	ALLOC_NORMAL, ALLOC_HUGETLB, ALLOC_TRANSPARENT
+    };
+
     struct CleartextEntry {
 	int ll_next;
 	int ll_prev;
@@ -143,6 +203,12 @@ class DirectIPLookup : public IPRouteTable { public:
 	uint8_t *_tbl_0_23_plen;
 	uint8_t *_tbl_24_31_plen;
 
+	// Requested huge page size, or 0, and how each lookup table was
+	// actually allocated
+	uint32_t _huge_page_size;
+	uint8_t _tbl_0_23_alloc;
+	uint8_t _tbl_24_31_alloc;
+
 	uint32_t _rtable_size;
 	uint32_t _tbl_24_31_size;
 	uint32_t _vport_size;
@@ -155,29 +221,44 @@ class DirectIPLookup : public IPRouteTable { public:
 	uint32_t _tbl_24_31_capacity;
 	uint32_t _vport_capacity;
 
+	// Maps (gateway, port) to the _vport[] entry holding it.  _vport[0]
+	// is never indexed, since the default route changes it in place.
+	HashTable<uint64_t, int> _vport_index;
+
 	Table()
 	    : _tbl_0_23(0), _tbl_24_31(0), _vport(0), _rtable(0),
-	      _rt_hashtbl(0), _tbl_0_23_plen(0), _tbl_24_31_plen(0) {
+	      _rt_hashtbl(0), _tbl_0_23_plen(0), _tbl_24_31_plen(0),
+	      _huge_page_size(0) {
 	}
 
 	~Table() {
 	    cleanup();
 	}
 
-	int initialize();
+	int initialize(uint32_t huge_page_size = 0);
 	void cleanup();
+	void swap(Table &x);
 
 	static inline uint32_t prefix_hash(uint32_t, uint32_t);
+	static inline uint64_t vport_key(IPAddress gw, int16_t port) {
+	    return ((uint64_t) gw.addr() << 32) | (uint16_t) port;
+	}
+
+	void *lookup_alloc(size_t size, uint8_t &alloc, bool huge = false) const;
+	void lookup_free(void *p, size_t size, uint8_t alloc) const;
 
 	int find_entry(uint32_t, uint32_t) const;
 	String dump() const;
+	String dump(uint32_t &pos, uint32_t max) const;
 
 	int vport_find(IPAddress gw, int16_t port);
 	void vport_unref(uint16_t);
 
 	int add_route(const IPRoute&, bool, IPRoute*, ErrorHandler *);
+	int add_routes(const Vector<IPRoute>&, ErrorHandler *);
 	int remove_route(const IPRoute&, IPRoute*, ErrorHandler *);
 	void flush();
+	size_t memory_usage() const;
 
     };
 
@@ -116,9 +116,13 @@ IPFragmenter::fragment(Packet *p_in)
     ip->ip_sum = 0;
     ip->ip_sum = click_in_cksum((const unsigned char *)ip, hlen);
     Packet *first_fragment = p->clone();
-    first_fragment->take(p->length() - p->network_header_offset() - hlen - first_dlen);
-    output(0).push(first_fragment);
-    _fragments++;
+    first_fragment->take(p->total_length() - p->network_header_offset() - hlen - first_dlen);
+    if (first_fragment->segmented())
+	first_fragment = first_fragment->linearize();
+    if (first_fragment) {
+	output(0).push(first_fragment);
+	_fragments++;
+    }
 
     // output the remaining fragments
     int out_hlen = sizeof(click_ip) + optcopy(ip, 0);
@@ -136,7 +140,8 @@ IPFragmenter::fragment(Packet *p_in)
 
 	    memcpy(qip, ip, sizeof(click_ip));
 	    optcopy(ip, qip);
-	    memcpy(q->transport_header(), p->transport_header() + off, out_dlen);
+	    // the data may continue past p's first segment
+	    p->copy_data(p->transport_header_offset() + off, q->transport_header(), out_dlen);
 
 	    qip->ip_hl = out_hlen >> 2;
 	    qip->ip_off = htons(ntohs(ip->ip_off) + (off >> 3));
@@ -161,7 +166,9 @@ IPFragmenter::fragment(Packet *p_in)
 void
 IPFragmenter::push(int, Packet *p)
 {
-    if (p->network_length() <= (int) _mtu)
+    // network_length() covers only the first segment of a segmented packet
+    int nlen = p->total_length() - p->network_header_offset();
+    if (nlen <= (int) _mtu)
 	output(0).push(p);
     else
 	fragment(p);
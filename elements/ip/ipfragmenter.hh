@@ -63,6 +63,7 @@ class IPFragmenter : public Element { public:
   const char *class_name() const		{ return "IPFragmenter"; }
   const char *port_count() const		{ return PORTS_1_1X2; }
   const char *processing() const		{ return PUSH; }
+  const char *flags() const			{ return "G"; }
   int configure(Vector<String> &, ErrorHandler *);
 
   uint32_t drops() const			{ return _drops; }
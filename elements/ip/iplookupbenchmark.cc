@@ -0,0 +1,205 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * iplookupbenchmark.{cc,hh} -- compare IPRouteTable lookup performance
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, subject to the conditions listed in the Click LICENSE
+ * file. These conditions include: you must preserve this copyright
+ * notice, and you cannot mention the copyright holders in advertising
+ * related to the Software without their permission.  The Software is
+ * provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This notice is a
+ * summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "iplookupbenchmark.hh"
+#include "iproutetable.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/straccum.hh>
+#include <click/timestamp.hh>
+#include <click/userutils.hh>
+CLICK_DECLS
+
+IPLookupBenchmark::IPLookupBenchmark()
+    : _naddresses(65536), _nlookups(1000000), _batch(64), _sink(0)
+{
+}
+
+int
+IPLookupBenchmark::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    String tables;
+    uint32_t seed;
+    bool have_seed;
+    if (Args(conf, this, errh)
+	.read_mp("TABLES", AnyArg(), tables)
+	.read("ROUTES", FilenameArg(), _routes_file)
+	.read("TRACE", FilenameArg(), _trace_file)
+	.read("ADDRESSES", _naddresses)
+	.read("LOOKUPS", _nlookups)
+	.read("BATCH", _batch)
+	.read("SEED", seed).read_status(have_seed)
+	.complete() < 0)
+	return -1;
+
+    Vector<String> words;
+    cp_spacevec(tables, words);
+    for (String *it = words.begin(); it != words.end(); ++it) {
+	Element *e = cp_element(*it, this, errh, "TABLES");
+	if (!e)
+	    return -1;
+	IPRouteTable *t = static_cast<IPRouteTable *>(e->cast("IPRouteTable"));
+	if (!t)
+	    return errh->error("%<%s%> is not an IPRouteTable", it->c_str());
+	_tables.push_back(t);
+    }
+    if (!_tables.size())
+	return errh->error("no TABLES");
+    if (!_batch || !_nlookups)
+	return errh->error("BATCH and LOOKUPS must be positive");
+    if (have_seed)
+	click_srandom(seed);
+    return 0;
+}
+
+int
+IPLookupBenchmark::initialize(ErrorHandler *errh)
+{
+    Vector<IPRoute> routes;
+    if (_routes_file) {
+	String data = file_string(_routes_file, errh);
+	if (!data || _tables[0]->parse_route_file(data, routes, errh) < 0)
+	    return -1;
+	for (IPRouteTable **it = _tables.begin(); it != _tables.end(); ++it) {
+	    // add_routes may reorder its argument
+	    Vector<IPRoute> copy(routes);
+	    if ((*it)->add_routes(copy, errh) < 0)
+		return errh->error("%s: could not load ROUTES", (*it)->name().c_str());
+	}
+    }
+
+    if (_trace_file) {
+	String data = file_string(_trace_file, errh);
+	if (!data)
+	    return -1;
+	Vector<String> words;
+	cp_spacevec(cp_uncomment(data), words);
+	for (String *it = words.begin(); it != words.end(); ++it) {
+	    IPAddress a;
+	    if (!IPAddressArg().parse(*it, a, this))
+		return errh->error("%s: bad address %<%s%>", _trace_file.c_str(), it->c_str());
+	    _trace.push_back(a);
+	}
+	if (!_trace.size())
+	    return errh->error("%s: no addresses", _trace_file.c_str());
+    } else
+	make_trace(routes);
+    return 0;
+}
+
+void
+IPLookupBenchmark::make_trace(const Vector<IPRoute> &routes)
+{
+    _trace.reserve(_naddresses ? _naddresses : 1);
+    for (uint32_t i = 0; i < _naddresses || !_trace.size(); ++i) {
+	uint32_t r = (click_random() << 16) ^ click_random();
+	if (routes.size()) {
+	    const IPRoute &route = routes[click_random(0, routes.size() - 1)];
+	    r = (route.addr.addr() & route.mask.addr()) | (htonl(r) & ~route.mask.addr());
+	}
+	_trace.push_back(IPAddress(r));
+    }
+}
+
+void
+IPLookupBenchmark::run()
+{
+    int n = _trace.size();
+    Vector<int> ref_ports, ports(n, -1);
+    Vector<IPAddress> ref_gws, gws(n, IPAddress());
+    StringAccum sa;
+
+    for (IPRouteTable **it = _tables.begin(); it != _tables.end(); ++it) {
+	IPRouteTable *t = *it;
+
+	int sink = 0, j = 0;
+	Timestamp t0 = Timestamp::now_steady();
+	for (uint32_t i = 0; i < _nlookups; ++i) {
+	    IPAddress gw;
+	    sink += t->lookup_route(_trace[j], gw);
+	    if (++j == n)
+		j = 0;
+	}
+	Timestamp t1 = Timestamp::now_steady();
+
+	j = 0;
+	for (uint32_t done = 0; done < _nlookups; ) {
+	    uint32_t m = n - j;
+	    if (m > _batch)
+		m = _batch;
+	    if (m > _nlookups - done)
+		m = _nlookups - done;
+	    t->lookup_routes(&_trace[j], m, &ports[j], &gws[j]);
+	    done += m;
+	    if ((j += m) == n)
+		j = 0;
+	}
+	Timestamp t2 = Timestamp::now_steady();
+	_sink = sink;
+
+	// Fill in the results for any trace addresses not yet looked up.
+	if (_nlookups < (uint32_t) n)
+	    t->lookup_routes(&_trace[_nlookups], n - _nlookups,
+			     &ports[_nlookups], &gws[_nlookups]);
+
+	int mismatches = 0;
+	if (it == _tables.begin()) {
+	    ref_ports = ports;
+	    ref_gws = gws;
+	} else
+	    for (int k = 0; k < n; ++k)
+		if (ports[k] != ref_ports[k] || (ports[k] >= 0 && gws[k] != ref_gws[k]))
+		    ++mismatches;
+
+	sa << t->name() << '\t' << t->class_name() << '\t'
+	   << t->memory_usage() << '\t';
+	sa.snprintf(20, "%.1f\t", (t1 - t0).doubleval() * 1e9 / _nlookups);
+	sa.snprintf(20, "%.1f\t", (t2 - t1).doubleval() * 1e9 / _nlookups);
+	sa << mismatches << '\n';
+    }
+
+    _results = sa.take_string();
+}
+
+String
+IPLookupBenchmark::read_handler(Element *e, void *thunk)
+{
+    IPLookupBenchmark *b = static_cast<IPLookupBenchmark *>(e);
+    if (thunk)
+	return String(b->_trace.size());
+    else
+	return b->_results;
+}
+
+int
+IPLookupBenchmark::run_handler(const String &, Element *e, void *, ErrorHandler *)
+{
+    static_cast<IPLookupBenchmark *>(e)->run();
+    return 0;
+}
+
+void
+IPLookupBenchmark::add_handlers()
+{
+    add_read_handler("results", read_handler, 0);
+    add_read_handler("trace", read_handler, 1);
+    add_write_handler("run", run_handler, 0, Handler::BUTTON);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel IPRouteTable)
+EXPORT_ELEMENT(IPLookupBenchmark)
@@ -0,0 +1,127 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_IPLOOKUPBENCHMARK_HH
+#define CLICK_IPLOOKUPBENCHMARK_HH
+#include <click/element.hh>
+#include <click/ipaddress.hh>
+#include <click/vector.hh>
+CLICK_DECLS
+class IPRouteTable;
+struct IPRoute;
+
+/*
+=c
+
+IPLookupBenchmark(TABLES [, I<keywords> ROUTES, TRACE, ADDRESSES, LOOKUPS, BATCH, SEED])
+
+=s iproute
+
+compares the lookup speed of IPRouteTable elements
+
+=d
+
+IPLookupBenchmark measures the lookup speed and memory use of several
+IPRouteTable elements on the same route set and address trace, and checks
+that they agree.  It does not route packets.
+
+TABLES is a space-separated list of IPRouteTable elements, such as
+RadixIPLookup, DirectIPLookup, and PoptrieIPLookup.  Each benchmark run
+performs LOOKUPS lookups per table, cycling through the address trace, once
+with B<lookup_route> and once with B<lookup_routes> in batches of BATCH
+addresses.  Results are reported by the `C<results>' handler.
+
+Keyword arguments are:
+
+=over 8
+
+=item ROUTES
+
+Filename.  A text or binary route file (see IPRouteTable) loaded into every
+table at initialization time.  Tables can also be given routes through their
+own configurations.  User-level only.
+
+=item TRACE
+
+Filename.  A file of whitespace-separated IP addresses to use as the address
+trace.  User-level only.
+
+=item ADDRESSES
+
+Integer.  Without TRACE, the number of random addresses to generate.  When
+ROUTES is given, each address is chosen from a randomly chosen route's
+prefix; otherwise addresses are uniformly random.  Default is 65536.
+
+=item LOOKUPS
+
+Integer.  Number of lookups per table and method.  Default is 1000000.
+
+=item BATCH
+
+Integer.  Number of addresses per B<lookup_routes> call.  Default is 64.
+
+=item SEED
+
+Integer.  Random seed used to generate the address trace.  Default is to
+use the current random state.
+
+=back
+
+=h run write-only
+
+Runs the benchmark.
+
+=h results read-only
+
+Reports the results of the most recent run, one line per table: the table
+name, class, memory use in bytes (as reported by B<memory_usage>, or 0 if
+unknown), nanoseconds per lookup with B<lookup_route>, nanoseconds per lookup
+with B<lookup_routes>, and the number of trace addresses whose result
+differed from the first table's.
+
+=h trace read-only
+
+Reports the number of addresses in the trace.
+
+=e
+
+  r :: RadixIPLookup(LOAD routes.txt);
+  d :: DirectIPLookup(LOAD routes.txt);
+  p :: PoptrieIPLookup(LOAD routes.txt);
+  b :: IPLookupBenchmark(r d p);
+  Script(write b.run, print $(b.results), stop);
+
+=a IPRouteTable, RadixIPLookup, DirectIPLookup, PoptrieIPLookup,
+RangeIPLookup */
+
+class IPLookupBenchmark : public Element { public:
+
+    IPLookupBenchmark();
+
+    const char *class_name() const	{ return "IPLookupBenchmark"; }
+
+    int configure(Vector<String> &conf, ErrorHandler *errh);
+    int initialize(ErrorHandler *errh);
+    void add_handlers();
+
+    void run();
+
+  private:
+
+    Vector<IPRouteTable *> _tables;
+    Vector<IPAddress> _trace;
+    String _routes_file;
+    String _trace_file;
+    uint32_t _naddresses;
+    uint32_t _nlookups;
+    uint32_t _batch;
+    String _results;
+    volatile int _sink;
+
+    void make_trace(const Vector<IPRoute> &routes);
+
+    static String read_handler(Element *, void *);
+    static int run_handler(const String &, Element *, void *, ErrorHandler *);
+
+};
+
+CLICK_ENDDECLS
+#endif
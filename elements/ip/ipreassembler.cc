@@ -36,10 +36,10 @@ CLICK_DECLS
 #define IP_BYTE_OFF(iph)	((ntohs((iph)->ip_off) & IP_OFFMASK) << 3)
 
 IPReassembler::IPReassembler()
-    : _stat_frags_seen(0), _stat_good_assem(0), _stat_failed_assem(0), _stat_bad_pkts(0)
+    : _slot_base(0), _stat_frags_seen(0), _stat_good_assem(0),
+      _stat_failed_assem(0), _stat_bad_pkts(0), _stat_timeouts(0),
+      _stat_evictions(0), _stat_source_evictions(0)
 {
-    for (int i = 0; i < NMAP; i++)
-	_map[i] = 0;
     static_assert(IPREASSEMBLER_ANNO_OFFSET + IPREASSEMBLER_ANNO_SIZE <= Packet::anno_size, "anno too big");
     static_assert(sizeof(ChunkLink) == IPREASSEMBLER_ANNO_SIZE, "sizeof(ChunkLink) is expected to equal IPREASSEMBLER_ANNO_SIZE.");
 }
@@ -53,13 +53,17 @@ IPReassembler::configure(Vector<String> &conf, ErrorHandler *errh)
 {
     _mem_high_thresh = 256 * 1024;
     int mtu_anno = -1;
+    bool have_source_himem;
     if (Args(conf, this, errh)
 	.read("HIMEM", _mem_high_thresh)
+	.read("SOURCE_HIMEM", _source_high_thresh).read_status(have_source_himem)
 	.read("MAX_MTU_ANNO", AnnoArg(2), mtu_anno)
 	.complete() < 0)
 	return -1;
     _mtu_anno = mtu_anno;
     _mem_low_thresh = (_mem_high_thresh >> 2) * 3;
+    if (!have_source_himem)
+	_source_high_thresh = _mem_high_thresh >> 2;
     return 0;
 }
 
@@ -67,28 +71,22 @@ int
 IPReassembler::initialize(ErrorHandler *)
 {
     _mem_used = 0;
-    _reap_time = 0;
     return 0;
 }
 
 void
 IPReassembler::cleanup(CleanupStage)
 {
-    for (int i = 0; i < NMAP; i++)
-	while (_map[i]) {
-	    WritablePacket *next = (WritablePacket *)(_map[i]->next());
-	    _map[i]->kill();
-	    _map[i] = next;
-	}
+    while (_map.size())
+	remove_datagram(_map.begin().get())->kill();
 }
 
 void
-IPReassembler::check_error(ErrorHandler *errh, int bucket, const Packet *p, const char *format, ...)
+IPReassembler::check_error(ErrorHandler *errh, const Packet *p, const char *format, ...)
 {
     va_list val;
     va_start(val, format);
     StringAccum sa;
-    sa << "buck " << bucket << ": ";
     if (p->has_network_header()) {
 	const click_ip *iph = p->ip_header();
 	sa << iph->ip_src << " > " << iph->ip_dst << " [" << ntohs(iph->ip_id) << ':' << PACKET_DLEN(p) << ((iph->ip_off & htons(IP_MF)) ? "+]: " : "]: ");
@@ -103,40 +101,53 @@ IPReassembler::check(ErrorHandler *errh)
 {
     if (!errh)
 	errh = ErrorHandler::default_handler();
-    uint32_t mem_used = 0;
-    for (int b = 0; b < NMAP; b++)
-	for (WritablePacket *q = _map[b]; q; q = (WritablePacket *)(q->next()))
-	    if (q->has_network_header()) {
-		const click_ip *qip = q->ip_header();
-		if (bucketno(qip) != b)
-		    check_error(errh, b, q, "in wrong bucket");
-		mem_used += IPH_MEM_USED + q->transport_length();
-		ChunkLink *chunk = &PACKET_CHUNK(q);
-		int off = 0;
-#if VERBOSE_DEBUG
-		check_error(errh, b, q, "");
-		StringAccum sa;
-		while (chunk && (!off || off < q->transport_length())) {
-		    sa << " (" << chunk->off << ',' << chunk->lastoff << ')';
-		    off = chunk->lastoff;
-		    chunk = next_chunk(q, chunk);
-		}
-		errh->message("  %s", sa.c_str());
-		chunk = &PACKET_CHUNK(q);
-		off = 0;
-#endif
-		while (chunk) {
-		    if (chunk->off >= chunk->lastoff
-			|| chunk->lastoff > q->transport_length()
-			|| (off != 0 && chunk->off < off + 8)) {
-			check_error(errh, b, q, "bad chunk (%d, %d) at %d", chunk->off, chunk->lastoff, off);
-			break;
-		    }
-		    off = chunk->lastoff;
-		    chunk = next_chunk(q, chunk);
-		}
-	    } else
-		errh->error("buck %d: missing IP header", b);
+    uint32_t mem_used = 0, nslotted = 0;
+    for (HashContainer<Datagram>::iterator it = _map.begin(); it; ++it) {
+	WritablePacket *q = it->_q;
+	if (!q->has_network_header()) {
+	    errh->error("missing IP header");
+	    continue;
+	}
+	if (!(Key(q->ip_header()) == it->_key))
+	    check_error(errh, q, "key mismatch");
+	if (it->_mem != (uint32_t) (IPH_MEM_USED + q->transport_length()))
+	    check_error(errh, q, "bad mem: have %u, claim %u", IPH_MEM_USED + q->transport_length(), it->_mem);
+	if (!it->_source || it->_source->_ip.addr() != it->_key.src)
+	    check_error(errh, q, "bad source");
+	mem_used += it->_mem;
+	ChunkLink *chunk = &PACKET_CHUNK(q);
+	int off = 0;
+	uint32_t nchunks = 0;
+	while (chunk) {
+	    if (chunk->off > chunk->lastoff
+		|| (chunk->off == chunk->lastoff && chunk->lastoff != q->transport_length())
+		|| chunk->lastoff > q->transport_length()
+		|| (off != 0 && chunk->off < off + 8)) {
+		check_error(errh, q, "bad chunk (%d, %d) at %d", chunk->off, chunk->lastoff, off);
+		break;
+	    }
+	    off = chunk->lastoff;
+	    ++nchunks;
+	    chunk = next_chunk(q, chunk);
+	}
+	if (!chunk && nchunks != it->_nchunks)
+	    check_error(errh, q, "bad chunk count: have %u, claim %u", nchunks, it->_nchunks);
+    }
+    for (int i = 0; i < NSLOTS; ++i)
+	for (Datagram *d = _slots[i].front(); d; d = d->_slot_link.next()) {
+	    if ((d->_stamp & (NSLOTS - 1)) != i)
+		check_error(errh, d->_q, "in wrong time bucket");
+	    ++nslotted;
+	}
+    if (nslotted != _map.size())
+	errh->error("bad time buckets: have %u, claim %u", nslotted, (unsigned) _map.size());
+    for (HashContainer<Source>::iterator it = _sources.begin(); it; ++it) {
+	uint32_t smem = 0;
+	for (Datagram *d = it->_datagrams.front(); d; d = d->_source_link.next())
+	    smem += d->_mem;
+	if (smem != it->_mem || !smem)
+	    errh->error("%s: bad source mem: have %u, claim %u", it->_ip.unparse().c_str(), smem, it->_mem);
+    }
     if (mem_used != _mem_used)
 	errh->error("bad mem_used: have %u, claim %u", mem_used, _mem_used);
     return 0;
@@ -153,82 +164,95 @@ IPReassembler::debug_dump(Element *e, void *)
 	"good reassemblies:   " << r->_stat_good_assem << "\n"
 	"failed reassemblies: " << r->_stat_failed_assem << "\n"
 	"bad fragments seen:  " << r->_stat_bad_pkts << "\n"
+	"timeouts:            " << r->_stat_timeouts << "\n"
+	"evictions:           " << r->_stat_evictions << "\n"
+	"source evictions:    " << r->_stat_source_evictions << "\n"
 	"cached chunk data:\n";
-    for (int b = 0; b < NMAP; b++)
-	for (WritablePacket *q = r->_map[b]; q; q = (WritablePacket *)(q->next()))
-	    if (const click_ip *qip = q->ip_header()) {
-		sa << ' ' << IPFlowID(qip) << ' ' << ntohs(qip->ip_id);
-		ChunkLink *chunk = &PACKET_CHUNK(q);
-		while (chunk &&
-		       (chunk->lastoff > chunk->off) &&
-		       (chunk->lastoff <= q->transport_length())) {
-		    sa << " (" << chunk->off << ',' << chunk->lastoff << ')';
-		    chunk = next_chunk(q, chunk);
-		}
-		sa << '\n';
+    for (HashContainer<Datagram>::iterator it = r->_map.begin(); it; ++it) {
+	WritablePacket *q = it->_q;
+	if (const click_ip *qip = q->ip_header()) {
+	    sa << ' ' << IPFlowID(qip) << ' ' << ntohs(qip->ip_id);
+	    ChunkLink *chunk = &PACKET_CHUNK(q);
+	    while (chunk &&
+		   (chunk->lastoff > chunk->off) &&
+		   (chunk->lastoff <= q->transport_length())) {
+		sa << " (" << chunk->off << ',' << chunk->lastoff << ')';
+		chunk = next_chunk(q, chunk);
 	    }
+	    sa << '\n';
+	}
+    }
     return sa.take_string();
 }
 
-WritablePacket *
-IPReassembler::find_queue(Packet *p, WritablePacket ***store_pprev)
+String
+IPReassembler::read_handler(Element *e, void *)
 {
-    const click_ip *iph = p->ip_header();
-    int bucket = bucketno(iph);
-    WritablePacket **pprev = &_map[bucket];
-    WritablePacket *q;
-    for (q = *pprev; q; pprev = (WritablePacket **)&q->next(), q = *pprev) {
-	const click_ip *qiph = q->ip_header();
-	if (same_segment(iph, qiph)) {
-	    *store_pprev = pprev;
-	    return q;
-	}
-    }
-    *store_pprev = &_map[bucket];
-    return 0;
+    IPReassembler *r = static_cast<IPReassembler *>(e);
+    return String(r->_map.size());
 }
 
-Packet *
-IPReassembler::emit_whole_packet(WritablePacket *q, WritablePacket **q_pprev,
-				 Packet *p_in)
+void
+IPReassembler::touch(Datagram *d, int now)
 {
-    ++_stat_good_assem;
-    *q_pprev = (WritablePacket *)q->next();
-
-    click_ip *q_iph = q->ip_header();
-    q_iph->ip_len = htons(q->network_length());
-    q_iph->ip_sum = 0;
-    q_iph->ip_sum = click_in_cksum((const unsigned char *)q_iph, q_iph->ip_hl << 2);
-
-    // zero out the annotations we used
-    memset(&PACKET_CHUNK(q), 0, sizeof(ChunkLink));
-    q->set_timestamp_anno(p_in->timestamp_anno());
-    q->set_next(0);
-
-    p_in->kill();
-    _mem_used -= IPH_MEM_USED + q->transport_length();
-    return q;
+    if ((d->_stamp & (NSLOTS - 1)) != (now & (NSLOTS - 1))) {
+	_slots[d->_stamp & (NSLOTS - 1)].erase(d);
+	_slots[now & (NSLOTS - 1)].push_back(d);
+    }
+    d->_stamp = now;
+    d->_source->_datagrams.erase(d);
+    d->_source->_datagrams.push_back(d);
 }
 
 void
-IPReassembler::make_queue(Packet *p, WritablePacket **q_pprev)
+IPReassembler::charge(Datagram *d, int delta)
+{
+    _mem_used += delta;
+    d->_mem += delta;
+    d->_source->_mem += delta;
+}
+
+IPReassembler::Datagram *
+IPReassembler::make_datagram(Packet *p, int now)
 {
     int p_off = IP_BYTE_OFF(p->ip_header());
     int p_lastoff = p_off + PACKET_DLEN(p);
-    WritablePacket *q;
+    int p_network_length = p->network_length();
+    IPAddress src(p->ip_header()->ip_src);
+
+    void *dx = _datagram_alloc.allocate();
+    HashContainer<Source>::iterator sit = _sources.find(src);
+    void *sx = sit ? 0 : _source_alloc.allocate();
+    if (!dx || (!sit && !sx)) {
+	if (dx)
+	    _datagram_alloc.deallocate(dx);
+	if (sx)
+	    _source_alloc.deallocate(sx);
+	p->kill();
+	click_chatter("out of memory");
+	return 0;
+    }
 
+    Datagram *d = new(dx) Datagram(Key(p->ip_header()));
+    WritablePacket *q;
     if (p_off == 0) {
 	q = p->uniqueify();
 	if (!q) {
+	    _datagram_alloc.deallocate(dx);
+	    if (sx)
+		_source_alloc.deallocate(sx);
 	    click_chatter("out of memory");
-	    return;
+	    return 0;
 	}
     } else {
 	q = Packet::make(p->headroom() + p->ip_header_offset(), 0, 20 + p_lastoff, 0);
 	if (!q) {
+	    _datagram_alloc.deallocate(dx);
+	    if (sx)
+		_source_alloc.deallocate(sx);
 	    p->kill();
 	    click_chatter("out of memory");
-	    return;
+	    return 0;
 	}
 	q->set_ip_header((click_ip *)q->data(), 20);
 	memcpy(q->ip_header(), p->ip_header(), 20);
@@ -237,22 +261,95 @@ IPReassembler::make_queue(Packet *p, WritablePacket **q_pprev)
 	p->kill();
     }
 
-    _mem_used += IPH_MEM_USED + p_lastoff;
-
     click_ip *q_iph = q->ip_header();
     q_iph->ip_off = (q_iph->ip_off & ~htons(IP_OFFMASK)); // leave MF, DF, RF
 
     if (_mtu_anno >= 0)
-	q->set_anno_u16(_mtu_anno, p->network_length());
+	q->set_anno_u16(_mtu_anno, p_network_length);
 
     PACKET_CHUNK(q).off = p_off;
     PACKET_CHUNK(q).lastoff = p_lastoff;
 
     // link it up
-    q->set_next(*q_pprev);
-    *q_pprev = q;
+    d->_q = q;
+    d->_stamp = now;
+    if (sit)
+	d->_source = sit.get();
+    else {
+	d->_source = new(sx) Source(src);
+	_sources.insert_at(sit, d->_source);
+	_sources.balance();
+    }
+    d->_source->_datagrams.push_back(d);
+    _slots[now & (NSLOTS - 1)].push_back(d);
+    _map.set(d);
+    _map.balance();
+    charge(d, IPH_MEM_USED + p_lastoff);
+    return d;
+}
+
+WritablePacket *
+IPReassembler::remove_datagram(Datagram *d)
+{
+    WritablePacket *q = d->_q;
+    _map.erase(d->_key);
+    _slots[d->_stamp & (NSLOTS - 1)].erase(d);
+    Source *s = d->_source;
+    s->_datagrams.erase(d);
+    charge(d, -(int) d->_mem);
+    if (s->_datagrams.empty()) {
+	_sources.erase(s->_ip);
+	s->~Source();
+	_source_alloc.deallocate(s);
+    }
+    d->~Datagram();
+    _datagram_alloc.deallocate(d);
+    if (q)
+	q->set_next(0);
+    return q;
+}
+
+void
+IPReassembler::fail_datagram(Datagram *d, uint32_t &stat)
+{
+    ++stat;
+    ++_stat_failed_assem;
+    checked_output_push(1, remove_datagram(d));
+}
+
+void
+IPReassembler::enforce_source_quota(Datagram *keep)
+{
+    // Throw away the source's other partial packets, least recently active
+    // first, until it is back within its quota.
+    Source *s = keep->_source;
+    while (_source_high_thresh && s->_mem > _source_high_thresh) {
+	Datagram *d = s->_datagrams.front();
+	if (d == keep)
+	    d = d->_source_link.next();
+	if (!d)
+	    break;
+	fail_datagram(d, _stat_source_evictions);
+    }
+}
+
+Packet *
+IPReassembler::emit_whole_packet(Datagram *d, Packet *p_in)
+{
+    ++_stat_good_assem;
+    WritablePacket *q = remove_datagram(d);
+
+    click_ip *q_iph = q->ip_header();
+    q_iph->ip_len = htons(q->network_length());
+    q_iph->ip_sum = 0;
+    q_iph->ip_sum = click_in_cksum((const unsigned char *)q_iph, q_iph->ip_hl << 2);
+
+    // zero out the annotations we used
+    memset(&PACKET_CHUNK(q), 0, sizeof(ChunkLink));
+    q->set_timestamp_anno(p_in->timestamp_anno());
 
-    check();
+    p_in->kill();
+    return q;
 }
 
 IPReassembler::ChunkLink *
@@ -281,7 +378,7 @@ IPReassembler::simple_action(Packet *p)
 	p->timestamp_anno().assign_now();
 	now = p->timestamp_anno().sec();
     }
-    if (now >= _reap_time)
+    if (now - REAP_TIMEOUT > _slot_base)
 	reap(now);
 
     // calculate packet edges
@@ -303,16 +400,17 @@ IPReassembler::simple_action(Packet *p)
 
     // clean up memory if necessary
     if (_mem_used > _mem_high_thresh)
-	reap_overfull(now);
+	reap_overfull();
 
-    // get its Packet queue
-    WritablePacket **q_pprev;
-    WritablePacket *q = find_queue(p, &q_pprev);
-    if (!q) {			// make a new queue
-	make_queue(p, q_pprev);
+    // get its partial packet
+    Datagram *d = _map.get(Key(iph));
+    if (!d) {			// make a new partial packet
+	if ((d = make_datagram(p, now)))
+	    enforce_source_quota(d);
 	return 0;
     }
-    WritablePacket *q_bucket_next = (WritablePacket *)(q->next());
+    touch(d, now);
+    WritablePacket *q = d->_q;
 
     if (_mtu_anno >= 0 && q->anno_u16(_mtu_anno) < p->network_length())
 	q->set_anno_u16(_mtu_anno, p->network_length());
@@ -334,20 +432,21 @@ IPReassembler::simple_action(Packet *p)
 	if (iph->ip_off & htons(IP_MF))
 	    want_space += (p_lastoff - p_off);
 	// request space
-	if (!(q = q->put(want_space))) {
+	// (put() frees q on failure)
+	if (!(d->_q = q = q->put(want_space))) {
 	    click_chatter("out of memory");
-	    *q_pprev = q_bucket_next;
-	    _mem_used -= IPH_MEM_USED + old_transport_length;
+	    remove_datagram(d);
 	    p->kill();
 	    return 0;
 	}
 	// get rid of extra space
 	q->take(q->transport_length() - p_lastoff);
-	// hook up packet, and add final chunk
-	*q_pprev = q;
+	// add final chunk
 	ChunkLink *last_chunk = (ChunkLink *)(q->transport_header() + old_transport_length);
 	last_chunk->off = last_chunk->lastoff = p_lastoff;
-	_mem_used += p_lastoff - old_transport_length;
+	++d->_nchunks;
+	charge(d, p_lastoff - old_transport_length);
+	enforce_source_quota(d);
     }
 
     // find chunks before and after p
@@ -355,8 +454,11 @@ IPReassembler::simple_action(Packet *p)
     while (chunk->lastoff < p_off)
 	chunk = next_chunk(q, chunk);
     ChunkLink *last = chunk;
-    while (last && last->lastoff < p_lastoff)
+    uint32_t nmerged = 0;
+    while (last && last->lastoff < p_lastoff) {
 	last = next_chunk(q, last);
+	++nmerged;
+    }
 
     // patch chunks
     assert(chunk && last);
@@ -364,8 +466,11 @@ IPReassembler::simple_action(Packet *p)
 	ChunkLink *new_chunk = (ChunkLink *)(q->transport_header() + p_lastoff);
 	*new_chunk = *last;
 	chunk->lastoff = p_lastoff;
-    } else
+	d->_nchunks += 1 - nmerged;
+    } else {
 	chunk->lastoff = last->lastoff;
+	d->_nchunks -= nmerged;
+    }
     if (p_off < chunk->off)
 	chunk->off = p_off;
 
@@ -377,7 +482,7 @@ IPReassembler::simple_action(Packet *p)
 	uint16_t old_ip_off = q->ip_header()->ip_off;
 	int header_delta = p->ip_header_offset() - q->ip_header_offset();
 	if (header_delta > 0)
-	    q = q->push(header_delta);
+	    d->_q = q = q->push(header_delta);
 	else if (header_delta < 0)
 	    q->pull(-header_delta);
 	q->set_ip_header((click_ip *)(q->data() + p->ip_header_offset()), p->ip_header_length());
@@ -404,36 +509,28 @@ IPReassembler::simple_action(Packet *p)
     if ((q->ip_header()->ip_off & htons(IP_MF)) == 0
 	&& PACKET_CHUNK(q).off == 0
 	&& PACKET_CHUNK(q).lastoff == q->transport_length())
-	return emit_whole_packet(q, q_pprev, p);
+	return emit_whole_packet(d, p);
 
-    // Otherwise, done for now
-    //check();
+    // Otherwise, done for now; give up on packets with too many holes
     p->kill();
+    if (d->_nchunks > MAX_CHUNKS)
+	fail_datagram(d, _stat_evictions);
     return 0;
 }
 
 void
-IPReassembler::reap_overfull(int now)
+IPReassembler::reap_overfull()
 {
-    check();
-
-    // First throw away fragments at least 10 seconds old, then at least 5
-    // seconds old, then any fragments.
-    for (int delta = 10; delta >= 0; delta -= 5)
-	for (int bucket = 0; bucket < NMAP; bucket++) {
-	    WritablePacket **pprev = &_map[bucket];
-	    for (WritablePacket *q = *pprev; q; q = *pprev)
-		if (!delta || q->timestamp_anno().sec() < now - delta) {
-		    *pprev = (WritablePacket *)q->next();
-		    _mem_used -= IPH_MEM_USED + q->transport_length();
-		    q->set_next(0);
-		    checked_output_push(1, q);
-		    ++_stat_failed_assem;
-		    if (_mem_used <= _mem_low_thresh)
-			return;
-		} else
-		    pprev = (WritablePacket **)&q->next();
+    // Throw away the least recently active partial packets, starting from
+    // the oldest time bucket.
+    for (int i = 0; i < NSLOTS; ++i) {
+	SlotList &slot = _slots[(_slot_base + i) & (NSLOTS - 1)];
+	while (Datagram *d = slot.front()) {
+	    fail_datagram(d, _stat_evictions);
+	    if (_mem_used <= _mem_low_thresh)
+		return;
 	}
+    }
 
     click_chatter("IPReassembler: cannot free enough memory!");
 }
@@ -441,31 +538,34 @@ IPReassembler::reap_overfull(int now)
 void
 IPReassembler::reap(int now)
 {
-    // look at all queues. If no activity for 30 seconds, kill that queue
-
+    // Drop partial packets with no activity for REAP_TIMEOUT seconds.  Only
+    // the time buckets for seconds that have newly become too old need to
+    // be examined.
     int kill_time = now - REAP_TIMEOUT;
-
-    for (int i = 0; i < NMAP; i++) {
-	WritablePacket **q_pprev = &_map[i];
-	for (WritablePacket *q = *q_pprev; q; ) {
-	    if (q->timestamp_anno().sec() < kill_time) {
-		*q_pprev = (WritablePacket *)q->next();
-		q->set_next(0);
-		_mem_used -= IPH_MEM_USED + q->transport_length();
-		checked_output_push(1, q);
-	    } else
-		q_pprev = (WritablePacket **)&q->next();
-	    q = *q_pprev;
+    if (kill_time - _slot_base > NSLOTS)
+	_slot_base = kill_time - NSLOTS;
+    for (; _slot_base < kill_time; ++_slot_base) {
+	SlotList &slot = _slots[_slot_base & (NSLOTS - 1)];
+	for (Datagram *d = slot.front(); d; ) {
+	    Datagram *next = d->_slot_link.next();
+	    if (d->_stamp < kill_time) {
+		++_stat_timeouts;
+		checked_output_push(1, remove_datagram(d));
+	    }
+	    d = next;
 	}
     }
-
-    _reap_time = now + REAP_INTERVAL;
 }
 
 void
 IPReassembler::add_handlers()
 {
     add_read_handler("dump", debug_dump);
+    add_data_handlers("mem_used", Handler::OP_READ, &_mem_used);
+    add_data_handlers("timeouts", Handler::OP_READ, &_stat_timeouts);
+    add_data_handlers("evictions", Handler::OP_READ, &_stat_evictions);
+    add_data_handlers("source_evictions", Handler::OP_READ, &_stat_source_evictions);
+    add_read_handler("datagrams", read_handler, 0);
 }
 
 CLICK_ENDDECLS
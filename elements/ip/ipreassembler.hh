@@ -4,7 +4,11 @@
 #include <click/element.hh>
 #include <click/glue.hh>
 #include <clicknet/ip.h>
-#include <click/timer.hh>
+#include <click/hashcontainer.hh>
+#include <click/hashcode.hh>
+#include <click/hashallocator.hh>
+#include <click/ipaddress.hh>
+#include <click/list.hh>
 CLICK_DECLS
 
 /*
@@ -27,8 +31,19 @@ outputs, however, a single packet containing all the received fragments at
 their proper offsets is pushed onto output 1.
 
 IPReassembler's memory usage is bounded. When memory consumption rises above
-HIMEM bytes, IPReassembler throws away old fragments until memory consumption
-drops below 3/4*HIMEM bytes. Default HIMEM is 256K.
+HIMEM bytes, IPReassembler throws away the least recently active partial
+packets until memory consumption drops below 3/4*HIMEM bytes. Default HIMEM
+is 256K.  Each source address is also limited to SOURCE_HIMEM bytes of
+partial packets: when a source exceeds its quota, its own least recently
+active partial packets are thrown away, so a single source sending a flood
+of fragments cannot evict other sources' packets.  A partial packet whose
+fragments leave more than 64 separate holes is also thrown away.  Partial
+packets that are thrown away are treated like dormant ones.
+
+Partial packets are found by a hash table keyed on source, destination,
+protocol, and IP ID, which grows as needed.  Dormant partial packets are
+found through one-second time buckets, so neither timeouts nor memory
+pressure require a scan of all partial packets.
 
 Output packets have the same MAC header as the fragment that contains
 offset 0.  Other than that, input MAC headers are ignored.
@@ -45,6 +60,11 @@ Keyword arguments are:
 
 The upper bound for memory consumption, in bytes. Default is 256K.
 
+=item SOURCE_HIMEM
+
+The upper bound for memory consumption by any one source address, in bytes.
+Zero means no per-source bound.  Default is HIMEM/4.
+
 =item MAX_MTU_ANNO
 
 Optional. A 2 byte annotation that will be filled with the maximum size of any
@@ -60,6 +80,31 @@ second output.
 
 IPReassembler destroys its input packets' "next packet" annotations.
 
+=h dump read-only
+
+Returns statistics and a description of every partial packet.
+
+=h datagrams read-only
+
+Returns the number of partial packets.
+
+=h mem_used read-only
+
+Returns the number of bytes charged to partial packets.
+
+=h timeouts read-only
+
+Returns the number of partial packets dropped as dormant.
+
+=h evictions read-only
+
+Returns the number of partial packets dropped because of HIMEM, or because
+they had too many holes.
+
+=h source_evictions read-only
+
+Returns the number of partial packets dropped because of SOURCE_HIMEM.
+
 =a IPFragmenter */
 
 class IPReassembler : public Element { public:
@@ -89,52 +134,106 @@ class IPReassembler : public Element { public:
   private:
 
     enum { REAP_TIMEOUT = 30, // seconds
-	   REAP_INTERVAL = 10, // seconds
+	   NSLOTS = 32,	      // one-second time buckets, > REAP_TIMEOUT
+	   MAX_CHUNKS = 65,
 	   IPH_MEM_USED = 40 };
 
-    enum { NMAP = 256 };
-    WritablePacket *_map[NMAP];
+    struct Key {
+	uint32_t src;
+	uint32_t dst;
+	uint16_t id;
+	uint8_t p;
+	Key(const click_ip *iph)
+	    : src(iph->ip_src.s_addr), dst(iph->ip_dst.s_addr),
+	      id(iph->ip_id), p(iph->ip_p) {
+	}
+	hashcode_t hashcode() const {
+	    return hash_mix32(src ^ (dst * 0x9E3779B1U) ^ ((id << 8) | p));
+	}
+	bool operator==(const Key &x) const {
+	    return src == x.src && dst == x.dst && id == x.id && p == x.p;
+	}
+    };
+
+    struct Source;
+
+    // A partial packet.  The packet data, and the ChunkLinks describing
+    // which parts have arrived, live in _q.
+    struct Datagram {
+	Key _key;
+	Datagram *_hashnext;
+	WritablePacket *_q;
+	Source *_source;
+	int _stamp;		// second of last activity
+	uint32_t _mem;		// bytes charged against HIMEM
+	uint32_t _nchunks;
+	List_member<Datagram> _slot_link;
+	List_member<Datagram> _source_link;
+	Datagram(const Key &key)
+	    : _key(key), _hashnext(), _q(), _source(), _mem(0), _nchunks(1) {
+	}
+	typedef Key key_type;
+	typedef const Key &key_const_reference;
+	key_const_reference hashkey() const {
+	    return _key;
+	}
+    };
 
-    int _reap_time;
+    typedef List<Datagram, &Datagram::_slot_link> SlotList;
+    typedef List<Datagram, &Datagram::_source_link> SourceList;
+
+    struct Source {
+	IPAddress _ip;
+	Source *_hashnext;
+	uint32_t _mem;
+	SourceList _datagrams;	// least recently active first
+	Source(IPAddress ip)
+	    : _ip(ip), _hashnext(), _mem(0) {
+	}
+	typedef IPAddress key_type;
+	typedef IPAddress key_const_reference;
+	key_const_reference hashkey() const {
+	    return _ip;
+	}
+    };
+
+    HashContainer<Datagram> _map;
+    HashContainer<Source> _sources;
+    SlotList _slots[NSLOTS];
+    int _slot_base;		// older seconds have been reaped
+    SizedHashAllocator<sizeof(Datagram)> _datagram_alloc;
+    SizedHashAllocator<sizeof(Source)> _source_alloc;
 
     uint32_t _stat_frags_seen;
     uint32_t _stat_good_assem;
     uint32_t _stat_failed_assem;
     uint32_t _stat_bad_pkts;
+    uint32_t _stat_timeouts;
+    uint32_t _stat_evictions;
+    uint32_t _stat_source_evictions;
 
     uint32_t _mem_used;
     uint32_t _mem_high_thresh;	// defaults to 256K
     uint32_t _mem_low_thresh;	// defaults to 3/4 * _mem_high_thresh
+    uint32_t _source_high_thresh; // defaults to 1/4 * _mem_high_thresh
     int8_t _mtu_anno;
 
-    static inline int bucketno(const click_ip *);
-    static inline bool same_segment(const click_ip *, const click_ip *);
     static String debug_dump(Element *e, void *);
-
-    WritablePacket *find_queue(Packet *, WritablePacket ***);
-    void make_queue(Packet *, WritablePacket **);
+    static String read_handler(Element *e, void *);
+
+    Datagram *make_datagram(Packet *, int now);
+    void touch(Datagram *, int now);
+    void charge(Datagram *, int delta);
+    WritablePacket *remove_datagram(Datagram *);
+    void fail_datagram(Datagram *, uint32_t &stat);
+    void enforce_source_quota(Datagram *);
     static ChunkLink *next_chunk(WritablePacket *, ChunkLink *);
-    Packet *emit_whole_packet(WritablePacket *, WritablePacket **, Packet *);
-    void reap_overfull(int);
+    Packet *emit_whole_packet(Datagram *, Packet *);
+    void reap_overfull();
     void reap(int);
-    static void check_error(ErrorHandler *, int, const Packet *, const char *, ...);
+    static void check_error(ErrorHandler *, const Packet *, const char *, ...);
 
 };
 
-
-inline int
-IPReassembler::bucketno(const click_ip *h)
-{
-    return (h->ip_id % NMAP);
-}
-
-inline bool
-IPReassembler::same_segment(const click_ip *h, const click_ip *h2)
-{
-    return h->ip_id == h2->ip_id && h->ip_p == h2->ip_p
-	&& h->ip_src.s_addr == h2->ip_src.s_addr
-	&& h->ip_dst.s_addr == h2->ip_dst.s_addr;
-}
-
 CLICK_ENDDECLS
 #endif
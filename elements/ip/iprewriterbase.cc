@@ -33,6 +33,7 @@
 #include <click/error.hh>
 #include <click/algorithm.hh>
 #include <click/heap.hh>
+#include <click/router.hh>
 
 #ifdef CLICK_LINUXMODULE
 #include <click/cxxprotect.h>
@@ -216,6 +217,38 @@ IPRewriterBase::cleanup(CleanupStage)
     _input_specs.clear();
 }
 
+bool
+IPRewriterBase::take_flows(Element *e)
+{
+    // Flows point at their owner's input specs and live in their reply
+    // element's map, so only rewriters that keep their flows to themselves
+    // can hand them over.
+    if (e != router()->hotswap_unchanged_element(this))
+	return false;
+    IPRewriterBase *rw = static_cast<IPRewriterBase *>(e);
+    if (_heap->_use_count != 1 || rw->_heap->_use_count != 1
+	|| _heap->size() != 0)
+	return false;
+    for (int i = 0; i < _input_specs.size(); ++i)
+	if (_input_specs[i].reply_element != this
+	    || rw->_input_specs[i].reply_element != rw)
+	    return false;
+
+    _map.swap(rw->_map);
+    click_swap(_heap, rw->_heap);
+    for (int which_heap = 0; which_heap < 2; ++which_heap) {
+	Vector<IPRewriterFlow *> &myheap = _heap->_heaps[which_heap];
+	for (int i = 0; i < myheap.size(); ++i)
+	    myheap[i]->_owner = &_input_specs[myheap[i]->_owner->owner_input];
+    }
+    for (int i = 0; i < _input_specs.size(); ++i) {
+	_input_specs[i].count = rw->_input_specs[i].count;
+	_input_specs[i].failures = rw->_input_specs[i].failures;
+	rw->_input_specs[i].count = 0;
+    }
+    return true;
+}
+
 IPRewriterEntry *
 IPRewriterBase::get_entry(int ip_p, const IPFlowID &flowid, int input)
 {
@@ -443,6 +476,21 @@ IPRewriterBase::pattern_write_handler(const String &str, Element *e, void *user_
     return 0;
 }
 
+int
+IPRewriterBase::parse_mappings_chunk(const String &data, uint32_t &bucket,
+				     uint32_t &max, ErrorHandler *errh)
+{
+    // Chunked mappings handlers use the next map bucket as their cursor.
+    // Empty data requests all mappings.
+    String cursor;
+    bucket = 0;
+    max = 0xFFFFFFFFU;
+    if (data && (!Handler::parse_chunk_param(data, max, cursor)
+		 || (cursor && !IntArg().parse(cursor, bucket))))
+	return errh->error("expected %<CHUNK max [cursor]%>");
+    return 0;
+}
+
 void
 IPRewriterBase::add_rewriter_handlers(bool writable_patterns)
 {
@@ -150,6 +150,8 @@ class IPRewriterBase : public Element { public:
 	return timeouts[1] ? timeouts[1] : timeouts[0];
     }
 
+    bool take_flows(Element *old_element);
+
     IPRewriterEntry *store_flow(IPRewriterFlow *flow, int input,
 				Map &map, Map *reply_map_ptr = 0);
     inline void unmap_flow(IPRewriterFlow *flow,
@@ -167,6 +169,7 @@ class IPRewriterBase : public Element { public:
     static String read_handler(Element *e, void *user_data);
     static int write_handler(const String &str, Element *e, void *user_data, ErrorHandler *errh);
     static int pattern_write_handler(const String &str, Element *e, void *user_data, ErrorHandler *errh);
+    static int parse_mappings_chunk(const String &data, uint32_t &bucket, uint32_t &max, ErrorHandler *errh);
 
     friend int IPRewriterInput::rewrite_flowid(const IPFlowID &flowid,
 			IPFlowID &rewritten_flowid, Packet *p, int mapid);
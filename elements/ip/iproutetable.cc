@@ -25,6 +25,9 @@
 #include <click/glue.hh>
 #include <click/straccum.hh>
 #include <click/router.hh>
+#if CLICK_USERLEVEL
+# include <click/userutils.hh>
+#endif
 #include "iproutetable.hh"
 CLICK_DECLS
 
@@ -39,7 +42,13 @@ cp_ip_route(String s, IPRoute *r_store, bool remove_route, Element *context)
     String word = cp_shift_spacevec(s);
     if (word == "-")
 	/* null gateway; do nothing */;
-    else if (IPAddressArg().parse(word, r.gw, context))
+    else if (!s && word && !remove_route
+	     && IntArg().parse(word, r.port)) {
+	// Common `ADDR/MASK OUTPUT' form.  Checking for the port first avoids
+	// a possibly expensive address lookup on a bare number.
+	*r_store = r;
+	return true;
+    } else if (IPAddressArg().parse(word, r.gw, context))
 	/* do nothing */;
     else
 	goto two_words;
@@ -86,6 +95,11 @@ IPRoute::unparse() const
 }
 
 
+IPRouteTable::IPRouteTable()
+    : _load_nroutes(-1)
+{
+}
+
 void *
 IPRouteTable::cast(const char *name)
 {
@@ -101,7 +115,20 @@ IPRouteTable::configure(Vector<String> &conf, ErrorHandler *errh)
     int r = 0, r1, eexist = 0;
     IPRoute route;
     for (int i = 0; i < conf.size(); i++) {
-	if (!cp_ip_route(conf[i], &route, false, this)) {
+	String arg = conf[i];
+	if (cp_shift_spacevec(arg) == "LOAD") {
+#if CLICK_USERLEVEL
+	    String filename;
+	    if (!FilenameArg().parse(arg, filename)) {
+		errh->error("argument %d should be %<LOAD FILENAME%>", i+1);
+		r = -EINVAL;
+	    } else if ((r1 = load_routes(filename, errh)) < 0)
+		r = r1;
+#else
+	    errh->error("argument %d: LOAD not supported in this driver", i+1);
+	    r = -EINVAL;
+#endif
+	} else if (!cp_ip_route(conf[i], &route, false, this)) {
 	    errh->error("argument %d should be %<ADDR/MASK [GATEWAY] OUTPUT%>", i+1);
 	    r = -EINVAL;
 	} else if (route.port < 0 || route.port >= noutputs()) {
@@ -126,6 +153,18 @@ IPRouteTable::add_route(const IPRoute&, bool, IPRoute*, ErrorHandler *errh)
     return errh->error("cannot add routes to this routing table");
 }
 
+int
+IPRouteTable::add_routes(Vector<IPRoute> &routes, ErrorHandler *errh)
+{
+    sort_routes(routes);
+    for (IPRoute *r = routes.begin(); r != routes.end(); ++r) {
+	int x = add_route(*r, true, 0, errh);
+	if (x < 0)
+	    return x;
+    }
+    return 0;
+}
+
 int
 IPRouteTable::remove_route(const IPRoute&, IPRoute*, ErrorHandler *errh)
 {
@@ -139,12 +178,155 @@ IPRouteTable::lookup_route(IPAddress, IPAddress&) const
     return -1;			// by default, route lookups fail
 }
 
+void
+IPRouteTable::lookup_routes(const IPAddress *dst, int n, int *ports, IPAddress *gws) const
+{
+    for (int i = 0; i < n; ++i)
+	ports[i] = lookup_route(dst[i], gws[i]);
+}
+
 String
 IPRouteTable::dump_routes()
 {
     return String();
 }
 
+String
+IPRouteTable::dump_routes_chunk(uint32_t& pos, uint32_t)
+{
+    pos = 0;
+    return dump_routes();
+}
+
+size_t
+IPRouteTable::memory_usage() const
+{
+    return 0;
+}
+
+
+static int
+route_compar(const void *av, const void *bv, void *)
+{
+    const IPRoute *a = static_cast<const IPRoute *>(av);
+    const IPRoute *b = static_cast<const IPRoute *>(bv);
+    uint32_t am = ntohl(a->mask.addr()), bm = ntohl(b->mask.addr());
+    if (am != bm)
+	return am < bm ? -1 : 1;
+    uint32_t aa = ntohl(a->addr.addr()), ba = ntohl(b->addr.addr());
+    if (aa != ba)
+	return aa < ba ? -1 : 1;
+    return a->extra - b->extra;
+}
+
+void
+IPRouteTable::sort_routes(Vector<IPRoute> &routes)
+{
+    // use 'extra' to keep routes for the same prefix in their original order
+    for (int i = 0; i < routes.size(); ++i)
+	routes[i].extra = i;
+    click_qsort(routes.begin(), routes.size(), sizeof(IPRoute), route_compar);
+}
+
+static const char route_file_magic[] = "CLICKRT1";
+enum { route_file_header_size = 12, route_file_record_size = 16 };
+
+int
+IPRouteTable::parse_route_file(const String &data, Vector<IPRoute> &routes,
+			       ErrorHandler *errh)
+{
+    const unsigned char *s = reinterpret_cast<const unsigned char *>(data.data());
+    int len = data.length();
+
+    if (len >= 8 && memcmp(s, route_file_magic, 8) == 0) {
+	uint32_t n;
+	if (len >= route_file_header_size) {
+	    memcpy(&n, s + 8, 4);
+	    n = ntohl(n);
+	}
+	if (len < route_file_header_size
+	    || n > (uint32_t) (len - route_file_header_size) / route_file_record_size
+	    || (uint32_t) len != route_file_header_size + n * route_file_record_size)
+	    return errh->error("truncated binary route file");
+	routes.reserve(routes.size() + n);
+	s += route_file_header_size;
+	for (uint32_t i = 0; i < n; ++i, s += route_file_record_size) {
+	    IPRoute r;
+	    uint16_t port;
+	    memcpy(&r.addr, s, 4);
+	    memcpy(&r.mask, s + 4, 4);
+	    memcpy(&r.gw, s + 8, 4);
+	    memcpy(&port, s + 12, 2);
+	    r.port = ntohs(port);
+	    r.addr &= r.mask;
+	    if (r.port >= noutputs())
+		return errh->error("route %u: bad OUTPUT", i + 1);
+	    routes.push_back(r);
+	}
+	return 0;
+    }
+
+    const char *end = data.end();
+    int lineno = 1;
+    for (const char *x = data.begin(); x < end; ++lineno) {
+	const char *nl = find(x, end, '\n');
+	String line = cp_uncomment(data.substring(x, nl));
+	x = nl + 1;
+	if (!line)
+	    continue;
+	IPRoute r;
+	if (!cp_ip_route(line, &r, false, this))
+	    return errh->error("line %d: expected %<ADDR/MASK [GATEWAY] OUTPUT%>", lineno);
+	if (r.port < 0 || r.port >= noutputs())
+	    return errh->error("line %d: bad OUTPUT", lineno);
+	routes.push_back(r);
+    }
+    return 0;
+}
+
+String
+IPRouteTable::unparse_route_file(const Vector<IPRoute> &routes)
+{
+    StringAccum sa;
+    uint32_t n = htonl(routes.size());
+    sa.append(route_file_magic, 8);
+    sa.append(reinterpret_cast<const char *>(&n), 4);
+    for (const IPRoute *r = routes.begin(); r != routes.end(); ++r)
+	if (char *x = sa.extend(route_file_record_size)) {
+	    uint16_t port = htons(r->port);
+	    memcpy(x, &r->addr, 4);
+	    memcpy(x + 4, &r->mask, 4);
+	    memcpy(x + 8, &r->gw, 4);
+	    memcpy(x + 12, &port, 2);
+	    x[14] = x[15] = 0;
+	}
+    return sa.take_string();
+}
+
+#if CLICK_USERLEVEL
+int
+IPRouteTable::load_routes(const String &filename, ErrorHandler *errh)
+{
+    Timestamp start = Timestamp::now_steady();
+    int before = errh->nerrors();
+    String data = file_string(filename, errh);
+    if (errh->nerrors() != before)
+	return -EINVAL;
+
+    Vector<IPRoute> routes;
+    PrefixErrorHandler perrh(errh, filename + ": ");
+    if (parse_route_file(data, routes, &perrh) < 0)
+	return -EINVAL;
+    int r = add_routes(routes, errh);
+    if (r == -ENOMEM && errh->nerrors() == before)
+	errh->error("%s: out of memory", filename.c_str());
+
+    _load_nroutes = routes.size();
+    _load_time = Timestamp::now_steady() - start;
+    return r;
+}
+#endif
+
 
 void
 IPRouteTable::push(int, Packet *p)
@@ -275,21 +457,103 @@ IPRouteTable::table_handler(Element *e, void *)
     return r->dump_routes();
 }
 
+int
+IPRouteTable::table_chunk_handler(int, String& s, Element* e, const Handler*, ErrorHandler* errh)
+{
+    IPRouteTable *r = static_cast<IPRouteTable*>(e);
+    if (!s) {
+	s = r->dump_routes();
+	return 0;
+    }
+    uint32_t max, pos = 0;
+    String cursor;
+    if (!Handler::parse_chunk_param(s, max, cursor)
+	|| (cursor && (!IntArg().parse(cursor, pos) || pos == 0)))
+	return errh->error("expected %<CHUNK max [cursor]%>");
+    String data = r->dump_routes_chunk(pos, max);
+    s = Handler::chunk_value(pos ? String(pos) : String(), data);
+    return 0;
+}
+
+String
+IPRouteTable::load_info_handler(Element *e, void *)
+{
+    IPRouteTable *table = static_cast<IPRouteTable*>(e);
+    StringAccum sa;
+    if (table->_load_nroutes >= 0)
+	sa << "routes " << table->_load_nroutes << '\n'
+	   << "time " << table->_load_time << '\n';
+    if (size_t m = table->memory_usage())
+	sa << "memory " << m << '\n';
+    return sa.take_string();
+}
+
+#if CLICK_USERLEVEL
+int
+IPRouteTable::load_handler(const String &str, Element *e, void *, ErrorHandler *errh)
+{
+    IPRouteTable *table = static_cast<IPRouteTable*>(e);
+    String filename;
+    if (!FilenameArg().parse(cp_uncomment(str), filename))
+	return errh->error("expected FILENAME");
+    return table->load_routes(filename, errh);
+}
+
+int
+IPRouteTable::save_handler(const String &str, Element *e, void *, ErrorHandler *errh)
+{
+    IPRouteTable *table = static_cast<IPRouteTable*>(e);
+    String filename;
+    if (!FilenameArg().parse(cp_uncomment(str), filename))
+	return errh->error("expected FILENAME");
+
+    Vector<IPRoute> routes;
+    String text = table->dump_routes();
+    if (table->parse_route_file(text, routes, errh) < 0)
+	return -EINVAL;
+    String data = unparse_route_file(routes);
+
+    FILE *f = fopen(filename.c_str(), "wb");
+    if (!f)
+	return errh->error("%s: %s", filename.c_str(), strerror(errno));
+    size_t w = fwrite(data.data(), 1, data.length(), f);
+    if (fclose(f) != 0 || w != (size_t) data.length())
+	return errh->error("%s: %s", filename.c_str(), strerror(errno));
+    return 0;
+}
+#endif
+
 int
 IPRouteTable::lookup_handler(int, String& s, Element* e, const Handler*, ErrorHandler* errh)
 {
     IPRouteTable *table = static_cast<IPRouteTable*>(e);
-    IPAddress a;
-    if (IPAddressArg().parse(s, a, table)) {
-	IPAddress gw;
-	int port = table->lookup_route(a, gw);
-	if (gw)
-	    s = String(port) + " " + gw.unparse();
-	else
-	    s = String(port);
-	return 0;
-    } else
+    Vector<String> words;
+    cp_spacevec(s, words);
+    Vector<IPAddress> addrs(words.size(), IPAddress());
+    for (int i = 0; i < words.size(); ++i)
+	if (!IPAddressArg().parse(words[i], addrs[i], table))
+	    return errh->error("expected IP address");
+    if (addrs.size() == 0)
 	return errh->error("expected IP address");
+
+    Vector<int> ports(addrs.size(), -1);
+    Vector<IPAddress> gws(addrs.size(), IPAddress());
+    table->lookup_routes(addrs.begin(), addrs.size(), ports.begin(), gws.begin());
+
+    // A single address reports "PORT [GW]"; several addresses report
+    // "ADDR PORT [GW]" on separate lines.
+    StringAccum sa;
+    for (int i = 0; i < addrs.size(); ++i) {
+	if (addrs.size() > 1)
+	    sa << addrs[i] << ' ';
+	sa << ports[i];
+	if (gws[i])
+	    sa << ' ' << gws[i];
+	if (addrs.size() > 1)
+	    sa << '\n';
+    }
+    s = sa.take_string();
+    return 0;
 }
 
 void
@@ -299,7 +563,12 @@ IPRouteTable::add_handlers()
     add_write_handler("set", add_route_handler, 1);
     add_write_handler("remove", remove_route_handler);
     add_write_handler("ctrl", ctrl_handler);
-    add_read_handler("table", table_handler, 0, Handler::EXPENSIVE);
+    set_handler("table", Handler::h_read | Handler::h_read_param | Handler::h_read_chunked | Handler::h_expensive, table_chunk_handler);
+    add_read_handler("load_info", load_info_handler, 0);
+#if CLICK_USERLEVEL
+    add_write_handler("load", load_handler, 0);
+    add_write_handler("save", save_handler, 0);
+#endif
     set_handler("lookup", Handler::OP_READ | Handler::READ_PARAM, lookup_handler);
 }
 
@@ -3,6 +3,7 @@
 #define CLICK_IPROUTETABLE_HH
 #include <click/glue.hh>
 #include <click/element.hh>
+#include <click/timestamp.hh>
 CLICK_DECLS
 
 /*
@@ -72,6 +73,13 @@ should be preferred for almost all purposes.
 A Click script containing the 167000-route dump is available at
 http://www.read.cs.ucla.edu/click/routetabletest-167k.click.gz
 
+PoptrieIPLookup trades some lookup speed relative to DirectIPLookup for a
+much smaller lookup table: for 200000 routes, about 7 MB, where
+DirectIPLookup's tables take nearly 60 MB.  This matters when running many
+tables at once.  The IPLookupBenchmark
+element measures lookup speed, memory use, and agreement for any set of
+IPRouteTable elements on your own route set and address trace.
+
 =head1 INTERFACE
 
 These four IPRouteTable virtual functions should generally be overridden by
@@ -115,6 +123,43 @@ implementation returns an empty string.
 
 =back
 
+Several more virtual functions may be overridden to speed up large tables.
+
+=over 4
+
+=item C<int B<add_routes>(VectorE<lt>IPRouteE<gt> &routes, ErrorHandler *errh)>
+
+Adds many routes at once, as if by B<add_route> with C<set> true, so later
+routes for a prefix replace earlier ones.  May reorder C<routes>.  Used when
+loading route files.  The default implementation sorts C<routes> with
+B<sort_routes>, then calls B<add_route> for each one.
+
+=item C<void B<lookup_routes>(const IPAddress *dst, int n, int *ports, IPAddress *gws) const>
+
+Looks up the routes for the C<n> addresses in C<dst>, storing each output
+port in C<ports> and each gateway in C<gws>, as if by B<lookup_route>.
+Implementations can overlap the memory accesses of independent lookups.  The
+default implementation calls B<lookup_route> for each address.
+
+=item C<size_t B<memory_usage>() const>
+
+Returns the approximate number of bytes used by the lookup structures, or 0
+if unknown.  The default implementation returns 0.
+
+=item C<String B<dump_routes_chunk>(uint32_t &pos, uint32_t max)>
+
+Returns a textual description of about C<max> routes starting at position
+C<pos>, and sets C<pos> to the position of the next chunk, or 0 if the table
+is complete.  Position 0 is the start of the table; other positions are
+defined by the implementation.  Used by the chunked `C<table>' handler, so
+that large tables can be read without building their whole description at
+once.  Positions are usually indexes into the implementation's tables, so
+routes changed between chunks, or moved when a table is resized, may be
+missed or repeated.  The default implementation returns B<dump_routes> and
+sets C<pos> to 0.
+
+=back
+
 The following functions, overridden by IPRouteTable, are available for use by
 subclasses.
 
@@ -125,6 +170,11 @@ subclasses.
 The default implementation of B<configure> parses C<conf> as a list of routes,
 where each route is the space-separated list `C<address/mask [gateway]
 output>'. The routes are successively added to the element with B<add_route>.
+An argument `C<LOAD filename>' instead loads a route file (see below) with
+B<add_routes>.
+IPRouteTable declares the C<C> flag, so the router may configure several
+routing tables at once on different threads; B<add_route> implementations
+must therefore touch only their own element's state during configuration.
 
 =item C<void B<push>(int port, Packet *p)>
 
@@ -153,12 +203,39 @@ up to the `C<ctrl>' handler.
 =item C<static String B<table_handler>(Element *, void *)>
 
 This read handler callback function returns the element's routing table via
-the B<dump_routes> function. Normally hooked up to the `C<table>' handler.
+the B<dump_routes> function.
+
+=item C<static int B<table_chunk_handler>(int, String &, Element *, const Handler *, ErrorHandler *)>
+
+This read handler callback function returns the element's routing table,
+either whole via B<dump_routes> or in chunks via B<dump_routes_chunk> (see
+Handler::call_read_chunk). Normally hooked up to the `C<table>' handler.
+
+=item C<static void B<sort_routes>(VectorE<lt>IPRouteE<gt> &routes)>
+
+Sorts C<routes> by increasing prefix length, then by address.  Routes for
+the same prefix keep their relative order.  Inserting routes in this order
+means a route never needs to skip over more-specific routes added before it.
 
 =back
 
-=a RadixIPLookup, DirectIPLookup, RangeIPLookup, StaticIPLookup,
-LinearIPLookup, SortedIPLookup, LinuxIPLookup */
+=head1 ROUTE FILES
+
+The `C<LOAD>' configuration keyword and the `C<load>' handler read routes
+from a file in bulk.  This is much faster than adding routes one at a time
+through configuration strings or the `C<add>' handler, since the whole file
+is parsed first and then handed to B<add_routes>.  Route files are either
+text, with one `C<address/mask [gateway] output>' route per line, or binary.
+A binary route file starts with the eight bytes `C<CLICKRT1>' and a 4-byte
+route count, followed by one 16-byte record per route: the 4-byte address,
+the 4-byte mask, the 4-byte gateway, a 2-byte output port, and two zero
+bytes.  Multibyte values are in network byte order.  Masks need not be
+prefixes, so any table's routes survive a save and reload.  The `C<save>'
+handler writes the current table in binary form.
+
+=a RadixIPLookup, DirectIPLookup, RangeIPLookup, PoptrieIPLookup,
+StaticIPLookup, LinearIPLookup, SortedIPLookup, LinuxIPLookup,
+IPLookupBenchmark */
 
 struct IPRoute {
     IPAddress addr;
@@ -187,28 +264,51 @@ struct IPRoute {
 
 class IPRouteTable : public Element { public:
 
+    IPRouteTable();
+
     void* cast(const char*);
+    const char *flags() const		{ return "C"; }
     int configure(Vector<String>&, ErrorHandler*);
     void add_handlers();
 
     virtual int add_route(const IPRoute& route, bool allow_replace, IPRoute* replaced_route, ErrorHandler* errh);
+    virtual int add_routes(Vector<IPRoute>& routes, ErrorHandler* errh);
     virtual int remove_route(const IPRoute& route, IPRoute* removed_route, ErrorHandler* errh);
     virtual int lookup_route(IPAddress addr, IPAddress& gw) const = 0;
     virtual String dump_routes();
+    virtual String dump_routes_chunk(uint32_t& pos, uint32_t max);
+    virtual void lookup_routes(const IPAddress *dst, int n, int *ports, IPAddress *gws) const;
+    virtual size_t memory_usage() const;
 
     void push(int port, Packet* p);
 
+    static void sort_routes(Vector<IPRoute>& routes);
+    int parse_route_file(const String& data, Vector<IPRoute>& routes, ErrorHandler* errh);
+    static String unparse_route_file(const Vector<IPRoute>& routes);
+#if CLICK_USERLEVEL
+    int load_routes(const String& filename, ErrorHandler* errh);
+#endif
+
     static int add_route_handler(const String&, Element*, void*, ErrorHandler*);
     static int remove_route_handler(const String&, Element*, void*, ErrorHandler*);
     static int ctrl_handler(const String&, Element*, void*, ErrorHandler*);
     static int lookup_handler(int operation, String&, Element*, const Handler*, ErrorHandler*);
     static String table_handler(Element*, void*);
+    static int table_chunk_handler(int operation, String&, Element*, const Handler*, ErrorHandler*);
+    static String load_info_handler(Element*, void*);
+#if CLICK_USERLEVEL
+    static int load_handler(const String&, Element*, void*, ErrorHandler*);
+    static int save_handler(const String&, Element*, void*, ErrorHandler*);
+#endif
 
   private:
 
     enum { CMD_ADD, CMD_SET, CMD_REMOVE };
     int run_command(int command, const String &, Vector<IPRoute>* old_routes, ErrorHandler*);
 
+    int _load_nroutes;
+    Timestamp _load_time;
+
 };
 
 inline StringAccum&
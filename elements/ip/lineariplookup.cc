@@ -210,6 +210,20 @@ LinearIPLookup::dump_routes()
     return sa.take_string();
 }
 
+String
+LinearIPLookup::dump_routes_chunk(uint32_t &pos, uint32_t max)
+{
+    StringAccum sa;
+    uint32_t i = pos, n = 0;
+    for (; i < (uint32_t) _t.size() && n < max; i++)
+	if (_t[i].real()) {
+	    _t[i].unparse(sa, true) << '\n';
+	    ++n;
+	}
+    pos = (i < (uint32_t) _t.size() ? i : 0);
+    return sa.take_string();
+}
+
 void
 LinearIPLookup::push(int, Packet *p)
 {
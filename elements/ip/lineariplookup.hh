@@ -48,11 +48,13 @@ local interface, and all others via gateway 18.26.4.1:
 
 =h table read-only
 
-Outputs a human-readable version of the current routing table.
+Outputs a human-readable version of the current routing table.  Large tables
+can be read in chunks; see IPRouteTable's B<dump_routes_chunk>.
 
 =h lookup read-only
 
-Reports the OUTput port and GW corresponding to an address.
+Reports the OUTput port and GW corresponding to an address.  Given several
+space-separated addresses, reports one `C<ADDR OUT [GW]>' line per address.
 
 =h add write-only
 
@@ -96,6 +98,7 @@ class LinearIPLookup : public IPRouteTable { public:
     int remove_route(const IPRoute&, IPRoute*, ErrorHandler *);
     int lookup_route(IPAddress, IPAddress&) const;
     String dump_routes();
+    String dump_routes_chunk(uint32_t &pos, uint32_t max);
 
     bool check() const;
 
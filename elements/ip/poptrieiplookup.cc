@@ -0,0 +1,790 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * poptrieiplookup.{cc,hh} -- IP lookup using a population-count compressed
+ * multiway trie
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, subject to the conditions listed in the Click LICENSE
+ * file. These conditions include: you must preserve this copyright
+ * notice, and you cannot mention the copyright holders in advertising
+ * related to the Software without their permission.  The Software is
+ * provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This notice is a
+ * summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "poptrieiplookup.hh"
+#include <click/ipaddress.hh>
+#include <click/straccum.hh>
+#include <click/router.hh>
+#include <click/error.hh>
+#include <click/master.hh>
+CLICK_DECLS
+
+// The lookup structure follows Asai and Ohara, "Poptrie: A Compressed Trie
+// with Population Count for Fast and Scalable Software IP Routing Table
+// Lookup" (SIGCOMM 2015).  Trie::direct is indexed by the top 18 address
+// bits.  An entry with the LEAF bit set holds a next hop index; otherwise it
+// is the index of a Node in Trie::nodes.  Each Node covers the next 6
+// address bits.  Its internal children are stored consecutively starting at
+// nodes[base1], and its leaves, with runs of equal leaves collapsed,
+// consecutively starting at leaves[base0]; population counts of the two
+// bitmaps locate the child.
+//
+// Routes live in _routes and in _rib, a plain binary trie.  An update
+// changes _rib, builds new subtrees for the direct entries the route covers
+// in _new_nodes and _new_leaves, then commit() appends them to the arrays
+// and stores the direct entries.  Lookups on other threads thus see either
+// an entry's old subtree or its new one.  The old subtrees become garbage,
+// which rebuild_all() reclaims once it gets large by building a new Trie.
+// A Trie replaced while lookups may be using it is retired, and freed once
+// every thread has been quiescent (see RouterThread::quiescent_epoch()).
+
+static inline int
+popcount64(uint64_t x)
+{
+#if __GNUC__ >= 4
+    return __builtin_popcountll(x);
+#else
+    x = x - ((x >> 1) & 0x5555555555555555ULL);
+    x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+    x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return (x * 0x0101010101010101ULL) >> 56;
+#endif
+}
+
+static inline uint64_t
+prefix_bits(int v)
+{
+    // bits 0 through v, inclusive
+    return (2ULL << v) - 1;
+}
+
+PoptrieIPLookup::PoptrieIPLookup()
+    : _trie(0), _nh(0), _nh_size(0), _nh_capacity(0), _rib_free(-1),
+      _garbage_nodes(0), _garbage_leaves(0), _ngrace(0), _reclaim_timer(this),
+      _nodes_base(0), _leaves_base(0)
+{
+}
+
+PoptrieIPLookup::~PoptrieIPLookup()
+{
+    for (Retired *it = _retiring.begin(); it != _retiring.end(); ++it)
+	free_retired(*it);
+    for (Retired *it = _retired.begin(); it != _retired.end(); ++it)
+	free_retired(*it);
+    free_trie(_trie);
+    delete[] _nh;
+}
+
+int
+PoptrieIPLookup::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    if (!(_trie = alloc_trie(64, 64)) || !(_nh = new NextHop[16]))
+	return errh->error("out of memory");
+    for (int i = 0; i < (1 << DIRECT_BITS); ++i)
+	_trie->direct[i] = LEAF;
+
+    // next hop 0 means "no route"
+    _nh[0].port = -1;
+    _nh_size = 1;
+    _nh_capacity = 16;
+    _nh_refs.push_back(1);
+    // _rib[0] is the root and is never freed
+    (void) rib_alloc();
+
+    return IPRouteTable::configure(conf, errh);
+}
+
+int
+PoptrieIPLookup::initialize(ErrorHandler *)
+{
+    _reclaim_timer.initialize(this);
+    if (_retired.size())
+	_reclaim_timer.schedule_after_msec(RECLAIM_INTERVAL);
+    return 0;
+}
+
+void
+PoptrieIPLookup::take_state(Element *e, ErrorHandler *)
+{
+    if (e == router()->hotswap_unchanged_element(this)) {
+	PoptrieIPLookup *o = static_cast<PoptrieIPLookup *>(e);
+	Trie *t = _trie;
+	_trie = o->_trie;
+	o->_trie = t;
+	NextHop *nh = _nh;
+	_nh = o->_nh;
+	o->_nh = nh;
+	click_swap(_nh_size, o->_nh_size);
+	click_swap(_nh_capacity, o->_nh_capacity);
+	_nh_refs.swap(o->_nh_refs);
+	_nh_free.swap(o->_nh_free);
+	_nh_index.swap(o->_nh_index);
+	_rib.swap(o->_rib);
+	click_swap(_rib_free, o->_rib_free);
+	_routes.swap(o->_routes);
+	click_swap(_garbage_nodes, o->_garbage_nodes);
+	click_swap(_garbage_leaves, o->_garbage_leaves);
+	_retired.swap(o->_retired);
+	click_swap(_ngrace, o->_ngrace);
+	_grace.swap(o->_grace);
+	if (_retired.size())
+	    _reclaim_timer.schedule_now();
+    }
+}
+
+inline uint16_t
+PoptrieIPLookup::lookup_nexthop(const Trie *t, uint32_t addr)
+{
+    uint32_t e = t->direct[addr >> (32 - DIRECT_BITS)];
+    if (e & LEAF)
+	return e;
+
+    const Node *n = &t->nodes[e];
+    int offset = DIRECT_BITS;
+    int v = extract(addr, offset);
+    while (n->vector & (1ULL << v)) {
+	n = &t->nodes[n->base1 + popcount64(n->vector & prefix_bits(v)) - 1];
+	offset += STRIDE;
+	v = extract(addr, offset);
+    }
+    return t->leaves[n->base0 + popcount64(n->leafvec & prefix_bits(v)) - 1];
+}
+
+int
+PoptrieIPLookup::lookup_route(IPAddress addr, IPAddress &gw) const
+{
+    uint16_t nhi = lookup_nexthop(_trie, ntohl(addr.addr()));
+    // _nh is grown before any entry refers to the new next hops
+    click_read_fence();
+    const NextHop &nh = _nh[nhi];
+    gw = nh.gw;
+    return nh.port;
+}
+
+void
+PoptrieIPLookup::lookup_routes(const IPAddress *dst, int n, int *ports, IPAddress *gws) const
+{
+    // Prefetch the direct entries for a group of addresses, then the first
+    // trie node of each, before walking any of them.
+    enum { GROUP = 16 };
+    const Trie *t = _trie;
+    uint32_t addr[GROUP], e[GROUP];
+    for (int base = 0; base < n; base += GROUP) {
+	int m = (n - base < GROUP ? n - base : GROUP);
+	for (int k = 0; k < m; ++k) {
+	    addr[k] = ntohl(dst[base + k].addr());
+	    CLICK_PREFETCH(&t->direct[addr[k] >> (32 - DIRECT_BITS)]);
+	}
+	for (int k = 0; k < m; ++k) {
+	    e[k] = t->direct[addr[k] >> (32 - DIRECT_BITS)];
+	    if (!(e[k] & LEAF))
+		CLICK_PREFETCH(&t->nodes[e[k]]);
+	}
+	for (int k = 0; k < m; ++k)
+	    if (!(e[k] & LEAF))
+		e[k] = lookup_nexthop(t, addr[k]);
+	click_read_fence();
+	const NextHop *nh = _nh;
+	for (int k = 0; k < m; ++k) {
+	    uint16_t nhi = e[k];
+	    ports[base + k] = nh[nhi].port;
+	    gws[base + k] = nh[nhi].gw;
+	}
+    }
+}
+
+void
+PoptrieIPLookup::push(int, Packet *p)
+{
+    IPAddress gw;
+    int port = lookup_route(p->dst_ip_anno(), gw);
+
+    if (port >= 0) {
+	if (gw)
+	    p->set_dst_ip_anno(gw);
+	output(port).push(p);
+    } else
+	p->kill();
+}
+
+
+PoptrieIPLookup::Trie *
+PoptrieIPLookup::alloc_trie(uint32_t nodes_capacity, uint32_t leaves_capacity)
+{
+    Trie *t = new Trie;
+    if (!t)
+	return 0;
+    t->direct = (uint32_t *) CLICK_LALLOC(sizeof(uint32_t) << DIRECT_BITS);
+    t->nodes = (Node *) CLICK_LALLOC(sizeof(Node) * nodes_capacity);
+    t->leaves = (uint16_t *) CLICK_LALLOC(sizeof(uint16_t) * leaves_capacity);
+    t->nnodes = t->nleaves = 0;
+    t->nodes_capacity = nodes_capacity;
+    t->leaves_capacity = leaves_capacity;
+    if (!t->direct || !t->nodes || !t->leaves) {
+	free_trie(t);
+	return 0;
+    }
+    return t;
+}
+
+void
+PoptrieIPLookup::free_trie(Trie *t)
+{
+    if (t) {
+	if (t->direct)
+	    CLICK_LFREE(t->direct, sizeof(uint32_t) << DIRECT_BITS);
+	if (t->nodes)
+	    CLICK_LFREE(t->nodes, sizeof(Node) * t->nodes_capacity);
+	if (t->leaves)
+	    CLICK_LFREE(t->leaves, sizeof(uint16_t) * t->leaves_capacity);
+	delete t;
+    }
+}
+
+bool
+PoptrieIPLookup::grow_nexthops()
+{
+    NextHop *nh = new NextHop[_nh_capacity * 2];
+    if (!nh)
+	return false;
+    for (uint32_t i = 0; i < _nh_size; ++i)
+	nh[i] = _nh[i];
+    retire(0, _nh, 0);
+    click_write_fence();
+    _nh = nh;
+    _nh_capacity *= 2;
+    return true;
+}
+
+void
+PoptrieIPLookup::retire(Trie *t, NextHop *nh, int nhi)
+{
+    _retiring.push_back(Retired());
+    Retired &r = _retiring.back();
+    r.trie = t;
+    r.nh = nh;
+    r.nhi = nhi;
+}
+
+inline void
+PoptrieIPLookup::free_retired(const Retired &r)
+{
+    free_trie(r.trie);
+    delete[] r.nh;
+}
+
+bool
+PoptrieIPLookup::grace_passed() const
+{
+    for (int i = 0; i < _grace.size(); ++i)
+	if (!RouterThread::quiescent_since(_grace[i], master()->thread(i)->quiescent_epoch()))
+	    return false;
+    return true;
+}
+
+void
+PoptrieIPLookup::reclaim(bool update)
+{
+    // A lookup that can see retired memory loaded _trie or _nh before the
+    // update that retired it ended.  Once every thread has been quiescent
+    // since a snapshot taken after that, no such lookup is still running.
+    _retired_lock.acquire();
+    if (update) {
+	for (Retired *it = _retiring.begin(); it != _retiring.end(); ++it)
+	    _retired.push_back(*it);
+	_retiring.clear();
+    }
+    if (_ngrace && grace_passed()) {
+	for (int i = 0; i < _ngrace; ++i) {
+	    free_retired(_retired[i]);
+	    if (_retired[i].nhi)
+		_nh_free.push_back(_retired[i].nhi);
+	}
+	_retired.erase(_retired.begin(), _retired.begin() + _ngrace);
+	_ngrace = 0;
+    }
+    if (!_ngrace && _retired.size()) {
+	_grace.resize(master()->nthreads());
+	click_fence();
+	for (int i = 0; i < _grace.size(); ++i)
+	    _grace[i] = master()->thread(i)->quiescent_epoch();
+	_ngrace = _retired.size();
+    }
+    bool more = _retired.size();
+    _retired_lock.release();
+
+    // routes loaded by configure() wait for initialize()
+    if (more && _reclaim_timer.initialized() && !_reclaim_timer.scheduled())
+	_reclaim_timer.schedule_after_msec(RECLAIM_INTERVAL);
+}
+
+void
+PoptrieIPLookup::run_timer(Timer *)
+{
+    reclaim(false);
+}
+
+int
+PoptrieIPLookup::nexthop_ref(IPAddress gw, int32_t port, ErrorHandler *errh)
+{
+    uint64_t key = nexthop_key(gw, port);
+    HashTable<uint64_t, int>::iterator it = _nh_index.find(key);
+    if (it) {
+	++_nh_refs[it.value()];
+	return it.value();
+    }
+
+    // _reclaim_timer adds to _nh_free
+    int nh = 0;
+    _retired_lock.acquire();
+    if (_nh_free.size()) {
+	nh = _nh_free.back();
+	_nh_free.pop_back();
+    }
+    _retired_lock.release();
+    if (!nh) {
+	if (_nh_size > MAX_NEXTHOPS)
+	    return errh->error("too many distinct next hops");
+	else if (_nh_size == _nh_capacity && !grow_nexthops())
+	    return errh->error("out of memory");
+	nh = _nh_size++;
+	_nh_refs.push_back(0);
+    }
+    _nh[nh].gw = gw;
+    _nh[nh].port = port;
+    _nh_refs[nh] = 1;
+    _nh_index.set(key, nh);
+    return nh;
+}
+
+void
+PoptrieIPLookup::nexthop_unref(int nh)
+{
+    // Lookups may still return nh until the entries that refer to it are
+    // rebuilt, so it is not reused at once.
+    if (nh && --_nh_refs[nh] == 0) {
+	_nh_index.erase(nexthop_key(_nh[nh].gw, _nh[nh].port));
+	retire(0, 0, nh);
+    }
+}
+
+int
+PoptrieIPLookup::rib_alloc()
+{
+    int rn;
+    if (_rib_free >= 0) {
+	rn = _rib_free;
+	_rib_free = _rib[rn].child[0];
+    } else {
+	rn = _rib.size();
+	_rib.push_back(RibNode());
+    }
+    _rib[rn].child[0] = _rib[rn].child[1] = _rib[rn].route = -1;
+    return rn;
+}
+
+int
+PoptrieIPLookup::rib_find(uint32_t prefix, int plen, bool create, int *path)
+{
+    int rn = 0;
+    path[0] = 0;
+    for (int d = 0; d < plen; ++d) {
+	int b = (prefix >> (31 - d)) & 1;
+	int c = _rib[rn].child[b];
+	if (c < 0) {
+	    if (!create)
+		return -1;
+	    c = rib_alloc();
+	    _rib[rn].child[b] = c;
+	}
+	rn = c;
+	path[d + 1] = rn;
+    }
+    return rn;
+}
+
+void
+PoptrieIPLookup::rib_prune(int *path, int plen)
+{
+    for (int d = plen; d > 0; --d) {
+	int rn = path[d];
+	RibNode &r = _rib[rn];
+	if (r.route >= 0 || r.child[0] >= 0 || r.child[1] >= 0)
+	    break;
+	RibNode &parent = _rib[path[d - 1]];
+	parent.child[parent.child[1] == rn] = -1;
+	r.child[0] = _rib_free;
+	_rib_free = rn;
+    }
+}
+
+inline uint16_t
+PoptrieIPLookup::rib_nexthop(int rn) const
+{
+    return _routes[_rib[rn].route].extra;
+}
+
+int
+PoptrieIPLookup::set_route(const IPRoute &route, bool allow_replace,
+			   IPRoute *old_route, ErrorHandler *errh)
+{
+    uint32_t prefix = ntohl(route.addr.addr()) & ntohl(route.mask.addr());
+    int plen = route.prefix_len();
+    if (plen < 0)
+	return errh->error("bad route mask");
+
+    int path[33];
+    int rn = rib_find(prefix, plen, true, path);
+    int nh = nexthop_ref(route.gw, route.port, errh);
+    if (nh < 0) {
+	rib_prune(path, plen);
+	return nh;
+    }
+
+    if (_rib[rn].route >= 0) {
+	IPRoute &r = _routes[_rib[rn].route];
+	if (old_route)
+	    *old_route = r;
+	if (!allow_replace) {
+	    nexthop_unref(nh);
+	    return -EEXIST;
+	}
+	nexthop_unref(r.extra);
+	r = route;
+	r.extra = nh;
+    } else {
+	_rib[rn].route = _routes.size();
+	_routes.push_back(route);
+	_routes.back().extra = nh;
+    }
+    return 0;
+}
+
+int
+PoptrieIPLookup::add_route(const IPRoute &route, bool allow_replace,
+			   IPRoute *old_route, ErrorHandler *errh)
+{
+    int r = set_route(route, allow_replace, old_route, errh);
+    if (r >= 0)
+	r = rebuild(ntohl(route.addr.addr()), route.prefix_len());
+    return r;
+}
+
+int
+PoptrieIPLookup::add_routes(Vector<IPRoute> &routes, ErrorHandler *errh)
+{
+    sort_routes(routes);
+    int r = 0;
+    for (IPRoute *it = routes.begin(); it != routes.end() && r >= 0; ++it)
+	r = set_route(*it, true, 0, errh);
+    int rr = rebuild_all();
+    return (r < 0 ? r : rr);
+}
+
+int
+PoptrieIPLookup::remove_route(const IPRoute &route, IPRoute *old_route,
+			      ErrorHandler *)
+{
+    uint32_t prefix = ntohl(route.addr.addr()) & ntohl(route.mask.addr());
+    int plen = route.prefix_len();
+    int path[33];
+    int rn = (plen >= 0 ? rib_find(prefix, plen, false, path) : -1);
+    if (rn < 0 || _rib[rn].route < 0)
+	return -ENOENT;
+
+    int ri = _rib[rn].route;
+    if (!route.match(_routes[ri]))
+	return -ENOENT;
+    if (old_route)
+	*old_route = _routes[ri];
+    nexthop_unref(_routes[ri].extra);
+    _rib[rn].route = -1;
+
+    // keep _routes dense by moving the last route into the hole
+    if (ri != _routes.size() - 1) {
+	_routes[ri] = _routes.back();
+	int mpath[33];
+	int mrn = rib_find(ntohl(_routes[ri].addr.addr()) & ntohl(_routes[ri].mask.addr()),
+			   _routes[ri].prefix_len(), false, mpath);
+	_rib[mrn].route = ri;
+    }
+    _routes.pop_back();
+
+    rib_prune(path, plen);
+    return rebuild(prefix, plen);
+}
+
+
+void
+PoptrieIPLookup::release_slot(uint32_t slot)
+{
+    uint32_t e = _trie->direct[slot];
+    if (!(e & LEAF))
+	count_subtree(e, _garbage_nodes, _garbage_leaves);
+}
+
+void
+PoptrieIPLookup::count_subtree(uint32_t ni, uint32_t &nnodes, uint32_t &nleaves) const
+{
+    const Node &n = _trie->nodes[ni];
+    ++nnodes;
+    nleaves += popcount64(n.leafvec);
+    for (int i = popcount64(n.vector) - 1; i >= 0; --i)
+	count_subtree(n.base1 + i, nnodes, nleaves);
+}
+
+void
+PoptrieIPLookup::build_node(uint32_t ni, int rn, int depth, uint16_t nh)
+{
+    // The last level covers fewer than STRIDE address bits; its children
+    // are spread over all the slots so lookups can still extract STRIDE bits.
+    int k = (32 - depth < STRIDE ? 32 - depth : STRIDE);
+    int span = 1 << (STRIDE - k);
+    uint16_t leaf[1 << STRIDE], child_nh[1 << STRIDE];
+    int child_rn[1 << STRIDE];
+    uint64_t vector = 0;
+
+    for (int v = 0; v < (1 << k); ++v) {
+	int c = rn;
+	uint16_t h = nh;
+	for (int j = k - 1; j >= 0 && c >= 0; --j) {
+	    c = _rib[c].child[(v >> j) & 1];
+	    if (c >= 0 && _rib[c].route >= 0)
+		h = rib_nexthop(c);
+	}
+	int p = v * span;
+	if (c >= 0 && depth + k < 32
+	    && (_rib[c].child[0] >= 0 || _rib[c].child[1] >= 0)) {
+	    vector |= 1ULL << p;
+	    child_rn[p] = c;
+	    child_nh[p] = h;
+	} else
+	    for (int q = 0; q < span; ++q)
+		leaf[p + q] = h;
+    }
+
+    uint32_t base1 = _nodes_base + _new_nodes.size();
+    _new_nodes.resize(_new_nodes.size() + popcount64(vector));
+    uint32_t base0 = _leaves_base + _new_leaves.size();
+    uint64_t leafvec = 0;
+    int nleaves = 0;
+    for (int p = 0; p < (1 << STRIDE); ++p)
+	if (!(vector & (1ULL << p))
+	    && (nleaves == 0 || leaf[p] != _new_leaves.back())) {
+	    leafvec |= 1ULL << p;
+	    _new_leaves.push_back(leaf[p]);
+	    ++nleaves;
+	}
+
+    Node &n = _new_nodes[ni - _nodes_base];
+    n.vector = vector;
+    n.leafvec = leafvec;
+    n.base0 = base0;
+    n.base1 = base1;
+
+    for (int p = 0; p < (1 << STRIDE); ++p)
+	if (vector & (1ULL << p))
+	    build_node(base1 + popcount64(vector & prefix_bits(p)) - 1,
+		       child_rn[p], depth + k, child_nh[p]);
+}
+
+void
+PoptrieIPLookup::build_slot(uint32_t slot, int rn, uint16_t nh)
+{
+    release_slot(slot);
+    _new_direct.push_back(slot);
+    if (rn < 0 || (_rib[rn].child[0] < 0 && _rib[rn].child[1] < 0))
+	_new_direct.push_back(LEAF | nh);
+    else {
+	uint32_t ni = _nodes_base + _new_nodes.size();
+	_new_nodes.push_back(Node());
+	build_node(ni, rn, DIRECT_BITS, nh);
+	_new_direct.push_back(ni);
+    }
+}
+
+void
+PoptrieIPLookup::rebuild_slots(int rn, int depth, uint32_t prefix, uint16_t nh)
+{
+    if (rn >= 0 && _rib[rn].route >= 0)
+	nh = rib_nexthop(rn);
+    if (depth == DIRECT_BITS)
+	build_slot(prefix >> (32 - DIRECT_BITS), rn, nh);
+    else if (rn < 0) {
+	uint32_t slot = prefix >> (32 - DIRECT_BITS);
+	uint32_t end = slot + (1U << (DIRECT_BITS - depth));
+	for (; slot != end; ++slot) {
+	    release_slot(slot);
+	    _new_direct.push_back(slot);
+	    _new_direct.push_back(LEAF | nh);
+	}
+    } else
+	for (int b = 0; b < 2; ++b)
+	    rebuild_slots(_rib[rn].child[b], depth + 1,
+			  prefix | ((uint32_t) b << (31 - depth)), nh);
+}
+
+int
+PoptrieIPLookup::commit(bool fresh)
+{
+    // Append the new nodes and leaves, in a new Trie if they do not fit (or
+    // if we are replacing everything), then point direct entries at them.
+    Trie *t = _trie, *nt = t;
+    uint32_t nnodes = _nodes_base + _new_nodes.size();
+    uint32_t nleaves = _leaves_base + _new_leaves.size();
+    if (fresh || nnodes > t->nodes_capacity || nleaves > t->leaves_capacity) {
+	nt = alloc_trie(nnodes + nnodes / 2 + 64, nleaves + nleaves / 2 + 64);
+	if (!nt) {
+	    _new_nodes.clear();
+	    _new_leaves.clear();
+	    _new_direct.clear();
+	    return -ENOMEM;
+	}
+	if (fresh)
+	    for (int i = 0; i < (1 << DIRECT_BITS); ++i)
+		nt->direct[i] = LEAF;
+	else {
+	    memcpy(nt->direct, t->direct, sizeof(uint32_t) << DIRECT_BITS);
+	    memcpy(nt->nodes, t->nodes, sizeof(Node) * t->nnodes);
+	    memcpy(nt->leaves, t->leaves, sizeof(uint16_t) * t->nleaves);
+	}
+    }
+
+    if (_new_nodes.size())
+	memcpy(nt->nodes + _nodes_base, _new_nodes.begin(), sizeof(Node) * _new_nodes.size());
+    if (_new_leaves.size())
+	memcpy(nt->leaves + _leaves_base, _new_leaves.begin(), sizeof(uint16_t) * _new_leaves.size());
+    nt->nnodes = nnodes;
+    nt->nleaves = nleaves;
+    click_write_fence();
+    for (uint32_t *it = _new_direct.begin(); it != _new_direct.end(); it += 2)
+	nt->direct[it[0]] = it[1];
+
+    if (nt != t) {
+	click_write_fence();
+	_trie = nt;
+	retire(t, 0, 0);
+    }
+    if (fresh) {
+	Vector<Node>().swap(_new_nodes);
+	Vector<uint16_t>().swap(_new_leaves);
+	Vector<uint32_t>().swap(_new_direct);
+    } else {
+	_new_nodes.clear();
+	_new_leaves.clear();
+	_new_direct.clear();
+    }
+    return 0;
+}
+
+int
+PoptrieIPLookup::rebuild(uint32_t prefix, int plen)
+{
+    // Find the _rib node covering the affected direct entries, and the
+    // next hop it inherits from shorter routes.
+    int depth = (plen < DIRECT_BITS ? plen : DIRECT_BITS);
+    prefix &= ntohl(IPAddress::make_prefix(depth).addr());
+    int rn = 0;
+    uint16_t nh = 0;
+    for (int d = 0; d < depth && rn >= 0; ++d) {
+	if (_rib[rn].route >= 0)
+	    nh = rib_nexthop(rn);
+	rn = _rib[rn].child[(prefix >> (31 - d)) & 1];
+    }
+    _nodes_base = _trie->nnodes;
+    _leaves_base = _trie->nleaves;
+    rebuild_slots(rn, depth, prefix, nh);
+    int r = commit(false);
+
+    const Trie *t = _trie;
+    if (r >= 0 && ((_garbage_nodes > 4096 && _garbage_nodes > t->nnodes / 2)
+		   || (_garbage_leaves > 4096 && _garbage_leaves > t->nleaves / 2)))
+	return rebuild_all();
+    reclaim(true);
+    return r;
+}
+
+int
+PoptrieIPLookup::rebuild_all()
+{
+    _nodes_base = _leaves_base = 0;
+    rebuild_slots(0, 0, 0, 0);
+    int r = commit(true);
+    if (r >= 0)
+	_garbage_nodes = _garbage_leaves = 0;
+    reclaim(true);
+    return r;
+}
+
+
+String
+PoptrieIPLookup::dump_routes()
+{
+    StringAccum sa;
+    for (IPRoute *it = _routes.begin(); it != _routes.end(); ++it)
+	it->unparse(sa, true) << '\n';
+    return sa.take_string();
+}
+
+String
+PoptrieIPLookup::dump_routes_chunk(uint32_t &pos, uint32_t max)
+{
+    StringAccum sa;
+    uint32_t i = pos;
+    for (; i < (uint32_t) _routes.size() && i - pos < max; ++i)
+	_routes[i].unparse(sa, true) << '\n';
+    pos = (i < (uint32_t) _routes.size() ? i : 0);
+    return sa.take_string();
+}
+
+size_t
+PoptrieIPLookup::lookup_memory_usage() const
+{
+    const Trie *t = _trie;
+    return (sizeof(uint32_t) << DIRECT_BITS)
+	+ t->nodes_capacity * sizeof(Node)
+	+ t->leaves_capacity * sizeof(uint16_t)
+	+ _nh_capacity * sizeof(NextHop);
+}
+
+size_t
+PoptrieIPLookup::memory_usage() const
+{
+    return lookup_memory_usage()
+	+ _rib.size() * sizeof(RibNode)
+	+ _routes.size() * sizeof(IPRoute)
+	+ _nh_refs.size() * sizeof(int);
+}
+
+String
+PoptrieIPLookup::stats_handler(Element *e, void *)
+{
+    PoptrieIPLookup *pl = static_cast<PoptrieIPLookup *>(e);
+    const Trie *t = pl->_trie;
+    StringAccum sa;
+    sa << "routes " << pl->_routes.size() << '\n'
+       << "nexthops " << pl->_nh_index.size() << '\n'
+       << "nodes " << (t->nnodes - pl->_garbage_nodes) << '\n'
+       << "leaves " << (t->nleaves - pl->_garbage_leaves) << '\n'
+       << "lookup_memory " << pl->lookup_memory_usage() << '\n';
+    pl->_retired_lock.acquire();
+    sa << "retired " << pl->_retired.size() << '\n';
+    pl->_retired_lock.release();
+    return sa.take_string();
+}
+
+void
+PoptrieIPLookup::add_handlers()
+{
+    IPRouteTable::add_handlers();
+    add_read_handler("stats", stats_handler, 0);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(IPRouteTable)
+EXPORT_ELEMENT(PoptrieIPLookup)
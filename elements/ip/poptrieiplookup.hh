@@ -0,0 +1,264 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_POPTRIEIPLOOKUP_HH
+#define CLICK_POPTRIEIPLOOKUP_HH
+#include <click/glue.hh>
+#include <click/element.hh>
+#include <click/vector.hh>
+#include <click/hashtable.hh>
+#include <click/timer.hh>
+#include <click/sync.hh>
+#include "iproutetable.hh"
+CLICK_DECLS
+
+/*
+=c
+
+PoptrieIPLookup(ADDR1/MASK1 [GW1] OUT1, ADDR2/MASK2 [GW2] OUT2, ...)
+
+=s iproute
+
+IP lookup using a compressed multiway trie (poptrie)
+
+=d
+
+Performs IP lookup using a poptrie, a multiway trie compressed with
+population counts.  The first 18 address bits index a direct-pointing array
+of 262144 entries; longer prefixes are resolved by at most three trie nodes,
+which consume 6, 6, and 2 address bits.  Every trie node holds two 64-bit bitmaps,
+one marking which of its 64 children are internal nodes and one marking
+where runs of identical leaves start, so children and leaves are stored
+densely and located with a population count.  A lookup thus touches at most
+five small memory locations, and the lookup structure for a full BGP table
+fits in a few megabytes.
+
+Expects a destination IP address annotation with each packet. Looks up that
+address in its routing table, using longest-prefix-match, sets the destination
+annotation to the corresponding GW (if specified), and emits the packet on the
+indicated OUTput port.
+
+Each argument is a route, specifying a destination and mask, an optional
+gateway IP address, and an output port.  At most 65535 distinct GW/OUTput
+pairs are supported.
+
+Routes are kept in a binary trie used only at update time.  Adding or
+removing a route rebuilds the lookup structure only for the /18 address
+blocks the route covers; space freed by these partial rebuilds is reclaimed
+by an occasional full rebuild.  Bulk loads with `C<LOAD>' or the `C<load>'
+handler rebuild the lookup structure once.
+
+Lookups take no locks and may run on other threads while routes change.  An
+update writes new trie nodes beside the ones in use, then switches
+direct-pointing entries to them one at a time; when the node arrays are
+full, or on a full rebuild, it builds a new lookup structure and switches to
+it with a single pointer store.  Replaced memory is freed by a timer once
+every router thread has finished the driver pass it was running, or has
+blocked, since the replacement; no lookup can still be using it then.
+
+Uses the IPRouteTable interface; see IPRouteTable for description.
+
+=h table read-only
+
+Outputs a human-readable version of the current routing table.  Large tables
+can be read in chunks; see IPRouteTable's B<dump_routes_chunk>.
+
+=h lookup read-only
+
+Reports the OUTput port and GW corresponding to an address.  Given several
+space-separated addresses, reports one `C<ADDR OUT [GW]>' line per address.
+
+=h add write-only
+
+Adds a route to the table. Format should be `C<ADDR/MASK [GW] OUT>'.
+Fails if a route for C<ADDR/MASK> already exists.
+
+=h set write-only
+
+Sets a route, whether or not a route for the same prefix already exists.
+
+=h remove write-only
+
+Removes a route from the table. Format should be `C<ADDR/MASK>'.
+
+=h ctrl write-only
+
+Adds or removes a group of routes. Write `C<add>/C<set ADDR/MASK [GW] OUT>' to
+add a route, and `C<remove ADDR/MASK>' to remove a route. You can supply
+multiple commands, one per line; all commands are executed as one atomic
+operation.
+
+=h load write-only
+
+Loads routes from a text or binary route file, setting each route whether
+or not a route for the same prefix already exists. See IPRouteTable for the
+file formats.
+
+=h save write-only
+
+Writes the current routing table to a file in binary route file format.
+
+=h load_info read-only
+
+Reports the number of routes read by the most recent load, the time taken
+to parse and insert them, and the approximate memory used by the table.
+
+=h stats read-only
+
+Reports the number of routes, distinct next hops, trie nodes, and leaves,
+the bytes used by the lookup structure alone (excluding the update-time
+route trie), and the number of replaced structures and next hops not yet
+freed.
+
+=n
+
+See IPRouteTable for a performance comparison of the various IP routing
+elements, and IPLookupBenchmark for comparing them on your own routes.
+
+=a IPRouteTable, DirectIPLookup, RadixIPLookup, RangeIPLookup,
+IPLookupBenchmark */
+
+class PoptrieIPLookup : public IPRouteTable { public:
+
+    PoptrieIPLookup();
+    ~PoptrieIPLookup();
+
+    const char *class_name() const		{ return "PoptrieIPLookup"; }
+    const char *port_count() const		{ return "1/-"; }
+    const char *processing() const		{ return PUSH; }
+
+    int configure(Vector<String> &conf, ErrorHandler *errh);
+    int initialize(ErrorHandler *errh);
+    void take_state(Element *, ErrorHandler *);
+    void add_handlers();
+
+    void push(int port, Packet *p);
+    void run_timer(Timer *);
+
+    int add_route(const IPRoute&, bool, IPRoute*, ErrorHandler *);
+    int add_routes(Vector<IPRoute>&, ErrorHandler *);
+    int remove_route(const IPRoute&, IPRoute*, ErrorHandler *);
+    int lookup_route(IPAddress, IPAddress&) const;
+    void lookup_routes(const IPAddress *, int, int *, IPAddress *) const;
+    String dump_routes();
+    String dump_routes_chunk(uint32_t &pos, uint32_t max);
+    size_t memory_usage() const;
+
+  private:
+
+    enum {
+	DIRECT_BITS = 18,
+	STRIDE = 6,
+	MAX_NEXTHOPS = 0xFFFF
+    };
+    enum { LEAF = 0x80000000U };	// direct entry holds a next hop
+    enum { RECLAIM_INTERVAL = 10 };	// msec between quiescence checks
+
+    struct Node {
+	uint64_t vector;	// bit v set: child v is an internal node
+	uint64_t leafvec;	// bit v set: a leaf run starts at child v
+	uint32_t base0;		// index of first leaf in leaves
+	uint32_t base1;		// index of first internal child in nodes
+    };
+
+    struct NextHop {
+	IPAddress gw;
+	int32_t port;
+    };
+
+    struct RibNode {
+	int child[2];
+	int route;		// index into _routes, or -1
+    };
+
+    // The lookup structure.  Lookups load _trie once; nodes and leaves
+    // below nnodes and nleaves never change while the Trie is published.
+    struct Trie {
+	uint32_t *direct;
+	Node *nodes;
+	uint16_t *leaves;
+	uint32_t nnodes;
+	uint32_t nodes_capacity;
+	uint32_t nleaves;
+	uint32_t leaves_capacity;
+    };
+
+    // A replaced Trie or next hop array, or a freed next hop index, kept
+    // until lookups that might use it have finished.
+    struct Retired {
+	Trie *trie;
+	NextHop *nh;
+	int nhi;
+    };
+
+    Trie * volatile _trie;
+    NextHop * volatile _nh;
+    uint32_t _nh_size;
+    uint32_t _nh_capacity;
+
+    // update-time structures
+    Vector<int> _nh_refs;
+    Vector<int> _nh_free;
+    HashTable<uint64_t, int> _nh_index;
+    Vector<RibNode> _rib;
+    int _rib_free;
+    Vector<IPRoute> _routes;	// route.extra holds the next hop index
+    uint32_t _garbage_nodes;
+    uint32_t _garbage_leaves;
+    Vector<Retired> _retiring;	// retired by the update in progress
+
+    // Memory retired by finished updates.  _retired[0, _ngrace) was
+    // retired before _grace, the threads' quiescent epochs, was taken.
+    // Updates and _reclaim_timer share these under _retired_lock.
+    Vector<Retired> _retired;
+    int _ngrace;
+    Vector<uint32_t> _grace;
+    Spinlock _retired_lock;
+    Timer _reclaim_timer;
+
+    // the update being built: nodes and leaves to append at _nodes_base and
+    // _leaves_base, and (slot, entry) pairs to store in direct
+    Vector<Node> _new_nodes;
+    Vector<uint16_t> _new_leaves;
+    Vector<uint32_t> _new_direct;
+    uint32_t _nodes_base;
+    uint32_t _leaves_base;
+
+    static inline uint64_t nexthop_key(IPAddress gw, int32_t port) {
+	return ((uint64_t) gw.addr() << 32) | (uint32_t) port;
+    }
+    static inline int extract(uint32_t addr, int offset) {
+	return ((((uint64_t) addr) << 32) >> (64 - STRIDE - offset)) & ((1 << STRIDE) - 1);
+    }
+    static inline uint16_t lookup_nexthop(const Trie *t, uint32_t addr);
+
+    static Trie *alloc_trie(uint32_t nodes_capacity, uint32_t leaves_capacity);
+    static void free_trie(Trie *t);
+    bool grow_nexthops();
+    void retire(Trie *t, NextHop *nh, int nhi);
+    void reclaim(bool update);
+    bool grace_passed() const;
+    inline void free_retired(const Retired &r);
+
+    int nexthop_ref(IPAddress gw, int32_t port, ErrorHandler *errh);
+    void nexthop_unref(int nh);
+    int rib_alloc();
+    int rib_find(uint32_t prefix, int plen, bool create, int *path);
+    void rib_prune(int *path, int plen);
+    inline uint16_t rib_nexthop(int rn) const;
+    int set_route(const IPRoute &route, bool allow_replace, IPRoute *old_route, ErrorHandler *errh);
+
+    int rebuild(uint32_t prefix, int plen);
+    int rebuild_all();
+    int commit(bool fresh);
+    void rebuild_slots(int rn, int depth, uint32_t prefix, uint16_t nh);
+    void build_slot(uint32_t slot, int rn, uint16_t nh);
+    void build_node(uint32_t ni, int rn, int depth, uint16_t nh);
+    void release_slot(uint32_t slot);
+    void count_subtree(uint32_t ni, uint32_t &nnodes, uint32_t &nleaves) const;
+    size_t lookup_memory_usage() const;
+
+    static String stats_handler(Element *, void *);
+
+};
+
+CLICK_ENDDECLS
+#endif
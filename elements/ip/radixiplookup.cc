@@ -25,6 +25,8 @@
 #include <click/error.hh>
 #include <click/glue.hh>
 #include <click/straccum.hh>
+#include <click/router.hh>
+#include <click/hashtable.hh>
 #include "radixiplookup.hh"
 CLICK_DECLS
 
@@ -32,6 +34,7 @@ class RadixIPLookup::Radix { public:
 
     static Radix *make_radix(int level);
     static void free_radix(Radix *r, int level);
+    static size_t memory_usage(const Radix *r, int level);
 
     int change(uint32_t addr, uint32_t mask, int key, bool set, int level);
 
@@ -115,6 +118,17 @@ RadixIPLookup::Radix::free_radix(Radix* r, int level)
     delete[] (unsigned char *)r;
 }
 
+size_t
+RadixIPLookup::Radix::memory_usage(const Radix *r, int level)
+{
+    int n = _nbuckets[level];
+    size_t m = sizeof(Radix) + n * sizeof(Child) + (n - 2) * sizeof(int);
+    for (int i = 0; i < n; i++)
+	if (r->_children[i].child)
+	    m += memory_usage(r->_children[i].child, level + 1);
+    return m;
+}
+
 int
 RadixIPLookup::Radix::change(uint32_t addr, uint32_t mask, int key, bool set, int level)
 {
@@ -179,6 +193,19 @@ RadixIPLookup::cleanup(CleanupStage)
     _radix = 0;
 }
 
+void
+RadixIPLookup::take_state(Element *e, ErrorHandler *)
+{
+    if (e != router()->hotswap_unchanged_element(this))
+	return;
+    RadixIPLookup *r = static_cast<RadixIPLookup *>(e);
+    _v.swap(r->_v);
+    click_swap(_vfree, r->_vfree);
+    _lookup.swap(r->_lookup);
+    click_swap(_default_key, r->_default_key);
+    click_swap(_radix, r->_radix);
+}
+
 
 String
 RadixIPLookup::dump_routes()
@@ -192,15 +219,80 @@ RadixIPLookup::dump_routes()
     return sa.take_string();
 }
 
+String
+RadixIPLookup::dump_routes_chunk(uint32_t &pos, uint32_t max)
+{
+    StringAccum sa;
+    for (int j = _vfree; j >= 0; j = _v[j].extra)
+	_v[j].kill();
+    uint32_t i = pos, n = 0;
+    for (; i < (uint32_t) _v.size() && n < max; i++)
+	if (_v[i].real()) {
+	    _v[i].unparse(sa, true) << '\n';
+	    ++n;
+	}
+    pos = (i < (uint32_t) _v.size() ? i : 0);
+    return sa.take_string();
+}
+
+
+size_t
+RadixIPLookup::memory_usage() const
+{
+    return _v.capacity() * sizeof(IPRoute)
+	+ _lookup.capacity() * sizeof(GWPort)
+	+ (_radix ? Radix::memory_usage(_radix, 0) : 0);
+}
+
 
 int
-RadixIPLookup::add_route(const IPRoute &route, bool set, IPRoute *old_route, ErrorHandler *)
+RadixIPLookup::new_lookup_key(ErrorHandler *errh)
+{
+    // Lookup keys share a radix value with the route index; see combine_key.
+    if (_lookup.size() >= 0xff) {
+	if (!errh)
+	    errh = ErrorHandler::silent_handler();
+	return errh->error("too many distinct gateway and output pairs");
+    }
+    return _lookup.size() + 1;
+}
+
+int
+RadixIPLookup::add_route(const IPRoute &route, bool set, IPRoute *old_route, ErrorHandler *errh)
 {
-    int found = (_vfree < 0 ? _v.size() : _vfree), last_key;
     int lookup_key = find_lookup_key(route.gw, route.port);
-    if(!lookup_key) 
-	lookup_key = _lookup.size() + 1;
-		    
+    if (!lookup_key && (lookup_key = new_lookup_key(errh)) < 0)
+	return lookup_key;
+    return change_route(route, set, old_route, lookup_key);
+}
+
+int
+RadixIPLookup::add_routes(Vector<IPRoute> &routes, ErrorHandler *errh)
+{
+    // Index existing (gateway, port) pairs rather than searching _lookup
+    // linearly for every route.
+    HashTable<uint64_t, int> lookup_keys;
+    for (int i = 0; i < _lookup.size(); ++i)
+	lookup_keys.set(((uint64_t) _lookup[i].gw.addr() << 32) | (uint32_t) _lookup[i].port, i + 1);
+
+    sort_routes(routes);
+    _v.reserve(_v.size() + routes.size());
+    for (IPRoute *r = routes.begin(); r != routes.end(); ++r) {
+	int &lookup_key = lookup_keys[((uint64_t) r->gw.addr() << 32) | (uint32_t) r->port];
+	if (!lookup_key && (lookup_key = new_lookup_key(errh)) < 0)
+	    return lookup_key;
+	int x = change_route(*r, true, 0, lookup_key);
+	if (x < 0)
+	    return x;
+    }
+    return 0;
+}
+
+int
+RadixIPLookup::change_route(const IPRoute &route, bool set, IPRoute *old_route, int lookup_key)
+{
+    int found = (_vfree < 0 ? _v.size() : _vfree), last_key;
+
     if (route.mask) {
 	uint32_t addr = ntohl(route.addr.addr());
 	uint32_t mask = ntohl(route.mask.addr());
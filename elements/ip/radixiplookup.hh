@@ -33,11 +33,13 @@ Uses the IPRouteTable interface; see IPRouteTable for description.
 
 =h table read-only
 
-Outputs a human-readable version of the current routing table.
+Outputs a human-readable version of the current routing table.  Large tables
+can be read in chunks; see IPRouteTable's B<dump_routes_chunk>.
 
 =h lookup read-only
 
-Reports the OUTput port and GW corresponding to an address.
+Reports the OUTput port and GW corresponding to an address.  Given several
+space-separated addresses, reports one `C<ADDR OUT [GW]>' line per address.
 
 =h add write-only
 
@@ -59,11 +61,32 @@ add a route, and `C<remove ADDR/MASK>' to remove a route. You can supply
 multiple commands, one per line; all commands are executed as one atomic
 operation.
 
+=h load write-only
+
+Loads routes from a text or binary route file, setting each route whether
+or not a route for the same prefix already exists. See IPRouteTable for the
+file formats. Routes can also be loaded at configuration time with a
+`C<LOAD FILENAME>' argument.
+
+=h save write-only
+
+Writes the current routing table to a file in binary route file format.
+
+=h load_info read-only
+
+Reports the number of routes read by the most recent load, the time taken
+to parse and insert them, and the approximate memory used by the table.
+
 =n
 
 See IPRouteTable for a performance comparison of the various IP routing
 elements.
 
+When a configuration is hotswapped in, a RadixIPLookup whose name,
+configuration, and connections are unchanged takes over the old element's
+table in constant time, including any routes added or removed through
+handlers.
+
 =a IPRouteTable, DirectIPLookup, RangeIPLookup, StaticIPLookup,
 LinearIPLookup, SortedIPLookup, LinuxIPLookup
 */
@@ -80,12 +103,16 @@ class RadixIPLookup : public IPRouteTable { public:
 
 
     void cleanup(CleanupStage);
+    void take_state(Element *, ErrorHandler *);
 
     int add_route(const IPRoute&, bool, IPRoute*, ErrorHandler *);
+    int add_routes(Vector<IPRoute>&, ErrorHandler *);
     int remove_route(const IPRoute&, IPRoute*, ErrorHandler *);
     int lookup_route(IPAddress, IPAddress&) const;
     int find_lookup_key(IPAddress gw, int port);
     String dump_routes();
+    String dump_routes_chunk(uint32_t &pos, uint32_t max);
+    size_t memory_usage() const;
 
   private:
 	struct GWPort {
@@ -108,6 +135,9 @@ class RadixIPLookup : public IPRouteTable { public:
 	return ((comb & 0xff000000) >> 24);
     }
 
+    int new_lookup_key(ErrorHandler *errh);
+    int change_route(const IPRoute&, bool, IPRoute*, int lookup_key);
+
 
     class Radix;
 
@@ -44,7 +44,8 @@ Outputs a human-readable version of the current routing table.
 
 =h lookup read-only
 
-Reports the OUTput port and GW corresponding to an address.
+Reports the OUTput port and GW corresponding to an address.  Given several
+space-separated addresses, reports one `C<ADDR OUT [GW]>' line per address.
 
 =h add write-only
 
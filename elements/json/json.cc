@@ -522,7 +522,9 @@ void Json::hard_unparse(StringAccum &sa, const unparse_manipulator &m, int depth
 	    if (ob->next_ > -2) {
 		sa.append(q, 2);
 		unparse_indent(sa, m, depth + 1);
-		sa << '\"' << ob->v_.first.encode_json() << '\"' << ':';
+		sa << '\"';
+		JsonWriter::append_string(sa, ob->v_.first.begin(), ob->v_.first.end());
+		sa.append("\":", 2);
 		ob->v_.second.hard_unparse(sa, m, depth + 1);
 		q = ",\n";
 	    }
@@ -556,8 +558,10 @@ void Json::unparse(StringAccum &sa) const
 	    ObjectItem *ob = oj->os_, *oe = ob + oj->n_;
 	    for (; ob != oe; ++ob)
 		if (ob->next_ > -2) {
-		    sa << q << '\"' << ob->v_.first.encode_json() << '\"'
-		       << ':' << ob->v_.second;
+		    sa << q << '\"';
+		    JsonWriter::append_string(sa, ob->v_.first.begin(), ob->v_.first.end());
+		    sa.append("\":", 2);
+		    ob->v_.second.unparse(sa);
 		    q = ',';
 		}
 	}
@@ -575,8 +579,11 @@ void Json::unparse(StringAccum &sa) const
 	if (q == '[')
 	    sa << q;
 	sa << ']';
-    } else if (_type == j_string)
-	sa << '\"' << _str.encode_json() << '\"';
+    } else if (_type == j_string) {
+	sa << '\"';
+	JsonWriter::append_string(sa, _str.begin(), _str.end());
+	sa << '\"';
+    }
     else if (_type == j_null)
 	sa.append("null", 4);
     else {
@@ -816,6 +823,39 @@ Json::parse_string(String &result, const String &str, const char *s, const char
     return s + 1;
 }
 
+const char *
+Json::parse_number(const char *s, const char *end, bool &integer)
+{
+    integer = true;
+    if (s != end && *s == '-')
+	++s;
+    if (s == end || *s < '0' || *s > '9')
+	return 0;
+    if (*s == '0')
+	++s;
+    else
+	for (++s; s != end && isdigit((unsigned char) *s); )
+	    ++s;
+    if (s != end && *s == '.') {
+	integer = false;
+	if (s + 1 == end || s[1] < '0' || s[1] > '9')
+	    return 0;
+	for (s += 2; s != end && isdigit((unsigned char) *s); )
+	    ++s;
+    }
+    if (s != end && (*s == 'e' || *s == 'E')) {
+	integer = false;
+	++s;
+	if (s != end && (*s == '+' || *s == '-'))
+	    ++s;
+	if (s == end || *s < '0' || *s > '9')
+	    return 0;
+	for (++s; s != end && isdigit((unsigned char) *s); )
+	    ++s;
+    }
+    return s;
+}
+
 const char *
 Json::parse_primitive(const String &str, const char *begin, const char *end)
 {
@@ -824,12 +864,9 @@ Json::parse_primitive(const String &str, const char *begin, const char *end)
     _cjson = 0;
 
     const char *s = begin;
+    bool integer;
     switch (*s) {
     case '-':
-	if (s + 1 == end || s[1] < '0' || s[1] > '9')
-	    return 0;
-	++s;
-	/* fallthru */
     case '0':
     case '1':
     case '2':
@@ -839,37 +876,15 @@ Json::parse_primitive(const String &str, const char *begin, const char *end)
     case '6':
     case '7':
     case '8':
-    case '9': {
-	json_type type = j_int;
-	if (*s == '0')
-	    ++s;
-	else
-	    for (++s; s != end && isdigit((unsigned char) *s); )
-		++s;
-	if (s != end && *s == '.') {
-	    type = j_double;
-	    if (s + 1 == end || s[1] < '0' || s[1] > '9')
-		return 0;
-	    for (s += 2; s != end && isdigit((unsigned char) *s); )
-		++s;
-	}
-	if (s != end && (*s == 'e' || *s == 'E')) {
-	    type = j_double;
-	    ++s;
-	    if (s != end && (*s == '+' || *s == '-'))
-		++s;
-	    if (s == end || s[1] < '0' || s[1] > '9')
-		return 0;
-	    for (++s; s != end && isdigit((unsigned char) *s); )
-		++s;
-	}
+    case '9':
+	if (!(s = parse_number(begin, end, integer)))
+	    return 0;
 	if (begin >= str.begin() && s <= str.end())
 	    _str = str.substring(begin, s);
 	else
 	    _str = String(begin, s);
-	_type = type;
+	_type = integer ? j_int : j_double;
 	return s;
-    }
     case 't':
 	if (s + 4 <= end && s[1] == 'r' && s[2] == 'u' && s[3] == 'e') {
 	    _str = String(true);
@@ -896,5 +911,358 @@ Json::parse_primitive(const String &str, const char *begin, const char *end)
     }
 }
 
+/** @class JsonWriter
+    @brief Streaming Json serializer.
+
+    JsonWriter appends Json text to a StringAccum as it is produced. Unlike
+    building a Json tree and calling Json::unparse(), it allocates nothing
+    per value, so it suits large handler outputs. The caller supplies the
+    structure:
+
+    <code>
+    StringAccum sa;
+    JsonWriter w(sa);
+    w.begin_object().member("name", "q").key("drops").begin_array();
+    w.value(1).value(2).end_array().end_object();
+    assert(sa.take_string() == "{\"name\":\"q\",\"drops\":[1,2]}");
+    </code>
+
+    JsonWriter inserts commas and colons itself, but does not otherwise
+    check its input; for instance, keys written outside of objects produce
+    invalid Json. Output matches Json::unparse() for the same values. */
+
+/** @brief Append the Json encoding of [@a s, @a end) to @a sa.
+
+    Does not add the surrounding double quotes. The encoding is the same as
+    String::encode_json(), but no temporary string is created. */
+void
+JsonWriter::append_string(StringAccum &sa, const char *s, const char *end)
+{
+    const char *last = s;
+    for (; s != end; ++s) {
+	int c = (unsigned char) *s;
+
+	// See String::encode_json() for U+2028 and U+2029.
+	if (unlikely(c == 0xE2)
+	    && s + 2 < end && (unsigned char) s[1] == 0x80
+	    && (unsigned char) (s[2] | 1) == 0xA9)
+	    c = 0x2028 + (s[2] & 1);
+	else if (likely(c >= 32 && c != '\\' && c != '\"' && c != '/'))
+	    continue;
+
+	sa.append(last, s);
+	sa << '\\';
+	switch (c) {
+	case '\b':
+	    sa << 'b';
+	    break;
+	case '\f':
+	    sa << 'f';
+	    break;
+	case '\n':
+	    sa << 'n';
+	    break;
+	case '\r':
+	    sa << 'r';
+	    break;
+	case '\t':
+	    sa << 't';
+	    break;
+	case '\\':
+	case '\"':
+	case '/':
+	    sa.append((char) c);
+	    break;
+	default: // c is a control character, 0x2028, or 0x2029
+	    sa.snprintf(5, "u%04X", c);
+	    if (c > 255)	// skip rest of encoding of U+202[89]
+		s += 2;
+	    break;
+	}
+	last = s + 1;
+    }
+    sa.append(last, s);
+}
+
+
+/** @class JsonParser
+    @brief Event-based Json parser.
+
+    JsonParser parses Json text and reports what it finds to virtual
+    callback functions, in the manner of a SAX parser, rather than building
+    a Json tree. Subclasses override the callbacks they need. For example,
+    on_begin_object() is called at each `{', on_key() at each object key,
+    and on_number() at each number. Every callback returns true to continue
+    parsing or false to stop; the default callbacks do nothing and return
+    true.
+
+    Strings and numbers are passed as substrings of the input String
+    whenever possible (that is, unless a string contains escapes), so
+    parsing large inputs copies little data. Numbers are passed as text, so
+    callbacks can convert them with the precision they need.
+
+    parse() parses a complete Json text. parse_prefix() parses one value
+    from a position in a String and returns where it stopped, which suits
+    concatenated values such as one-object-per-line logs. */
+
+JsonParser::~JsonParser()
+{
+}
+
+bool
+JsonParser::on_null()
+{
+    return true;
+}
+
+bool
+JsonParser::on_bool(bool)
+{
+    return true;
+}
+
+bool
+JsonParser::on_number(const String &, bool)
+{
+    return true;
+}
+
+bool
+JsonParser::on_string(const String &)
+{
+    return true;
+}
+
+bool
+JsonParser::on_key(const String &)
+{
+    return true;
+}
+
+bool
+JsonParser::on_begin_object()
+{
+    return true;
+}
+
+bool
+JsonParser::on_end_object()
+{
+    return true;
+}
+
+bool
+JsonParser::on_begin_array()
+{
+    return true;
+}
+
+bool
+JsonParser::on_end_array()
+{
+    return true;
+}
+
+const char *
+JsonParser::hard_parse(const String &str, const char *s, const char *end)
+{
+    int state = Json::st_initial;
+    const char *first;
+    String text;
+    bool integer;
+    _stack.clear();
+    _stopped = false;
+    _error_offset = -1;
+
+    while (1) {
+    next_token:
+	s = Json::skip_space(s, end);
+	if (s == end)
+	    goto error;
+
+	switch (*s) {
+
+	case ',':
+	    if (state == Json::st_object_delim)
+		state = Json::st_object_key;
+	    else if (state == Json::st_array_delim)
+		state = Json::st_array_value;
+	    else
+		goto error;
+	    ++s;
+	    goto next_token;
+
+	case ':':
+	    if (state != Json::st_object_colon)
+		goto error;
+	    state = Json::st_object_value;
+	    ++s;
+	    goto next_token;
+
+	case '}':
+	    if (state != Json::st_object_initial && state != Json::st_object_delim)
+		goto error;
+	    ++s;
+	    _stack.pop_back();
+	    if (!on_end_object())
+		goto stop;
+	    goto parse_value;
+
+	case ']':
+	    if (state != Json::st_array_initial && state != Json::st_array_delim)
+		goto error;
+	    ++s;
+	    _stack.pop_back();
+	    if (!on_end_array())
+		goto stop;
+	    goto parse_value;
+
+	case '\"':
+	    if (state == Json::st_object_initial || state == Json::st_object_key) {
+		if (!(s = Json::parse_string(text, str, (first = s) + 1, end))) {
+		    s = first;
+		    goto error;
+		}
+		state = Json::st_object_colon;
+		if (!on_key(text))
+		    goto stop;
+		goto next_token;
+	    }
+	    break;
+
+	}
+
+	if (state != Json::st_initial && state != Json::st_object_value
+	    && state != Json::st_array_initial && state != Json::st_array_value)
+	    goto error;
+
+	switch (*s) {
+
+	case '{':
+	    if (_stack.size() >= Json::max_depth)
+		goto error;
+	    _stack.push_back('{');
+	    state = Json::st_object_initial;
+	    ++s;
+	    if (!on_begin_object())
+		goto stop;
+	    goto next_token;
+
+	case '[':
+	    if (_stack.size() >= Json::max_depth)
+		goto error;
+	    _stack.push_back('[');
+	    state = Json::st_array_initial;
+	    ++s;
+	    if (!on_begin_array())
+		goto stop;
+	    goto next_token;
+
+	case '\"':
+	    if (!(s = Json::parse_string(text, str, (first = s) + 1, end))) {
+		s = first;
+		goto error;
+	    }
+	    if (!on_string(text))
+		goto stop;
+	    goto parse_value;
+
+	case 't':
+	    if (s + 4 > end || s[1] != 'r' || s[2] != 'u' || s[3] != 'e')
+		goto error;
+	    s += 4;
+	    if (!on_bool(true))
+		goto stop;
+	    goto parse_value;
+
+	case 'f':
+	    if (s + 5 > end || s[1] != 'a' || s[2] != 'l' || s[3] != 's' || s[4] != 'e')
+		goto error;
+	    s += 5;
+	    if (!on_bool(false))
+		goto stop;
+	    goto parse_value;
+
+	case 'n':
+	    if (s + 4 > end || s[1] != 'u' || s[2] != 'l' || s[3] != 'l')
+		goto error;
+	    s += 4;
+	    if (!on_null())
+		goto stop;
+	    goto parse_value;
+
+	default:
+	    if (!(s = Json::parse_number((first = s), end, integer))) {
+		s = first;
+		goto error;
+	    }
+	    if (first >= str.begin() && s <= str.end())
+		text = str.substring(first, s);
+	    else
+		text = String(first, s);
+	    if (!on_number(text, integer))
+		goto stop;
+	    goto parse_value;
+
+	}
+
+    parse_value:
+	if (_stack.empty())
+	    return s;
+	state = (_stack.back() == '{' ? Json::st_object_delim : Json::st_array_delim);
+    }
+
+ error:
+    _error_offset = s - str.begin();
+    return 0;
+ stop:
+    _stopped = true;
+    return 0;
+}
+
+/** @brief Parse the Json text @a str, calling callbacks for its contents.
+    @return true if @a str was a complete, valid Json text and no callback
+    stopped the parse
+
+    On a syntax error, error_offset() returns the offset into @a str where
+    parsing failed. Note that callbacks may have been called for a prefix
+    of @a str before the error was found. */
+bool
+JsonParser::parse(const String &str)
+{
+    const char *s = hard_parse(str, str.begin(), str.end());
+    if (!s)
+	return false;
+    s = Json::skip_space(s, str.end());
+    if (s != str.end()) {
+	_error_offset = s - str.begin();
+	return false;
+    }
+    return true;
+}
+
+/** @brief Parse one Json value from @a str starting at offset @a pos.
+    @return the offset following the value and any whitespace after it,
+    or -1 on error or if a callback stopped the parse
+
+    Parse a sequence of concatenated values like this:
+
+    <code>
+    for (int pos = 0; pos >= 0 && pos < str.length(); )
+        pos = parser.parse_prefix(str, pos);
+    </code> */
+int
+JsonParser::parse_prefix(const String &str, int pos)
+{
+    if (pos < 0 || pos > str.length()) {
+	_error_offset = pos;
+	return -1;
+    }
+    const char *s = hard_parse(str, str.begin() + pos, str.end());
+    if (!s)
+	return -1;
+    return Json::skip_space(s, str.end()) - str.begin();
+}
+
 CLICK_ENDDECLS
 ELEMENT_PROVIDES(Json)
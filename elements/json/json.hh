@@ -307,12 +307,14 @@ class Json { public:
     bool assign_parse(const String &str, const char *begin, const char *end);
     static const char *parse_string(String &result, const String &str, const char *s, const char *end);
     const char *parse_primitive(const String &str, const char *s, const char *end);
+    static const char *parse_number(const char *s, const char *end, bool &integer);
 
     friend class object_iterator;
     friend class const_object_iterator;
     friend class array_iterator;
     friend class const_array_iterator;
     friend bool operator==(const Json &a, const Json &b);
+    friend class JsonParser;
 
     struct JsonStatics;
     static char statics[];
@@ -2324,5 +2326,296 @@ inline bool operator!=(const Json_proxy_base<T> &a,
     return !(a == b);
 }
 
+/** @class JsonWriter
+    @brief Streaming Json serializer.
+
+    A JsonWriter appends Json text directly to a StringAccum, without
+    building a Json tree. See json.cc for details. */
+class JsonWriter { public:
+
+    explicit inline JsonWriter(StringAccum &sa);
+
+    inline StringAccum &sa() const;
+    inline int depth() const;
+
+    inline JsonWriter &begin_object();
+    inline JsonWriter &end_object();
+    inline JsonWriter &begin_array();
+    inline JsonWriter &end_array();
+    inline JsonWriter &key(const StringRef &k);
+
+    inline JsonWriter &value();
+    inline JsonWriter &value(bool x);
+    inline JsonWriter &value(int x);
+    inline JsonWriter &value(unsigned x);
+    inline JsonWriter &value(long x);
+    inline JsonWriter &value(unsigned long x);
+#if HAVE_LONG_LONG
+    inline JsonWriter &value(long long x);
+    inline JsonWriter &value(unsigned long long x);
+#endif
+#if HAVE_FLOAT_TYPES
+    inline JsonWriter &value(double x);
+#endif
+    inline JsonWriter &value(const StringRef &x);
+    inline JsonWriter &value(const String &x);
+    inline JsonWriter &value(const char *x);
+    inline JsonWriter &value(const Json &x);
+    inline JsonWriter &raw(const String &json_text);
+
+    template <typename T> inline JsonWriter &member(const StringRef &k, T x);
+
+    static void append_string(StringAccum &sa, const char *s, const char *end);
+
+  private:
+
+    StringAccum &_sa;
+    int _depth;
+    bool _comma;
+
+    inline void prefix();
+
+};
+
+/** @class JsonParser
+    @brief Event-based Json parser.
+
+    A JsonParser reports the contents of Json text to virtual callback
+    functions, without building a Json tree. See json.cc for details. */
+class JsonParser { public:
+
+    inline JsonParser();
+    virtual ~JsonParser();
+
+    bool parse(const String &str);
+    int parse_prefix(const String &str, int pos = 0);
+
+    inline int error_offset() const;
+    inline bool stopped() const;
+
+  protected:
+
+    virtual bool on_null();
+    virtual bool on_bool(bool x);
+    virtual bool on_number(const String &text, bool integer);
+    virtual bool on_string(const String &x);
+    virtual bool on_key(const String &key);
+    virtual bool on_begin_object();
+    virtual bool on_end_object();
+    virtual bool on_begin_array();
+    virtual bool on_end_array();
+
+  private:
+
+    int _error_offset;
+    bool _stopped;
+    Vector<char> _stack;
+
+    const char *hard_parse(const String &str, const char *s, const char *end);
+
+};
+
+
+/** @brief Construct a JsonWriter that appends to @a sa. */
+inline JsonWriter::JsonWriter(StringAccum &sa)
+    : _sa(sa), _depth(0), _comma(false) {
+}
+
+/** @brief Return the StringAccum this writer appends to. */
+inline StringAccum &JsonWriter::sa() const {
+    return _sa;
+}
+
+/** @brief Return the number of objects and arrays currently open. */
+inline int JsonWriter::depth() const {
+    return _depth;
+}
+
+inline void JsonWriter::prefix() {
+    if (_comma)
+	_sa << ',';
+}
+
+/** @brief Begin an object value. */
+inline JsonWriter &JsonWriter::begin_object() {
+    prefix();
+    _sa << '{';
+    ++_depth;
+    _comma = false;
+    return *this;
+}
+
+/** @brief End the innermost object. */
+inline JsonWriter &JsonWriter::end_object() {
+    assert(_depth > 0);
+    _sa << '}';
+    --_depth;
+    _comma = true;
+    return *this;
+}
+
+/** @brief Begin an array value. */
+inline JsonWriter &JsonWriter::begin_array() {
+    prefix();
+    _sa << '[';
+    ++_depth;
+    _comma = false;
+    return *this;
+}
+
+/** @brief End the innermost array. */
+inline JsonWriter &JsonWriter::end_array() {
+    assert(_depth > 0);
+    _sa << ']';
+    --_depth;
+    _comma = true;
+    return *this;
+}
+
+/** @brief Write object key @a k. The next call should write its value. */
+inline JsonWriter &JsonWriter::key(const StringRef &k) {
+    prefix();
+    _sa << '\"';
+    append_string(_sa, k.begin(), k.end());
+    _sa.append("\":", 2);
+    _comma = false;
+    return *this;
+}
+
+/** @brief Write a null value. */
+inline JsonWriter &JsonWriter::value() {
+    prefix();
+    _sa.append("null", 4);
+    _comma = true;
+    return *this;
+}
+
+/** @brief Write a simple value. */
+inline JsonWriter &JsonWriter::value(bool x) {
+    prefix();
+    _sa << x;
+    _comma = true;
+    return *this;
+}
+
+/** @overload */
+inline JsonWriter &JsonWriter::value(int x) {
+    prefix();
+    _sa << x;
+    _comma = true;
+    return *this;
+}
+
+/** @overload */
+inline JsonWriter &JsonWriter::value(unsigned x) {
+    prefix();
+    _sa << x;
+    _comma = true;
+    return *this;
+}
+
+/** @overload */
+inline JsonWriter &JsonWriter::value(long x) {
+    prefix();
+    _sa << x;
+    _comma = true;
+    return *this;
+}
+
+/** @overload */
+inline JsonWriter &JsonWriter::value(unsigned long x) {
+    prefix();
+    _sa << x;
+    _comma = true;
+    return *this;
+}
+
+#if HAVE_LONG_LONG
+/** @overload */
+inline JsonWriter &JsonWriter::value(long long x) {
+    prefix();
+    _sa << x;
+    _comma = true;
+    return *this;
+}
+
+/** @overload */
+inline JsonWriter &JsonWriter::value(unsigned long long x) {
+    prefix();
+    _sa << x;
+    _comma = true;
+    return *this;
+}
+#endif
+
+#if HAVE_FLOAT_TYPES
+/** @overload */
+inline JsonWriter &JsonWriter::value(double x) {
+    prefix();
+    _sa << x;
+    _comma = true;
+    return *this;
+}
+#endif
+
+/** @brief Write a string value. */
+inline JsonWriter &JsonWriter::value(const StringRef &x) {
+    prefix();
+    _sa << '\"';
+    append_string(_sa, x.begin(), x.end());
+    _sa << '\"';
+    _comma = true;
+    return *this;
+}
+
+/** @overload */
+inline JsonWriter &JsonWriter::value(const String &x) {
+    return value(StringRef(x));
+}
+
+/** @overload */
+inline JsonWriter &JsonWriter::value(const char *x) {
+    return value(StringRef(x));
+}
+
+/** @brief Write the Json value @a x. */
+inline JsonWriter &JsonWriter::value(const Json &x) {
+    prefix();
+    x.unparse(_sa);
+    _comma = true;
+    return *this;
+}
+
+/** @brief Write @a json_text, which must be a complete Json value, as is. */
+inline JsonWriter &JsonWriter::raw(const String &json_text) {
+    prefix();
+    _sa << json_text;
+    _comma = true;
+    return *this;
+}
+
+/** @brief Write object member @a k with value @a x. */
+template <typename T>
+inline JsonWriter &JsonWriter::member(const StringRef &k, T x) {
+    key(k);
+    return value(x);
+}
+
+/** @brief Construct a JsonParser. */
+inline JsonParser::JsonParser()
+    : _error_offset(-1), _stopped(false) {
+}
+
+/** @brief Return the offset of the syntax error found by the last parse, or
+    -1 if there was none. */
+inline int JsonParser::error_offset() const {
+    return _error_offset;
+}
+
+/** @brief Return true iff a callback stopped the last parse. */
+inline bool JsonParser::stopped() const {
+    return _stopped;
+}
+
 CLICK_ENDDECLS
 #endif
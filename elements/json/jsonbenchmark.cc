@@ -0,0 +1,228 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * jsonbenchmark.{cc,hh} -- compare Json serializer and parser performance
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, subject to the conditions listed in the Click LICENSE
+ * file. These conditions include: you must preserve this copyright
+ * notice, and you cannot mention the copyright holders in advertising
+ * related to the Software without their permission.  The Software is
+ * provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This notice is a
+ * summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "jsonbenchmark.hh"
+#include "json.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/straccum.hh>
+#include <click/timestamp.hh>
+#include <click/userutils.hh>
+CLICK_DECLS
+
+namespace {
+class CountingJsonParser : public JsonParser { public:
+    CountingJsonParser()
+	: nvalues(0) {
+    }
+    int nvalues;
+  protected:
+    bool on_null() {
+	++nvalues;
+	return true;
+    }
+    bool on_bool(bool) {
+	++nvalues;
+	return true;
+    }
+    bool on_number(const String &, bool) {
+	++nvalues;
+	return true;
+    }
+    bool on_string(const String &) {
+	++nvalues;
+	return true;
+    }
+    bool on_begin_object() {
+	++nvalues;
+	return true;
+    }
+    bool on_begin_array() {
+	++nvalues;
+	return true;
+    }
+};
+}
+
+JsonBenchmark::JsonBenchmark()
+    : _nrecords(1000), _iterations(100), _consistent(false), _sink(0)
+{
+}
+
+int
+JsonBenchmark::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    uint32_t seed;
+    bool have_seed;
+    if (Args(conf, this, errh)
+	.read("RECORDS", _nrecords)
+	.read("ITERATIONS", _iterations)
+	.read("INPUT", FilenameArg(), _input_file)
+	.read("SEED", seed).read_status(have_seed)
+	.complete() < 0)
+	return -1;
+    if (!_iterations)
+	return errh->error("ITERATIONS must be positive");
+    if (have_seed)
+	click_srandom(seed);
+    return 0;
+}
+
+int
+JsonBenchmark::initialize(ErrorHandler *errh)
+{
+    static const char * const classes[] = {
+	"Counter", "Queue", "FromDevice", "ToDevice", "IPFilter",
+	"Strip(14)", "Print(\"ok\")"
+    };
+    _records.resize(_nrecords);
+    for (uint32_t i = 0; i < _nrecords; ++i) {
+	record &r = _records[i];
+	r.name = "element" + String(i);
+	r.class_name = classes[click_random(0, 6)];
+	r.count = click_random();
+	r.rate = click_random() / 1024.;
+	r.active = click_random() & 1;
+	for (int p = click_random(0, 4); p > 0; --p)
+	    r.ports.push_back(click_random(0, 15));
+    }
+
+    if (_input_file) {
+	_input = file_string(_input_file, errh);
+	if (!_input)
+	    return -1;
+    }
+    return 0;
+}
+
+String
+JsonBenchmark::unparse_tree() const
+{
+    Json j = Json::make_array();
+    for (const record *r = _records.begin(); r != _records.end(); ++r) {
+	Json o = Json::make_object();
+	o.set("name", r->name).set("class", r->class_name)
+	    .set("count", r->count).set("rate", r->rate)
+	    .set("active", r->active).set("ports", Json(r->ports));
+	j.push_back(o);
+    }
+    return j.unparse();
+}
+
+String
+JsonBenchmark::unparse_writer() const
+{
+    StringAccum sa;
+    JsonWriter w(sa);
+    w.begin_array();
+    for (const record *r = _records.begin(); r != _records.end(); ++r) {
+	w.begin_object().member("name", r->name).member("class", r->class_name)
+	    .member("count", r->count).member("rate", r->rate)
+	    .member("active", r->active).key("ports").begin_array();
+	for (const int *p = r->ports.begin(); p != r->ports.end(); ++p)
+	    w.value(*p);
+	w.end_array().end_object();
+    }
+    w.end_array();
+    return sa.take_string();
+}
+
+void
+JsonBenchmark::run()
+{
+    StringAccum sa;
+    String tree_text, writer_text;
+    int sink = 0;
+
+    Timestamp t0 = Timestamp::now_steady();
+    for (uint32_t i = 0; i < _iterations; ++i) {
+	tree_text = unparse_tree();
+	sink += tree_text.length();
+    }
+    Timestamp t1 = Timestamp::now_steady();
+    for (uint32_t i = 0; i < _iterations; ++i) {
+	writer_text = unparse_writer();
+	sink += writer_text.length();
+    }
+    Timestamp t2 = Timestamp::now_steady();
+
+    String input = _input ? _input : tree_text;
+    bool tree_ok = true, events_ok = true;
+    for (uint32_t i = 0; i < _iterations; ++i) {
+	Json j;
+	tree_ok = tree_ok && j.assign_parse(input);
+	sink += j.size();
+    }
+    Timestamp t3 = Timestamp::now_steady();
+    for (uint32_t i = 0; i < _iterations; ++i) {
+	CountingJsonParser p;
+	events_ok = events_ok && p.parse(input);
+	sink += p.nvalues;
+    }
+    Timestamp t4 = Timestamp::now_steady();
+    _sink = sink;
+
+    _consistent = tree_text == writer_text && tree_ok && events_ok;
+
+    const Timestamp *ts[] = { &t0, &t1, &t2, &t3, &t4 };
+    static const char * const names[] = {
+	"unparse_tree", "unparse_writer", "parse_tree", "parse_events"
+    };
+    for (int m = 0; m < 4; ++m) {
+	double sec = (*ts[m + 1] - *ts[m]).doubleval();
+	double bytes = (double) (m < 2 ? tree_text.length() : input.length())
+	    * _iterations;
+	sa << names[m] << '\t';
+	sa.snprintf(20, "%.1f\t", sec * 1e6 / _iterations);
+	sa.snprintf(20, "%.1f\n", sec > 0 ? bytes / sec / 1e6 : 0.);
+    }
+    _results = sa.take_string();
+}
+
+String
+JsonBenchmark::read_handler(Element *e, void *thunk)
+{
+    JsonBenchmark *b = static_cast<JsonBenchmark *>(e);
+    switch ((intptr_t) thunk) {
+    case 0:
+	return b->_results;
+    case 1:
+	return String(b->_consistent);
+    default:
+	return b->unparse_writer();
+    }
+}
+
+int
+JsonBenchmark::run_handler(const String &, Element *e, void *, ErrorHandler *)
+{
+    static_cast<JsonBenchmark *>(e)->run();
+    return 0;
+}
+
+void
+JsonBenchmark::add_handlers()
+{
+    add_read_handler("results", read_handler, 0);
+    add_read_handler("consistent", read_handler, 1);
+    add_read_handler("document", read_handler, 2);
+    add_write_handler("run", run_handler, 0, Handler::BUTTON);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel Json)
+EXPORT_ELEMENT(JsonBenchmark)
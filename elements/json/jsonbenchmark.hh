@@ -0,0 +1,147 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_JSONBENCHMARK_HH
+#define CLICK_JSONBENCHMARK_HH
+#include <click/element.hh>
+#include <click/vector.hh>
+CLICK_DECLS
+
+/*
+=c
+
+JsonBenchmark([I<keywords> RECORDS, ITERATIONS, INPUT, SEED])
+
+=s test
+
+compares Json tree and streaming serializer and parser speed
+
+=d
+
+JsonBenchmark measures how quickly Click's Json support can produce and
+consume Json text.  It does not route packets.
+
+Each run serializes a generated document, an array of RECORDS objects
+resembling per-element statistics, ITERATIONS times with each of two
+methods:
+
+=over 8
+
+=item unparse_tree
+
+Builds a Json tree for the document, then calls B<Json::unparse>.
+
+=item unparse_writer
+
+Writes the document with B<JsonWriter>, which appends directly to a
+StringAccum.
+
+=back
+
+It then parses a Json text, either the generated document or the contents of
+INPUT, ITERATIONS times with each of two methods:
+
+=over 8
+
+=item parse_tree
+
+Calls B<Json::parse> to build a Json tree.
+
+=item parse_events
+
+Parses with a B<JsonParser> whose callbacks count values.
+
+=back
+
+Results are reported by the `C<results>' handler.
+
+Keyword arguments are:
+
+=over 8
+
+=item RECORDS
+
+Integer.  Number of objects in the generated document.  Default is 1000.
+
+=item ITERATIONS
+
+Integer.  Number of times each method is run.  Default is 100.
+
+=item INPUT
+
+Filename.  A Json text, such as a large configuration file, to use for the
+parsing benchmarks.  Default is the generated document.
+
+=item SEED
+
+Integer.  Random seed used to generate the document.  Default is to use the
+current random state.
+
+=back
+
+=h run write-only
+
+Runs the benchmark.
+
+=h results read-only
+
+Reports the results of the most recent run, one line per method: the
+method name, microseconds per iteration, and megabytes of Json text per
+second.
+
+=h consistent read-only
+
+Returns true if, in the most recent run, both serializers produced
+identical text and both parsers accepted the parse input.
+
+=h document read-only
+
+Returns the generated document.
+
+=e
+
+  b :: JsonBenchmark(RECORDS 10000, ITERATIONS 20);
+  Script(write b.run, print $(b.results), stop);
+
+=a IPLookupBenchmark */
+
+class JsonBenchmark : public Element { public:
+
+    JsonBenchmark();
+
+    const char *class_name() const	{ return "JsonBenchmark"; }
+
+    int configure(Vector<String> &conf, ErrorHandler *errh);
+    int initialize(ErrorHandler *errh);
+    void add_handlers();
+
+    void run();
+
+  private:
+
+    struct record {
+	String name;
+	String class_name;
+	long count;
+	double rate;
+	bool active;
+	Vector<int> ports;
+    };
+
+    Vector<record> _records;
+    uint32_t _nrecords;
+    uint32_t _iterations;
+    String _input_file;
+    String _input;
+    String _results;
+    bool _consistent;
+    volatile int _sink;
+
+    String unparse_tree() const;
+    String unparse_writer() const;
+
+    static String read_handler(Element *, void *);
+    static int run_handler(const String &, Element *, void *, ErrorHandler *);
+
+};
+
+CLICK_ENDDECLS
+#endif
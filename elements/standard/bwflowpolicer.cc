@@ -0,0 +1,36 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * bwflowpolicer.{cc,hh} -- police packets per flow at a given bandwidth
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "bwflowpolicer.hh"
+#include "ratedunqueue.hh"
+CLICK_DECLS
+
+BandwidthFlowPolicer::BandwidthFlowPolicer()
+{
+}
+
+void
+BandwidthFlowPolicer::push(int, Packet *p)
+{
+    if (conform(p, p->length(), RatedUnqueue::tb_bandwidth_thresh))
+	output(0).push(p);
+    else
+	checked_output_push(1, p);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(FlowPolicer)
+EXPORT_ELEMENT(BandwidthFlowPolicer)
@@ -0,0 +1,44 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_BWFLOWPOLICER_HH
+#define CLICK_BWFLOWPOLICER_HH
+#include "elements/standard/flowpolicer.hh"
+CLICK_DECLS
+
+/*
+=c
+
+BandwidthFlowPolicer(RATE, I<keywords> KEY, PREFIX, ANNO, CAPACITY, BURST_DURATION, BURST_BYTES)
+
+=s shaping
+
+polices packets per flow at a specified bandwidth
+
+=d
+
+Like FlowPolicer, but RATE is a bandwidth, such as "384 kbps", and
+BURST_BYTES sets the capacity of each flow's token bucket in bytes.  Each
+flow's packets are emitted on output 0 as long as that flow stays under
+RATE; excess packets are emitted on output 1.
+
+See FlowPolicer for the other keywords and handlers.
+
+=e
+
+Limit each source address to 1 Mbps:
+
+  BandwidthFlowPolicer(1Mbps, CAPACITY 1000000) => [0] output, Discard;
+
+=a FlowPolicer, BandwidthRatedSplitter, BandwidthMeter */
+
+class BandwidthFlowPolicer : public FlowPolicer { public:
+
+    BandwidthFlowPolicer();
+
+    const char *class_name() const	{ return "BandwidthFlowPolicer"; }
+
+    void push(int port, Packet *);
+
+};
+
+CLICK_ENDDECLS
+#endif
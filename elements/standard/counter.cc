@@ -22,6 +22,7 @@
 #include <click/confparse.hh>
 #include <click/args.hh>
 #include <click/handlercall.hh>
+#include <click/router.hh>
 CLICK_DECLS
 
 Counter::Counter()
@@ -85,13 +86,27 @@ Counter::initialize(ErrorHandler *errh)
   return 0;
 }
 
+void
+Counter::take_state(Element *e, ErrorHandler *)
+{
+    if (e != router()->hotswap_unchanged_element(this))
+	return;
+    Counter *c = static_cast<Counter *>(e);
+    _count = c->_count;
+    _byte_count = c->_byte_count;
+    _rate = c->_rate;
+    _byte_rate = c->_byte_rate;
+    _count_triggered = c->_count_triggered;
+    _byte_triggered = c->_byte_triggered;
+}
+
 Packet *
 Counter::simple_action(Packet *p)
 {
     _count++;
-    _byte_count += p->length();
+    _byte_count += p->total_length();
     _rate.update(1);
-    _byte_rate.update(p->length());
+    _byte_rate.update(p->total_length());
 
   if (_count == _count_trigger && !_count_triggered) {
     _count_triggered = true;
@@ -221,6 +236,19 @@ Counter::llrpc(unsigned command, void *data)
     }
     return CLICK_LLRPC_PUT_DATA(&user_cs->values, &cs.values, sizeof(cs.values));
 
+#if CLICK_USERLEVEL
+  } else if (command == CLICK_LLRPC_EXPORT_STAT) {
+    click_llrpc_export_stat_st *es = (click_llrpc_export_stat_st *)data;
+    if (strcmp(es->name, "count") == 0)
+      es->addr = &_count;
+    else if (strcmp(es->name, "byte_count") == 0)
+      es->addr = &_byte_count;
+    else
+      return -EINVAL;
+    es->size = sizeof(counter_t);
+    return 0;
+#endif
+
   } else
     return Element::llrpc(command, data);
 }
@@ -39,6 +39,9 @@ emitting the packet.
 
 =back
 
+When a configuration is hotswapped in, a Counter whose name, configuration,
+and connections are unchanged keeps the old Counter's counts and rates.
+
 =h count read-only
 
 Returns the number of packets that have passed through since the last reset.
@@ -96,6 +99,11 @@ Argument is a pointer to a click_llrpc_counts_st structure (see
 count). Stores the corresponding counts in the corresponding C<values>
 components.
 
+=h CLICK_LLRPC_EXPORT_STAT llrpc
+
+User-level only.  Exports the C<count> and C<byte_count> statistics to
+ShmCounters; see <click/llrpc.h>.
+
 */
 
 class Counter : public Element { public:
@@ -105,11 +113,13 @@ class Counter : public Element { public:
 
     const char *class_name() const		{ return "Counter"; }
     const char *port_count() const		{ return PORTS_1_1; }
+    const char *flags() const			{ return "G"; }
 
     void reset();
 
     int configure(Vector<String> &, ErrorHandler *);
     int initialize(ErrorHandler *);
+    void take_state(Element *, ErrorHandler *);
     void add_handlers();
     int llrpc(unsigned, void *);
 
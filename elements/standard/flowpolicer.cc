@@ -0,0 +1,188 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * flowpolicer.{cc,hh} -- police packets per flow at a given rate
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "flowpolicer.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/master.hh>
+#include <click/ipaddress.hh>
+#include "ratedunqueue.hh"
+CLICK_DECLS
+
+FlowPolicer::FlowPolicer()
+    : _shards(0), _nshards(0), _mem(0), _memsize(0)
+{
+}
+
+FlowPolicer::~FlowPolicer()
+{
+}
+
+int
+FlowPolicer::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    String key = "src";
+    int prefix = 32;
+    _anno = AGGREGATE_ANNO_OFFSET;
+    _capacity = 65536;
+    if (Args(this, errh).bind(conf)
+	.read("KEY", WordArg(), key)
+	.read("PREFIX", prefix)
+	.read("ANNO", AnnoArg(4), _anno)
+	.read("CAPACITY", _capacity)
+	.consume() < 0)
+	return -1;
+
+    key = key.lower();
+    if (key == "src")
+	_key = key_src;
+    else if (key == "dst")
+	_key = key_dst;
+    else if (key == "srcdst")
+	_key = key_srcdst;
+    else if (key == "flow")
+	_key = key_flow;
+    else if (key == "anno")
+	_key = key_anno;
+    else
+	return errh->error("bad KEY, expected %<src%>, %<dst%>, %<srcdst%>, %<flow%>, or %<anno%>");
+    if (prefix < 0 || prefix > 32)
+	return errh->error("PREFIX out of range");
+    _mask = IPAddress::make_prefix(prefix).addr();
+    if (_capacity == 0)
+	return errh->error("CAPACITY must be positive");
+
+    TokenBucket tb;
+    if (RatedUnqueue::configure_helper(&tb, is_bandwidth(), this, conf, errh) < 0)
+	return -1;
+    _rate.assign(tb.rate(), tb.capacity());
+    return 0;
+}
+
+int
+FlowPolicer::initialize(ErrorHandler *errh)
+{
+    _nshards = master()->nthreads();
+    if (_nshards < 1)
+	_nshards = 1;
+
+    // Round each shard's share of CAPACITY up to a power of two of sets.
+    uint32_t per_shard = (_capacity - 1) / _nshards / ways + 1;
+    uint32_t nsets = 1;
+    while (nsets < per_shard && nsets < 0x40000000U)
+	nsets <<= 1;
+
+    _memsize = sizeof(Shard) * _nshards + sizeof(Set) * nsets * _nshards
+	+ CLICK_CACHE_LINE_SIZE;
+    if (!(_mem = CLICK_LALLOC(_memsize)))
+	return errh->error("out of memory");
+    uintptr_t a = reinterpret_cast<uintptr_t>(_mem);
+    a = (a + CLICK_CACHE_LINE_SIZE - 1) & ~(uintptr_t) (CLICK_CACHE_LINE_SIZE - 1);
+    _shards = reinterpret_cast<Shard *>(a);
+    Set *sets = reinterpret_cast<Set *>(_shards + _nshards);
+    for (int i = 0; i < _nshards; ++i) {
+	new(reinterpret_cast<void *>(&_shards[i])) Shard;
+	_shards[i].sets = sets + i * nsets;
+	_shards[i].mask = nsets - 1;
+    }
+    clear();
+    return 0;
+}
+
+void
+FlowPolicer::cleanup(CleanupStage)
+{
+    if (_mem) {
+	for (int i = 0; i < _nshards; ++i)
+	    _shards[i].~Shard();
+	CLICK_LFREE(_mem, _memsize);
+    }
+    _mem = 0;
+    _shards = 0;
+}
+
+void
+FlowPolicer::clear()
+{
+    for (Shard *sh = _shards; sh != _shards + _nshards; ++sh) {
+	sh->lock.acquire();
+	for (Set *s = sh->sets; s != sh->sets + sh->mask + 1; ++s)
+	    for (int i = 0; i < ways; ++i)
+		s->b[i].key = empty_key;
+	sh->count = 0;
+	sh->evictions = sh->drops = 0;
+	sh->lock.release();
+    }
+}
+
+void
+FlowPolicer::push(int, Packet *p)
+{
+    if (conform(p, 1, 1))
+	output(0).push(p);
+    else
+	checked_output_push(1, p);
+}
+
+enum { h_rate, h_count, h_evictions, h_drops, h_reset };
+
+String
+FlowPolicer::read_handler(Element *e, void *thunk)
+{
+    FlowPolicer *fp = static_cast<FlowPolicer *>(e);
+    int which = reinterpret_cast<intptr_t>(thunk);
+    if (which == h_rate) {
+	if (fp->is_bandwidth())
+	    return BandwidthArg::unparse(fp->_rate.rate());
+	else
+	    return String(fp->_rate.rate());
+    }
+    uint64_t n = 0;
+    for (Shard *sh = fp->_shards; sh != fp->_shards + fp->_nshards; ++sh)
+	switch (which) {
+	case h_count:
+	    n += sh->count;
+	    break;
+	case h_evictions:
+	    n += sh->evictions;
+	    break;
+	case h_drops:
+	    n += sh->drops;
+	    break;
+	}
+    return String(n);
+}
+
+int
+FlowPolicer::write_handler(const String &, Element *e, void *, ErrorHandler *)
+{
+    static_cast<FlowPolicer *>(e)->clear();
+    return 0;
+}
+
+void
+FlowPolicer::add_handlers()
+{
+    add_read_handler("rate", read_handler, h_rate);
+    add_read_handler("count", read_handler, h_count);
+    add_read_handler("evictions", read_handler, h_evictions);
+    add_read_handler("drops", read_handler, h_drops);
+    add_write_handler("reset", write_handler, h_reset, Handler::BUTTON);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(RatedUnqueue)
+EXPORT_ELEMENT(FlowPolicer)
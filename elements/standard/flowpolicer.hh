@@ -0,0 +1,285 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_FLOWPOLICER_HH
+#define CLICK_FLOWPOLICER_HH
+#include <click/element.hh>
+#include <click/tokenbucket.hh>
+#include <click/sync.hh>
+#include <click/hashcode.hh>
+#include <click/packet_anno.hh>
+#include <clicknet/ip.h>
+CLICK_DECLS
+
+/*
+=c
+
+FlowPolicer(RATE, I<keywords> KEY, PREFIX, ANNO, CAPACITY, BURST_DURATION, BURST_SIZE)
+
+=s shaping
+
+polices packets per flow at a specified rate
+
+=d
+
+FlowPolicer has two output ports.  It keeps a separate token bucket for every
+flow it sees, and emits a flow's packets on output 0 as long as that flow
+stays under RATE packets per second.  Excess packets are emitted on output 1,
+or dropped if output 1 is not connected.  Each flow behaves like its own
+RatedSplitter, so FlowPolicer can limit, for example, every source address or
+source prefix at once.
+
+KEY selects what defines a flow:
+
+=over 8
+
+=item C<src>
+
+The IP source address, masked to PREFIX bits.  This is the default.
+
+=item C<dst>
+
+The IP destination address, masked to PREFIX bits.
+
+=item C<srcdst>
+
+The IP source and destination addresses, both masked to PREFIX bits.
+
+=item C<flow>
+
+The IP 5-tuple: addresses, protocol, and TCP or UDP ports.
+
+=item C<anno>
+
+The 4-byte annotation named by ANNO.
+
+=back
+
+IP keys require the IP header annotation.  Packets without one share a
+single token bucket.
+
+Buckets take 16 bytes each and are kept in a hash table of 64-byte,
+four-way associative sets.  A bucket is refilled only when a packet for its
+flow arrives.  When a new flow hashes to a full set, it replaces the least
+recently used flow in that set, which starts over with a full bucket if it
+returns.  CAPACITY therefore bounds memory use: FlowPolicer uses about
+16*CAPACITY bytes no matter how many flows it sees.
+
+Each thread that pushes packets into FlowPolicer gets its own table of
+CAPACITY/I<N> buckets, where I<N> is the number of threads, so the packet
+path takes no contended locks.  Flows are policed per thread: if packets from
+one flow arrive on several threads, that flow may get up to RATE on each of
+them.  Use a configuration that directs each flow to one thread, for instance
+with receive-side scaling.
+
+Keyword arguments are:
+
+=over 8
+
+=item RATE
+
+Integer.  Token bucket fill rate in packets per second, for each flow.
+
+=item KEY
+
+One of C<src>, C<dst>, C<srcdst>, C<flow>, or C<anno>.  Default is C<src>.
+
+=item PREFIX
+
+Integer between 0 and 32.  Prefix length for address keys.  Default is 32.
+
+=item ANNO
+
+Annotation name.  The annotation used when KEY is C<anno>.  Default is
+AGGREGATE.
+
+=item CAPACITY
+
+Unsigned integer.  The maximum number of flows tracked, rounded up to a
+power of two per thread.  Default is 65536.
+
+=item BURST_DURATION
+
+Time.  If specified, the capacity of each token bucket is calculated as
+rate * burst_duration.  Default is 20ms.
+
+=item BURST_SIZE
+
+Integer.  If specified, the capacity of each token bucket is set to this
+value.
+
+=back
+
+=h rate read-only
+
+Returns the RATE.
+
+=h count read-only
+
+Returns the number of flows tracked.
+
+=h evictions read-only
+
+Returns the number of flows forgotten to make room for new ones.
+
+=h drops read-only
+
+Returns the number of packets over the rate.
+
+=h reset write-only
+
+Forgets all flows and resets the counts.
+
+=e
+
+Limit each /24 source prefix to 1000 packets per second:
+
+  FlowPolicer(1000, PREFIX 24, CAPACITY 1000000) => [0] output, Discard;
+
+=a BandwidthFlowPolicer, RatedSplitter, Meter, IPRateMonitor */
+
+class FlowPolicer : public Element { public:
+
+    FlowPolicer();
+    ~FlowPolicer();
+
+    const char *class_name() const	{ return "FlowPolicer"; }
+    const char *port_count() const	{ return PORTS_1_1X2; }
+    const char *processing() const	{ return PUSH; }
+    bool is_bandwidth() const		{ return class_name()[0] == 'B'; }
+
+    int configure(Vector<String> &, ErrorHandler *);
+    int initialize(ErrorHandler *);
+    void cleanup(CleanupStage);
+    void add_handlers();
+
+    void push(int port, Packet *);
+
+  protected:
+
+    inline bool conform(Packet *p, uint32_t cost, uint32_t need);
+
+  private:
+
+    struct Bucket {
+	uint64_t key;
+	uint32_t tokens;	// fraction of capacity, as in TokenCounter
+	uint32_t time;		// jiffies of last refill
+    };
+
+    enum { ways = 4 };
+    static const uint64_t empty_key = ~(uint64_t) 0;
+
+    struct Set {
+	Bucket b[ways];
+    } CLICK_ALIGNED(CLICK_CACHE_LINE_SIZE);
+
+    struct Shard {
+	Set *sets;
+	uint32_t mask;
+	uint32_t count;
+	uint64_t evictions;
+	uint64_t drops;
+	Spinlock lock;		// uncontended except against handlers
+    } CLICK_ALIGNED(CLICK_CACHE_LINE_SIZE);
+
+    enum { key_src, key_dst, key_srcdst, key_flow, key_anno };
+
+    TokenRate _rate;
+    int _key;
+    uint32_t _mask;
+    int _anno;
+    uint32_t _capacity;
+
+    Shard *_shards;
+    int _nshards;
+    void *_mem;
+    size_t _memsize;
+
+    inline uint64_t flow_key(const Packet *p) const;
+    void clear();
+
+    static String read_handler(Element *, void *);
+    static int write_handler(const String &, Element *, void *, ErrorHandler *);
+
+};
+
+inline uint64_t
+FlowPolicer::flow_key(const Packet *p) const
+{
+    if (_key == key_anno)
+	return p->anno_u32(_anno);
+    if (!p->has_network_header())
+	return 0;
+    const click_ip *iph = p->ip_header();
+    uint32_t src = iph->ip_src.s_addr & _mask, dst = iph->ip_dst.s_addr & _mask;
+    if (_key == key_src)
+	return src;
+    else if (_key == key_dst)
+	return dst;
+    uint64_t k = (((uint64_t) src << 32) | dst) * 0x9E3779B97F4A7C15ULL;
+    if (_key == key_flow) {
+	k += iph->ip_p;
+	if (IP_FIRSTFRAG(iph)
+	    && (iph->ip_p == IP_PROTO_TCP || iph->ip_p == IP_PROTO_UDP)
+	    && p->transport_length() >= 4)
+	    k = k * 0x9E3779B97F4A7C15ULL
+		+ *reinterpret_cast<const uint32_t *>(p->transport_header());
+    }
+    // Never collide with an empty bucket, even for two all-ones addresses.
+    return k >> 1;
+}
+
+/** @brief Charge @a cost tokens to @a p's flow if it holds at least @a need.
+ * @return true if @a p conforms to the rate
+ *
+ * Refills the flow's bucket first.  A new flow replaces the least recently
+ * refilled flow in its set. */
+inline bool
+FlowPolicer::conform(Packet *p, uint32_t cost, uint32_t need)
+{
+    uint64_t key = flow_key(p);
+    uint32_t now = _rate.now();
+    Shard &sh = _shards[click_current_shard(_nshards)];
+    sh.lock.acquire();
+
+    Set &set = sh.sets[hash_mix64(key) & sh.mask];
+    Bucket *b = set.b, *victim = 0;
+    uint32_t victim_age = 0;
+    for (; b != set.b + ways; ++b) {
+	if (b->key == key)
+	    break;
+	uint32_t age = b->key == empty_key ? ~0U : now - b->time;
+	if (!victim || age > victim_age)
+	    victim = b, victim_age = age;
+    }
+
+    if (b != set.b + ways) {
+	uint32_t diff = now - b->time;
+	if (diff >= _rate.time_until_full())
+	    b->tokens = TokenRate::max_tokens;
+	else if (diff) {
+	    uint32_t t = b->tokens + diff * _rate.tokens_per_tick();
+	    b->tokens = t < b->tokens ? (uint32_t) TokenRate::max_tokens : t;
+	}
+    } else {
+	b = victim;
+	if (b->key == empty_key)
+	    sh.count++;
+	else
+	    sh.evictions++;
+	b->key = key;
+	b->tokens = TokenRate::max_tokens;
+    }
+    b->time = now;
+
+    uint64_t scale = _rate.token_scale();
+    bool ok = b->tokens >= need * scale;
+    if (ok)
+	b->tokens = cost * scale < b->tokens ? b->tokens - (uint32_t) (cost * scale) : 0;
+    else
+	sh.drops++;
+    sh.lock.release();
+    return ok;
+}
+
+CLICK_ENDDECLS
+#endif
@@ -64,6 +64,8 @@ FrontDropQueue::live_reconfigure(Vector<String> &conf, ErrorHandler *errh)
   _head = j;
   _tail = new_capacity;
   _capacity = new_capacity;
+  if (_hist)
+    reset_enq_times();
   return 0;
 }
 
@@ -88,6 +90,8 @@ FrontDropQueue::take_state(Element *e, ErrorHandler *errh)
     }
     _head = i;
     _highwater_length = size();
+    if (_hist)
+	reset_enq_times();
 
     if (j != q->head())
 	errh->warning("some packets lost (old length %d, new capacity %d)",
@@ -118,6 +122,7 @@ FrontDropQueue::push(int, Packet *p)
     }
 
     _q[_tail] = p;
+    note_enq(_tail, size(_head, next));
     _tail = next;
 
     int s = size();
@@ -76,6 +76,20 @@ FullNoteQueue::pull(int)
 	return pull_failure();
 }
 
+int
+FullNoteQueue::pull_bulk(Packet **ps, int n)
+{
+    if (int k = deq_bulk(ps, n)) {
+	_sleepiness = 0;
+	_full_note.wake();
+	return k;
+    } else {
+	if (n > 0)
+	    pull_failure();
+	return 0;
+    }
+}
+
 #if CLICK_DEBUG_SCHEDULING
 String
 FullNoteQueue::read_handler(Element *e, void *)
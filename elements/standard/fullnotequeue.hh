@@ -80,6 +80,7 @@ class FullNoteQueue : public NotifierQueue { public:
 
     void push(int port, Packet *p);
     Packet *pull(int port);
+    int pull_bulk(Packet **ps, int n);
 
   protected:
 
@@ -103,10 +104,11 @@ FullNoteQueue::push_success(Storage::index_type h, Storage::index_type t,
 			    Storage::index_type nt, Packet *p)
 {
     _q[t] = p;
+    int s = size(h, nt);
+    note_enq(t, s);
     packet_memory_barrier(_q[t], _tail);
     _tail = nt;
 
-    int s = size(h, nt);
     if (s > _highwater_length)
 	_highwater_length = s;
 
@@ -138,6 +140,7 @@ FullNoteQueue::pull_success(Storage::index_type h,
 			    Storage::index_type nh)
 {
     Packet *p = _q[h];
+    note_deq(h);
     packet_memory_barrier(_q[h], _head);
     _head = nh;
 
@@ -0,0 +1,611 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * htb.{cc,hh} -- element implements a hierarchical token bucket shaper
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "htb.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/straccum.hh>
+#include <click/integers.hh>
+#include <click/packet_anno.hh>
+#if CLICK_USERLEVEL
+# include <click/userutils.hh>
+#endif
+CLICK_DECLS
+
+// Tokens never fall below -max_buffer, and idle time beyond max_buffer
+// does not count.
+static const int64_t max_buffer = (int64_t) 60 * 1000000000;
+
+HTB::HTB()
+    : _ids(none), _default(none), _timer(this)
+{
+}
+
+HTB::~HTB()
+{
+}
+
+void *
+HTB::cast(const char *n)
+{
+    if (strcmp(n, Notifier::EMPTY_NOTIFIER) == 0)
+	return static_cast<Notifier *>(&_empty_note);
+    else
+	return Element::cast(n);
+}
+
+inline int64_t
+HTB::cost(uint64_t ns_per_byte, uint32_t len)
+{
+    return (int64_t) ((ns_per_byte * len) >> 16);
+}
+
+inline int64_t
+HTB::now_nsec()
+{
+    return Timestamp::now_steady().nsecval();
+}
+
+int
+HTB::parse_class(const String &spec, bool add, ErrorHandler *errh)
+{
+    Vector<String> words;
+    cp_spacevec(cp_unquote(spec), words);
+    uint32_t id, pid = 0, rate, ceil, burst = 0, cburst = 0;
+    if (words.size() < 3 || words.size() > 6
+	|| !IntArg().parse(words[0], id) || id == 0
+	|| (words[1] != "-" && (!IntArg().parse(words[1], pid) || pid == 0))
+	|| !BandwidthArg().parse(words[2], rate)
+	|| (words.size() > 3 && !BandwidthArg().parse(words[3], ceil))
+	|| (words.size() > 4 && !IntArg().parse(words[4], burst))
+	|| (words.size() > 5 && !IntArg().parse(words[5], cburst)))
+	return errh->error("bad class %<%s%>, expected %<ID PARENT RATE [CEIL [BURST [CBURST]]]%>", spec.c_str());
+    if (words.size() == 3)
+	ceil = rate;
+    if (rate == 0 || ceil < rate)
+	return errh->error("class %u: RATE must be positive and no more than CEIL", id);
+
+    int parent = none;
+    if (pid && (parent = _ids.get(pid)) == none)
+	return errh->error("class %u: no parent class %u", id, pid);
+
+    int c = _ids.get(id);
+    if (!add) {
+	if (c == none)
+	    return errh->error("no class %u", id);
+	if (_cls[c].parent != parent)
+	    return errh->error("class %u: cannot change parent", id);
+    } else if (c != none)
+	return errh->error("class %u already exists", id);
+    else {
+	if (parent != none) {
+	    htb_class &p = _cls[parent];
+	    if (!p.nchildren) {
+		// the parent leaf becomes an interior class
+		if (p.qlen)
+		    return errh->error("class %u: parent class %u has queued packets", id, pid);
+		if (parent == _default)
+		    return errh->error("class %u: parent class %u is the default class", id, pid);
+		int level = p.parent == none ? max_depth - 1 : _cls[p.parent].level - 1;
+		if (level < 1)
+		    return errh->error("class %u: tree too deep", id);
+		p.level = level;
+	    }
+	    p.nchildren++;
+	}
+
+	c = _cls.size();
+	_cls.push_back(htb_class());
+	htb_class &k = _cls.back();
+	memset(&k, 0, sizeof(k));
+	k.id = id;
+	k.parent = parent;
+	k.level = 0;
+	k.mode = can_send;
+	k.deficit = _quantum;
+	k.where = in_none;
+	k.next = k.prev = k.feed = none;
+	k.wnext = k.wprev = none;
+	_ids.set(id, c);
+    }
+
+    htb_class &k = _cls[c];
+    if (!burst)
+	burst = rate / 100 > 3028 ? rate / 100 : 3028;
+    if (!cburst)
+	cburst = ceil / 100 > 3028 ? ceil / 100 : 3028;
+    k.rate = rate;
+    k.ceil = ceil;
+    k.ns_per_byte = int_divide((uint64_t) 1000000000 << 16, rate);
+    k.cns_per_byte = int_divide((uint64_t) 1000000000 << 16, ceil);
+    k.buffer = int_divide((uint64_t) burst * 1000000000, rate);
+    k.cbuffer = int_divide((uint64_t) cburst * 1000000000, ceil);
+    if (add) {
+	k.tokens = k.buffer;
+	k.ctokens = k.cbuffer;
+	k.t_c = now_nsec();
+    } else {
+	if (k.tokens > k.buffer)
+	    k.tokens = k.buffer;
+	if (k.ctokens > k.cbuffer)
+	    k.ctokens = k.cbuffer;
+	update_mode(c, now_nsec());
+	schedule_wakeup();
+    }
+    return 0;
+}
+
+int
+HTB::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    _empty_note.initialize(Notifier::EMPTY_NOTIFIER, router());
+    _anno = AGGREGATE_ANNO_OFFSET;
+    _default_id = 0;
+    _limit = 1000;
+    _quantum = 1514;
+    Timestamp tick = Timestamp::make_usec(100);
+    if (Args(conf, this, errh)
+	.read_all_with("CLASS", AnyArg(), _class_specs)
+	.read("FILE", FilenameArg(), _filename)
+	.read("ANNO", AnnoArg(4), _anno)
+	.read("DEFAULT", _default_id)
+	.read("LIMIT", _limit)
+	.read("QUANTUM", _quantum)
+	.read("TICK", tick)
+	.complete() < 0)
+	return -1;
+    if (!tick)
+	return errh->error("TICK must be positive");
+    if (_quantum == 0)
+	return errh->error("QUANTUM must be positive");
+    _tick = tick.nsecval();
+
+    if (_filename) {
+#if CLICK_USERLEVEL
+	String text = file_string(_filename, errh);
+	if (!text && errh->nerrors())
+	    return -1;
+	for (int pos = 0; pos < text.length(); ) {
+	    int eol = text.find_left('\n', pos);
+	    if (eol < 0)
+		eol = text.length();
+	    String line = text.substring(pos, eol - pos).trim_space();
+	    if (line && line[0] != '#')
+		_class_specs.push_back(line);
+	    pos = eol + 1;
+	}
+#else
+	return errh->error("FILE is only supported at user level");
+#endif
+    }
+
+    int before = errh->nerrors();
+    for (String *s = _class_specs.begin(); s != _class_specs.end(); ++s)
+	parse_class(*s, true, errh);
+    if (errh->nerrors() != before)
+	return -1;
+
+    if (_default_id) {
+	_default = _ids.get(_default_id);
+	if (_default == none || _cls[_default].nchildren)
+	    return errh->error("DEFAULT must name a leaf class");
+    }
+    return 0;
+}
+
+int
+HTB::initialize(ErrorHandler *)
+{
+    int64_t now = now_nsec();
+    for (htb_class *k = _cls.begin(); k != _cls.end(); ++k)
+	k->t_c = now;
+    for (int i = 0; i < max_depth; ++i)
+	_row[i] = none;
+    for (int i = 0; i < wheel_size; ++i)
+	_wheel[i] = none;
+    _wheel_tick = now / _tick;
+    _qlen = _drops = 0;
+    _timer.initialize(this);
+    return 0;
+}
+
+void
+HTB::cleanup(CleanupStage)
+{
+    for (htb_class *k = _cls.begin(); k != _cls.end(); ++k)
+	while (Packet *p = k->head) {
+	    k->head = p->next();
+	    p->kill();
+	}
+}
+
+int
+HTB::class_mode(const htb_class &k, int64_t diff, int64_t &wait) const
+{
+    int64_t toks = k.ctokens + diff;
+    if (toks < 0) {
+	wait = -toks;
+	return cant_send;
+    }
+    toks = k.tokens + diff;
+    if (toks >= 0)
+	return can_send;
+    wait = -toks;
+    return may_borrow;
+}
+
+void
+HTB::list_insert(int &head, int c)
+{
+    htb_class &k = _cls[c];
+    if (head == none) {
+	head = k.next = k.prev = c;
+    } else {
+	int tail = _cls[head].prev;
+	k.next = head;
+	k.prev = tail;
+	_cls[tail].next = c;
+	_cls[head].prev = c;
+    }
+}
+
+void
+HTB::list_remove(int &head, int c)
+{
+    htb_class &k = _cls[c];
+    if (k.next == c)
+	head = none;
+    else {
+	_cls[k.prev].next = k.next;
+	_cls[k.next].prev = k.prev;
+	if (head == c)
+	    head = k.next;
+    }
+    k.next = k.prev = none;
+}
+
+void
+HTB::place(int c)
+{
+    // A class that wants to send sits in the row for its level if it can
+    // send at its own rate, or in its parent's feed if it must borrow.
+    htb_class &k = _cls[c];
+    bool wants = k.nchildren ? k.feed != none : k.qlen != 0;
+    int where = in_none;
+    if (wants && k.mode == can_send)
+	where = in_row;
+    else if (wants && k.mode == may_borrow && k.parent != none)
+	where = in_feed;
+    if (where == k.where)
+	return;
+
+    int old = k.where;
+    if (old == in_row)
+	list_remove(_row[k.level], c);
+    else if (old == in_feed) {
+	list_remove(_cls[k.parent].feed, c);
+	_cls[k.parent].nfeed--;
+    }
+    k.where = where;
+    if (where == in_row)
+	list_insert(_row[k.level], c);
+    else if (where == in_feed) {
+	list_insert(_cls[k.parent].feed, c);
+	_cls[k.parent].nfeed++;
+    }
+    if (old == in_feed || where == in_feed)
+	place(k.parent);
+}
+
+void
+HTB::rotate(int c)
+{
+    // Move c's row or feed on to its next class.  When a feed has gone all
+    // the way around, its owner moves on in its own row or feed, as in
+    // Linux's htb_lookup_leaf(), so that a subtree and its borrowing
+    // siblings share their ancestor's tokens.
+    while (1) {
+	htb_class &k = _cls[c];
+	if (k.where != in_feed) {
+	    _row[k.level] = k.next;
+	    return;
+	}
+	htb_class &p = _cls[k.parent];
+	p.feed = k.next;
+	if (++p.feed_turns < p.nfeed)
+	    return;
+	p.feed_turns = 0;
+	c = k.parent;
+    }
+}
+
+void
+HTB::wheel_insert(int c, int64_t wake)
+{
+    wheel_remove(c);
+    htb_class &k = _cls[c];
+    k.wake = wake;
+    int64_t t = wake / _tick;
+    if (t <= _wheel_tick)
+	t = _wheel_tick + 1;
+    k.wslot = t % wheel_size;
+    int &head = _wheel[k.wslot];
+    if (head == none)
+	head = k.wnext = k.wprev = c;
+    else {
+	int tail = _cls[head].wprev;
+	k.wnext = head;
+	k.wprev = tail;
+	_cls[tail].wnext = c;
+	_cls[head].wprev = c;
+    }
+}
+
+void
+HTB::wheel_remove(int c)
+{
+    htb_class &k = _cls[c];
+    if (k.wnext == none)
+	return;
+    int &head = _wheel[k.wslot];
+    if (k.wnext == c)
+	head = none;
+    else {
+	_cls[k.wprev].wnext = k.wnext;
+	_cls[k.wnext].wprev = k.wprev;
+	if (head == c)
+	    head = k.wnext;
+    }
+    k.wnext = k.wprev = none;
+}
+
+void
+HTB::wheel_advance(int64_t now)
+{
+    int64_t target = now / _tick;
+    if (target <= _wheel_tick)
+	return;
+    int64_t first = _wheel_tick + 1;
+    int64_t last = target - _wheel_tick > wheel_size ? first + wheel_size - 1 : target;
+    _wheel_tick = target;
+
+    for (int64_t t = first; t <= last; ++t) {
+	int &head = _wheel[t % wheel_size];
+	if (head == none)
+	    continue;
+	// Detach the slot, then wake its due classes and refile the rest.
+	int c = head;
+	_cls[_cls[c].wprev].wnext = none;
+	head = none;
+	while (c != none) {
+	    htb_class &k = _cls[c];
+	    int next = k.wnext;
+	    k.wnext = k.wprev = none;
+	    if (k.wake <= now)
+		update_mode(c, now);
+	    else
+		wheel_insert(c, k.wake);
+	    c = next;
+	}
+    }
+}
+
+void
+HTB::update_mode(int c, int64_t now)
+{
+    htb_class &k = _cls[c];
+    int64_t diff = now - k.t_c, wait = 0;
+    if (diff > max_buffer)
+	diff = max_buffer;
+    int mode = class_mode(k, diff, wait);
+    if (mode != k.mode) {
+	k.mode = mode;
+	place(c);
+    }
+    if (mode != can_send)
+	wheel_insert(c, now + wait);
+    else
+	wheel_remove(c);
+}
+
+void
+HTB::charge(int c, uint32_t len, int level, int64_t now)
+{
+    // Classes at or above the lender's level pay with their own tokens;
+    // classes below it borrowed.  Every class pays against its ceiling.
+    for (; c != none; c = _cls[c].parent) {
+	htb_class &k = _cls[c];
+	int64_t diff = now - k.t_c;
+	if (diff > max_buffer)
+	    diff = max_buffer;
+
+	int64_t toks = k.tokens + diff;
+	if (toks > k.buffer)
+	    toks = k.buffer;
+	if (k.level >= level)
+	    toks -= cost(k.ns_per_byte, len);
+	else
+	    k.borrows++;
+	k.tokens = toks > -max_buffer ? toks : 1 - max_buffer;
+
+	toks = k.ctokens + diff;
+	if (toks > k.cbuffer)
+	    toks = k.cbuffer;
+	toks -= cost(k.cns_per_byte, len);
+	k.ctokens = toks > -max_buffer ? toks : 1 - max_buffer;
+
+	k.t_c = now;
+	k.packets++;
+	k.bytes += len;
+	update_mode(c, now);
+    }
+}
+
+void
+HTB::drop(Packet *p)
+{
+    _drops++;
+    checked_output_push(1, p);
+}
+
+void
+HTB::schedule_wakeup()
+{
+    for (int i = 0; i < max_depth; ++i)
+	if (_row[i] != none) {
+	    _empty_note.wake();
+	    return;
+	}
+    if (!_qlen)
+	return;
+    // Wake at the next occupied tick.  That tick's classes may still be
+    // early, in which case run_timer() will reschedule.
+    for (int i = 1; i <= wheel_size; ++i)
+	if (_wheel[(_wheel_tick + i) % wheel_size] != none) {
+	    _timer.schedule_at_steady(Timestamp::make_nsec((_wheel_tick + i) * _tick));
+	    return;
+	}
+}
+
+void
+HTB::push(int, Packet *p)
+{
+    int c = _ids.get(p->anno_u32(_anno));
+    if (c == none || _cls[c].nchildren)
+	c = _default;
+    if (c == none) {
+	drop(p);
+	return;
+    }
+
+    htb_class &k = _cls[c];
+    if (k.qlen >= _limit) {
+	k.drops++;
+	drop(p);
+	return;
+    }
+    p->set_next(0);
+    if (k.tail)
+	k.tail->set_next(p);
+    else
+	k.head = p;
+    k.tail = p;
+    k.qlen++;
+    _qlen++;
+    if (k.qlen == 1) {
+	place(c);
+	schedule_wakeup();
+    }
+}
+
+Packet *
+HTB::pull(int)
+{
+    int64_t now = now_nsec();
+    wheel_advance(now);
+
+    // Prefer classes that send at their own rate (level 0), then classes
+    // that borrow from the lowest possible ancestor.
+    for (int level = 0; level < max_depth; ++level)
+	while (_row[level] != none) {
+	    int c = _row[level];
+	    while (_cls[c].nchildren)
+		c = _cls[c].feed;
+
+	    htb_class &k = _cls[c];
+	    if (k.deficit <= 0) {
+		k.deficit += _quantum;
+		rotate(c);
+		continue;
+	    }
+
+	    Packet *p = k.head;
+	    k.head = p->next();
+	    if (!k.head)
+		k.tail = 0;
+	    p->set_next(0);
+	    k.qlen--;
+	    _qlen--;
+	    k.deficit -= p->length();
+	    charge(c, p->length(), level, now);
+	    if (!k.qlen)
+		place(c);
+	    return p;
+	}
+
+    _empty_note.sleep();
+    schedule_wakeup();
+    return 0;
+}
+
+void
+HTB::run_timer(Timer *)
+{
+    wheel_advance(now_nsec());
+    schedule_wakeup();
+}
+
+enum { h_classes, h_length, h_drops, h_add_class, h_set_class };
+
+String
+HTB::read_handler(Element *e, void *thunk)
+{
+    HTB *htb = static_cast<HTB *>(e);
+    switch (reinterpret_cast<intptr_t>(thunk)) {
+    case h_classes: {
+	StringAccum sa;
+	for (htb_class *k = htb->_cls.begin(); k != htb->_cls.end(); ++k) {
+	    sa << k->id << ' ';
+	    if (k->parent == none)
+		sa << '-';
+	    else
+		sa << htb->_cls[k->parent].id;
+	    sa << ' ' << cp_unparse_bandwidth(k->rate)
+	       << ' ' << cp_unparse_bandwidth(k->ceil)
+	       << ' ' << k->qlen << ' ' << k->packets << ' ' << k->bytes
+	       << ' ' << k->drops << ' ' << k->borrows << '\n';
+	}
+	return sa.take_string();
+    }
+    case h_length:
+	return String(htb->_qlen);
+    case h_drops:
+	return String(htb->_drops);
+    default:
+	return String();
+    }
+}
+
+int
+HTB::write_handler(const String &str, Element *e, void *thunk, ErrorHandler *errh)
+{
+    HTB *htb = static_cast<HTB *>(e);
+    return htb->parse_class(str, reinterpret_cast<intptr_t>(thunk) == h_add_class, errh);
+}
+
+void
+HTB::add_handlers()
+{
+    add_read_handler("classes", read_handler, h_classes);
+    add_read_handler("length", read_handler, h_length);
+    add_read_handler("drops", read_handler, h_drops);
+    add_write_handler("add_class", write_handler, h_add_class);
+    add_write_handler("set_class", write_handler, h_set_class);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(int64)
+EXPORT_ELEMENT(HTB)
@@ -0,0 +1,252 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_HTB_HH
+#define CLICK_HTB_HH
+#include <click/element.hh>
+#include <click/timer.hh>
+#include <click/notifier.hh>
+#include <click/hashtable.hh>
+#include <click/vector.hh>
+CLICK_DECLS
+
+/*
+=c
+
+HTB([I<keywords> CLASS, FILE, ANNO, DEFAULT, LIMIT, QUANTUM, TICK])
+
+=s shaping
+
+hierarchical token bucket shaper
+
+=d
+
+Queues packets in a tree of traffic classes and releases them at the rates
+configured for each class, following the hierarchical token bucket (HTB)
+discipline.  A single HTB element can shape thousands of classes, such as
+one per subscriber, at constant cost per packet.
+
+Each class has a guaranteed RATE and a ceiling rate CEIL.  A class may send
+at up to RATE using its own tokens.  Once those are exhausted, it may borrow
+unused tokens from its ancestors, up to CEIL.  Classes without children are
+I<leaf> classes and hold packets; other classes only lend.  Among leaf
+classes that can send at the same level of the tree, HTB uses deficit round
+robin with QUANTUM bytes per round.  Classes borrowing from the same ancestor
+take turns too: a borrowing subtree moves on once each of its own borrowing
+classes has had a turn.
+
+Each class's token state lives in one array.  When a class runs out of
+tokens, HTB computes the time at which it can send again and files it in a
+timing wheel.  Only those classes are reexamined as time passes, so the cost
+of shaping does not grow with the number of idle or blocked classes.
+
+Packets are classified by the 4-byte annotation ANNO, which should hold the
+ID of a leaf class; for instance, AggregateIPFlows or a Script element can
+set it.  Packets whose annotation does not name a leaf class go to the
+DEFAULT class, or are dropped if there is no DEFAULT.  Dropped packets are
+emitted on output 1 if output 1 exists.
+
+Classes are specified by CLASS arguments, by lines in FILE, or by writing the
+C<add_class> handler.  Each specification has the form
+
+   ID PARENT RATE [CEIL [BURST [CBURST]]]
+
+ID is a positive integer naming the class.  PARENT is the ID of the parent
+class, or `C<->' for a root class.  RATE and CEIL are bandwidths (CEIL
+defaults to RATE); BURST and CBURST are the token bucket sizes for RATE and
+CEIL, in bytes.  They default to 10ms of traffic at the corresponding rate,
+and at least 3028 bytes.  Parent classes must be specified before their
+children.  The tree may be at most 8 levels deep.
+
+Keyword arguments are:
+
+=over 8
+
+=item CLASS
+
+A class specification.  May be given multiple times.
+
+=item FILE
+
+Filename.  Read class specifications from this file, one per line.  Blank
+lines and lines starting with `C<#>' are ignored.  User-level only.
+
+=item ANNO
+
+Annotation name.  The annotation holding the class ID.  Default is
+AGGREGATE.
+
+=item DEFAULT
+
+Integer.  The ID of the leaf class for unclassified packets.  Default is
+none.
+
+=item LIMIT
+
+Unsigned integer.  Maximum number of packets queued per leaf class.  Default
+is 1000.
+
+=item QUANTUM
+
+Unsigned integer.  Bytes per leaf class per round robin round.  Default is
+1514.
+
+=item TICK
+
+Time value.  Granularity of the timing wheel.  Default is 100us.
+
+=back
+
+=h classes read-only
+
+Returns one line per class, in the form `I<ID> I<PARENT> I<RATE> I<CEIL>
+I<LENGTH> I<PACKETS> I<BYTES> I<DROPS> I<BORROWS>'.  I<LENGTH> is the number
+of packets queued, I<PACKETS> and I<BYTES> count packets sent, and I<BORROWS>
+counts packets sent using tokens borrowed from an ancestor.
+
+=h length read-only
+
+Returns the total number of packets queued.
+
+=h drops read-only
+
+Returns the total number of packets dropped.
+
+=h add_class write-only
+
+Adds a class.  The argument is a class specification.  A new class's parent
+must be a leaf class with no queued packets, or a class that already has
+children.
+
+=h set_class write-only
+
+Changes the RATE, CEIL, BURST, and CBURST of an existing class.  The
+argument is a class specification; its PARENT must match the class's parent.
+
+=e
+
+  AggregateIP(ip dst) -> htb :: HTB(FILE subscribers.conf, DEFAULT 99)
+    -> ToDevice(eth0);
+
+with subscribers.conf:
+
+  # id  parent  rate     ceil
+  1     -       1Gbps
+  2     1       100Mbps  1Gbps
+  99    1       10Mbps   100Mbps
+  10    2       5Mbps    50Mbps
+  11    2       5Mbps    50Mbps
+
+=a BandwidthShaper, BandwidthRatedUnqueue, DRRSched, AggregateIP
+
+Linux HTB queueing discipline documentation,
+L<http://luxik.cdi.cz/~devik/qos/htb/>. */
+
+class HTB : public Element { public:
+
+    HTB();
+    ~HTB();
+
+    const char *class_name() const	{ return "HTB"; }
+    const char *port_count() const	{ return PORTS_1_1X2; }
+    const char *processing() const	{ return "h/lh"; }
+    void *cast(const char *);
+
+    int configure(Vector<String> &, ErrorHandler *);
+    int initialize(ErrorHandler *);
+    void cleanup(CleanupStage);
+    void add_handlers();
+
+    void push(int port, Packet *);
+    Packet *pull(int port);
+    void run_timer(Timer *);
+
+  private:
+
+    enum { max_depth = 8, wheel_size = 256, none = -1 };
+    enum { can_send = 0, may_borrow = 1, cant_send = 2 };
+    enum { in_none = 0, in_row = 1, in_feed = 2 };
+
+    struct htb_class {
+	uint32_t id;
+	int parent;
+	int level;		// 0 for leaves; roots have level max_depth - 1
+	int nchildren;
+
+	uint32_t rate;		// bytes per second
+	uint32_t ceil;
+	uint64_t ns_per_byte;	// 16 fractional bits
+	uint64_t cns_per_byte;
+	int64_t buffer;		// burst, in nanoseconds at RATE
+	int64_t cbuffer;	// burst, in nanoseconds at CEIL
+
+	int64_t tokens;		// in nanoseconds; negative when overdrawn
+	int64_t ctokens;
+	int64_t t_c;		// time of last token update
+	int mode;
+
+	Packet *head;		// leaf queue
+	Packet *tail;
+	uint32_t qlen;
+	int32_t deficit;
+
+	int where;		// in_none, in_row, or in_feed
+	int next;		// in row[level] or parent's feed
+	int prev;
+	int feed;		// children in may_borrow mode that want to send
+	int nfeed;		// number of children in feed
+	int feed_turns;		// feed rotations since it last wrapped
+
+	int wnext;		// in the timing wheel
+	int wprev;
+	int wslot;
+	int64_t wake;
+
+	uint64_t packets;
+	uint64_t bytes;
+	uint32_t drops;
+	uint32_t borrows;
+    };
+
+    Vector<htb_class> _cls;
+    HashTable<uint32_t, int> _ids;
+    int _row[max_depth];
+
+    int _wheel[wheel_size];
+    int64_t _tick;		// nanoseconds
+    int64_t _wheel_tick;	// last tick processed
+
+    int _anno;
+    uint32_t _default_id;
+    int _default;
+    uint32_t _limit;
+    uint32_t _quantum;
+    uint32_t _qlen;
+    uint32_t _drops;
+
+    Vector<String> _class_specs;
+    String _filename;
+    Timer _timer;
+    ActiveNotifier _empty_note;
+
+    int parse_class(const String &spec, bool add, ErrorHandler *errh);
+    static inline int64_t cost(uint64_t ns_per_byte, uint32_t len);
+    static inline int64_t now_nsec();
+    int class_mode(const htb_class &c, int64_t diff, int64_t &wait) const;
+    void list_insert(int &head, int c);
+    void list_remove(int &head, int c);
+    void place(int c);
+    void rotate(int c);
+    void wheel_insert(int c, int64_t wake);
+    void wheel_remove(int c);
+    void wheel_advance(int64_t now);
+    void update_mode(int c, int64_t now);
+    void charge(int c, uint32_t len, int level, int64_t now);
+    void drop(Packet *p);
+    void schedule_wakeup();
+
+    static String read_handler(Element *, void *);
+    static int write_handler(const String &, Element *, void *, ErrorHandler *);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -47,6 +47,7 @@ MixedQueue::push(int port, Packet *p)
 	    checked_output_push(1, p);
 	} else {
 	    _q[t] = p;
+	    note_enq(t, size(h, nt));
 	    packet_memory_barrier(_q[t], _tail);
 	    _tail = nt;
 	}
@@ -62,6 +63,7 @@ MixedQueue::push(int port, Packet *p)
 	    _tail = t;
 	}
 	_q[ph] = p;
+	note_enq(ph, size(ph, t));
 	packet_memory_barrier(_q[ph], _head);
 	_head = ph;
     }
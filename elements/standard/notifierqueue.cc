@@ -52,10 +52,11 @@ NotifierQueue::push(int, Packet *p)
 
     if (nt != h) {
 	_q[t] = p;
+	int s = size(h, nt);
+	note_enq(t, s);
 	packet_memory_barrier(_q[t], _tail);
 	_tail = nt;
 
-	int s = size(h, nt);
 	if (s > _highwater_length)
 	    _highwater_length = s;
 
@@ -91,6 +92,19 @@ NotifierQueue::pull(int)
     return p;
 }
 
+int
+NotifierQueue::pull_bulk(Packet **ps, int n)
+{
+    if (n <= 0)
+	return 0;
+    else if (int k = deq_bulk(ps, n)) {
+	_sleepiness = 0;
+	return k;
+    } else
+	// pull() takes care of going to sleep
+	return (ps[0] = pull(0)) != 0;
+}
+
 #if CLICK_DEBUG_SCHEDULING
 String
 NotifierQueue::read_handler(Element *e, void *)
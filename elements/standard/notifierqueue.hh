@@ -79,6 +79,7 @@ class NotifierQueue : public SimpleQueue { public:
 
     void push(int port, Packet *);
     Packet *pull(int port);
+    int pull_bulk(Packet **ps, int n);
 
 #if CLICK_DEBUG_SCHEDULING
     void add_handlers();
@@ -41,6 +41,7 @@ QuickNoteQueue::pull(int)
 
     if (h != t) {
 	p = _q[h];
+	note_deq(h);
 	packet_memory_barrier(_q[h], _head);
 	_head = h = next_i(h);
 	_full_note.wake();
@@ -61,6 +62,15 @@ QuickNoteQueue::pull(int)
     return p;
 }
 
+int
+QuickNoteQueue::pull_bulk(Packet **ps, int n)
+{
+    int k = 0;
+    while (k < n && (ps[k] = pull(0)))
+	++k;
+    return k;
+}
+
 CLICK_ENDDECLS
 ELEMENT_REQUIRES(FullNoteQueue)
 EXPORT_ELEMENT(QuickNoteQueue)
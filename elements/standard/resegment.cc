@@ -0,0 +1,84 @@
+// -*- mode: c++; c-basic-offset: 4 -*-
+/*
+ * resegment.{cc,hh} -- splits packet data into segments
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "resegment.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+CLICK_DECLS
+
+Resegment::Resegment()
+{
+}
+
+int
+Resegment::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    uint32_t length;
+    if (Args(conf, this, errh)
+	.read_mp("LENGTH", length)
+	.complete() < 0)
+	return -1;
+#if !CLICK_USERLEVEL
+    if (length)
+	return errh->error("segments require user level");
+#endif
+    _length = length;
+    return 0;
+}
+
+Packet *
+Resegment::simple_action(Packet *p)
+{
+    uint32_t seglen = _length;
+    if (!p->segmented() && p->length() <= seglen)
+	return p;
+    if (!(p = p->linearize()) || !seglen)
+	return p;
+
+#if CLICK_USERLEVEL
+    // Make segments that share the contiguous buffer.  Clone before
+    // shortening p, so that the clones see the whole buffer, and before
+    // appending segments, so that they don't get segments of their own.
+    Vector<Packet *> segs;
+    uint32_t len = p->length();
+    for (uint32_t off = seglen; off < len; off += seglen) {
+	Packet *s = p->clone();
+	if (!s) {
+	    for (Packet **sp = segs.begin(); sp != segs.end(); ++sp)
+		(*sp)->kill();
+	    p->kill();
+	    return 0;
+	}
+	s->change_headroom_and_length(p->headroom() + off,
+				      len - off < seglen ? len - off : seglen);
+	segs.push_back(s);
+    }
+    p->change_headroom_and_length(p->headroom(), seglen);
+    for (Packet **sp = segs.begin(); sp != segs.end(); ++sp)
+	p->append_segment(*sp);
+#endif
+    return p;
+}
+
+void
+Resegment::add_handlers()
+{
+    add_data_handlers("length", Handler::OP_READ | Handler::OP_WRITE, &_length);
+}
+
+CLICK_ENDDECLS
+EXPORT_ELEMENT(Resegment)
+ELEMENT_MT_SAFE(Resegment)
@@ -0,0 +1,67 @@
+// -*- mode: c++; c-basic-offset: 4 -*-
+#ifndef CLICK_RESEGMENT_HH
+#define CLICK_RESEGMENT_HH
+#include <click/element.hh>
+CLICK_DECLS
+
+/*
+ * =c
+ * Resegment(LENGTH)
+ * =s basicmod
+ * splits packet data into segments, or makes it contiguous
+ * =d
+ *
+ * Changes how each packet's data is laid out in memory without changing
+ * the data itself.  If LENGTH is 0, Resegment makes each packet's data
+ * contiguous.  Otherwise, it splits each packet longer than LENGTH bytes
+ * into a chain of segments, each at most LENGTH bytes long.
+ *
+ * At user level, large packets, such as jumbo frames and TSO/GSO
+ * aggregates, may be carried as chains of segments; FromDevice.u and
+ * KernelTun create them when configured with a SEGMENT_LENGTH.  Only
+ * elements that handle segments keep them: queues, Unqueue, Tee, Counter,
+ * Truncate, CheckIPHeader, IPEncap, IPFragmenter, Discard, ToDevice.u, and
+ * KernelTun.  A segmented packet passed to any other element is linearized
+ * first, so every element sees the whole packet, but the copy costs as much
+ * as receiving the packet contiguously.  Keep segment-handling elements on
+ * the path between the segmenting source and the device to avoid it.
+ *
+ * Splitting a contiguous packet copies no data: the new segments share the
+ * packet's buffer.  Segments are only available at user level; in other
+ * drivers, LENGTH must be 0 and Resegment passes packets through unchanged.
+ *
+ * =h length read/write
+ *
+ * Returns or sets the LENGTH argument.
+ *
+ * Since packets are linearized on their way into other elements, a
+ * Resegment(LENGTH) followed by such an element has no effect.
+ *
+ * =e
+ *
+ *   FromDevice(eth0, SEGMENT_LENGTH 2048) -> Queue -> ToDevice(eth1);
+ *
+ * =a FromDevice.u, KernelTun, ToDevice.u */
+
+class Resegment : public Element { public:
+
+    Resegment();
+
+    const char *class_name() const		{ return "Resegment"; }
+    const char *port_count() const		{ return PORTS_1_1; }
+    const char *flags() const			{ return "G"; }
+
+    int configure(Vector<String> &, ErrorHandler *);
+    bool can_live_reconfigure() const		{ return true; }
+    void add_handlers();
+
+    Packet *simple_action(Packet *);
+
+  private:
+
+    uint32_t _length;
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -115,7 +115,8 @@ Script::static_cleanup()
 }
 
 Script::Script()
-    : _type(type_active), _write_status(0), _timer(this), _cur_steps(0)
+    : _input_var(-1), _type(type_active), _write_status(0), _timer(this),
+      _cur_steps(0)
 {
 }
 
@@ -131,6 +132,7 @@ Script::add_insn(int insn, int arg, int arg2, const String &arg3)
     _args.push_back(arg);
     _args2.push_back(arg2);
     _args3.push_back(arg3);
+    _code.push_back(Code());
 }
 
 int
@@ -237,6 +239,16 @@ Script::configure(Vector<String> &conf, ErrorHandler *errh)
 	    break;
 	}
 
+#if CLICK_USERLEVEL
+	case insn_save:
+	case insn_append: {
+	    String word = cp_shift_spacevec(conf[i]);
+	    String file = (conf[i] ? conf[i] : String::make_stable("-", 1));
+	    add_insn(insn, 0, 0, (">>" + (insn == insn_save)) + file + " " + word);
+	    break;
+	}
+#endif
+
 	case INSN_WRITE:
 	case INSN_WRITEQ:
 	case INSN_READ:
@@ -245,10 +257,6 @@ Script::configure(Vector<String> &conf, ErrorHandler *errh)
 	case INSN_PRINTQ:
 	case INSN_PRINTN:
 	case INSN_PRINTNQ:
-#if CLICK_USERLEVEL
-	case insn_save:
-	case insn_append:
-#endif
 	case INSN_GOTO:
 	    add_insn(insn, 0, 0, conf[i]);
 	    break;
@@ -320,6 +328,94 @@ Script::configure(Vector<String> &conf, ErrorHandler *errh)
     return errh->nerrors() ? -1 : 0;
 }
 
+void
+Script::compile(int ipos)
+{
+    Code &c = _code[ipos];
+    String &text = _args3[ipos];
+    int insn = _insns[ipos];
+    int flags = 0;
+
+    switch (insn) {
+
+#if CLICK_USERLEVEL
+    case insn_save:
+    case insn_append:
+#endif
+    case INSN_PRINT:
+    case INSN_PRINTQ:
+    case INSN_PRINTN:
+    case INSN_PRINTNQ:
+	if (text.length() && text[0] == '>') {
+	    c.append = (text.length() > 1 && text[1] == '>');
+	    text = text.substring(1 + c.append);
+	    c.file = cp_shift_spacevec(text);
+	    if (!c.file)
+		c.file = String::make_stable("-", 1);
+	}
+	if (find(text, '$') != text.end())
+	    break;
+	if (!text || !(isalpha((unsigned char) text[0]) || text[0] == '@' || text[0] == '_')) {
+	    c.value = cp_unquote(text);
+	    c.constant = true;
+	    break;
+	}
+	flags = HandlerCall::OP_READ + ((insn == INSN_PRINTQ || insn == INSN_PRINTNQ) ? HandlerCall::UNQUOTE_PARAM : 0);
+	goto bind;
+
+    case INSN_READ:
+    case INSN_READQ:
+	flags = HandlerCall::OP_READ + (insn == INSN_READQ ? HandlerCall::UNQUOTE_PARAM : 0);
+	goto bind;
+
+    case INSN_WRITE:
+    case INSN_WRITEQ:
+	flags = HandlerCall::OP_WRITE + (insn == INSN_WRITEQ ? HandlerCall::UNQUOTE_PARAM : 0);
+    bind:
+	// Calls that fail to bind are left to run time, which reports errors.
+	if (find(text, '$') == text.end()) {
+	    c.call = HandlerCall(text);
+	    if (c.call.initialize(flags, this, 0) >= 0) {
+		c.value = c.call.unparse();
+		c.constant = true;
+	    } else
+		c.call = HandlerCall();
+	}
+	break;
+
+    case INSN_RETURN:
+    case insn_returnq:
+    case INSN_SET:
+    case insn_setq:
+    case insn_error:
+    case insn_errorq:
+	if (find(text, '$') == text.end()) {
+	    if (insn == insn_returnq || insn == insn_setq || insn == insn_errorq)
+		c.value = cp_unquote(text);
+	    else
+		c.value = text;
+	    c.constant = true;
+	}
+	break;
+
+    case INSN_GOTO:
+	if (find(text, '$') == text.end()) {
+	    bool cond = true;
+	    if (!text || BoolArg().parse(text, cond)) {
+		c.cond = cond;
+		c.constant = true;
+	    }
+	}
+	break;
+
+    case INSN_WAIT_TIME:
+	if (find(text, '$') == text.end() && cp_time(text, &c.time))
+	    c.constant = true;
+	break;
+
+    }
+}
+
 int
 Script::initialize(ErrorHandler *errh)
 {
@@ -335,6 +431,10 @@ Script::initialize(ErrorHandler *errh)
 	    _vars[_args[i] + 1] = cp_expand(_args3[i], expander);
 	else if (_insns[i] == insn_initq || _insns[i] == insn_exportq)
 	    _vars[_args[i] + 1] = cp_unquote(cp_expand(_args3[i], expander));
+	else
+	    compile(i);
+    if (_type == type_push)
+	_input_var = find_variable(String::make_stable("input", 5), true);
 
     int insn = _insns[_insn_pos];
     assert(insn == INSN_INITIAL || insn == INSN_WAIT_STEP || INSN_WAIT_TIME);
@@ -343,7 +443,9 @@ Script::initialize(ErrorHandler *errh)
 	/* passive, do nothing */;
     else if (insn == INSN_WAIT_TIME) {
 	Timestamp ts;
-	if (cp_time(cp_expand(_args3[_insn_pos], expander), &ts))
+	if (_code[_insn_pos].constant)
+	    _timer.schedule_after(_code[_insn_pos].time);
+	else if (cp_time(cp_expand(_args3[_insn_pos], expander), &ts))
 	    _timer.schedule_after(ts);
 	else
 	    errh->error("syntax error at %<wait%>");
@@ -381,6 +483,7 @@ Script::step(int nsteps, int step_type, int njumps, ErrorHandler *errh)
 	// or indirectly
 	int ipos = _insn_pos++;
 	int insn = _insns[ipos];
+	const Code &c = _code[ipos];
 
 	switch (insn) {
 
@@ -405,7 +508,10 @@ Script::step(int nsteps, int step_type, int njumps, ErrorHandler *errh)
 	case INSN_WAIT_TIME:
 	    if (_step_count == nsteps) {
 		Timestamp ts;
-		if (cp_time(cp_expand(_args3[ipos], expander), &ts)) {
+		if (c.constant) {
+		    _timer.schedule_after(c.time);
+		    _insn_pos--;
+		} else if (cp_time(cp_expand(_args3[ipos], expander), &ts)) {
 		    _timer.schedule_after(ts);
 		    _insn_pos--;
 		} else
@@ -425,41 +531,34 @@ Script::step(int nsteps, int step_type, int njumps, ErrorHandler *errh)
 
 #if CLICK_USERLEVEL
 	case insn_save:
-	case insn_append: {
-	    String word = cp_shift_spacevec(_args3[ipos]);
-	    String file = (_args3[ipos] ? _args3[ipos] : "-");
-	    _args3[ipos] = (">>" + (insn == insn_save)) + file + " " + word;
-	    /* FALLTHRU */
-	}
+	case insn_append:
 #endif
 	case INSN_PRINT:
 	case INSN_PRINTQ:
 	case INSN_PRINTN:
 	case INSN_PRINTNQ: {
-	    String text = _args3[ipos];
+	    const String &text = _args3[ipos];
 
 #if CLICK_USERLEVEL
 	    FILE *f = stdout;
-	    if (text.length() && text[0] == '>') {
-		bool append = (text.length() > 1 && text[1] == '>');
-		text = text.substring(1 + append);
-		String filename = cp_shift_spacevec(text);
-		if (filename && filename != "-"
-		    && !(f = fopen(filename.c_str(), append ? "ab" : "wb"))) {
-		    errh->error("%s: %s", filename.c_str(), strerror(errno));
-		    break;
-		}
+	    if (c.file && c.file != "-"
+		&& !(f = fopen(c.file.c_str(), c.append ? "ab" : "wb"))) {
+		errh->error("%s: %s", c.file.c_str(), strerror(errno));
+		break;
 	    }
 #else
-	    if (text.length() && text[0] == '>') {
+	    if (c.file)
 		errh->error("file redirection not supported here");
-		(void) cp_shift_spacevec(text);
-	    }
 #endif
 
 	    int before = errh->nerrors();
 	    String result;
-	    if (text && (isalpha((unsigned char) text[0]) || text[0] == '@' || text[0] == '_')) {
+	    if (c.call.initialized()) {
+		ContextErrorHandler c_errh(errh, "While calling %<%s%>:", c.value.c_str());
+		result = c.call.call_read(&c_errh);
+	    } else if (c.constant)
+		result = c.value;
+	    else if (text && (isalpha((unsigned char) text[0]) || text[0] == '@' || text[0] == '_')) {
 		HandlerCall hc(cp_expand(text, expander));
 		int flags = HandlerCall::OP_READ + ((insn == INSN_PRINTQ || insn == INSN_PRINTNQ) ? HandlerCall::UNQUOTE_PARAM : 0);
 		if (hc.initialize(flags, this, errh) >= 0) {
@@ -488,10 +587,12 @@ Script::step(int nsteps, int step_type, int njumps, ErrorHandler *errh)
 
 	case INSN_READ:
 	case INSN_READQ: {
-	    HandlerCall hc(cp_expand(_args3[ipos], expander));
+	    HandlerCall hc(c.call);
 	    int flags = HandlerCall::OP_READ + (insn == INSN_READQ ? HandlerCall::UNQUOTE_PARAM : 0);
-	    if (hc.initialize(flags, this, errh) >= 0) {
-		ContextErrorHandler c_errh(errh, "While calling %<%s%>:", hc.unparse().c_str());
+	    if (!c.constant)
+		hc = HandlerCall(cp_expand(_args3[ipos], expander));
+	    if (c.constant || hc.initialize(flags, this, errh) >= 0) {
+		ContextErrorHandler c_errh(errh, "While calling %<%s%>:", (c.constant ? c.value : hc.unparse()).c_str());
 		String result = hc.call_read(&c_errh);
 		ErrorHandler *d_errh = ErrorHandler::default_handler();
 		d_errh->message("%s:\n%.*s\n", hc.handler()->unparse_name(hc.element()).c_str(), result.length(), result.data());
@@ -501,6 +602,11 @@ Script::step(int nsteps, int step_type, int njumps, ErrorHandler *errh)
 
 	case INSN_WRITE:
 	case INSN_WRITEQ: {
+	    if (c.constant) {
+		ContextErrorHandler c_errh(errh, "While calling %<%s%>:", c.value.c_str());
+		_write_status = c.call.call_write(&c_errh);
+		break;
+	    }
 	    HandlerCall hc(cp_expand(_args3[ipos], expander));
 	    int flags = HandlerCall::OP_WRITE + (insn == INSN_WRITEQ ? HandlerCall::UNQUOTE_PARAM : 0);
 	    if (hc.initialize(flags, this, errh) >= 0) {
@@ -514,10 +620,13 @@ Script::step(int nsteps, int step_type, int njumps, ErrorHandler *errh)
 	case insn_returnq:
 	case INSN_SET:
 	case insn_setq: {
-	    expander.errh = errh;
-	    _vars[_args[ipos] + 1] = cp_expand(_args3[ipos], expander);
-	    if (insn == insn_setq || insn == insn_returnq)
-		_vars[_args[ipos] + 1] = cp_unquote(_vars[_args[ipos] + 1]);
+	    if (c.constant)
+		_vars[_args[ipos] + 1] = c.value;
+	    else {
+		_vars[_args[ipos] + 1] = cp_expand(_args3[ipos], expander);
+		if (insn == insn_setq || insn == insn_returnq)
+		    _vars[_args[ipos] + 1] = cp_unquote(_vars[_args[ipos] + 1]);
+	    }
 	    if ((insn == INSN_RETURN || insn == insn_returnq)
 		&& _insn_pos == ipos + 1) {
 		_insn_pos--;
@@ -528,11 +637,13 @@ Script::step(int nsteps, int step_type, int njumps, ErrorHandler *errh)
 
 	case INSN_GOTO: {
 	    // reset intervening instructions
-	    String cond_text = cp_expand(_args3[ipos], expander);
-	    bool cond;
+	    String cond_text;
+	    bool cond = c.cond;
+	    if (!c.constant)
+		cond_text = cp_expand(_args3[ipos], expander);
 	    if (cond_text && !BoolArg().parse(cond_text, cond))
 		errh->error("bad condition %<%s%>", cond_text.c_str());
-	    else if (!cond_text || cond) {
+	    else if (c.constant ? cond : (!cond_text || cond)) {
 		if (_args[ipos] < 0)
 		    goto insn_finish;
 		for (int i = _args[ipos]; i < ipos; i++)
@@ -545,9 +656,12 @@ Script::step(int nsteps, int step_type, int njumps, ErrorHandler *errh)
 
 	case insn_error:
 	case insn_errorq: {
-	    String msg = cp_expand(_args3[ipos], expander);
-	    if (insn == insn_errorq)
-		msg = cp_unquote(msg);
+	    String msg = c.value;
+	    if (!c.constant) {
+		msg = cp_expand(_args3[ipos], expander);
+		if (insn == insn_errorq)
+		    msg = cp_unquote(msg);
+	    }
 	    if (msg)
 		errh->error("%.*s", msg.length(), msg.data());
 	    /* fallthru */
@@ -629,9 +743,7 @@ Script::push(int port, Packet *p)
     ErrorHandler *errh = ErrorHandler::default_handler();
     ContextErrorHandler cerrh(errh, "While executing %<%p{element}%>:", this);
 
-    // This is slow, but it probably doesn't need to be fast.
-    int i = find_variable(String::make_stable("input", 5), true);
-    _vars[i + 1] = String(port);
+    _vars[_input_var + 1] = String(port);
 
     _insn_pos = 0;
     step(0, STEP_JUMP, 0, &cerrh);
@@ -653,9 +765,7 @@ Script::pull(int)
     ErrorHandler *errh = ErrorHandler::default_handler();
     ContextErrorHandler cerrh(errh, "While executing %<%p{element}%>:", this);
 
-    // This is slow, but it probably doesn't need to be fast.
-    int i = find_variable(String::make_stable("input", 5), true);
-    _vars[i + 1] = String::make_stable("0", 1);
+    _vars[_input_var + 1] = String::make_stable("0", 1);
 
     _insn_pos = 0;
     step(0, STEP_JUMP, 0, &cerrh);
@@ -729,15 +839,39 @@ Script::Expander::expand(const String &vname, String &out, int vartype, int) con
 	return true;
     }
 
-    if (vartype == '(') {
-	HandlerCall hc(vname);
-	if (hc.initialize_read(script, errh) >= 0) {
-	    out = hc.call_read(errh);
-	    return true;
+    if (vartype == '(' && script->call_read(vname, out, errh))
+	return true;
+
+    return false;
+}
+
+bool
+Script::call_read(const String &hdesc, String &result, ErrorHandler *errh)
+{
+    // $(HANDLER PARAMS) expansions are evaluated on every step, so bind
+    // handler names once and reuse the bindings.
+    String params = hdesc;
+    String hname = cp_shift_spacevec(params);
+    HandlerCall *hc = _read_calls.get_pointer(hname);
+    if (!hc) {
+	HandlerCall call(hname);
+	if (call.initialize_read(this, 0) >= 0) {
+	    _read_calls.set(hname, call);
+	    hc = _read_calls.get_pointer(hname);
 	}
     }
+    if (hc && (!params || hc->handler()->read_param())) {
+	result = hc->handler()->call_read(hc->element(), params, errh);
+	return true;
+    }
 
-    return false;
+    // report errors
+    HandlerCall call(hdesc);
+    if (call.initialize_read(this, errh) >= 0) {
+	result = call.call_read(errh);
+	return true;
+    } else
+	return false;
 }
 
 int
@@ -4,6 +4,8 @@
 #include <click/element.hh>
 #include <click/timer.hh>
 #include <click/variableenv.hh>
+#include <click/handlercall.hh>
+#include <click/hashtable.hh>
 CLICK_DECLS
 
 /*
@@ -289,6 +291,13 @@ the element name.  Thus, "$(s.add ...)" can be written "$(add ...)", as below.
 	  goto begin_loop $(lt $x 5),
 	  stop);
 
+Script compiles its instructions at initialization time.  Instructions whose
+text contains no 'C<$>' are parsed once, and their handler calls are bound to
+the named handlers then; handler names in 'C<$(...)>' blocks are likewise
+looked up only the first time they are used.  Constant instructions, such as
+'C<write c.reset>' or 'C<wait 10ms>', thus cost little more than the handler
+call itself.
+
 =h step write-only
 
 Advance the instruction pointer past the current blocking instruction (C<pause> or C<wait>).  A numeric argument will step past that many blocking instructions.
@@ -488,7 +497,27 @@ class Script : public Element { public:
     Vector<int> _args2;
     Vector<String> _args3;
 
+    // Compiled form of each instruction.  Arguments without variables are
+    // expanded, and their handler calls bound, once at initialization, so
+    // executing them need not reparse the instruction text.
+    struct Code {
+	HandlerCall call;	// bound handler call, if call.initialized()
+	String value;		// expanded argument, if constant, or bound
+				// call's description
+	Timestamp time;		// WAIT_TIME interval, if constant
+	String file;		// print redirection, if any
+	bool append : 1;	// redirection appends
+	bool constant : 1;	// argument contains no variables
+	bool cond : 1;		// GOTO condition, if constant
+	Code()
+	    : append(false), constant(false), cond(false) {
+	}
+    };
+    Vector<Code> _code;
+    HashTable<String, HandlerCall> _read_calls;	// for $(handler) expansions
+
     Vector<String> _vars;
+    int _input_var;
     String _run_handler_name;
     String _run_args;
     int _run_op;
@@ -527,6 +556,8 @@ class Script : public Element { public:
     int complete_step(String *retval);
     int find_label(const String &) const;
     int find_variable(const String &name, bool add);
+    void compile(int ipos);
+    bool call_read(const String &hdesc, String &result, ErrorHandler *errh);
 
     static int step_handler(int, String&, Element*, const Handler*, ErrorHandler*);
     enum { error_one_number, error_two_numbers };
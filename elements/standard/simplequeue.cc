@@ -20,10 +20,12 @@
 #include "simplequeue.hh"
 #include <click/args.hh>
 #include <click/error.hh>
+#include <click/llrpc.h>
+#include <click/straccum.hh>
 CLICK_DECLS
 
 SimpleQueue::SimpleQueue()
-    : _q(0)
+    : _q(0), _histograms(false), _hist(0)
 {
 }
 
@@ -43,9 +45,16 @@ int
 SimpleQueue::configure(Vector<String> &conf, ErrorHandler *errh)
 {
     unsigned new_capacity = 1000;
-    if (Args(conf, this, errh).read_p("CAPACITY", new_capacity).complete() < 0)
+    bool histograms = false;
+    if (Args(conf, this, errh)
+	.read_p("CAPACITY", new_capacity)
+	.read("HISTOGRAMS", histograms)
+	.complete() < 0)
 	return -1;
+    if (_q && histograms != _histograms)
+	return errh->error("HISTOGRAMS cannot change at run time");
     _capacity = new_capacity;
+    _histograms = histograms;
     return 0;
 }
 
@@ -58,9 +67,34 @@ SimpleQueue::initialize(ErrorHandler *errh)
 	return errh->error("out of memory");
     _drops = 0;
     _highwater_length = 0;
+    if (_histograms) {
+	_hist = new histograms;
+	if (!_hist)
+	    return errh->error("out of memory");
+	memset(_hist->occupancy, 0, sizeof(_hist->occupancy));
+	memset(_hist->sojourn, 0, sizeof(_hist->sojourn));
+	_hist->enq_time = 0;
+	reset_enq_times();
+	if (!_hist->enq_time)
+	    return errh->error("out of memory");
+    }
     return 0;
 }
 
+void
+SimpleQueue::reset_enq_times()
+{
+    // Called when the queue is resized or takes another queue's packets.
+    // Sojourn times for packets already enqueued count from now.
+    delete[] _hist->enq_time;
+    _hist->enq_time = new Timestamp[_capacity + 1];
+    if (_hist->enq_time) {
+	Timestamp now = Timestamp::now_steady();
+	for (Storage::index_type i = 0; i <= _capacity; ++i)
+	    _hist->enq_time[i] = now;
+    }
+}
+
 int
 SimpleQueue::live_reconfigure(Vector<String> &conf, ErrorHandler *errh)
 {
@@ -89,6 +123,8 @@ SimpleQueue::live_reconfigure(Vector<String> &conf, ErrorHandler *errh)
     _head = 0;
     _tail = j;
     _capacity = new_capacity;
+    if (_hist)
+	reset_enq_times();
     return 0;
 }
 
@@ -113,6 +149,8 @@ SimpleQueue::take_state(Element *e, ErrorHandler *errh)
     }
     _tail = i;
     _highwater_length = size();
+    if (_hist)
+	reset_enq_times();
 
     if (j != q->_tail)
 	errh->warning("some packets lost (old length %d, new capacity %d)",
@@ -132,6 +170,11 @@ SimpleQueue::cleanup(CleanupStage)
 	_q[i]->kill();
     CLICK_LFREE(_q, sizeof(Packet *) * (_capacity + 1));
     _q = 0;
+    if (_hist) {
+	delete[] _hist->enq_time;
+	delete _hist;
+	_hist = 0;
+    }
 }
 
 void
@@ -144,10 +187,11 @@ SimpleQueue::push(int, Packet *p)
     // should this stuff be in SimpleQueue::enq?
     if (nt != h) {
 	_q[t] = p;
+	int s = size(h, nt);
+	note_enq(t, s);
 	packet_memory_barrier(_q[t], _tail);
 	_tail = nt;
 
-	int s = size(h, nt);
 	if (s > _highwater_length)
 	    _highwater_length = s;
 
@@ -166,6 +210,12 @@ SimpleQueue::pull(int)
     return deq();
 }
 
+int
+SimpleQueue::pull_bulk(Packet **ps, int n)
+{
+    return deq_bulk(ps, n);
+}
+
 
 String
 SimpleQueue::read_handler(Element *e, void *thunk)
@@ -181,11 +231,28 @@ SimpleQueue::read_handler(Element *e, void *thunk)
 	return String(q->capacity());
       case 3:
 	return String(q->_drops);
+      case 4:
+	return unparse_histogram(q->_hist->occupancy);
+      case 5:
+	return unparse_histogram(q->_hist->sojourn);
       default:
 	return "";
     }
 }
 
+String
+SimpleQueue::unparse_histogram(const uint64_t *buckets)
+{
+    StringAccum sa;
+    for (int i = 0; i < histograms::nbuckets; ++i)
+	if (buckets[i]) {
+	    uint64_t lo = i ? (uint64_t) 1 << (i - 1) : 0;
+	    uint64_t hi = i ? ((uint64_t) 1 << i) - 1 : 0;
+	    sa << lo << '-' << hi << ' ' << buckets[i] << '\n';
+	}
+    return sa.take_string();
+}
+
 void
 SimpleQueue::reset()
 {
@@ -202,6 +269,10 @@ SimpleQueue::write_handler(const String &, Element *e, void *thunk, ErrorHandler
       case 0:
 	q->_drops = 0;
 	q->_highwater_length = q->size();
+	if (q->_hist) {
+	    memset(q->_hist->occupancy, 0, sizeof(q->_hist->occupancy));
+	    memset(q->_hist->sojourn, 0, sizeof(q->_hist->sojourn));
+	}
 	return 0;
       case 1:
 	q->reset();
@@ -218,11 +289,46 @@ SimpleQueue::add_handlers()
     add_read_handler("highwater_length", read_handler, 1);
     add_read_handler("capacity", read_handler, 2, Handler::CALM);
     add_read_handler("drops", read_handler, 3);
+    if (_histograms) {
+	add_read_handler("occupancy_histogram", read_handler, 4);
+	add_read_handler("sojourn_histogram", read_handler, 5);
+    }
     add_write_handler("capacity", reconfigure_keyword_handler, "0 CAPACITY");
     add_write_handler("reset_counts", write_handler, 0, Handler::BUTTON | Handler::NONEXCLUSIVE);
     add_write_handler("reset", write_handler, 1, Handler::BUTTON);
 }
 
+#if CLICK_USERLEVEL
+uint64_t
+SimpleQueue::length_stat(const void *thunk)
+{
+    return static_cast<const SimpleQueue *>(thunk)->size();
+}
+#endif
+
+int
+SimpleQueue::llrpc(unsigned command, void *data)
+{
+#if CLICK_USERLEVEL
+    if (command == CLICK_LLRPC_EXPORT_STAT) {
+	click_llrpc_export_stat_st *es = (click_llrpc_export_stat_st *) data;
+	es->addr = 0;
+	es->size = sizeof(int);
+	if (strcmp(es->name, "length") == 0) {
+	    es->read = length_stat;
+	    es->thunk = this;
+	} else if (strcmp(es->name, "highwater_length") == 0)
+	    es->addr = &_highwater_length;
+	else if (strcmp(es->name, "drops") == 0)
+	    es->addr = &_drops;
+	else
+	    return -EINVAL;
+	return 0;
+    }
+#endif
+    return Element::llrpc(command, data);
+}
+
 CLICK_ENDDECLS
 ELEMENT_PROVIDES(Storage)
 EXPORT_ELEMENT(SimpleQueue)
@@ -3,13 +3,14 @@
 #define CLICK_SIMPLEQUEUE_HH
 #include <click/element.hh>
 #include <click/standard/storage.hh>
+#include <click/integers.hh>
 CLICK_DECLS
 
 /*
 =c
 
 SimpleQueue
-SimpleQueue(CAPACITY)
+SimpleQueue(CAPACITY [, I<keywords> HISTOGRAMS])
 
 =s storage
 
@@ -21,6 +22,23 @@ Stores incoming packets in a first-in-first-out queue.
 Drops incoming packets if the queue already holds CAPACITY packets.
 The default for CAPACITY is 1000.
 
+Keyword arguments are:
+
+=over 8
+
+=item CAPACITY
+
+Unsigned integer. Same as the CAPACITY argument.
+
+=item HISTOGRAMS
+
+Boolean. If true, the queue keeps occupancy and sojourn-time histograms,
+available through the C<occupancy_histogram> and C<sojourn_histogram>
+handlers.  This costs a clock read per enqueued and dequeued packet.
+Default is false.
+
+=back
+
 B<Multithreaded Click note:> SimpleQueue is designed to be used in an
 environment with at most one concurrent pusher and at most one concurrent
 puller.  Thus, at most one thread pushes to the SimpleQueue at a time and at
@@ -54,12 +72,38 @@ are emitted on output 1 if output 1 exists.
 
 =h reset_counts write-only
 
-When written, resets the C<drops> and C<highwater_length> counters.
+When written, resets the C<drops> and C<highwater_length> counters and any
+histograms.
 
 =h reset write-only
 
 When written, drops all packets in the queue.
 
+=h occupancy_histogram read-only
+
+Present only if HISTOGRAMS is true.  Returns a histogram of the queue's
+length, sampled after each enqueue.  Each line has the form `I<LOW>-I<HIGH>
+I<COUNT>', meaning I<COUNT> enqueues left between I<LOW> and I<HIGH>
+packets in the queue, inclusive.  Buckets are powers of two; empty buckets
+are omitted.
+
+=h sojourn_histogram read-only
+
+Present only if HISTOGRAMS is true.  Returns a histogram of the time
+dequeued packets spent in the queue, in microseconds, in the same format as
+C<occupancy_histogram>.
+
+=h CLICK_LLRPC_EXPORT_STAT llrpc
+
+User-level only.  Exports the C<length>, C<highwater_length>, and C<drops>
+statistics to ShmCounters; see <click/llrpc.h>.
+
+=n
+
+Elements that pull from a queue in bursts, such as Unqueue, can use
+SimpleQueue's pull_bulk() method to dequeue several packets at once.  This
+reads the producer's index once per burst rather than once per packet.
+
 =a Queue, NotifierQueue, MixedQueue, RED, FrontDropQueue, ThreadSafeQueue */
 
 class SimpleQueue : public Element, public Storage { public:
@@ -72,6 +116,8 @@ class SimpleQueue : public Element, public Storage { public:
     inline bool enq(Packet*);
     inline void lifo_enq(Packet*);
     inline Packet* deq();
+    inline int enq_bulk(Packet **ps, int n);
+    inline int deq_bulk(Packet **ps, int n);
 
     // to be used with care
     Packet* packet(int i) const			{ return _q[i]; }
@@ -84,6 +130,7 @@ class SimpleQueue : public Element, public Storage { public:
     const char *class_name() const		{ return "SimpleQueue"; }
     const char *port_count() const		{ return PORTS_1_1X2; }
     const char *processing() const		{ return "h/lh"; }
+    const char *flags() const			{ return "G"; }
     void* cast(const char*);
 
     int configure(Vector<String>&, ErrorHandler*);
@@ -93,14 +140,32 @@ class SimpleQueue : public Element, public Storage { public:
     int live_reconfigure(Vector<String>&, ErrorHandler*);
     void take_state(Element*, ErrorHandler*);
     void add_handlers();
+    int llrpc(unsigned, void *);
 
     void push(int port, Packet*);
     Packet* pull(int port);
 
+    /** @brief Pull up to @a n packets into @a ps.
+     * @return the number of packets pulled
+     *
+     * Acts like up to @a n calls to pull(0), including any notification.
+     * Subclasses that override pull() should override pull_bulk() too. */
+    virtual int pull_bulk(Packet **ps, int n);
+
   protected:
 
+    struct histograms {
+	enum { nbuckets = 33 };
+	Timestamp *enq_time;
+	uint64_t occupancy[nbuckets];
+	uint64_t sojourn[nbuckets] CLICK_ALIGNED(CLICK_CACHE_LINE_SIZE);
+    };
+
     Packet* volatile * _q;
-    volatile int _drops;
+    bool _histograms;
+    histograms *_hist;
+    // _drops and _highwater_length are written by the producer.
+    volatile int _drops CLICK_ALIGNED(CLICK_CACHE_LINE_SIZE);
     int _highwater_length;
 
     friend class MixedQueue;
@@ -110,10 +175,53 @@ class SimpleQueue : public Element, public Storage { public:
 
     static String read_handler(Element*, void*);
     static int write_handler(const String&, Element*, void*, ErrorHandler*);
+#if CLICK_USERLEVEL
+    static uint64_t length_stat(const void *);
+#endif
+
+    static inline int histogram_bucket(uint64_t x);
+    inline void note_enq(Storage::index_type t, int s);
+    inline void note_deq(Storage::index_type h, const Timestamp &now);
+    inline void note_deq(Storage::index_type h);
+    void reset_enq_times();
+    static String unparse_histogram(const uint64_t *buckets);
 
 };
 
 
+inline int
+SimpleQueue::histogram_bucket(uint64_t x)
+{
+    // bucket 0 holds 0; bucket i holds [2^(i-1), 2^i)
+    if (x > 0xFFFFFFFFU)
+	return histograms::nbuckets - 1;
+    return x ? 33 - ffs_msb((uint32_t) x) : 0;
+}
+
+inline void
+SimpleQueue::note_enq(Storage::index_type t, int s)
+{
+    if (unlikely(_hist)) {
+	_hist->enq_time[t] = Timestamp::now_steady();
+	_hist->occupancy[histogram_bucket(s)]++;
+    }
+}
+
+inline void
+SimpleQueue::note_deq(Storage::index_type h, const Timestamp &now)
+{
+    Timestamp::value_type us = (now - _hist->enq_time[h]).usecval();
+    _hist->sojourn[histogram_bucket(us > 0 ? us : 0)]++;
+}
+
+inline void
+SimpleQueue::note_deq(Storage::index_type h)
+{
+    if (unlikely(_hist))
+	note_deq(h, Timestamp::now_steady());
+}
+
+
 inline bool
 SimpleQueue::enq(Packet *p)
 {
@@ -121,9 +229,10 @@ SimpleQueue::enq(Packet *p)
     Storage::index_type h = _head, t = _tail, nt = next_i(t);
     if (nt != h) {
 	_q[t] = p;
+	int s = size(h, nt);
+	note_enq(t, s);
 	packet_memory_barrier(_q[t], _tail);
 	_tail = nt;
-	int s = size(h, nt);
 	if (s > _highwater_length)
 	    _highwater_length = s;
 	return true;
@@ -147,6 +256,7 @@ SimpleQueue::lifo_enq(Packet *p)
 	_tail = t;
     }
     _q[ph] = p;
+    note_enq(ph, size(ph, t));
     packet_memory_barrier(_q[ph], _head);
     _head = ph;
 }
@@ -157,6 +267,7 @@ SimpleQueue::deq()
     Storage::index_type h = _head, t = _tail;
     if (h != t) {
 	Packet *p = _q[h];
+	note_deq(h);
 	packet_memory_barrier(_q[h], _head);
 	_head = next_i(h);
 	assert(p);
@@ -165,6 +276,50 @@ SimpleQueue::deq()
 	return 0;
 }
 
+inline int
+SimpleQueue::enq_bulk(Packet **ps, int n)
+    /* Enqueue as many of the @a n packets in @a ps as fit, in order, and
+       return how many were enqueued.  Unlike enq(), packets that do not fit
+       are neither killed nor counted as drops. */
+{
+    Storage::index_type h = _head, t = _tail, nt;
+    int k = 0;
+    for (; k < n && (nt = next_i(t)) != h; ++k, t = nt) {
+	_q[t] = ps[k];
+	note_enq(t, size(h, nt));
+    }
+    if (k) {
+	packet_memory_barrier(_q[prev_i(t)], _tail);
+	_tail = t;
+	int s = size(h, t);
+	if (s > _highwater_length)
+	    _highwater_length = s;
+    }
+    return k;
+}
+
+inline int
+SimpleQueue::deq_bulk(Packet **ps, int n)
+    /* Dequeue up to @a n packets into @a ps and return how many were
+       dequeued.  The producer's index is read once. */
+{
+    Storage::index_type h = _head, t = _tail;
+    int k = 0;
+    if (unlikely(_hist) && h != t) {
+	Timestamp now = Timestamp::now_steady();
+	for (Storage::index_type x = h; k < n && x != t; ++k, x = next_i(x))
+	    note_deq(x, now);
+	k = 0;
+    }
+    for (; k < n && h != t; ++k, h = next_i(h))
+	ps[k] = _q[h];
+    if (k) {
+	packet_memory_barrier(_q[prev_i(h)], _head);
+	_head = h;
+    }
+    return k;
+}
+
 template <typename Filter>
 Packet *
 SimpleQueue::yank1(Filter filter)
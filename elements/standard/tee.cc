@@ -29,10 +29,18 @@ int
 Tee::configure(Vector<String> &conf, ErrorHandler *errh)
 {
     unsigned n = noutputs();
-    if (Args(conf, this, errh).read_p("N", n).complete() < 0)
+    _cow_header = 0;
+    if (Args(conf, this, errh)
+	.read_p("N", n)
+	.read("COW_HEADER", _cow_header)
+	.complete() < 0)
 	return -1;
     if (n != (unsigned) noutputs())
 	return errh->error("%d outputs implies %d arms", noutputs(), noutputs());
+#if !CLICK_USERLEVEL
+    if (_cow_header)
+	return errh->error("COW_HEADER requires user level");
+#endif
     return 0;
 }
 
@@ -40,6 +48,8 @@ void
 Tee::push(int, Packet *p)
 {
   int n = noutputs();
+  if (_cow_header)
+    p->set_cow_header_length(_cow_header);
   for (int i = 0; i < n - 1; i++)
     if (Packet *q = p->clone())
       output(i).push(q);
@@ -58,10 +68,18 @@ int
 PullTee::configure(Vector<String> &conf, ErrorHandler *errh)
 {
     unsigned n = noutputs();
-    if (Args(conf, this, errh).read_p("N", n).complete() < 0)
+    _cow_header = 0;
+    if (Args(conf, this, errh)
+	.read_p("N", n)
+	.read("COW_HEADER", _cow_header)
+	.complete() < 0)
 	return -1;
     if (n != (unsigned) noutputs())
 	return errh->error("%d outputs implies %d arms", noutputs(), noutputs());
+#if !CLICK_USERLEVEL
+    if (_cow_header)
+	return errh->error("COW_HEADER requires user level");
+#endif
     return 0;
 }
 
@@ -71,6 +89,8 @@ PullTee::pull(int)
   Packet *p = input(0).pull();
   if (p) {
     int n = noutputs();
+    if (_cow_header)
+      p->set_cow_header_length(_cow_header);
     for (int i = 1; i < n; i++)
       if (Packet *q = p->clone())
 	output(i).push(q);
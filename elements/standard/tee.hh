@@ -5,9 +5,9 @@ CLICK_DECLS
 
 /*
  * =c
- * Tee([N])
+ * Tee([N, I<keywords> COW_HEADER])
  *
- * PullTee([N])
+ * PullTee([N, I<keywords> COW_HEADER])
  * =s basictransfer
  * duplicates packets
  * =d
@@ -20,6 +20,27 @@ CLICK_DECLS
  * Tee and PullTee have however many outputs are used in the configuration,
  * but you can say how many outputs you expect with the optional argument
  * N.
+ *
+ * Keyword arguments are:
+ *
+ * =over 8
+ *
+ * =item COW_HEADER
+ *
+ * Unsigned.  If nonzero, turns on header-only copy-on-write for the copies
+ * (user level only).  When a downstream element writes a copy, as EtherEncap,
+ * DecIPTTL, or SetIPChecksum do, only the first COW_HEADER bytes of data,
+ * plus the packet's headroom and its network and transport headers, are
+ * copied; the rest of the data stays shared as a read-only segment.  This
+ * suits mirroring and multicast paths that rewrite only headers.  The copies
+ * are segmented packets (see Resegment), so the payload stays shared only
+ * while they pass through elements that handle segments; other elements,
+ * such as Print or ToDump, receive a linearized copy of the whole packet.
+ * Default is 0.
+ *
+ * =back
+ *
+ * =a Resegment
  */
 
 class Tee : public Element {
@@ -31,11 +52,16 @@ class Tee : public Element {
   const char *class_name() const		{ return "Tee"; }
   const char *port_count() const		{ return "1/1-"; }
   const char *processing() const		{ return PUSH; }
+  const char *flags() const			{ return "G"; }
 
   int configure(Vector<String> &, ErrorHandler *);
 
   void push(int, Packet *);
 
+ private:
+
+  uint32_t _cow_header;
+
 };
 
 class PullTee : public Element {
@@ -47,11 +73,16 @@ class PullTee : public Element {
   const char *class_name() const		{ return "PullTee"; }
   const char *port_count() const		{ return "1/1-"; }
   const char *processing() const		{ return "l/lh"; }
+  const char *flags() const			{ return "G"; }
 
   int configure(Vector<String> &, ErrorHandler *);
 
   Packet *pull(int);
 
+ private:
+
+  uint32_t _cow_header;
+
 };
 
 CLICK_ENDDECLS
@@ -89,6 +89,16 @@ ThreadSafeQueue::pull(int)
     }
 }
 
+int
+ThreadSafeQueue::pull_bulk(Packet **ps, int n)
+{
+    // Each packet needs its own slot reservation.
+    int k = 0;
+    while (k < n && (ps[k] = pull(0)))
+	++k;
+    return k;
+}
+
 CLICK_ENDDECLS
 ELEMENT_REQUIRES(FullNoteQueue)
 EXPORT_ELEMENT(ThreadSafeQueue)
@@ -62,6 +62,7 @@ class ThreadSafeQueue : public FullNoteQueue { public:
 
     void push(int port, Packet *);
     Packet *pull(int port);
+    int pull_bulk(Packet **ps, int n);
 
   private:
 
@@ -40,8 +40,8 @@ Truncate::configure(Vector<String> &conf, ErrorHandler *errh)
 Packet *
 Truncate::simple_action(Packet *p)
 {
-    if (p->length() > _nbytes) {
-	unsigned nbytes = p->length() - _nbytes;
+    if (p->total_length() > _nbytes) {
+	unsigned nbytes = p->total_length() - _nbytes;
 	if (_extra_anno)
 	    SET_EXTRA_LENGTH_ANNO(p, EXTRA_LENGTH_ANNO(p) + nbytes);
         p->take(nbytes);
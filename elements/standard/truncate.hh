@@ -23,6 +23,7 @@ class Truncate : public Element { public:
 
     const char *class_name() const		{ return "Truncate"; }
     const char *port_count() const		{ return PORTS_1_1; }
+    const char *flags() const			{ return "G"; }
 
     int configure(Vector<String> &, ErrorHandler *);
     bool can_live_reconfigure() const		{ return true; }
@@ -20,13 +20,14 @@
 
 #include <click/config.h>
 #include "unqueue.hh"
+#include "simplequeue.hh"
 #include <click/args.hh>
 #include <click/error.hh>
 #include <click/standard/scheduleinfo.hh>
 CLICK_DECLS
 
 Unqueue::Unqueue()
-    : _task(this)
+    : _task(this), _queue(0), _held_pos(0), _held_end(0)
 {
 }
 
@@ -48,6 +49,11 @@ Unqueue::initialize(ErrorHandler *errh)
     _count = 0;
     ScheduleInfo::initialize_task(this, &_task, _active, errh);
     _signal = Notifier::upstream_empty_signal(this, 0, &_task);
+#if !CLICK_STATS
+    // Bypassing the port is safe only when it keeps no statistics.
+    if (input(0).port() == 0)
+	_queue = (SimpleQueue *) input(0).element()->cast("SimpleQueue");
+#endif
     if (_burst < 0)
 	_burst = 0x7FFFFFFFU;
     else if (_burst == 0)
@@ -55,21 +61,55 @@ Unqueue::initialize(ErrorHandler *errh)
     return 0;
 }
 
+void
+Unqueue::cleanup(CleanupStage)
+{
+    while (_held_pos < _held_end)
+	_held[_held_pos++]->kill();
+}
+
+inline bool
+Unqueue::push_held()
+{
+    // A downstream push may deactivate us; keep the rest of the burst until
+    // we are reactivated.
+    while (_held_pos < _held_end && _active)
+	output(0).push(_held[_held_pos++]);
+    return _held_pos == _held_end;
+}
+
 bool
 Unqueue::run_task(Task *)
 {
     if (!_active)
 	return false;
 
+    bool held = _held_pos < _held_end;
+    if (held && !push_held())
+	return true;
+
     int worked = 0, limit = _burst;
     if (_limit >= 0 && _count + limit >= (uint32_t) _limit) {
 	limit = _limit - _count;
 	if (limit <= 0)
-	    return false;
+	    return held;
     }
 
     while (worked < limit && _active) {
-	if (Packet *p = input(0).pull()) {
+	if (_queue) {
+	    int n = _queue->pull_bulk(_held, limit - worked < bulk_size ? limit - worked : bulk_size);
+	    if (!n) {
+		if (!_signal)
+		    goto out;
+		break;
+	    }
+	    worked += n;
+	    _count += n;
+	    _held_pos = 0;
+	    _held_end = n;
+	    if (!push_held())
+		break;
+	} else if (Packet *p = input(0).pull()) {
 	    ++worked;
 	    ++_count;
 	    output(0).push(p);
@@ -81,7 +121,7 @@ Unqueue::run_task(Task *)
 
     _task.fast_reschedule();
   out:
-    return worked > 0;
+    return worked > 0 || held;
 }
 
 #if 0 && defined(CLICK_LINUXMODULE)
@@ -4,6 +4,7 @@
 #include <click/task.hh>
 #include <click/notifier.hh>
 CLICK_DECLS
+class SimpleQueue;
 
 /*
 =c
@@ -21,6 +22,12 @@ its single output. Pulls a maximum of BURST packets every time
 it is scheduled. Default BURST is 1. If BURST
 is less than 0, pull until nothing comes back.
 
+When Unqueue's input is connected directly to a queue element, such as Queue
+or SimpleQueue, Unqueue dequeues up to 32 packets at a time from the queue
+using a single bulk operation.  The packets are then pushed one by one.  If
+a push deactivates Unqueue, the rest of that burst is held, and pushed when
+Unqueue is reactivated.
+
 Keyword arguments are:
 
 =over 4
@@ -70,9 +77,11 @@ class Unqueue : public Element { public:
     const char *class_name() const		{ return "Unqueue"; }
     const char *port_count() const		{ return PORTS_1_1; }
     const char *processing() const		{ return PULL_TO_PUSH; }
+    const char *flags() const			{ return "G"; }
 
     int configure(Vector<String> &, ErrorHandler *);
     int initialize(ErrorHandler *);
+    void cleanup(CleanupStage);
     void add_handlers();
 
     bool run_task(Task *);
@@ -85,6 +94,14 @@ class Unqueue : public Element { public:
     uint32_t _count;
     Task _task;
     NotifierSignal _signal;
+    SimpleQueue *_queue;
+
+    enum { bulk_size = 32 };
+    Packet *_held[bulk_size];	// burst from _queue not yet pushed
+    int _held_pos;
+    int _held_end;
+
+    inline bool push_held();
 
     enum {
 	h_active, h_reset, h_burst, h_limit
@@ -92,6 +92,14 @@ CheckTCPHeader::simple_action(Packet *p)
   if (!p->has_network_header() || iph->ip_p != IP_PROTO_TCP)
     return drop(NOT_TCP, p);
 
+  // the checksum covers the whole packet, so gather its segments first
+  if (p->segmented()) {
+    if (!(p = p->linearize()))
+      return 0;
+    iph = p->ip_header();
+    tcph = p->tcp_header();
+  }
+
   iph_len = iph->ip_hl << 2;
   len = ntohs(iph->ip_len) - iph_len;
   tcph_len = tcph->th_off << 2;
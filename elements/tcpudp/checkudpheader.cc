@@ -91,6 +91,14 @@ CheckUDPHeader::simple_action(Packet *p)
   if (!p->has_network_header() || iph->ip_p != IP_PROTO_UDP)
     return drop(NOT_UDP, p);
 
+  // the checksum covers the whole packet, so gather its segments first
+  if (p->segmented()) {
+    if (!(p = p->linearize()))
+      return 0;
+    iph = p->ip_header();
+    udph = p->udp_header();
+  }
+
   iph_len = iph->ip_hl << 2;
   len = ntohs(udph->uh_ulen);
   if (len < sizeof(click_udp)
@@ -165,24 +165,44 @@ IPRewriter::push(int port, Packet *p_in)
     output(m->output()).push(p);
 }
 
-String
-IPRewriter::udp_mappings_handler(Element *e, void *)
+int
+IPRewriter::udp_mappings_handler(int, String &data, Element *e, const Handler *, ErrorHandler *errh)
 {
     IPRewriter *rw = (IPRewriter *)e;
+    uint32_t b, max, n = 0, nb = rw->_udp_map.bucket_count();
+    if (parse_mappings_chunk(data, b, max, errh) < 0)
+	return -1;
     click_jiffies_t now = click_jiffies();
     StringAccum sa;
-    for (Map::iterator iter = rw->_udp_map.begin(); iter.live(); ++iter) {
-	iter->flow()->unparse(sa, iter->direction(), now);
-	sa << '\n';
+    for (; b < nb && n < max; ++b)
+	for (Map::iterator iter = rw->_udp_map.begin(b);
+	     iter.live() && iter.bucket() == b; ++iter, ++n) {
+	    iter->flow()->unparse(sa, iter->direction(), now);
+	    sa << '\n';
+	}
+    if (data)
+	data = Handler::chunk_value(b < nb ? String(b) : String(), sa.take_string());
+    else
+	data = sa.take_string();
+    return 0;
+}
+
+void
+IPRewriter::take_state(Element *e, ErrorHandler *)
+{
+    if (take_flows(e)) {
+	IPRewriter *rw = static_cast<IPRewriter *>(e);
+	_allocator.swap(rw->_allocator);
+	_udp_map.swap(rw->_udp_map);
+	_udp_allocator.swap(rw->_udp_allocator);
     }
-    return sa.take_string();
 }
 
 void
 IPRewriter::add_handlers()
 {
-    add_read_handler("tcp_mappings", tcp_mappings_handler);
-    add_read_handler("udp_mappings", udp_mappings_handler);
+    set_handler("tcp_mappings", Handler::h_read | Handler::h_read_param | Handler::h_read_chunked, tcp_mappings_handler);
+    set_handler("udp_mappings", Handler::h_read | Handler::h_read_param | Handler::h_read_chunked, udp_mappings_handler);
     add_rewriter_handlers(true);
 }
 
@@ -171,6 +171,11 @@ packets to the rewritten destination address. Default is true.
 
 =back
 
+When a configuration is hotswapped in, an IPRewriter whose name,
+configuration, and connections are unchanged takes over the old element's
+mappings in constant time.  This does not happen if MAPPING_CAPACITY names
+another element, or if an input's reply element is another element.
+
 =h nmappings r
 
 Returns the number of mappings in this IPRewriter's mapping table.
@@ -204,6 +209,10 @@ relevant output port is starred.
 Returns a human-readable description of the IPRewriter's current set of
 UDP mappings.
 
+Both mapping handlers support chunked reads, so that large flow tables can be
+exported a piece at a time (see ControlSocket's READSTREAM command).  Flows
+created or expired during a chunked read may be missed or repeated.
+
 =a TCPRewriter, IPAddrRewriter, IPAddrPairRewriter, IPRewriterPatterns,
 RoundRobinIPMapper, FTPPortMapper, ICMPRewriter, ICMPPingRewriter */
 
@@ -218,6 +227,7 @@ class IPRewriter : public TCPRewriter { public:
     void *cast(const char *);
 
     int configure(Vector<String> &, ErrorHandler *);
+    void take_state(Element *, ErrorHandler *);
 
     IPRewriterEntry *get_entry(int ip_p, const IPFlowID &flowid, int input);
     HashContainer<IPRewriterEntry> *get_map(int mapid) {
@@ -260,7 +270,7 @@ class IPRewriter : public TCPRewriter { public:
 	IPRewriter *x = static_cast<IPRewriter *>(rwinput->reply_element);
 	return x->_udp_map;
     }
-    static String udp_mappings_handler(Element *e, void *user_data);
+    static int udp_mappings_handler(int, String &, Element *, const Handler *, ErrorHandler *);
 
 };
 
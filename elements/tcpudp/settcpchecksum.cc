@@ -44,7 +44,11 @@ SetTCPChecksum::configure(Vector<String> &conf, ErrorHandler *errh)
 Packet *
 SetTCPChecksum::simple_action(Packet *p_in)
 {
-  WritablePacket *p = p_in->uniqueify();
+  // the checksum covers the whole packet, so gather its segments first
+  Packet *q = p_in->linearize();
+  WritablePacket *p = (q ? q->uniqueify() : 0);
+  if (!p)
+    return 0;
   click_ip *iph = p->ip_header();
   click_tcp *tcph = p->tcp_header();
   unsigned plen = ntohs(iph->ip_len) - (iph->ip_hl << 2);
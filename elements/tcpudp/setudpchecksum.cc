@@ -37,7 +37,9 @@ SetUDPChecksum::~SetUDPChecksum()
 Packet *
 SetUDPChecksum::simple_action(Packet *p_in)
 {
-    WritablePacket *p = p_in->uniqueify();
+    // the checksum covers the whole packet, so gather its segments first
+    Packet *q = p_in->linearize();
+    WritablePacket *p = (q ? q->uniqueify() : 0);
     if (!p)
 	return 0;
 
@@ -343,24 +343,40 @@ TCPRewriter::push(int port, Packet *p_in)
 }
 
 
-String
-TCPRewriter::tcp_mappings_handler(Element *e, void *)
+int
+TCPRewriter::tcp_mappings_handler(int, String &data, Element *e, const Handler *, ErrorHandler *errh)
 {
     TCPRewriter *rw = (TCPRewriter *)e;
+    uint32_t b, max, n = 0, nb = rw->_map.bucket_count();
+    if (parse_mappings_chunk(data, b, max, errh) < 0)
+	return -1;
     click_jiffies_t now = click_jiffies();
     StringAccum sa;
-    for (Map::iterator iter = rw->_map.begin(); iter.live(); ++iter) {
-	TCPFlow *f = static_cast<TCPFlow *>(iter->flow());
-	f->unparse(sa, iter->direction(), now);
-	sa << '\n';
-    }
-    return sa.take_string();
+    for (; b < nb && n < max; ++b)
+	for (Map::iterator iter = rw->_map.begin(b);
+	     iter.live() && iter.bucket() == b; ++iter, ++n) {
+	    TCPFlow *f = static_cast<TCPFlow *>(iter->flow());
+	    f->unparse(sa, iter->direction(), now);
+	    sa << '\n';
+	}
+    if (data)
+	data = Handler::chunk_value(b < nb ? String(b) : String(), sa.take_string());
+    else
+	data = sa.take_string();
+    return 0;
+}
+
+void
+TCPRewriter::take_state(Element *e, ErrorHandler *)
+{
+    if (take_flows(e))
+	_allocator.swap(static_cast<TCPRewriter *>(e)->_allocator);
 }
 
 void
 TCPRewriter::add_handlers()
 {
-    add_read_handler("mappings", tcp_mappings_handler, 0);
+    set_handler("mappings", Handler::h_read | Handler::h_read_param | Handler::h_read_chunked, tcp_mappings_handler);
     add_rewriter_handlers(true);
 }
 
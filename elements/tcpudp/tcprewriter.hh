@@ -75,10 +75,15 @@ packets to the rewritten destination address. Default is true.
 
 =back
 
+When a configuration is hotswapped in, a TCPRewriter whose name,
+configuration, and connections are unchanged takes over the old element's
+mappings in constant time.  This does not happen if MAPPING_CAPACITY names
+another element, or if an input's reply element is another element.
+
 =h mappings read-only
 
 Returns a human-readable description of the TCPRewriter's current set of
-mappings.
+mappings.  Supports chunked reads, as IPRewriter's mapping handlers do.
 
 =a IPRewriter, IPAddrRewriter, IPAddrPairRewriter, IPRewriterPatterns,
 FTPPortMapper */
@@ -152,6 +157,7 @@ class TCPRewriter : public IPRewriterBase { public:
     void *cast(const char *);
 
     int configure(Vector<String> &, ErrorHandler *);
+    void take_state(Element *, ErrorHandler *);
 
     IPRewriterEntry *add_flow(int ip_p, const IPFlowID &flowid,
 			      const IPFlowID &rewritten_flowid, int input);
@@ -180,7 +186,7 @@ class TCPRewriter : public IPRewriterBase { public:
 	    return _timeouts[0];
     }
 
-    static String tcp_mappings_handler(Element *, void *);
+    static int tcp_mappings_handler(int, String &, Element *, const Handler *, ErrorHandler *);
 
 };
 
@@ -177,23 +177,39 @@ UDPRewriter::push(int port, Packet *p_in)
 }
 
 
-String
-UDPRewriter::dump_mappings_handler(Element *e, void *)
+int
+UDPRewriter::dump_mappings_handler(int, String &data, Element *e, const Handler *, ErrorHandler *errh)
 {
     UDPRewriter *rw = (UDPRewriter *)e;
+    uint32_t b, max, n = 0, nb = rw->_map.bucket_count();
+    if (parse_mappings_chunk(data, b, max, errh) < 0)
+	return -1;
     click_jiffies_t now = click_jiffies();
     StringAccum sa;
-    for (Map::iterator iter = rw->_map.begin(); iter.live(); ++iter) {
-	iter->flow()->unparse(sa, iter->direction(), now);
-	sa << '\n';
-    }
-    return sa.take_string();
+    for (; b < nb && n < max; ++b)
+	for (Map::iterator iter = rw->_map.begin(b);
+	     iter.live() && iter.bucket() == b; ++iter, ++n) {
+	    iter->flow()->unparse(sa, iter->direction(), now);
+	    sa << '\n';
+	}
+    if (data)
+	data = Handler::chunk_value(b < nb ? String(b) : String(), sa.take_string());
+    else
+	data = sa.take_string();
+    return 0;
+}
+
+void
+UDPRewriter::take_state(Element *e, ErrorHandler *)
+{
+    if (take_flows(e))
+	_allocator.swap(static_cast<UDPRewriter *>(e)->_allocator);
 }
 
 void
 UDPRewriter::add_handlers()
 {
-    add_read_handler("mappings", dump_mappings_handler, 0);
+    set_handler("mappings", Handler::h_read | Handler::h_read_param | Handler::h_read_chunked, dump_mappings_handler);
     add_rewriter_handlers(true);
 }
 
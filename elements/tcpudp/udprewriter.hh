@@ -152,10 +152,15 @@ packets to the rewritten destination address. Default is true.
 
 =back
 
+When a configuration is hotswapped in, a UDPRewriter whose name,
+configuration, and connections are unchanged takes over the old element's
+mappings in constant time.  This does not happen if MAPPING_CAPACITY names
+another element, or if an input's reply element is another element.
+
 =h mappings read-only
 
 Returns a human-readable description of the UDPRewriter's current set of
-mappings.
+mappings.  Supports chunked reads, as IPRewriter's mapping handlers do.
 
 =a TCPRewriter, IPAddrRewriter, IPAddrPairRewriter, IPRewriterPatterns,
 RoundRobinIPMapper, FTPPortMapper, ICMPRewriter, ICMPPingRewriter */
@@ -186,6 +191,7 @@ class UDPRewriter : public IPRewriterBase { public:
     void *cast(const char *);
 
     int configure(Vector<String> &, ErrorHandler *);
+    void take_state(Element *, ErrorHandler *);
 
     IPRewriterEntry *add_flow(int ip_p, const IPFlowID &flowid,
 			      const IPFlowID &rewritten_flowid, int input);
@@ -211,7 +217,7 @@ class UDPRewriter : public IPRewriterBase { public:
 	    return _timeouts[0];
     }
 
-    static String dump_mappings_handler(Element *, void *);
+    static int dump_mappings_handler(int, String &, Element *, const Handler *, ErrorHandler *);
 
     friend class IPRewriter;
 
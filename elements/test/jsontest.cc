@@ -26,6 +26,52 @@ JsonTest::JsonTest()
 {
 }
 
+namespace {
+class TraceJsonParser : public JsonParser { public:
+    TraceJsonParser(const String &input, int stop_after = -1)
+	: input(input), shared(0), stop_after(stop_after) {
+    }
+    String input;
+    StringAccum trace;
+    int shared;
+    int stop_after;
+  protected:
+    bool event(const char *type, const String &text = String()) {
+	trace << type << text << ' ';
+	if (text.length() && text.data() >= input.begin() && text.data() < input.end())
+	    ++shared;
+	return --stop_after != 0;
+    }
+    bool on_null() {
+	return event("null");
+    }
+    bool on_bool(bool x) {
+	return event(x ? "true" : "false");
+    }
+    bool on_number(const String &text, bool integer) {
+	return event(integer ? "i:" : "d:", text);
+    }
+    bool on_string(const String &x) {
+	return event("s:", x);
+    }
+    bool on_key(const String &key) {
+	return event("k:", key);
+    }
+    bool on_begin_object() {
+	return event("{");
+    }
+    bool on_end_object() {
+	return event("}");
+    }
+    bool on_begin_array() {
+	return event("[");
+    }
+    bool on_end_array() {
+	return event("]");
+    }
+};
+}
+
 #define CHECK(x) if (!(x)) return errh->error("%s:%d: test %<%s%> failed", __FILE__, __LINE__, #x);
 
 int
@@ -200,6 +246,63 @@ JsonTest::initialize(ErrorHandler *errh)
 	CHECK(j.unparse() == "{\"foo\":\"\360\237\222\243ENOMEM\360\237\222\243\",\"\360\237\222\243ENOMEM\360\237\222\243\":2}");
     }
 
+    {
+	Json j = Json::parse("[1e5,1E+2,-0.5e-3,0,-7]");
+	CHECK(j.size() == 5);
+	CHECK(j[0].is_double() && j[1].is_double() && j[2].is_double());
+	CHECK(j[3].is_int() && j[4].is_int());
+	CHECK(!Json::parse("1e").is_number());
+	CHECK(!Json::parse("-").is_number());
+	CHECK(!Json::parse("01").is_number());
+    }
+
+    {
+	StringAccum sa;
+	JsonWriter w(sa);
+	w.begin_object().member("name", "q/1").member("n", 1)
+	    .member("ok", true).key("a").begin_array();
+	w.value(2).value().value("x\"\n").begin_object().end_object().end_array();
+	w.key("e").begin_array().end_array().member("d", 1.5).end_object();
+	CHECK(w.depth() == 0);
+	String text = sa.take_string();
+	CHECK(text == "{\"name\":\"q\\/1\",\"n\":1,\"ok\":true,\"a\":[2,null,\"x\\\"\\n\",{}],\"e\":[],\"d\":1.5}");
+	CHECK(Json::parse(text).unparse() == text);
+
+	JsonWriter w2(sa);
+	w2.begin_array().value(Json::parse("{\"a\":[1]}")).raw("[true]").end_array();
+	CHECK(sa.take_string() == "[{\"a\":[1]},[true]]");
+    }
+
+    {
+	String input = "{\"a\":[1,-2.5e3,\"xy\",\"\\u0041\"],\"b\":{},\"c\":null,\"d\":false}";
+	TraceJsonParser p(input);
+	CHECK(p.parse(input));
+	CHECK(p.trace.take_string() == "{ k:a [ i:1 d:-2.5e3 s:xy s:A ] k:b { } k:c null k:d false } ");
+	CHECK(p.shared == 7);
+	CHECK(p.error_offset() == -1 && !p.stopped());
+
+	TraceJsonParser p2(input, 3);
+	CHECK(!p2.parse(input));
+	CHECK(p2.stopped() && p2.error_offset() == -1);
+	CHECK(p2.trace.take_string() == "{ k:a [ ");
+
+	TraceJsonParser p3("[1,]");
+	CHECK(!p3.parse(p3.input));
+	CHECK(p3.error_offset() == 3 && !p3.stopped());
+	CHECK(!p3.parse("[1] x") && p3.error_offset() == 4);
+	CHECK(!p3.parse("[\"a") && p3.error_offset() == 1);
+
+	String lines = "{\"a\":1}\n[2]\n 3\n";
+	TraceJsonParser p4(lines);
+	int pos = 0, n = 0;
+	while (pos >= 0 && pos < lines.length()) {
+	    pos = p4.parse_prefix(lines, pos);
+	    ++n;
+	}
+	CHECK(pos == lines.length() && n == 3);
+	CHECK(p4.trace.take_string() == "{ k:a i:1 } [ i:2 ] i:3 ");
+    }
+
     errh->message("All tests pass!");
     return 0;
 }
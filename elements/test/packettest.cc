@@ -34,7 +34,7 @@ PacketTest::PacketTest()
 int
 PacketTest::initialize(ErrorHandler *errh)
 {
-    const unsigned char *lowers = (const unsigned char *)"abcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyz";
+    const unsigned char *lowers = (const unsigned char *)"abcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyz";
     IPAddress addr(String("1.2.3.4"));
 
     Packet *p = Packet::make(10, lowers, 20, 30);
@@ -95,19 +95,47 @@ PacketTest::initialize(ErrorHandler *errh)
     p->kill();
 #endif
 
+#if CLICK_USERLEVEL
+    // test header-only copy-on-write: the header is private, the payload
+    // shared
+    p = Packet::make(10, lowers, 52, 4);
+    p->set_cow_header_length(16);
+    p2 = p->clone();
+    CHECK(p2->cow_header_length() == 16);
+    p3 = p2->uniqueify();
+    CHECK(p3 && p3->segmented());
+    CHECK(p3->length() == 16 && p3->total_length() == 52);
+    CHECK(p3->data() != p->data());
+    CHECK(p3->segment()->data() == p->data() + 16);
+    CHECK(p3->headroom() >= 10);
+    p3->data()[0] = 'A';
+    CHECK(p->data()[0] == 'a');
+    p2 = p3->linearize();
+    CHECK(p2 && !p2->segmented() && p2->length() == 52);
+    CHECK(p2->data()[0] == 'A');
+    CHECK_DATA(p2->data() + 1, lowers + 1, 51);
+    CHECK(!p->shared());
+    CHECK_DATA(p->data(), lowers, 52);
+    p->kill();
+    p2->kill();
+#endif
+
     // test shift_data()
+    // (a packet pool may hand out more tailroom than requested)
     p = Packet::make(10, lowers, 60, 4);
-    CHECK(p->headroom() == 10 && p->tailroom() == 4);
+    uint32_t tailroom = p->tailroom();
+    CHECK(p->headroom() == 10 && tailroom >= 4);
     p = p->shift_data(-2);
-    CHECK(p->headroom() == 8 && p->tailroom() == 6);
+    CHECK(p->headroom() == 8 && p->tailroom() == tailroom + 2);
     CHECK(p->length() == 60);
     CHECK_DATA(p->data(), lowers, 60);
     CHECK_ALIGNED(p->data());
     p->kill();
 
     p = Packet::make(9, lowers, 60, 4);
+    tailroom = p->tailroom();
     p = p->shift_data(3);
-    CHECK(p->headroom() == 12 && p->tailroom() == 1 && p->length() == 60);
+    CHECK(p->headroom() == 12 && p->tailroom() == tailroom - 3 && p->length() == 60);
     CHECK_DATA(p->data(), lowers, 60);
     CHECK_ALIGNED(p->data());
     p->kill();
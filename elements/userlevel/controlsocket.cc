@@ -25,7 +25,12 @@
 #include <click/timer.hh>
 #include <click/router.hh>
 #include <click/straccum.hh>
+#include <click/userutils.hh>
 #include <click/llrpc.h>
+#if HAVE_MULTITHREAD
+# include <click/task.hh>
+# include <click/master.hh>
+#endif
 #include <unistd.h>
 #include <sys/socket.h>
 #include <sys/un.h>
@@ -33,7 +38,7 @@
 #include <fcntl.h>
 CLICK_DECLS
 
-const char ControlSocket::protocol_version[] = "1.3";
+const char ControlSocket::protocol_version[] = "1.5";
 
 class ControlSocketErrorHandler : public ErrorHandler { public:
 
@@ -83,12 +88,20 @@ ControlSocketErrorHandler::account(int level)
 
 
 ControlSocket::ControlSocket()
-  : _socket_fd(-1), _proxy(0), _full_proxy(0), _retry_timer(0)
+  : _socket_fd(-1), _proxy(0), _full_proxy(0), _retry_timer(0),
+    _home_thread(false), _call_batch(16), _call_chunk(1024)
 {
+#if HAVE_MULTITHREAD
+    _resume_task = 0;
+    pthread_mutex_init(&_call_lock, 0);
+#endif
 }
 
 ControlSocket::~ControlSocket()
 {
+#if HAVE_MULTITHREAD
+    pthread_mutex_destroy(&_call_lock);
+#endif
 }
 
 int
@@ -100,7 +113,8 @@ ControlSocket::configure(Vector<String> &conf, ErrorHandler *errh)
 	return -1;
 
     // remove keyword arguments
-    bool read_only = false, verbose = false, retry_warnings = true, localhost = false;
+    bool read_only = false, verbose = false, retry_warnings = true, localhost = false,
+	home_thread = false;
     _retries = 0;
     if (args.read("READONLY", read_only)
 	.read("PROXY", _proxy)
@@ -108,12 +122,20 @@ ControlSocket::configure(Vector<String> &conf, ErrorHandler *errh)
 	.read("RETRIES", _retries)
 	.read("RETRY_WARNINGS", retry_warnings)
 	.read("LOCALHOST", localhost)
+	.read("HOME_THREAD", home_thread)
+	.read("CALL_BATCH", _call_batch)
+	.read("CALL_CHUNK", _call_chunk)
 	.consume() < 0)
 	return -1;
+    if (_call_batch <= 0)
+	return errh->error("CALL_BATCH must be positive");
+    if (_call_chunk == 0)
+	return errh->error("CALL_CHUNK must be positive");
     _read_only = read_only;
     _verbose = verbose;
     _retry_warnings = retry_warnings;
     _localhost = localhost;
+    _home_thread = home_thread;
 
     socktype = socktype.upper();
     if (socktype == "TCP") {
@@ -264,6 +286,22 @@ ControlSocket::initialize(ErrorHandler *errh)
   if (_full_proxy)
     _full_proxy->add_error_receiver(proxy_error_function, this);
 
+#if HAVE_MULTITHREAD
+  // one task per thread runs handler calls passed to that thread, and
+  // _resume_task answers the commands whose calls have finished
+  if (_home_thread && master()->nthreads() > 1) {
+    for (int i = 0; i < master()->nthreads(); ++i) {
+      Task *t = new Task(call_task_hook, this);
+      t->initialize(this, false);
+      t->move_thread(i);
+      _call_tasks.push_back(t);
+    }
+    _resume_task = new Task(resume_task_hook, this);
+    _resume_task->initialize(this, false);
+  }
+  _call_queues.resize(_call_tasks.size());
+#endif
+
   if (initialize_socket(errh) >= 0)
     return 0;
   else if (_retries >= 0) {
@@ -302,8 +340,25 @@ ControlSocket::take_state(Element *e, ErrorHandler *errh)
     cs->_socket_fd = -1;
     _conns.swap(cs->_conns);
 
+#if HAVE_MULTITHREAD
+    // The old router's tasks no longer run, so its queued calls finish
+    // here, and the commands that were waiting for them are answered.
+    for (int t = 0; t < cs->_call_queues.size(); ++t)
+	cs->run_queued(t, INT_MAX);
+    cs->_resumed.clear();
+#endif
+    for (connection **it = _conns.begin(); it != _conns.end(); ++it)
+	if (*it && (*it)->cmd != cmd_none)
+	    finish_command(**it);
+
     if (_socket_fd >= 0)
 	add_select(_socket_fd, SELECT_READ);
+    // streams refer to the old router's elements
+    for (connection **it = _conns.begin(); it != _conns.end(); ++it)
+	if (*it && (*it)->stream_h) {
+	    (*it)->stream_h = 0;
+	    (*it)->message(CSERR_NO_ROUTER, "Read handler '" + (*it)->stream_name + "' interrupted by hotswap");
+	}
     for (connection **it = _conns.begin(); it != _conns.end(); ++it) {
 	if (*it && !(*it)->in_closed)
 	    add_select((*it)->fd, SELECT_READ);
@@ -329,6 +384,16 @@ ControlSocket::cleanup(CleanupStage)
 	    unlink(_unix_pathname.c_str());
 	_socket_fd = -1;
     }
+#if HAVE_MULTITHREAD
+    // calls still queued are dropped along with their connections
+    for (Task **it = _call_tasks.begin(); it != _call_tasks.end(); ++it)
+	delete *it;
+    _call_tasks.clear();
+    _call_queues.clear();
+    delete _resume_task;
+    _resume_task = 0;
+    _resumed.clear();
+#endif
     for (connection **it = _conns.begin(); it != _conns.end(); ++it)
 	if (*it) {
 	    (*it)->flush_write(this, false);	// try one last time to emit all data
@@ -341,6 +406,21 @@ ControlSocket::cleanup(CleanupStage)
     }
 }
 
+ControlSocket::connection::~connection()
+{
+    delete[] errhs;
+}
+
+void
+ControlSocket::connection::start_command(int cmd_, const String &name, int ncalls)
+{
+    cmd = cmd_;
+    cmd_name = name;
+    calls.clear();
+    delete[] errhs;
+    errhs = new ControlSocketErrorHandler[ncalls ? ncalls : 1];
+}
+
 int
 ControlSocket::connection::message(int code, const String &msg, bool continuation)
 {
@@ -508,6 +588,156 @@ ControlSocket::parse_handler(connection &conn, const String &full_name, Element
   }
 }
 
+void
+ControlSocket::run_call(handler_call &c)
+{
+    if (c.write)
+	c.result = c.h->call_write(c.data, c.e, c.errh);
+    else if (c.chunk && c.whole)
+	c.data += c.h->call_read_chunk(c.e, c.cursor, c.chunk, c.errh);
+    else if (c.chunk)
+	c.data = c.h->call_read_chunk(c.e, c.cursor, c.chunk, c.errh);
+    else
+	c.data = c.h->call_read(c.e, c.data, c.errh);
+}
+
+#if HAVE_MULTITHREAD
+int
+ControlSocket::call_thread(const handler_call &c) const
+{
+    // Returns the thread that must run the call, or -1 to run it here.
+    if (!c.h->exclusive() || _proxy || _call_tasks.empty()
+	|| c.e == router()->root_element() || !router()->running())
+	return -1;
+    int t = router()->home_thread_id(c.e);
+    if (t < 0 || t >= _call_tasks.size() || t == router()->home_thread_id(this))
+	return -1;
+    return t;
+}
+
+bool
+ControlSocket::run_queued(int thread, int max)
+{
+    Deque<handler_call *> &q = _call_queues[thread];
+    for (; max > 0; --max) {
+	pthread_mutex_lock(&_call_lock);
+	handler_call *c = q.empty() ? 0 : q.front();
+	if (c)
+	    q.pop_front();
+	pthread_mutex_unlock(&_call_lock);
+	if (!c)
+	    return false;
+	run_call(*c);
+	bool resume = false;
+	pthread_mutex_lock(&_call_lock);
+	if (c->whole && c->cursor)
+	    // read the next chunk after the thread's other tasks have run
+	    q.push_back(c);
+	else if (--c->conn->calls_pending == 0) {
+	    _resumed.push_back(c->conn);
+	    resume = true;
+	}
+	pthread_mutex_unlock(&_call_lock);
+	if (resume && router()->running())
+	    _resume_task->reschedule();
+    }
+    pthread_mutex_lock(&_call_lock);
+    bool more = !q.empty();
+    pthread_mutex_unlock(&_call_lock);
+    return more;
+}
+
+bool
+ControlSocket::call_task_hook(Task *t, void *thunk)
+{
+    ControlSocket *cs = static_cast<ControlSocket *>(thunk);
+    if (cs->run_queued(t->home_thread_id(), cs->_call_batch))
+	t->fast_reschedule();
+    return true;
+}
+
+bool
+ControlSocket::resume_task_hook(Task *, void *thunk)
+{
+    ControlSocket *cs = static_cast<ControlSocket *>(thunk);
+    Vector<connection *> conns;
+    pthread_mutex_lock(&cs->_call_lock);
+    conns.swap(cs->_resumed);
+    pthread_mutex_unlock(&cs->_call_lock);
+    for (connection **it = conns.begin(); it != conns.end(); ++it) {
+	cs->finish_command(**it);
+	// send the response and go on to the connection's next command
+	cs->selected((*it)->fd, SELECT_WRITE);
+    }
+    return true;
+}
+#endif
+
+bool
+ControlSocket::start_calls(connection &conn)
+{
+    // Returns true if some calls were passed to other threads; the command
+    // is then answered by finish_command() once they are done.
+#if HAVE_MULTITHREAD
+    // Pass calls to their threads first, then run the rest here while
+    // those threads work.  Whole reads of chunked handlers go a chunk at a
+    // time, so no single call holds up the other thread for long.
+    int queued = 0;
+    for (handler_call *c = conn.calls.begin(); c != conn.calls.end(); ++c)
+	if ((c->thread = call_thread(*c)) >= 0) {
+	    if (!c->write && !c->chunk && !c->data && c->h->read_chunked()) {
+		c->chunk = _call_chunk;
+		c->whole = true;
+	    }
+	    c->conn = &conn;
+	    ++queued;
+	}
+    if (queued) {
+	pthread_mutex_lock(&_call_lock);
+	conn.calls_pending = queued;
+	for (handler_call *c = conn.calls.begin(); c != conn.calls.end(); ++c)
+	    if (c->thread >= 0)
+		_call_queues[c->thread].push_back(c);
+	pthread_mutex_unlock(&_call_lock);
+	for (handler_call *c = conn.calls.begin(); c != conn.calls.end(); ++c)
+	    if (c->thread >= 0)
+		_call_tasks[c->thread]->reschedule();
+    }
+    for (handler_call *c = conn.calls.begin(); c != conn.calls.end(); ++c)
+	if (c->thread < 0)
+	    run_call(*c);
+    return queued;
+#else
+    for (handler_call *c = conn.calls.begin(); c != conn.calls.end(); ++c)
+	run_call(*c);
+    return false;
+#endif
+}
+
+void
+ControlSocket::finish_command(connection &conn)
+{
+    switch (conn.cmd) {
+    case cmd_read:
+	read_finish(conn);
+	break;
+    case cmd_write:
+	write_finish(conn);
+	break;
+    case cmd_readmany:
+	readmany_finish(conn);
+	break;
+    case cmd_stream:
+	stream_finish(conn);
+	break;
+    }
+    conn.cmd = cmd_none;
+    conn.calls.clear();
+    conn.entries.clear();
+    delete[] conn.errhs;
+    conn.errhs = 0;
+}
+
 int
 ControlSocket::read_command(connection &conn, const String &handlername, String param)
 {
@@ -518,22 +748,221 @@ ControlSocket::read_command(connection &conn, const String &handlername, String
   else if (!h->read_visible())
     return conn.message(CSERR_PERMISSION, "Handler '" + handlername + "' write-only");
 
+  conn.start_command(cmd_read, handlername, 1);
+  conn.calls.push_back(handler_call(e, h, false, param, &conn.errhs[0]));
+
   // collect errors from proxy
-  ControlSocketErrorHandler errh;
   _proxied_handler = h->name();
-  _proxied_errh = &errh;
-  String data = h->call_read(e, param, &errh);
+  _proxied_errh = &conn.errhs[0];
+  bool parked = start_calls(conn);
   _proxied_errh = 0;
 
+  if (!parked)
+    finish_command(conn);
+  return 0;
+}
+
+void
+ControlSocket::read_finish(connection &conn)
+{
+  ControlSocketErrorHandler &errh = conn.errhs[0];
+  String data = conn.calls[0].data;
+
   // did we get an error message?
-  if (errh.nerrors() > 0)
-    return conn.transfer_messages(CSERR_UNSPECIFIED, "Read handler '" + handlername + "' error", &errh);
+  if (errh.nerrors() > 0) {
+    conn.transfer_messages(CSERR_UNSPECIFIED, "Read handler '" + conn.cmd_name + "' error", &errh);
+    return;
+  }
 
-  conn.message(CSERR_OK, "Read handler '" + handlername + "' OK");
+  conn.message(CSERR_OK, "Read handler '" + conn.cmd_name + "' OK");
   conn.out_text << "DATA " << data.length() << '\r' << '\n' << data;
+}
+
+void
+ControlSocket::expand_pattern(const String &pattern, Vector<readmany_entry> &entries)
+{
+  String canonical_name = canonical_handler_name(pattern);
+  const char *dot = find(canonical_name, '.');
+  String ename, hname;
+  Vector<Element *> es;
+  bool eglob = false;
+
+  if (dot != canonical_name.end()) {
+    ename = canonical_name.substring(canonical_name.begin(), dot);
+    hname = canonical_name.substring(dot + 1, canonical_name.end());
+    if ((eglob = has_glob(ename))) {
+      for (int i = 0; i < router()->nelements(); ++i)
+	if (glob_match(router()->ename(i), ename))
+	  es.push_back(router()->element(i));
+    } else {
+      Element *e = router()->find(ename);
+      int num;
+      if (!e && IntArg().parse(ename, num) && num > 0 && num <= router()->nelements())
+	e = router()->element(num - 1);
+      if (!e) {
+	entries.push_back(readmany_entry(pattern, CSERR_NO_SUCH_ELEMENT, "No element named '" + ename + "'"));
+	return;
+      }
+      es.push_back(e);
+    }
+  } else {
+    hname = canonical_name;
+    es.push_back(router()->root_element());
+  }
+
+  // Wildcard handler names skip expensive handlers, such as large tables;
+  // name those explicitly to read them.
+  bool hglob = has_glob(hname);
+  Vector<int> his;
+  for (Element **ep = es.begin(); ep != es.end(); ++ep) {
+    String prefix = (*ep == router()->root_element() ? String() : (*ep)->name() + ".");
+    if (hglob) {
+      his.clear();
+      Router::element_hindexes(*ep, his);
+      for (int *hip = his.begin(); hip != his.end(); ++hip) {
+	const Handler *h = Router::handler(router(), *hip);
+	if (h->read_visible() && !(h->flags() & Handler::EXPENSIVE)
+	    && glob_match(h->name(), hname))
+	  entries.push_back(readmany_entry(prefix + h->name(), *ep, h));
+      }
+    } else {
+      const Handler *h = Router::handler(*ep, hname);
+      if (h && h->read_visible())
+	entries.push_back(readmany_entry(prefix + hname, *ep, h));
+      else if (!eglob) {
+	if (h && h->visible())
+	  entries.push_back(readmany_entry(pattern, CSERR_PERMISSION, "Handler '" + pattern + "' write-only"));
+	else
+	  entries.push_back(readmany_entry(pattern, CSERR_NO_SUCH_HANDLER, "No handler named '" + pattern + "'"));
+      }
+    }
+  }
+}
+
+int
+ControlSocket::readmany_command(connection &conn, const String *pbegin, const String *pend, bool json)
+{
+  if (_proxy)
+    return conn.message(CSERR_UNIMPLEMENTED, "READMANY unsupported with PROXY");
+
+  // Resolve every pattern first, then call all the handlers in one pass.
+  Vector<readmany_entry> entries;
+  for (const String *p = pbegin; p != pend; ++p)
+    expand_pattern(*p, entries);
+  if (!entries.size())
+    return conn.message(CSERR_NO_SUCH_HANDLER, "No handlers match");
+
+  conn.start_command(cmd_readmany, String(), entries.size());
+  conn.cmd_json = json;
+  conn.entries.swap(entries);
+  for (readmany_entry *it = conn.entries.begin(); it != conn.entries.end(); ++it)
+    if (it->h)
+      conn.calls.push_back(handler_call(it->e, it->h, false, String(), &conn.errhs[it - conn.entries.begin()]));
+  if (!start_calls(conn))
+    finish_command(conn);
+  return 0;
+}
+
+void
+ControlSocket::readmany_finish(connection &conn)
+{
+  Vector<readmany_entry> &entries = conn.entries;
+  bool json = conn.cmd_json;
+  StringAccum sa;
+  if (json)
+    sa << '{';
+  handler_call *c = conn.calls.begin();
+  for (readmany_entry *it = entries.begin(); it != entries.end(); ++it) {
+    if (it->h) {
+      ControlSocketErrorHandler &errh = *c->errh;
+      it->data = c->data;
+      ++c;
+      if (errh.nerrors() > 0) {
+	it->code = CSERR_HANDLER_ERROR;
+	StringAccum msg;
+	for (const String *m = errh.messages().begin(); m != errh.messages().end(); ++m)
+	  msg << (m == errh.messages().begin() ? "" : "\n") << *m;
+	it->data = msg.take_string();
+      }
+    }
+    if (json) {
+      if (it != entries.begin())
+	sa << ',';
+      sa << '"' << it->name.encode_json() << "\":";
+      if (it->code == CSERR_OK)
+	sa << '"' << it->data.encode_json() << '"';
+      else
+	sa << "{\"error\":\"" << it->data.encode_json() << "\"}";
+    } else
+      sa << it->name << ' ' << it->code << ' ' << it->data.length()
+	 << '\r' << '\n' << it->data << '\r' << '\n';
+  }
+  if (json)
+    sa << '}' << '\n';
+
+  conn.message(CSERR_OK, "Read " + String(entries.size()) + " handlers OK");
+  conn.out_text << "DATA " << sa.length() << '\r' << '\n' << sa;
+}
+
+int
+ControlSocket::readstream_command(connection &conn, const String &handlername, uint32_t chunk)
+{
+  if (_proxy)
+    return conn.message(CSERR_UNIMPLEMENTED, "READSTREAM unsupported with PROXY");
+
+  Element *e;
+  const Handler* h = parse_handler(conn, handlername, &e);
+  if (!h)
+    return ANY_ERR;
+  else if (!h->read_visible())
+    return conn.message(CSERR_PERMISSION, "Handler '" + handlername + "' write-only");
+
+  conn.stream_started = false;
+  conn.stream_e = e;
+  conn.stream_h = h;
+  conn.stream_name = handlername;
+  conn.stream_cursor = String();
+  conn.stream_chunk = chunk;
+  stream_next(conn);
   return 0;
 }
 
+void
+ControlSocket::stream_next(connection &conn)
+{
+  conn.start_command(cmd_stream, conn.stream_name, 1);
+  conn.calls.push_back(handler_call(conn.stream_e, conn.stream_h, false, String(), &conn.errhs[0]));
+  conn.calls[0].chunk = conn.stream_chunk;
+  conn.calls[0].cursor = conn.stream_cursor;
+  if (!start_calls(conn))
+    finish_command(conn);
+}
+
+void
+ControlSocket::stream_finish(connection &conn)
+{
+  ControlSocketErrorHandler &errh = conn.errhs[0];
+  handler_call &c = conn.calls[0];
+
+  if (errh.nerrors() > 0) {
+    conn.stream_h = 0;
+    conn.transfer_messages(CSERR_UNSPECIFIED, "Read handler '" + conn.stream_name + "' error", &errh);
+    return;
+  }
+
+  if (!conn.stream_started) {
+    conn.message(CSERR_OK, "Read handler '" + conn.stream_name + "' streaming");
+    conn.stream_started = true;
+  }
+  if (c.data)
+    conn.out_text << "DATA " << c.data.length() << '\r' << '\n' << c.data;
+  conn.stream_cursor = c.cursor;
+  if (!c.cursor) {
+    conn.stream_h = 0;
+    conn.message(CSERR_OK, "Read handler '" + conn.stream_name + "' OK");
+  }
+}
+
 int
 ControlSocket::write_command(connection &conn, const String &handlername, String data)
 {
@@ -552,10 +981,21 @@ ControlSocket::write_command(connection &conn, const String &handlername, String
     return conn.message(CSERR_DATA_TOO_BIG, "Data too large for write handler '" + handlername + "'");
 #endif
 
-  ControlSocketErrorHandler errh;
+  conn.start_command(cmd_write, handlername, 1);
+  conn.calls.push_back(handler_call(e, h, true, data, &conn.errhs[0]));
 
   // call handler
-  int result = h->call_write(data, e, &errh);
+  if (!start_calls(conn))
+    finish_command(conn);
+  return 0;
+}
+
+void
+ControlSocket::write_finish(connection &conn)
+{
+  ControlSocketErrorHandler &errh = conn.errhs[0];
+  const String &handlername = conn.cmd_name;
+  int result = conn.calls[0].result;
 
   // add a generic error message for certain handler codes
   int code = errh.error_code();
@@ -574,7 +1014,6 @@ ControlSocket::write_command(connection &conn, const String &handlername, String
   else if (code == CSERR_HANDLER_ERROR)
     msg = "Write handler '" + handlername + "' error";
   conn.transfer_messages(code, msg, &errh);
-  return 0;
 }
 
 int
@@ -754,6 +1193,20 @@ ControlSocket::parse_command(connection &conn, const String &line)
       else
 	  return write_command(conn, words[1], data);
 
+  } else if (command == "READMANY") {
+      bool json = (words.size() > 1 && words[1].upper() == "JSON");
+      if (words.size() < 2 + json)
+	  return conn.message(CSERR_SYNTAX, "Wrong number of arguments");
+      return readmany_command(conn, words.begin() + 1 + json, words.end(), json);
+
+  } else if (command == "READSTREAM") {
+      if (words.size() != 2 && words.size() != 3)
+	  return conn.message(CSERR_SYNTAX, "Wrong number of arguments");
+      uint32_t chunk = 1000;
+      if (words.size() == 3 && (!IntArg().parse(words[2], chunk) || chunk == 0))
+	  return conn.message(CSERR_SYNTAX, "Syntax error in 'readstream'");
+      return readstream_command(conn, words[1], chunk);
+
   } else if (command == "CHECKREAD" || command == "CHECKWRITE") {
       if (words.size() != 2)
 	  return conn.message(CSERR_SYNTAX, "Wrong number of arguments");
@@ -784,6 +1237,8 @@ ControlSocket::parse_command(connection &conn, const String &line)
     conn.message(CSERR_OK, "READ handler [arg...]   call read handler, return DATA", true);
     conn.message(CSERR_OK, "READDATA handler len    call read handler with len data bytes, return DATA", true);
     conn.message(CSERR_OK, "READUNTIL handler term  call read handler, take data until term, return DATA", true);
+    conn.message(CSERR_OK, "READMANY [JSON] pat...  call matching read handlers, return DATA", true);
+    conn.message(CSERR_OK, "READSTREAM handler [n]  read handler in chunks of n entries, return DATA...", true);
     conn.message(CSERR_OK, "WRITE handler [arg...]  call write handler", true);
     conn.message(CSERR_OK, "WRITEDATA handler len   call write handler, pass len data bytes", true);
     conn.message(CSERR_OK, "WRITEUNTIL handler term call write handler, take data until term", true);
@@ -854,10 +1309,19 @@ ControlSocket::selected(int fd, int)
 		conn->in_closed = true;
 	}
 
+    // continue a READSTREAM once its earlier chunks have been written;
+    // commands wait until the stream ends, and until the handler calls of
+    // a parked command finish
+    bool blocked = (conn->cmd != cmd_none);
+    if (conn->stream_h && !blocked) {
+	if (!conn->out_text.length() && !conn->out_closed)
+	    stream_next(*conn);
+	blocked = conn->stream_h;
+    }
+
     // parse commands
     // 16.Jun.2004: process only one command each time through
-    bool blocked = false;
-    if (conn->in_text.length()) {
+    if (conn->in_text.length() && !blocked) {
 	const char *in_text = conn->in_text.begin() + conn->inpos;
 	const char *in_end = conn->in_text.end();
 	const char *line_end = in_text;
@@ -892,11 +1356,15 @@ ControlSocket::selected(int fd, int)
     // write data until blocked
     // The 2nd argument causes write events to remain selected when commands
     // remain to be processed (whether or not CS has data to write).
-    conn->flush_write(this, conn->in_text.length() && !blocked);
-
-    // maybe close out
-    if ((conn->in_closed && !conn->in_text.length() && !conn->out_text.length())
-	|| conn->out_closed) {
+    bool parked = (conn->cmd != cmd_none);
+    conn->flush_write(this, (conn->in_text.length() && !blocked) || (conn->stream_h && !parked));
+    if (parked && conn->in_closed)
+	remove_select(conn->fd, SELECT_READ);
+
+    // maybe close out; a parked connection must wait for its calls
+    if (((conn->in_closed && !conn->in_text.length() && !conn->out_text.length()
+	  && !conn->stream_h)
+	 || conn->out_closed) && !parked) {
 	remove_select(conn->fd, SELECT_READ | SELECT_WRITE);
 	close(conn->fd);
 	if (_verbose)
@@ -2,15 +2,20 @@
 #define CLICK_CONTROLSOCKET_HH
 #include "elements/userlevel/handlerproxy.hh"
 #include <click/straccum.hh>
+#if HAVE_MULTITHREAD
+# include <click/deque.hh>
+# include <pthread.h>
+#endif
 CLICK_DECLS
 class ControlSocketErrorHandler;
 class Timer;
+class Task;
 class Handler;
 
 /*
 =c
 
-ControlSocket("TCP", PORTNUMBER [, I<keywords READONLY, PROXY, VERBOSE, LOCALHOST, RETRIES, RETRY_WARNINGS>])
+ControlSocket("TCP", PORTNUMBER [, I<keywords READONLY, PROXY, VERBOSE, LOCALHOST, RETRIES, RETRY_WARNINGS, HOME_THREAD, CALL_BATCH, CALL_CHUNK>])
 ControlSocket("UNIX", FILENAME [, I<keywords>])
 
 =s control
@@ -39,8 +44,8 @@ The server will accept lines terminated by CR, LF, or CRLF. Its response
 lines are always terminated by CRLF.
 
 When a connection is opened, the server responds by stating its protocol
-version number with a line like "Click::ControlSocket/1.3". The current
-version number is 1.3. Changes in minor version number will only add commands
+version number with a line like "Click::ControlSocket/1.5". The current
+version number is 1.5. Changes in minor version number will only add commands
 and functionality to this specification, not change existing functionality.
 
 ControlSocket supports hot-swapping, meaning you can change configurations
@@ -88,6 +93,24 @@ Boolean. If true, ControlSocket will print warning messages every time it
 fails to open a socket. If false, it will print messages only on the final
 failure. Default is true.
 
+=item HOME_THREAD
+
+Boolean. In multithreaded drivers, if true, exclusive handlers of elements
+homed on other threads run on those threads; see below. Default is false.
+
+=item CALL_BATCH
+
+Integer. With HOME_THREAD, the maximum number of handler calls ControlSocket
+runs on another thread before letting that thread's other tasks run. Default
+is 16.
+
+=item CALL_CHUNK
+
+Integer. With HOME_THREAD, a read of a chunked handler (such as a large
+routing table) that is passed to another thread is split into chunks of
+about this many entries, each counting as one call towards CALL_BATCH.
+Default is 1024.
+
 =back
 
 The PORT argument for TCP ControlSockets can also be an integer followed by a
@@ -96,6 +119,25 @@ ControlSocket should bind on some port I<greater than or equal to> PORT.  If
 PORT itself is in use, ControlSocket will try several nearby ports before
 giving up.  This can be useful in tests.
 
+In multithreaded drivers, ControlSocket serves its connections on its home
+thread, and by default calls every handler there.  To keep handler calls off
+the packet-processing threads, give ControlSocket a thread of its own with
+StaticThreadSched; for example, run "click -j 3" with "StaticThreadSched(cs
+2)" and keep tasks off thread 2.
+
+With HOME_THREAD true, an exclusive handler of an element homed on another
+thread is passed to that thread and runs there between its tasks, at most
+CALL_BATCH calls at a time, so it never runs at the same time as that
+element's own tasks and timers.  This is not full exclusivity: the other
+threads keep running, so a handler whose state is shared with elements on
+other threads still needs its own locking.  Nonexclusive handlers still run
+on ControlSocket's thread.  Reads of chunked handlers run a chunk at a time
+(see CALL_CHUNK), so a large table does not stall the other thread's packet
+processing.  ControlSocket's thread never waits for the calls: it sets the
+connection aside, keeps serving other connections, and sends the response
+once the last call finishes.  Handlers named in one READMANY command are
+dispatched to their threads together.
+
 =head1 SERVER COMMANDS
 
 Many server commands
@@ -136,6 +178,43 @@ for a terminator, ControlSocket removes trailing spaces from both
 I<terminator> and the input lines. Introduced in version 1.3 of the
 ControlSocket protocol.
 
+=item READMANY [JSON] I<pattern...>
+
+Call many read handlers at once and return all their results in one "DATA
+I<n>" response.  Each I<pattern> names a handler as above, but its element
+and handler parts may contain shell-style wildcards C<*>, C<?>, and C<[...]>;
+for instance, C<*.count> names every element's C<count> handler.  Wildcard
+handler parts skip handlers marked as expensive, such as routing tables.  All
+handlers are resolved first, then called in a single pass.  Handlers that
+match no element, or read handlers that fail, are reported individually.
+
+Without C<JSON>, the data consists of one record per handler: a line
+"I<name> I<code> I<len>" followed by the I<len> bytes of the handler's
+result (or of its error message, if I<code> is not 200) and CRLF.  With C<JSON>, the
+data is a JSON object mapping each handler name to its result string, or to
+an object C<{"error": I<message>}> on error.  READMANY is not available with
+PROXY.  Introduced in version 1.4 of the ControlSocket protocol.
+
+=item READSTREAM I<handler> [I<n>]
+
+Read a large handler value incrementally.  Chunked read handlers, such as
+many elements' routing, ARP, and flow tables, return about I<n> entries per
+chunk (default 1000).  On success, responds with a "success" message,
+followed by any number of "DATA I<m>" lines, each followed by I<m> bytes of
+data, and finally by another message line: "200" if the whole value was
+read, or an error code if a later chunk failed.  ControlSocket reads the
+next chunk only once the client has received the previous one, so a slow
+client never causes a large table to be buffered in memory.  Handlers that
+do not support chunking are returned in one DATA block.  The chunks are not
+a snapshot: the element keeps running between them, and entries added or
+removed meanwhile, or moved when the element resizes a table, may be missed
+or repeated.  No other commands
+on the same connection are processed until the stream ends.  Clients can
+also page through a chunked handler themselves by reading it with
+parameters "CHUNK I<n> [I<cursor>]": the first line of the result is the
+cursor for the next chunk, empty at the end of the table.  Not available
+with PROXY.  Introduced in version 1.5 of the ControlSocket protocol.
+
 =item WRITE I<handler> I<params...>
 
 Call a write I<handler>, passing the I<params>, if any, as arguments.
@@ -267,6 +346,43 @@ class ControlSocket : public Element { public:
     Element *_proxy;
     HandlerProxy *_full_proxy;
 
+    struct connection;
+
+    struct handler_call {
+	Element *e;
+	const Handler *h;
+	bool write;
+	int thread;
+	String data;		// read parameter or write data; read result
+	int result;
+	uint32_t chunk;		// if nonzero, read one chunk from cursor
+	bool whole;		// read every chunk, appending them to data
+	String cursor;
+	ControlSocketErrorHandler *errh;
+	connection *conn;	// waiting for the result
+	handler_call(Element *e_, const Handler *h_, bool write_,
+		     const String &data_, ControlSocketErrorHandler *errh_)
+	    : e(e_), h(h_), write(write_), thread(-1), data(data_),
+	      result(0), chunk(0), whole(false), errh(errh_), conn(0) {
+	}
+    };
+
+    struct readmany_entry {
+	String name;
+	Element *e;
+	const Handler *h;
+	int code;
+	String data;
+	readmany_entry(const String &name_, Element *e_, const Handler *h_)
+	    : name(name_), e(e_), h(h_), code(CSERR_OK) {
+	}
+	readmany_entry(const String &name_, int code_, const String &msg)
+	    : name(name_), e(0), h(0), code(code_), data(msg) {
+	}
+    };
+
+    enum { cmd_none, cmd_read, cmd_write, cmd_readmany, cmd_stream };
+
     struct connection {
 	int fd;
 	StringAccum in_text;
@@ -275,16 +391,35 @@ class ControlSocket : public Element { public:
 	int outpos;
 	bool in_closed;
 	bool out_closed;
+	// READSTREAM state; stream_h is null unless a stream is active
+	bool stream_started;
+	Element *stream_e;
+	const Handler *stream_h;
+	String stream_name;
+	String stream_cursor;
+	uint32_t stream_chunk;
+	// the command whose handler calls are running; while calls_pending
+	// is nonzero, other threads hold pointers into calls
+	int cmd;
+	String cmd_name;
+	bool cmd_json;
+	Vector<handler_call> calls;
+	Vector<readmany_entry> entries;
+	ControlSocketErrorHandler *errhs;
+	int calls_pending;
 	connection(int fd_)
 	    : fd(fd_), inpos(0), outpos(0),
-	      in_closed(false), out_closed(false) {
+	      in_closed(false), out_closed(false), stream_h(0),
+	      cmd(cmd_none), errhs(0), calls_pending(0) {
 	}
+	~connection();
 	int message(int code, const String &msg, bool continuation = false);
 	int transfer_messages(int default_code, const String &msg, ControlSocketErrorHandler *);
 	static void contract(StringAccum &sa, int &pos);
 	void flush_write(ControlSocket *cs, bool read_needs_processing);
 	int read(int len, String &data);
 	int read_insufficient();
+	void start_command(int cmd, const String &name, int ncalls);
     };
     Vector<connection *> _conns;
 
@@ -294,6 +429,23 @@ class ControlSocket : public Element { public:
     int _retries;
     Timer *_retry_timer;
 
+    bool _home_thread;
+    int _call_batch;
+    uint32_t _call_chunk;
+#if HAVE_MULTITHREAD
+    Vector<Task *> _call_tasks;
+    Vector<Deque<handler_call *> > _call_queues;	// per thread
+    Task *_resume_task;
+    Vector<connection *> _resumed;	// connections whose calls finished
+    pthread_mutex_t _call_lock;	// protects _call_queues, _resumed, and
+				// connections' calls_pending
+
+    int call_thread(const handler_call &) const;
+    bool run_queued(int thread, int max);
+    static bool call_task_hook(Task *, void *);
+    static bool resume_task_hook(Task *, void *);
+#endif
+
     enum { READ_CLOSED = 1, WRITE_CLOSED = 2, ANY_ERR = -1 };
 
     static const char protocol_version[];
@@ -303,12 +455,24 @@ class ControlSocket : public Element { public:
     static void retry_hook(Timer *, void *);
     void initialize_connection(int fd);
 
+    static void run_call(handler_call &);
+    bool start_calls(connection &conn);
+    void finish_command(connection &conn);
+
     String proxied_handler_name(const String &) const;
     const Handler* parse_handler(connection &conn, const String &, Element **);
     int read_command(connection &conn, const String &, String);
+    void read_finish(connection &conn);
     int write_command(connection &conn, const String &, String);
+    void write_finish(connection &conn);
     int check_command(connection &conn, const String &, bool write);
     int llrpc_command(connection &conn, const String &, String);
+    void expand_pattern(const String &, Vector<readmany_entry> &);
+    int readmany_command(connection &conn, const String *, const String *, bool json);
+    void readmany_finish(connection &conn);
+    int readstream_command(connection &conn, const String &, uint32_t chunk);
+    void stream_next(connection &conn);
+    void stream_finish(connection &conn);
     int parse_command(connection &conn, const String &);
 
     static ErrorHandler *proxy_error_function(const String &, void *);
@@ -41,8 +41,10 @@
 #include <click/packet_anno.hh>
 #include <click/standard/scheduleinfo.hh>
 #include <click/userutils.hh>
+#include <click/llrpc.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <sys/uio.h>
 #include "fakepcap.hh"
 
 #if FROMDEVICE_ALLOW_LINUX
@@ -73,7 +75,7 @@ FromDevice::FromDevice()
 #if FROMDEVICE_ALLOW_PCAP
       _pcap(0), _pcap_complaints(0),
 #endif
-      _datalink(-1), _count(0), _promisc(0), _snaplen(0)
+      _datalink(-1), _count(0), _promisc(0), _snaplen(0), _segment_length(0)
 {
 #if FROMDEVICE_ALLOW_LINUX || FROMDEVICE_ALLOW_PCAP || FROMDEVICE_ALLOW_NETMAP
     _fd = -1;
@@ -109,9 +111,12 @@ FromDevice::configure(Vector<String> &conf, ErrorHandler *errh)
 	.read("ENCAP", WordArg(), encap_type).read_status(has_encap)
 	.read("BURST", _burst)
 	.read("TIMESTAMP", timestamp)
+	.read("SEGMENT_LENGTH", _segment_length)
 	.complete() < 0)
 	return -1;
-    if (_snaplen > 8190 || _snaplen < 14)
+    if (_segment_length && _segment_length < min_segment_length)
+	return errh->error("SEGMENT_LENGTH must be 0 or at least %d", min_segment_length);
+    if (_snaplen > (_segment_length ? 65535 : 8190) || _snaplen < 14)
 	return errh->error("SNAPLEN out of range");
     if (_headroom > 8190)
 	return errh->error("HEADROOM out of range");
@@ -454,7 +459,7 @@ FromDevice_get_packet(u_char* clientdata,
 		      const u_char* data)
 {
     FromDevice *fd = (FromDevice *) clientdata;
-    WritablePacket *p = Packet::make(fd->_headroom, data, pkthdr->caplen, 0);
+    WritablePacket *p = Packet::make_segmented(fd->_headroom, data, pkthdr->caplen, fd->_segment_length);
     fd->emit_packet(p, pkthdr->len - pkthdr->caplen,
 		    Timestamp::make_usec(pkthdr->ts.tv_sec, pkthdr->ts.tv_usec));
 }
@@ -535,11 +540,27 @@ FromDevice::selected(int, int)
     while (_method == method_linux && nlinux < _burst) {
 	struct sockaddr_ll sa;
 	socklen_t fromlen = sizeof(sa);
-	WritablePacket *p = Packet::make(_headroom, 0, _snaplen, 0);
-	int len = recvfrom(_fd, p->data(), p->length(), MSG_TRUNC, (sockaddr *)&sa, &fromlen);
+	WritablePacket *p = Packet::make_segmented(_headroom, 0, _snaplen, _segment_length);
+	int len;
+	if (!p->segmented())
+	    len = recvfrom(_fd, p->data(), p->length(), MSG_TRUNC, (sockaddr *)&sa, &fromlen);
+	else {
+	    // scatter large packets directly into the segments
+	    struct iovec iov[max_iov];
+	    struct msghdr msg;
+	    memset(&msg, 0, sizeof(msg));
+	    msg.msg_name = &sa;
+	    msg.msg_namelen = fromlen;
+	    msg.msg_iov = iov;
+	    for (Packet *s = p; s; s = s->segment(), ++msg.msg_iovlen) {
+		iov[msg.msg_iovlen].iov_base = const_cast<unsigned char *>(s->data());
+		iov[msg.msg_iovlen].iov_len = s->length();
+	    }
+	    len = recvmsg(_fd, &msg, MSG_TRUNC);
+	}
 	if (len > 0 && (sa.sll_pkttype != PACKET_OUTGOING || _outbound)) {
 	    if (len > _snaplen) {
-		assert(p->length() == (uint32_t)_snaplen);
+		assert(p->total_length() == (uint32_t)_snaplen);
 		SET_EXTRA_LENGTH_ANNO(p, len - _snaplen);
 	    } else
 		p->take(_snaplen - len);
@@ -642,6 +663,20 @@ FromDevice::add_handlers()
     add_write_handler("reset_counts", write_handler, 0, Handler::BUTTON);
 }
 
+int
+FromDevice::llrpc(unsigned command, void *data)
+{
+    if (command == CLICK_LLRPC_EXPORT_STAT) {
+	click_llrpc_export_stat_st *es = (click_llrpc_export_stat_st *) data;
+	if (strcmp(es->name, "count") != 0)
+	    return -EINVAL;
+	es->addr = &_count;
+	es->size = sizeof(_count);
+	return 0;
+    } else
+	return Element::llrpc(command, data);
+}
+
 CLICK_ENDDECLS
 ELEMENT_REQUIRES(userlevel FakePcap KernelFilter NetmapInfo)
 EXPORT_ELEMENT(FromDevice)
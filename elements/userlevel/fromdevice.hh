@@ -83,7 +83,7 @@ The default is false.
 =item SNAPLEN
 
 Unsigned.  On some systems, packets larger than SNAPLEN will be truncated.
-Defaults to 2046.
+At most 8190, or 65535 if SEGMENT_LENGTH is set.  Defaults to 2046.
 
 =item FORCE_IP
 
@@ -126,6 +126,16 @@ Integer. Maximum number of packets to read per scheduling. Defaults to 1.
 
 Boolean. If false, then do not timestamp packets. Defaults to true.
 
+=item SEGMENT_LENGTH
+
+Unsigned. If nonzero, packets longer than SEGMENT_LENGTH bytes are read into
+a chain of segments of at most SEGMENT_LENGTH bytes each, rather than one
+contiguous buffer; see Resegment. This lets SNAPLEN be as large as 65535,
+enough for jumbo frames and the TSO/GSO aggregates that Linux packet sockets
+deliver, without allocating a huge buffer per packet. Must be 0 or at least
+1024. Values up to 2048 minus HEADROOM use Click's preallocated packet
+buffers. Defaults to 0.
+
 =back
 
 =e
@@ -156,6 +166,10 @@ number of drops is not known.
 Returns a string indicating the encapsulation type on this link. Can be
 `C<IP>', `C<ETHER>', or `C<FDDI>', for example.
 
+=h CLICK_LLRPC_EXPORT_STAT llrpc
+
+Exports the C<count> statistic to ShmCounters; see <click/llrpc.h>.
+
 =a ToDevice.u, FromDump, ToDump, KernelFilter, FromDevice(n) */
 
 class FromDevice : public Element { public:
@@ -167,12 +181,14 @@ class FromDevice : public Element { public:
     const char *port_count() const	{ return "0/1-2"; }
     const char *processing() const	{ return PUSH; }
 
-    enum { default_snaplen = 2046 };
+    enum { default_snaplen = 2046, min_segment_length = 1024,
+	   max_iov = 65535 / min_segment_length + 1 };
     int configure_phase() const		{ return KernelFilter::CONFIGURE_PHASE_FROMDEVICE; }
     int configure(Vector<String> &, ErrorHandler *);
     int initialize(ErrorHandler *);
     void cleanup(CleanupStage);
     void add_handlers();
+    int llrpc(unsigned, void *);
 
     inline String ifname() const	{ return _ifname; }
     inline int fd() const		{ return _fd; }
@@ -248,6 +264,7 @@ class FromDevice : public Element { public:
     int _was_promisc : 2;
     int _snaplen;
     unsigned _headroom;
+    uint32_t _segment_length;
     enum { method_default, method_netmap, method_pcap, method_linux };
     int _method;
 #if FROMDEVICE_ALLOW_PCAP
@@ -30,6 +30,7 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/ioctl.h>
+#include <sys/uio.h>
 #include <arpa/inet.h>
 
 #if defined(__linux__) && defined(HAVE_LINUX_IF_TUN_H)
@@ -68,7 +69,7 @@
 CLICK_DECLS
 
 KernelTun::KernelTun()
-    : _fd(-1), _tap(false), _task(this), _ignore_q_errs(false),
+    : _fd(-1), _tap(false), _segment_length(0), _task(this), _ignore_q_errs(false),
       _printed_write_err(false), _printed_read_err(false),
       _selected_calls(0), _packets(0)
 {
@@ -105,6 +106,7 @@ KernelTun::configure(Vector<String> &conf, ErrorHandler *errh)
 	.read("ETHER", _macaddr)
 	.read("IGNORE_QUEUE_OVERFLOWS", _ignore_q_errs)
 	.read("MTU", _mtu_out)
+	.read("SEGMENT_LENGTH", _segment_length)
 #if KERNELTUN_LINUX
 	.read("DEV_NAME", Args::deprecated, _dev_name)
 	.read("DEVNAME", _dev_name)
@@ -118,6 +120,10 @@ KernelTun::configure(Vector<String> &conf, ErrorHandler *errh)
 	return errh->error("BURST must be >= 1");
     if (_mtu_out < (int) sizeof(click_ip))
 	return errh->error("MTU must be greater than %d", sizeof(click_ip));
+    if (_segment_length && _segment_length < min_segment_length)
+	return errh->error("SEGMENT_LENGTH must be 0 or at least %d", min_segment_length);
+    if (_segment_length && _mtu_out > 65535)
+	return errh->error("MTU too big");
     if (_headroom > 8192)
 	return errh->error("HEADROOM too big");
     _adjust_headroom = !_adjust_headroom;
@@ -505,13 +511,25 @@ KernelTun::selected(int fd, int)
 bool
 KernelTun::one_selected(const Timestamp &now)
 {
-    WritablePacket *p = Packet::make(_headroom, 0, _mtu_in, 0);
+    WritablePacket *p = Packet::make_segmented(_headroom, 0, _mtu_in, _segment_length);
     if (!p) {
 	click_chatter("out of memory!");
 	return false;
     }
 
-    int cc = read(_fd, p->data(), _mtu_in);
+    int cc;
+    if (!p->segmented())
+	cc = read(_fd, p->data(), _mtu_in);
+    else {
+	// scatter large packets directly into the segments
+	struct iovec iov[max_iov];
+	int niov = 0;
+	for (Packet *s = p; s; s = s->segment(), ++niov) {
+	    iov[niov].iov_base = const_cast<unsigned char *>(s->data());
+	    iov[niov].iov_len = s->length();
+	}
+	cc = readv(_fd, iov, niov);
+    }
     if (cc > 0) {
 	++_packets;
 	p->take(_mtu_in - cc);
@@ -596,7 +614,7 @@ KernelTun::push(int, Packet *p)
 	    goto kill;
 	}
 	// use network length for MTU
-	check_length = p->length() - sizeof(click_ether);
+	check_length = p->total_length() - sizeof(click_ether);
 
     } else {
 	iph = p->ip_header();
@@ -613,7 +631,7 @@ KernelTun::push(int, Packet *p)
 	}
 	// strip link headers
 	p->change_headroom_and_length(p->headroom() + p->network_header_offset(), p->network_length());
-	check_length = p->length();
+	check_length = p->total_length();
     }
 
     // check MTU
@@ -662,6 +680,28 @@ KernelTun::push(int, Packet *p)
 	/* existing packet is OK */;
     }
 
+    if (p && p->segmented()) {
+	// gather segments with one system call, or copy them if too many
+	struct iovec iov[max_iov];
+	int niov = 0;
+	Packet *s;
+	for (s = p; s && niov < max_iov; s = s->segment(), ++niov) {
+	    iov[niov].iov_base = const_cast<unsigned char *>(s->data());
+	    iov[niov].iov_len = s->length();
+	}
+	if (s)
+	    p = p->linearize();
+	else {
+	    int w = writev(_fd, iov, niov);
+	    if (w != (int) p->total_length() && (errno != ENOBUFS || !_ignore_q_errs || !_printed_write_err)) {
+		_printed_write_err = true;
+		click_chatter("%s(%s): write failed: %s", class_name(), _dev_name.c_str(), strerror(errno));
+	    }
+	    p->kill();
+	    return;
+	}
+    }
+
     if (p) {
 	int w = write(_fd, p->data(), p->length());
 	if (w != (int) p->length() && (errno != ENOBUFS || !_ignore_q_errs || !_printed_write_err)) {
@@ -10,7 +10,7 @@ CLICK_DECLS
 /*
 =c
 
-KernelTun(ADDR/MASK [, GATEWAY, I<keywords> HEADROOM, ETHER, MTU, IGNORE_QUEUE_OVERFLOWS])
+KernelTun(ADDR/MASK [, GATEWAY, I<keywords> HEADROOM, ETHER, MTU, SEGMENT_LENGTH, IGNORE_QUEUE_OVERFLOWS])
 
 =s comm
 
@@ -55,6 +55,15 @@ Integer. The interface's MTU, not including any link headers. KernelTun will
 refuse to send packets larger than the MTU. Default is 1500; not all operating
 systems allow MTU to be set.
 
+=item SEGMENT_LENGTH
+
+Integer. If nonzero, packets longer than SEGMENT_LENGTH bytes are read from
+the device into a chain of segments of at most SEGMENT_LENGTH bytes each,
+rather than one contiguous buffer, and segmented packets are written with a
+single gathering write. Together with a large MTU, this carries jumbo and
+GSO-sized packets through Click without per-packet huge allocations or
+copies; see Resegment. Must be 0 or at least 1024. Default is 0.
+
 =item ETHER
 
 Ethernet address. Specifies the tunnel device's Ethernet address. Default is
@@ -113,7 +122,7 @@ class KernelTun : public Element { public:
     const char *port_count() const	{ return "0-1/1-2"; }
     const char *processing() const	{ return "a/h"; }
     const char *flow_code() const	{ return "x/y"; }
-    const char *flags() const		{ return "S3"; }
+    const char *flags() const		{ return "S3 G"; }
 
     void *cast(const char *);
     int configure_phase() const		{ return CONFIGURE_PHASE_PRIVILEGED - 1; }
@@ -129,7 +138,8 @@ class KernelTun : public Element { public:
 
   private:
 
-    enum { DEFAULT_MTU = 1500 };
+    enum { DEFAULT_MTU = 1500, min_segment_length = 1024,
+	   max_iov = 65535 / min_segment_length + 2 };
     enum Type { LINUX_UNIVERSAL, LINUX_ETHERTAP, BSD_TUN, BSD_TAP, OSX_TUN,
 		NETBSD_TUN, NETBSD_TAP };
 
@@ -144,6 +154,7 @@ class KernelTun : public Element { public:
     IPAddress _gw;
     EtherAddress _macaddr;
     unsigned _headroom;
+    uint32_t _segment_length;
     unsigned _burst;
     Task _task;
     NotifierSignal _signal;
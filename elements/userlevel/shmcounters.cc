@@ -0,0 +1,242 @@
+/*
+ * shmcounters.{cc,hh} -- element exports numeric statistics through shared
+ * memory
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding. */
+
+#include <click/config.h>
+#include "shmcounters.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/router.hh>
+#include <click/straccum.hh>
+#include <click/userutils.hh>
+#include <click/llrpc.h>
+#include <click/shmcounters.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+CLICK_DECLS
+
+ShmCounters::ShmCounters()
+    : _interval(Timestamp::make_msec(10)), _timer(this),
+      _region(0), _region_size(0), _values(0)
+{
+}
+
+ShmCounters::~ShmCounters()
+{
+}
+
+int
+ShmCounters::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    if (Args(conf, this, errh)
+	.read_mp("FILENAME", FilenameArg(), _filename)
+	.read_all_with("EXPORT", AnyArg(), _exports)
+	.read("INTERVAL", _interval)
+	.complete() < 0)
+	return -1;
+    if (!_exports.size())
+	return errh->error("no EXPORT arguments");
+    if (!_interval)
+	return errh->error("INTERVAL must be positive");
+    return 0;
+}
+
+int
+ShmCounters::add_stat(Element *e, const String &sname, bool quiet,
+		      ErrorHandler *errh)
+{
+    String name = e->name() + "." + sname;
+    if (name.length() >= CLICK_SHMCOUNTERS_NAME_SIZE)
+	return errh->error("%<%s%>: name too long", name.c_str());
+
+    click_llrpc_export_stat_st es;
+    memset(&es, 0, sizeof(es));
+    es.name = sname.c_str();
+    if (e->llrpc(CLICK_LLRPC_EXPORT_STAT, &es) < 0
+	|| (es.addr && es.size != 4 && es.size != 8)
+	|| (!es.addr && !es.read)) {
+	if (quiet)
+	    return 0;
+	return errh->error("%<%s%> cannot be exported", name.c_str());
+    }
+
+    export_stat s;
+    s.addr = es.addr;
+    s.size = es.size;
+    s.read = es.read;
+    s.thunk = es.thunk;
+    _names.push_back(name);
+    _stats.push_back(s);
+    return 0;
+}
+
+int
+ShmCounters::parse_export(const String &spec, ErrorHandler *errh)
+{
+    Vector<String> words;
+    cp_spacevec(spec, words);
+    int before = errh->nerrors();
+    for (String *w = words.begin(); w != words.end(); ++w) {
+	const char *dot = find(*w, '.');
+	if (dot == w->begin() || dot + 1 >= w->end()) {
+	    errh->error("EXPORT should be %<ELEMENT.STAT%>");
+	    continue;
+	}
+	String ename = w->substring(w->begin(), dot);
+	String sname = w->substring(dot + 1, w->end());
+	if (has_glob(ename)) {
+	    for (int i = 0; i < router()->nelements(); ++i)
+		if (glob_match(router()->ename(i), ename))
+		    add_stat(router()->element(i), sname, true, errh);
+	} else if (Element *e = router()->find(ename, this))
+	    add_stat(e, sname, false, errh);
+	else
+	    errh->error("no element named %<%s%>", ename.c_str());
+    }
+    return errh->nerrors() == before ? 0 : -1;
+}
+
+int
+ShmCounters::create_region(ErrorHandler *errh)
+{
+    uint32_t n = _names.size();
+    size_t names_offset = sizeof(click_shmcounters_header);
+    size_t values_offset = names_offset + n * CLICK_SHMCOUNTERS_NAME_SIZE;
+    values_offset = (values_offset + 63) & ~(size_t) 63;
+    _region_size = values_offset + n * sizeof(uint64_t);
+
+    // Build the region under a temporary name, then rename it into place,
+    // so that readers of an older region never see it truncated.
+    String tmpname = _filename + ".tmp" + String(getpid());
+    int fd = open(tmpname.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+	return errh->error("%s: %s", tmpname.c_str(), strerror(errno));
+    if (ftruncate(fd, _region_size) < 0) {
+	errh->error("%s: %s", tmpname.c_str(), strerror(errno));
+	close(fd);
+	unlink(tmpname.c_str());
+	return -1;
+    }
+    void *mem = mmap(0, _region_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED) {
+	unlink(tmpname.c_str());
+	return errh->error("mmap: %s", strerror(errno));
+    }
+
+    _region = reinterpret_cast<click_shmcounters_header *>(mem);
+    memset(mem, 0, _region_size);
+    _region->magic = CLICK_SHMCOUNTERS_MAGIC;
+    _region->version = CLICK_SHMCOUNTERS_VERSION;
+    _region->ncounters = n;
+    _region->name_size = CLICK_SHMCOUNTERS_NAME_SIZE;
+    _region->names_offset = names_offset;
+    _region->values_offset = values_offset;
+    _region->interval_ns = _interval.nsecval();
+    _region->pid = getpid();
+    for (uint32_t i = 0; i < n; ++i)
+	memcpy(const_cast<char *>(click_shmcounters_name(_region, i)),
+	       _names[i].data(), _names[i].length());
+    _values = click_shmcounters_values(_region);
+
+    if (rename(tmpname.c_str(), _filename.c_str()) < 0) {
+	errh->error("%s: %s", _filename.c_str(), strerror(errno));
+	unlink(tmpname.c_str());
+	return -1;
+    }
+    return 0;
+}
+
+int
+ShmCounters::initialize(ErrorHandler *errh)
+{
+    for (String *s = _exports.begin(); s != _exports.end(); ++s)
+	if (parse_export(*s, errh) < 0)
+	    return -1;
+    if (create_region(errh) < 0)
+	return -1;
+    // Other elements may not be initialized yet, so publish the first
+    // values once the router is running.
+    _timer.initialize(this);
+    _timer.schedule_now();
+    return 0;
+}
+
+void
+ShmCounters::cleanup(CleanupStage stage)
+{
+    if (_region) {
+	if (stage >= CLEANUP_ROUTER_INITIALIZED)
+	    update();
+	munmap(reinterpret_cast<void *>(_region), _region_size);
+	_region = 0;
+	unlink(_filename.c_str());
+    }
+}
+
+void
+ShmCounters::update()
+{
+    // Sequence lock: generation is odd while values are inconsistent.
+    _region->generation = _region->generation + 1;
+    click_shmcounters_barrier();
+    volatile uint64_t *v = _values;
+    for (export_stat *s = _stats.begin(); s != _stats.end(); ++s, ++v)
+	if (!s->addr)
+	    *v = s->read(s->thunk);
+	else if (s->size == 8)
+	    *v = *reinterpret_cast<const volatile uint64_t *>(s->addr);
+	else
+	    *v = *reinterpret_cast<const volatile uint32_t *>(s->addr);
+    _region->update_ns = Timestamp::now().nsecval();
+    click_shmcounters_barrier();
+    _region->generation = _region->generation + 1;
+}
+
+void
+ShmCounters::run_timer(Timer *)
+{
+    update();
+    _timer.reschedule_after(_interval);
+}
+
+String
+ShmCounters::read_handler(Element *e, void *)
+{
+    ShmCounters *sc = static_cast<ShmCounters *>(e);
+    StringAccum sa;
+    for (String *n = sc->_names.begin(); n != sc->_names.end(); ++n)
+	sa << *n << '\n';
+    return sa.take_string();
+}
+
+int
+ShmCounters::write_handler(const String &, Element *e, void *, ErrorHandler *)
+{
+    ShmCounters *sc = static_cast<ShmCounters *>(e);
+    if (sc->_region)
+	sc->update();
+    return 0;
+}
+
+void
+ShmCounters::add_handlers()
+{
+    add_read_handler("counters", read_handler, 0, Handler::CALM);
+    add_write_handler("update", write_handler, 0, Handler::BUTTON);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel)
+EXPORT_ELEMENT(ShmCounters)
@@ -0,0 +1,144 @@
+#ifndef CLICK_SHMCOUNTERS_HH
+#define CLICK_SHMCOUNTERS_HH
+#include <click/element.hh>
+#include <click/timer.hh>
+struct click_shmcounters_header;
+CLICK_DECLS
+
+/*
+=c
+
+ShmCounters(FILENAME, EXPORT ... [, I<KEYWORDS>])
+
+=s control
+
+exports numeric statistics through shared memory
+
+=d
+
+Maintains a shared-memory region, the file FILENAME, that holds the current
+values of a set of numeric statistics in a fixed binary layout.  External
+programs can map FILENAME and sample thousands of statistics at high rates
+with no system calls and no interaction with the router: no handler is
+called and no value is formatted.  FILENAME should normally be on a memory
+file system, such as C</dev/shm/click-counters>.
+
+Each EXPORT argument is a space-separated list of `C<ELEMENT.STAT>' names.
+Element names may contain shell-style wildcards; for instance, `C<EXPORT
+q*.drops>' exports the drop count of every queue whose name starts with
+`C<q>'.  Only elements that support the CLICK_LLRPC_EXPORT_STAT LLRPC can
+export statistics.  These include:
+
+=over 5
+
+=item *
+
+Counter: C<count>, C<byte_count>
+
+=item *
+
+SimpleQueue, Queue, and other queues: C<length>, C<highwater_length>,
+C<drops>
+
+=item *
+
+FromDevice.u: C<count>
+
+=item *
+
+ToDevice.u: C<pulls>
+
+=back
+
+Every INTERVAL, ShmCounters copies each statistic from its element's
+memory into the region.  The copy is a few loads and stores per statistic,
+so short intervals are cheap.
+
+The region layout is defined by <click/shmcounters.h>, which external
+readers can include on its own.  A header gives the number of counters and
+the offsets of a name table and a value array; each value is a 64-bit
+unsigned integer.  Updates are published with a sequence lock, and the
+click_shmcounters_read() function in that header copies a consistent
+snapshot.  The `click-shmcounters' tool prints the contents of a region.
+
+The region is created under a temporary name and renamed to FILENAME, so
+readers of a previous region are unaffected.  FILENAME is removed when the
+router stops; readers that still have it mapped keep the last values.
+
+Keyword arguments are:
+
+=over 8
+
+=item EXPORT
+
+Space-separated `C<ELEMENT.STAT>' names.  May be given multiple times.
+
+=item INTERVAL
+
+Time value. Update interval.  Default is 10ms.
+
+=back
+
+=h counters read-only
+
+Returns the exported statistic names, one per line, in region order.
+
+=h update write-only
+
+Updates the region immediately.
+
+=e
+
+  q :: Queue;
+  c :: Counter;
+  ShmCounters(/dev/shm/click-counters, EXPORT c.count q.length q.drops,
+              INTERVAL 1ms);
+
+=a Counter, Queue, FromDevice.u, ToDevice.u, TelemetrySocket, ControlSocket */
+
+class ShmCounters : public Element { public:
+
+    ShmCounters();
+    ~ShmCounters();
+
+    const char *class_name() const	{ return "ShmCounters"; }
+
+    int configure(Vector<String> &conf, ErrorHandler *errh);
+    int initialize(ErrorHandler *errh);
+    void cleanup(CleanupStage stage);
+    void add_handlers();
+
+    void run_timer(Timer *);
+    void update();
+
+  private:
+
+    struct export_stat {
+	const volatile void *addr;
+	uint32_t size;
+	uint64_t (*read)(const void *);
+	const void *thunk;
+    };
+
+    String _filename;
+    Vector<String> _exports;
+    Timestamp _interval;
+    Timer _timer;
+
+    Vector<String> _names;
+    Vector<export_stat> _stats;
+    click_shmcounters_header *_region;
+    size_t _region_size;
+    volatile uint64_t *_values;
+
+    int add_stat(Element *e, const String &sname, bool quiet, ErrorHandler *errh);
+    int parse_export(const String &spec, ErrorHandler *errh);
+    int create_region(ErrorHandler *errh);
+
+    static String read_handler(Element *, void *);
+    static int write_handler(const String &, Element *, void *, ErrorHandler *);
+
+};
+
+CLICK_ENDDECLS
+#endif
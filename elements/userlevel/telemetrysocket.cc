@@ -0,0 +1,520 @@
+/*
+ * telemetrysocket.{cc,hh} -- element streams sampled handler values to
+ * TCP/IP or Unix-domain sockets
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding. */
+
+#include <click/config.h>
+#include "telemetrysocket.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/router.hh>
+#include <click/handler.hh>
+#include <click/straccum.hh>
+#include <click/userutils.hh>
+#include <clicknet/tcp.h>	/* for SEQ_LT, etc. */
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+CLICK_DECLS
+
+const char TelemetrySocket::protocol_version[] = "1.0";
+
+TelemetrySocket::sample_group::sample_group(TelemetrySocket *o, const Timestamp &i)
+    : owner(o), interval(i), timer(sample_hook, this)
+{
+}
+
+TelemetrySocket::TelemetrySocket()
+    : _socket_fd(-1), _max_pos(0), _live_fds(0), _dropped(0)
+{
+}
+
+TelemetrySocket::~TelemetrySocket()
+{
+}
+
+int
+TelemetrySocket::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    String socktype;
+    Args args = Args(this, errh).bind(conf);
+    if (args.read_mp("TYPE", socktype).execute() < 0)
+	return -1;
+
+    bool greeting = true;
+    if (args.read_all_with("SAMPLE", AnyArg(), _sample_specs)
+	.read("GREETING", greeting)
+	.consume() < 0)
+	return -1;
+    _greeting = greeting;
+
+    socktype = socktype.upper();
+    if (socktype == "TCP") {
+	_tcp_socket = true;
+	uint16_t portno;
+	if (args.read_mp("PORT", IPPortArg(IP_PROTO_TCP), portno)
+	    .complete() < 0)
+	    return -1;
+	_unix_pathname = String(portno);
+
+    } else if (socktype == "UNIX") {
+	_tcp_socket = false;
+	if (args.read_mp("FILENAME", FilenameArg(), _unix_pathname)
+	    .complete() < 0)
+	    return -1;
+	if (_unix_pathname.length() >= (int)sizeof(((struct sockaddr_un *)0)->sun_path))
+	    return errh->error("filename too long");
+
+    } else
+	return errh->error("unknown socket type %<%s%>", socktype.c_str());
+
+    if (!_sample_specs.size())
+	return errh->error("no SAMPLE arguments");
+    return 0;
+}
+
+int
+TelemetrySocket::add_sample(const Timestamp &interval, Element *e,
+			    const String &hname, bool quiet, ErrorHandler *errh)
+{
+    const Handler *h = Router::handler(e, hname);
+    String name = (e == router()->root_element() ? hname : e->name() + "." + hname);
+    if (!h || !h->read_visible()) {
+	if (quiet)
+	    return 0;
+	return errh->error("no read handler %<%s%>", name.c_str());
+    }
+
+    // Sample each handler from a timer on its element's home thread.
+    Element *timer_owner = e;
+    if (e == router()->root_element()
+	|| router()->home_thread_id(e) == router()->home_thread_id(this))
+	timer_owner = this;
+    int thread = router()->home_thread_id(timer_owner);
+
+    sample_group *g = 0;
+    for (sample_group **gp = _groups.begin(); gp != _groups.end(); ++gp)
+	if ((*gp)->interval == interval
+	    && router()->home_thread_id((*gp)->timer.element()) == thread) {
+	    g = *gp;
+	    break;
+	}
+    if (!g) {
+	g = new sample_group(this, interval);
+	g->timer.initialize(timer_owner);
+	_groups.push_back(g);
+    }
+
+    g->elements.push_back(e);
+    g->handlers.push_back(h);
+    g->names.push_back(name);
+    g->values.push_back(String());
+    return 0;
+}
+
+int
+TelemetrySocket::parse_sample(const String &spec, ErrorHandler *errh)
+{
+    Vector<String> words;
+    cp_spacevec(spec, words);
+    Timestamp interval;
+    if (words.size() < 2 || !TimestampArg().parse(words[0], interval)
+	|| !interval)
+	return errh->error("SAMPLE should be %<INTERVAL HANDLER...%>");
+
+    int before = errh->nerrors();
+    for (String *w = words.begin() + 1; w != words.end(); ++w) {
+	const char *dot = find(*w, '.');
+	if (dot == w->end()) {
+	    add_sample(interval, router()->root_element(), *w, false, errh);
+	    continue;
+	}
+	String ename = w->substring(w->begin(), dot);
+	String hname = w->substring(dot + 1, w->end());
+	if (has_glob(ename)) {
+	    for (int i = 0; i < router()->nelements(); ++i)
+		if (glob_match(router()->ename(i), ename))
+		    add_sample(interval, router()->element(i), hname, true, errh);
+	} else if (Element *e = router()->find(ename, this))
+	    add_sample(interval, e, hname, false, errh);
+	else
+	    errh->error("no element named %<%s%>", ename.c_str());
+    }
+    return errh->nerrors() == before ? 0 : -1;
+}
+
+int
+TelemetrySocket::initialize_socket_error(ErrorHandler *errh, const char *syscall)
+{
+    int e = errno;		// preserve errno
+    if (_socket_fd >= 0) {
+	close(_socket_fd);
+	_socket_fd = -1;
+    }
+    return errh->error("%s: %s", syscall, strerror(e));
+}
+
+int
+TelemetrySocket::initialize_socket(ErrorHandler *errh)
+{
+    // open socket, set options, bind to address
+    if (_tcp_socket) {
+	_socket_fd = socket(PF_INET, SOCK_STREAM, 0);
+	if (_socket_fd < 0)
+	    return initialize_socket_error(errh, "socket");
+	int sockopt = 1;
+	if (setsockopt(_socket_fd, SOL_SOCKET, SO_REUSEADDR, (void *)&sockopt, sizeof(sockopt)) < 0)
+	    errh->warning("setsockopt: %s", strerror(errno));
+
+	// bind to port
+	int portno = -1;
+	(void) IntArg().parse(_unix_pathname, portno);
+	struct sockaddr_in sa;
+	sa.sin_family = AF_INET;
+	sa.sin_port = htons(portno);
+	sa.sin_addr = IPAddress().in_addr();
+	if (bind(_socket_fd, (struct sockaddr *)&sa, sizeof(sa)) < 0)
+	    return initialize_socket_error(errh, "bind");
+
+    } else {
+	_socket_fd = socket(PF_UNIX, SOCK_STREAM, 0);
+	if (_socket_fd < 0)
+	    return initialize_socket_error(errh, "socket");
+
+	// bind to port
+	struct sockaddr_un sa;
+	sa.sun_family = AF_UNIX;
+	memcpy(sa.sun_path, _unix_pathname.c_str(), _unix_pathname.length() + 1);
+	if (bind(_socket_fd, (struct sockaddr *)&sa, sizeof(sa)) < 0)
+	    return initialize_socket_error(errh, "bind");
+    }
+
+    // start listening
+    if (listen(_socket_fd, 2) < 0)
+	return initialize_socket_error(errh, "listen");
+
+    // nonblocking I/O and close-on-exec for the socket
+    fcntl(_socket_fd, F_SETFL, O_NONBLOCK);
+    fcntl(_socket_fd, F_SETFD, FD_CLOEXEC);
+
+    add_select(_socket_fd, SELECT_READ);
+    return 0;
+}
+
+int
+TelemetrySocket::initialize(ErrorHandler *errh)
+{
+    // Handlers are resolved here, rather than in configure(), so that every
+    // element's handlers and home thread are known.
+    for (String *s = _sample_specs.begin(); s != _sample_specs.end(); ++s)
+	if (parse_sample(*s, errh) < 0)
+	    return -1;
+
+    if (initialize_socket(errh) < 0)
+	return -1;
+
+    // Other elements may not be initialized yet, so take the first sample
+    // once the router is running.
+    for (sample_group **gp = _groups.begin(); gp != _groups.end(); ++gp)
+	(*gp)->timer.schedule_now();
+    return 0;
+}
+
+void
+TelemetrySocket::cleanup(CleanupStage)
+{
+    for (sample_group **gp = _groups.begin(); gp != _groups.end(); ++gp)
+	delete *gp;
+    _groups.clear();
+
+    if (_socket_fd >= 0) {
+	// shut down the listening socket in case we forked
+#ifdef SHUT_RDWR
+	shutdown(_socket_fd, SHUT_RDWR);
+#else
+	shutdown(_socket_fd, 2);
+#endif
+	close(_socket_fd);
+	if (!_tcp_socket)
+	    unlink(_unix_pathname.c_str());
+	_socket_fd = -1;
+    }
+
+    for (int i = 0; i < _fd_alive.size(); i++)
+	if (_fd_alive[i]) {
+	    close(i);
+	    _fd_alive[i] = 0;
+	}
+    _live_fds = 0;
+}
+
+static bool
+parse_integer(const String &s, int64_t &value)
+{
+    return s && IntArg().parse(s, value);
+}
+
+static void
+append_value(StringAccum &sa, const String &name, const String &value,
+	     bool &first)
+{
+    int64_t x;
+    sa << (first ? "" : ",") << '"' << name.encode_json() << "\":";
+    if (parse_integer(value, x))
+	sa << x;
+    else
+	sa << '"' << value.encode_json() << '"';
+    first = false;
+}
+
+void
+TelemetrySocket::sample_hook(Timer *t, void *user_data)
+{
+    sample_group *g = static_cast<sample_group *>(user_data);
+    g->owner->sample(g);
+    t->reschedule_after(g->interval);
+}
+
+void
+TelemetrySocket::sample(sample_group *g)
+{
+    // Call the handlers outside the lock; only this group's timer thread
+    // (or a write to the "sample" handler) modifies g->values.
+    int n = g->handlers.size();
+    Vector<String> now(n, String());
+    for (int i = 0; i < n; ++i)
+	now[i] = g->handlers[i]->call_read(g->elements[i]).trim_space();
+    Timestamp ts = Timestamp::now();
+
+    StringAccum dsa, vsa;
+    bool dfirst = true, vfirst = true;
+    _lock.acquire();
+    for (int i = 0; i < n; ++i) {
+	String &old = g->values[i];
+	if (now[i] == old)
+	    continue;
+	int64_t x, y;
+	if (parse_integer(old, x) && parse_integer(now[i], y)) {
+	    dsa << (dfirst ? "" : ",") << '"' << g->names[i].encode_json()
+		<< "\":" << (y - x);
+	    dfirst = false;
+	} else
+	    append_value(vsa, g->names[i], now[i], vfirst);
+	old = now[i];
+    }
+
+    if (!dfirst || !vfirst) {
+	StringAccum sa;
+	sa << "{\"t\":" << ts;
+	if (!vfirst)
+	    sa << ",\"v\":{" << vsa << '}';
+	if (!dfirst)
+	    sa << ",\"d\":{" << dsa << '}';
+	sa << "}\n";
+	emit(sa.take_string());
+    }
+    _lock.release();
+}
+
+String
+TelemetrySocket::snapshot() const
+{
+    StringAccum sa;
+    bool first = true;
+    sa << "{\"t\":" << Timestamp::now() << ",\"v\":{";
+    for (sample_group * const *gp = _groups.begin(); gp != _groups.end(); ++gp)
+	for (int i = 0; i < (*gp)->names.size(); ++i)
+	    append_value(sa, (*gp)->names[i], (*gp)->values[i], first);
+    sa << "}}\n";
+    return sa.take_string();
+}
+
+void
+TelemetrySocket::emit(const String &record)
+{
+    if (_live_fds) {
+	_messages.push_back(record);
+	_message_pos.push_back(_max_pos);
+	_max_pos += record.length();
+	flush();
+    }
+}
+
+int
+TelemetrySocket::flush(int fd)
+{
+    // check file descriptor
+    if (fd >= _fd_alive.size() || !_fd_alive[fd])
+	return _messages.size();
+
+    // write any greeting and snapshot first
+    bool error = false;
+    while (_fd_prefix[fd]) {
+	const String &p = _fd_prefix[fd];
+	int w = write(fd, p.data(), p.length());
+	if (w < 0 && errno != EINTR) {
+	    error = (errno != EAGAIN);
+	    break;
+	} else if (w > 0)
+	    _fd_prefix[fd] = p.substring(w);
+    }
+
+    // find first useful message (binary search)
+    uint32_t fd_pos = _fd_pos[fd];
+    int l = 0, r = _messages.size() - 1, useful_message = _messages.size();
+    while (l <= r) {
+	int m = (l + r) >> 1;
+	if (SEQ_LT(fd_pos, _message_pos[m]))
+	    r = m - 1;
+	else if (SEQ_GEQ(fd_pos, _message_pos[m] + _messages[m].length()))
+	    l = m + 1;
+	else {
+	    useful_message = m;
+	    break;
+	}
+    }
+
+    // if messages found, write data until blocked or closed
+    while (!error && !_fd_prefix[fd] && useful_message < _message_pos.size()) {
+	const String &m = _messages[useful_message];
+	int mpos = _message_pos[useful_message];
+	const char *data = m.data() + (fd_pos - mpos);
+	int len = m.length() - (fd_pos - mpos);
+	int w = write(fd, data, len);
+	if (w < 0 && errno != EINTR) {
+	    error = (errno != EAGAIN);
+	    break;
+	} else if (w > 0)
+	    fd_pos += w;
+	if (SEQ_GEQ(fd_pos, mpos + m.length()))
+	    useful_message++;
+    }
+
+    // store changed fd_pos
+    _fd_pos[fd] = fd_pos;
+
+    // close out on error, or if socket falls too far behind
+    if (error || SEQ_LT(fd_pos, _max_pos - MAX_BACKLOG)) {
+	if (!error)
+	    _dropped++;
+	close(fd);
+	remove_select(fd, SELECT_WRITE);
+	_fd_alive[fd] = 0;
+	_fd_prefix[fd] = String();
+	_live_fds--;
+	return _messages.size();
+    } else if (fd_pos == _max_pos && !_fd_prefix[fd])
+	remove_select(fd, SELECT_WRITE);
+    else
+	add_select(fd, SELECT_WRITE);
+
+    return useful_message;
+}
+
+void
+TelemetrySocket::flush()
+{
+    int min_useful_message = _messages.size();
+    if (min_useful_message)
+	for (int i = 0; i < _fd_alive.size(); i++)
+	    if (_fd_alive[i]) {
+		int m = flush(i);
+		if (m < min_useful_message)
+		    min_useful_message = m;
+	    }
+
+    // cull old messages
+    if (min_useful_message >= 10 || (min_useful_message && !_live_fds)) {
+	_messages.erase(_messages.begin(), _messages.begin() + min_useful_message);
+	_message_pos.erase(_message_pos.begin(), _message_pos.begin() + min_useful_message);
+    }
+}
+
+void
+TelemetrySocket::selected(int fd, int)
+{
+    _lock.acquire();
+    if (fd == _socket_fd) {
+	union { struct sockaddr_in in; struct sockaddr_un un; } sa;
+#if HAVE_ACCEPT_SOCKLEN_T
+	socklen_t sa_len;
+#else
+	int sa_len;
+#endif
+	sa_len = sizeof(sa);
+	int new_fd = accept(_socket_fd, (struct sockaddr *)&sa, &sa_len);
+
+	if (new_fd < 0) {
+	    if (errno != EAGAIN)
+		click_chatter("%s: accept: %s", declaration().c_str(), strerror(errno));
+	    _lock.release();
+	    return;
+	}
+
+	fcntl(new_fd, F_SETFL, O_NONBLOCK);
+	fcntl(new_fd, F_SETFD, FD_CLOEXEC);
+
+	while (new_fd >= _fd_alive.size()) {
+	    _fd_alive.push_back(0);
+	    _fd_pos.push_back(0);
+	    _fd_prefix.push_back(String());
+	}
+	_fd_alive[new_fd] = 1;
+	_fd_pos[new_fd] = _max_pos;
+	_live_fds++;
+
+	// The snapshot reflects every record emitted so far, so the new client
+	// starts at the current end of the log.
+	StringAccum prefix;
+	if (_greeting)
+	    prefix << "Click::TelemetrySocket/" << protocol_version << "\r\n";
+	prefix << snapshot();
+	_fd_prefix[new_fd] = prefix.take_string();
+	fd = new_fd;
+    }
+
+    flush(fd);
+    _lock.release();
+}
+
+String
+TelemetrySocket::read_handler(Element *e, void *thunk)
+{
+    TelemetrySocket *ts = static_cast<TelemetrySocket *>(e);
+    if (thunk)
+	return String(ts->_dropped);
+    else
+	return String(ts->_live_fds);
+}
+
+int
+TelemetrySocket::sample_handler(const String &, Element *e, void *, ErrorHandler *)
+{
+    TelemetrySocket *ts = static_cast<TelemetrySocket *>(e);
+    for (sample_group **gp = ts->_groups.begin(); gp != ts->_groups.end(); ++gp)
+	ts->sample(*gp);
+    return 0;
+}
+
+void
+TelemetrySocket::add_handlers()
+{
+    add_read_handler("subscribers", read_handler, 0);
+    add_read_handler("dropped", read_handler, 1);
+    add_write_handler("sample", sample_handler, 0, Handler::BUTTON);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel)
+EXPORT_ELEMENT(TelemetrySocket)
@@ -0,0 +1,162 @@
+#ifndef CLICK_TELEMETRYSOCKET_HH
+#define CLICK_TELEMETRYSOCKET_HH
+#include <click/element.hh>
+#include <click/timer.hh>
+#include <click/sync.hh>
+CLICK_DECLS
+class Handler;
+
+/*
+=c
+
+TelemetrySocket("TCP", PORTNUMBER, SAMPLE ... [, I<KEYWORDS>])
+TelemetrySocket("UNIX", FILENAME, SAMPLE ... [, I<KEYWORDS>])
+
+=s control
+
+streams sampled handler values to connected sockets
+
+=d
+
+Periodically samples a set of read handlers and streams their values to
+every client connected to a TCP or UNIX-domain socket.  Unlike ControlSocket,
+clients do not poll: they connect and receive updates as they are produced.
+Each handler is read once per interval no matter how many clients are
+connected, and every client receives the same bytes, so adding subscribers
+costs only the socket writes.
+
+Each SAMPLE argument has the form `C<INTERVAL HANDLER...>', and specifies
+that the named read handlers should be sampled every INTERVAL seconds.
+Element names in HANDLER may contain shell-style wildcards, as in
+`C<SAMPLE 1s c*.count>'.  Supply SAMPLE more than once to sample different
+handlers at different rates.
+
+Updates are JSON objects, one per line.  A client first receives a
+snapshot holding the most recently sampled value of every handler, then one
+line per sampling interval in which some value changed:
+
+  {"t":1350000000.123456,"v":{"c.count":12,"q.length":0,"src.data":"abc"}}
+  {"t":1350000001.123456,"d":{"c.count":5}}
+
+`C<t>' is the sampling time.  `C<v>' holds absolute values: integers are
+reported as JSON numbers, other values as strings.  `C<d>' holds
+delta-encoded integer values, the change since the handler's previously
+reported value; handlers that did not change are omitted.  A handler
+whose value switches between integer and non-integer forms is reported in
+`C<v>'.
+
+The server does not read any data from its clients.  Handlers are sampled by
+timers running on their elements' home threads.  If a client falls more than
+500,000 bytes behind, TelemetrySocket closes its connection; it may reconnect
+to receive a fresh snapshot.
+
+Keyword arguments are:
+
+=over 8
+
+=item SAMPLE
+
+`C<INTERVAL HANDLER...>'.  May be given multiple times.  At least one is
+required.
+
+=item GREETING
+
+Boolean. Determines whether the C<Click::TelemetrySocket/1.0> greeting line
+is sent to new clients before the snapshot.  Default is true.
+
+=back
+
+=h subscribers read-only
+
+Returns the number of connected clients.
+
+=h dropped read-only
+
+Returns the number of clients disconnected for falling behind.
+
+=h sample write-only
+
+Samples every handler immediately and sends any changes.
+
+=e
+
+  TelemetrySocket(unix, /tmp/telemetry,
+                  SAMPLE 100ms q.length q.drops,
+                  SAMPLE 1s c*.count);
+
+=a ControlSocket, ChatterSocket */
+
+class TelemetrySocket : public Element { public:
+
+    TelemetrySocket();
+    ~TelemetrySocket();
+
+    const char *class_name() const	{ return "TelemetrySocket"; }
+
+    int configure_phase() const		{ return CONFIGURE_PHASE_INFO; }
+    int configure(Vector<String> &conf, ErrorHandler *);
+    int initialize(ErrorHandler *);
+    void cleanup(CleanupStage);
+    void add_handlers();
+
+    void selected(int fd, int mask);
+
+  private:
+
+    struct sample_group {
+	TelemetrySocket *owner;
+	Timestamp interval;
+	Timer timer;
+	Vector<Element *> elements;
+	Vector<const Handler *> handlers;
+	Vector<String> names;
+	Vector<String> values;
+	sample_group(TelemetrySocket *o, const Timestamp &i);
+    };
+
+    String _unix_pathname;
+    int _socket_fd;
+    bool _greeting : 1;
+    bool _tcp_socket : 1;
+
+    Vector<String> _sample_specs;
+    Vector<sample_group *> _groups;
+
+    // Shared output log, as in ChatterSocket.  Positions are byte offsets
+    // into the stream of all records sent; old records are culled once
+    // every client has written them.
+    Vector<String> _messages;
+    Vector<uint32_t> _message_pos;
+    uint32_t _max_pos;
+
+    Vector<int> _fd_alive;
+    Vector<uint32_t> _fd_pos;
+    Vector<String> _fd_prefix;
+    int _live_fds;
+    uint32_t _dropped;
+
+    Spinlock _lock;
+
+    static const char protocol_version[];
+    enum { MAX_BACKLOG = 500000 };
+
+    int parse_sample(const String &spec, ErrorHandler *errh);
+    int add_sample(const Timestamp &interval, Element *e, const String &hname,
+		   bool quiet, ErrorHandler *errh);
+    int initialize_socket_error(ErrorHandler *errh, const char *syscall);
+    int initialize_socket(ErrorHandler *errh);
+
+    static void sample_hook(Timer *t, void *user_data);
+    void sample(sample_group *g);
+    String snapshot() const;
+    void emit(const String &record);
+    int flush(int fd);
+    void flush();
+
+    static String read_handler(Element *, void *);
+    static int sample_handler(const String &, Element *, void *, ErrorHandler *);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -32,8 +32,10 @@
 #include <click/standard/scheduleinfo.hh>
 #include <click/packet_anno.hh>
 #include <click/straccum.hh>
+#include <click/llrpc.h>
 #include <stdio.h>
 #include <unistd.h>
+#include <sys/uio.h>
 
 #if TODEVICE_ALLOW_DEVBPF
 # include <fcntl.h>
@@ -313,6 +315,25 @@ ToDevice::netmap_send_packet(Packet *p)
 }
 #endif
 
+/*
+ * Segmented packets are sent with one gathering system call.  Return the
+ * number of iovecs filled in, or -1 if the packet has too many segments or
+ * the method cannot gather.
+ */
+int
+ToDevice::gather_packet(const Packet *p, struct iovec *iov) const
+{
+    if (_method != method_linux && _method != method_devbpf
+	&& _method != method_pcapfd)
+	return -1;
+    int n = 0;
+    for (; p && n < max_iov; p = p->segment(), ++n) {
+	iov[n].iov_base = const_cast<unsigned char *>(p->data());
+	iov[n].iov_len = p->length();
+    }
+    return p ? -1 : n;
+}
+
 /*
  * Linux select marks datagram fd's as writeable when the socket
  * buffer has enough space to do a send (sock_writeable() in
@@ -329,6 +350,26 @@ ToDevice::send_packet(Packet *p)
     int r = 0;
     errno = 0;
 
+#if TODEVICE_ALLOW_LINUX || TODEVICE_ALLOW_DEVBPF || TODEVICE_ALLOW_PCAPFD
+    if (p->segmented()) {
+	struct iovec iov[max_iov];
+	int niov = gather_packet(p, iov);
+	assert(niov > 0);
+# if TODEVICE_ALLOW_LINUX
+	if (_method == method_linux) {
+	    struct msghdr msg;
+	    memset(&msg, 0, sizeof(msg));
+	    msg.msg_iov = iov;
+	    msg.msg_iovlen = niov;
+	    r = sendmsg(_fd, &msg, 0);
+	} else
+# endif
+	if (writev(_fd, iov, niov) != (ssize_t) p->total_length())
+	    r = -1;
+	return r >= 0 ? 0 : (errno ? -errno : -EINVAL);
+    }
+#endif
+
 #if TODEVICE_ALLOW_NETMAP
     if (_method == method_netmap)
 	r = netmap_send_packet(p);
@@ -379,6 +420,11 @@ ToDevice::run_task(Task *)
 	    ++_pulls;
 	    if (!(p = input(0).pull()))
 		break;
+	    // copy the segments of packets we can't send by gathering
+	    struct iovec iov[max_iov];
+	    if (p->segmented() && gather_packet(p, iov) < 0
+		&& !(p = p->linearize()))
+		continue;
 	}
 	if ((r = send_packet(p)) >= 0) {
 	    _backoff = 0;
@@ -471,6 +517,20 @@ ToDevice::add_handlers()
     add_write_handler("debug", write_param, h_debug);
 }
 
+int
+ToDevice::llrpc(unsigned command, void *data)
+{
+    if (command == CLICK_LLRPC_EXPORT_STAT) {
+	click_llrpc_export_stat_st *es = (click_llrpc_export_stat_st *) data;
+	if (strcmp(es->name, "pulls") != 0)
+	    return -EINVAL;
+	es->addr = &_pulls;
+	es->size = sizeof(_pulls);
+	return 0;
+    } else
+	return Element::llrpc(command, data);
+}
+
 CLICK_ENDDECLS
 ELEMENT_REQUIRES(FromDevice userlevel)
 EXPORT_ELEMENT(ToDevice)
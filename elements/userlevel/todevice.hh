@@ -6,6 +6,7 @@
 #include <click/timer.hh>
 #include <click/notifier.hh>
 #include "elements/userlevel/fromdevice.hh"
+struct iovec;
 CLICK_DECLS
 
 /*
@@ -56,10 +57,19 @@ CLICK_DECLS
  *
  * Packets that are written successfully are sent on output 0, if it exists.
  * Packets that fail to be written are pushed out output 1, if it exists.
+ *
+ * Segmented packets, such as those FromDevice.u and KernelTun create for
+ * jumbo and TSO/GSO-sized traffic, are sent with a single gathering write
+ * when METHOD is LINUX, or on BSDs, so their data is not copied.  With other
+ * methods, ToDevice first makes their data contiguous.
 
  * KernelTun lets you send IP packets to the host kernel's IP processing code,
  * sort of like the kernel module's ToHost element.
  *
+ * =h CLICK_LLRPC_EXPORT_STAT llrpc
+ *
+ * Exports the C<pulls> statistic to ShmCounters; see <click/llrpc.h>.
+ *
  * =a
  * FromDevice.u, FromDump, ToDump, KernelTun, ToDevice(n) */
 
@@ -89,13 +99,14 @@ class ToDevice : public Element { public:
     const char *class_name() const		{ return "ToDevice"; }
     const char *port_count() const		{ return "1/0-2"; }
     const char *processing() const		{ return "l/h"; }
-    const char *flags() const			{ return "S2"; }
+    const char *flags() const			{ return "S2 G"; }
 
     int configure_phase() const { return KernelFilter::CONFIGURE_PHASE_TODEVICE; }
     int configure(Vector<String> &, ErrorHandler *);
     int initialize(ErrorHandler *);
     void cleanup(CleanupStage);
     void add_handlers();
+    int llrpc(unsigned, void *);
 
     String ifname() const			{ return _ifname; }
     int fd() const				{ return _fd; }
@@ -138,6 +149,8 @@ class ToDevice : public Element { public:
 
     enum { h_debug, h_signal, h_pulls, h_q };
     FromDevice *find_fromdevice() const;
+    enum { max_iov = 64 };
+    int gather_packet(const Packet *p, struct iovec *iov) const;
     int send_packet(Packet *p);
     static int write_param(const String &in_s, Element *e, void *vparam, ErrorHandler *errh);
     static String read_param(Element *e, void *thunk);
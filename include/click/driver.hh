@@ -17,7 +17,7 @@ void click_static_initialize();
 void click_static_cleanup();
 
 Lexer *click_lexer();
-Router *click_read_router(String filename, bool is_expr, ErrorHandler * = 0, bool initialize = true, Master * = 0);
+Router *click_read_router(String filename, bool is_expr, ErrorHandler * = 0, bool initialize = true, Master * = 0, Vector<String> *files = 0);
 
 String click_compile_archive_file(const Vector<ArchiveElement> &ar,
 		const ArchiveElement *ae,
@@ -242,6 +242,9 @@ class Element { public:
 #if CLICK_STATS >= 2
 	Element* _owner;		// Whose input or output are we?
 #endif
+#if CLICK_USERLEVEL
+	bool _linearize;		// Does the receiver lack the G flag?
+#endif
 
 	inline Port();
 	inline void assign(bool isoutput, Element *owner, Element *e, int port);
@@ -527,6 +530,9 @@ Element::Port::Port()
     : _e(0), _port(-2)
 {
     PORT_ASSIGN(0);
+#if CLICK_USERLEVEL
+    _linearize = false;
+#endif
 }
 
 inline void
@@ -553,6 +559,12 @@ Element::Port::assign(bool isoutput, Element *owner, Element *e, int port)
 {
     PORT_ASSIGN(owner);
     assign(isoutput, e, port);
+#if CLICK_USERLEVEL
+    // The element receiving packets over this port is e for a push output
+    // and owner for a pull input.
+    Element *receiver = (isoutput ? e : owner);
+    _linearize = receiver && receiver->flag_value('G') <= 0;
+#endif
 }
 
 /** @brief Returns whether this port is active (a push output or a pull input).
@@ -597,6 +609,9 @@ Element::Port::port() const
  * freed by downstream elements.  Thus, you must not use @a p after pushing it
  * downstream.  To push a copy and keep a copy, see Packet::clone().
  *
+ * At user level, a Packet::segmented() packet pushed to an element that
+ * lacks the <tt>G</tt> flag is linearized first; see Element::flags().
+ *
  * output(i).push(p) basically behaves like the following code, although it
  * maintains additional statistics depending on how CLICK_STATS is defined:
  *
@@ -608,6 +623,10 @@ inline void
 Element::Port::push(Packet* p) const
 {
     assert(_e && p);
+#if CLICK_USERLEVEL
+    if (unlikely(p->segmented()) && _linearize && !(p = p->linearize()))
+	return;
+#endif
 #if CLICK_STATS >= 1
     ++_packets;
 #endif
@@ -643,6 +662,9 @@ Element::Port::push(Packet* p) const
  * This port must be an active() pull input port.  Usually called from element
  * code like @link Element::input input(i) @endlink .pull().
  *
+ * At user level, a Packet::segmented() packet pulled by an element that
+ * lacks the <tt>G</tt> flag is linearized first; see Element::flags().
+ *
  * input(i).pull() basically behaves like the following code, although it
  * maintains additional statistics depending on how CLICK_STATS is defined:
  *
@@ -676,6 +698,10 @@ Element::Port::pull() const
     Packet *p = _e->pull(_port);
 # endif
 #endif
+#if CLICK_USERLEVEL
+    if (p && unlikely(p->segmented()) && _linearize)
+	p = p->linearize();
+#endif
 #if CLICK_STATS >= 1
     if (p)
 	++_packets;
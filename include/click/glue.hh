@@ -375,6 +375,24 @@ click_invalid_processor()
 extern __thread int click_current_thread_id;
 #endif
 
+/** @brief Return the index of the calling thread's shard among @a nshards.
+ *
+ * Elements that keep per-thread state in @a nshards shards use this to pick
+ * the shard for the running thread or processor.  Without threads, always
+ * returns 0. */
+inline unsigned
+click_current_shard(unsigned nshards)
+{
+#if CLICK_USERLEVEL && HAVE_MULTITHREAD && HAVE___THREAD_STORAGE_CLASS
+    return (unsigned) click_current_thread_id % nshards;
+#elif CLICK_LINUXMODULE
+    return (unsigned) click_current_processor() % nshards;
+#else
+    (void) nshards;
+    return 0;
+#endif
+}
+
 
 // TIMEVALS AND JIFFIES
 // click_jiffies_t is the type of click_jiffies() and must be unsigned.
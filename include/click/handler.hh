@@ -42,6 +42,8 @@ class Handler { public:
 	h_button = 0x2000,	///< @brief Write handler ignores data.
 	h_checkbox = 0x4000,	///< @brief Read/write handler is boolean and
 				///  should be rendered as a checkbox.
+	h_read_chunked = 0x8000,///< @brief Read handler can return its value
+				///  in chunks; see call_read_chunk().
 	h_driver_flag_shift = 20,
 	h_driver_flag_0 = 1 << h_driver_flag_shift,
 				///< @brief First uninterpreted handler flag
@@ -166,6 +168,15 @@ class Handler { public:
 	return _flags & h_raw;
     }
 
+    /** @brief Check if this read handler can return its value in chunks.
+     *
+     * Chunked read handlers, such as large tables, also take parameters; see
+     * call_read_chunk(). */
+    inline bool read_chunked() const {
+	return (_flags & (h_read | h_read_param | h_read_chunked))
+	    == (h_read | h_read_param | h_read_chunked);
+    }
+
 
     /** @brief Call a read handler, possibly with parameters.
      * @param e element on which to call the handler
@@ -198,6 +209,47 @@ class Handler { public:
      * which case errors are reported to ErrorHandler::silent_handler(). */
     int call_write(const String &value, Element *e, ErrorHandler *errh) const;
 
+    /** @brief Call a read handler for one chunk of its value.
+     * @param e element on which to call the handler
+     * @param[in,out] cursor position of the chunk to read: empty for the
+     * first chunk, otherwise a cursor returned by an earlier call
+     * @param max maximum number of entries to return
+     * @param errh optional error handler
+     *
+     * On return, @a cursor holds the position of the next chunk, or is empty
+     * if the value is complete.  Cursors are opaque strings defined by the
+     * handler.  Chunked handlers bound each call's memory use and latency
+     * by @a max, although they may return a few extra entries to end a chunk
+     * at a convenient boundary.  If this handler is not read_chunked(),
+     * returns its whole value and sets @a cursor to empty.
+     *
+     * Chunks are not a snapshot.  Many handlers' cursors are positions in a
+     * hash table or vector, so if the element changes between calls, for
+     * instance by resizing that table, entries may be missed or repeated.
+     * Callers that need a consistent value should read it whole.
+     *
+     * A chunked handler is called with a parameter of the form "CHUNK max
+     * [cursor]", which it can parse with parse_chunk_param(), and returns
+     * chunk_value(). */
+    String call_read_chunk(Element *e, String &cursor, uint32_t max,
+			   ErrorHandler *errh) const;
+
+    /** @brief Parse a chunked read handler parameter.
+     * @param param handler parameter
+     * @param[out] max maximum number of entries to return
+     * @param[out] cursor position of the chunk to read
+     * @return true iff @a param requests a chunk
+     * @sa call_read_chunk() */
+    static bool parse_chunk_param(const String &param, uint32_t &max,
+				  String &cursor);
+
+    /** @brief Return a chunked read handler's value.
+     * @param next_cursor position of the next chunk, or empty if this chunk
+     * completes the value
+     * @param data this chunk's data
+     * @sa call_read_chunk() */
+    static String chunk_value(const String &next_cursor, const String &data);
+
 
     /** @brief Unparse this handler's name.
      * @param e relevant element
@@ -94,6 +94,24 @@ inline hashcode_t hashcode(T * const &x) {
     return reinterpret_cast<uintptr_t>(x) >> 3;
 }
 
+/** @brief Mix the bits of @a h into a well-distributed 32-bit hash.
+ *
+ * Every input bit affects every output bit (the MurmurHash3 finalizer), so
+ * the result can be masked or shifted to pick a bucket or a shard. */
+inline uint32_t hash_mix32(uint32_t h) {
+    h ^= h >> 16;
+    h *= 0x85EBCA6BU;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35U;
+    return h ^ (h >> 16);
+}
+
+/** @brief Mix the bits of @a k into a well-distributed 32-bit hash.
+ * @sa hash_mix32 */
+inline uint32_t hash_mix64(uint64_t k) {
+    return hash_mix32((uint32_t) k ^ ((uint32_t) (k >> 32) * 0x9E3779B1U));
+}
+
 template <typename T>
 inline typename T::key_const_reference hashkey(const T &x) {
     return x.hashkey();
@@ -17,6 +17,7 @@
  * legally binding.
  */
 #include <click/pair.hh>
+#include <click/algorithm.hh>
 #include <click/hashcontainer.hh>
 #include <click/hashallocator.hh>
 CLICK_DECLS
@@ -197,6 +198,15 @@ class HashTable<T> {
     /** @overload */
     inline const_iterator end() const;
 
+    /** @brief Return an iterator for the first element in bucket @a n.
+     *
+     * The result is not live() if bucket @a n is empty.  Otherwise,
+     * advancing it continues into later buckets in order.
+     * @param n bucket number, >= 0 and < bucket_count() */
+    inline iterator begin(size_type n);
+    /** @overload */
+    inline const_iterator begin(size_type n) const;
+
 
     /** @brief Return an iterator for the element with key @a key, if any.
      *
@@ -360,6 +370,11 @@ class HashTable_const_iterator { public:
 	return _rep ? &HashTable_const_iterator::live : 0;
     }
 
+    /** @brief Return the bucket number this iterator is in. */
+    size_t bucket() const {
+	return _rep.bucket();
+    }
+
     /** @brief Advance this iterator to the next element. */
     void operator++(int) {
 	_rep++;
@@ -492,6 +507,11 @@ class HashTable_const_iterator<Pair<K, V> > { public:
 	return _rep ? &HashTable_const_iterator::live : 0;
     }
 
+    /** @brief Return the bucket number this iterator is in. */
+    size_t bucket() const {
+	return _rep.bucket();
+    }
+
     /** @brief Advance this iterator to the next element. */
     void operator++(int) {
 	_rep++;
@@ -662,6 +682,16 @@ class HashTable {
 	return _rep.begin();
     }
 
+    /** @brief Return an iterator for the first element in bucket @a n.
+     * @param n bucket number, >= 0 and < bucket_count() */
+    inline iterator begin(size_type n) {
+	return _rep.begin(n);
+    }
+    /** @overload */
+    inline const_iterator begin(size_type n) const {
+	return _rep.begin(n);
+    }
+
     /** @brief Return an iterator for the end of the table.
      * @invariant end().live() == false */
     inline iterator end() {
@@ -884,6 +914,18 @@ inline typename HashTable<T>::iterator HashTable<T>::begin()
     return iterator(_rep.begin());
 }
 
+template <typename T>
+inline typename HashTable<T>::const_iterator HashTable<T>::begin(size_type n) const
+{
+    return const_iterator(_rep.begin(n));
+}
+
+template <typename T>
+inline typename HashTable<T>::iterator HashTable<T>::begin(size_type n)
+{
+    return iterator(_rep.begin(n));
+}
+
 template <typename T>
 inline typename HashTable<T>::const_iterator HashTable<T>::end() const
 {
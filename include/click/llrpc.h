@@ -85,6 +85,7 @@ CLICK_CXX_UNPROTECT
 #define CLICK_LLRPC_RAW_HANDLER			_CLICK_IOS(17)
 #define CLICK_LLRPC_ABANDON_HANDLER		_CLICK_IOS(18)
 #define CLICK_LLRPC_CALL_HANDLER		_CLICK_IO(19)
+#define CLICK_LLRPC_EXPORT_STAT			_CLICK_IOS(20)
 
 struct click_llrpc_proxy_st {
     void* proxied_handler;	/* const Router::Handler* */
@@ -106,6 +107,16 @@ struct click_llrpc_call_handler_st {
     void *errorbuf;
 };
 
+/* CLICK_LLRPC_EXPORT_STAT is in-process only: it reports where a numeric
+   statistic lives so that ShmCounters can copy it without formatting. */
+struct click_llrpc_export_stat_st {
+    const char *name;		/* in: statistic name, such as "count" */
+    const volatile void *addr;	/* out: address of the statistic, or 0 */
+    uint32_t size;		/* out: size of *addr in bytes (4 or 8) */
+    uint64_t (*read)(const void *thunk); /* out: if !addr, read(thunk) */
+    const void *thunk;
+};
+
 /* data manipulation */
 
 #if CLICK_USERLEVEL
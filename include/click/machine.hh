@@ -53,4 +53,36 @@ click_fence()
 #endif
 }
 
+/** @brief Read memory fence.
+
+    Orders earlier loads before later loads, as needed by the readers of a
+    sequence lock. */
+inline void
+click_read_fence()
+{
+#if CLICK_LINUXMODULE
+    smp_rmb();
+#elif defined(__i386__) || defined(__arch_um__) || defined(__x86_64__)
+    click_compiler_fence();	// x86 does not reorder loads with loads
+#else
+    click_fence();
+#endif
+}
+
+/** @brief Write memory fence.
+
+    Orders earlier stores before later stores, as needed by the writers of
+    a sequence lock. */
+inline void
+click_write_fence()
+{
+#if CLICK_LINUXMODULE
+    smp_wmb();
+#elif defined(__i386__) || defined(__arch_um__) || defined(__x86_64__)
+    click_compiler_fence();	// x86 does not reorder stores with stores
+#else
+    click_fence();
+#endif
+}
+
 #endif
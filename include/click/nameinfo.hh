@@ -5,6 +5,7 @@
 #include <click/straccum.hh>
 CLICK_DECLS
 class Element;
+class Router;
 class NameDB;
 class ErrorHandler;
 
@@ -111,6 +112,16 @@ class NameInfo { public:
      */
     static void uninstalldb(NameDB *db);
 
+    /** @brief Prepare databases for concurrent queries.
+     * @param router router whose databases are queried, may be null
+     *
+     * Queries may reorganize dynamic databases.  After this call, and until
+     * the next definition, queries on the global databases and on @a
+     * router's databases do not modify them, so several threads can query
+     * at once.  Router uses this function before configuring elements in
+     * parallel. */
+    static void prepare_concurrent_queries(Router *router);
+
     /** @brief Query installed databases for @a name.
      * @param type database type
      * @param context compound element context
@@ -314,6 +325,12 @@ class NameDB { public:
      * The default implementation always returns false. */
     virtual bool define(const String &name, const void *value, size_t value_size);
 
+    /** @brief Prepare this database for concurrent queries.
+     *
+     * After this call, query() and revquery() must not modify the database
+     * until the next define().  The default implementation does nothing. */
+    virtual void prepare_concurrent_queries();
+
     /** @brief Define a name in this database to a 32-bit integer value.
      * @param name name to define
      * @param value value to define
@@ -438,6 +455,8 @@ class DynamicNameDB : public NameDB { public:
      * The @a value_size parameter must equal this database's value size. */
     bool define(const String &name, const void *value, size_t value_size);
 
+    void prepare_concurrent_queries();
+
 #if CLICK_NAMEDB_CHECK
     /** @cond never */
     void check(ErrorHandler *);
@@ -77,6 +77,20 @@ class Packet { public:
     inline const unsigned char *end_buffer() const;
     inline uint32_t buffer_length() const;
 
+    // SEGMENTS
+#if CLICK_USERLEVEL
+    static WritablePacket *make_segmented(uint32_t headroom, const void *data,
+					  uint32_t length, uint32_t segment_length) CLICK_WARN_UNUSED_RESULT;
+    void append_segment(Packet *p);
+#endif
+    inline bool segmented() const;
+    inline Packet *segment() const;
+    inline uint32_t total_length() const;
+    uint32_t copy_data(uint32_t offset, void *dst, uint32_t len) const;
+    inline Packet *linearize() CLICK_WARN_UNUSED_RESULT;
+    inline uint32_t cow_header_length() const;
+    inline void set_cow_header_length(uint32_t len);
+
 #if CLICK_LINUXMODULE
     struct sk_buff *skb()		{ return (struct sk_buff *)this; }
     const struct sk_buff *skb() const	{ return (const struct sk_buff*)this; }
@@ -105,7 +119,8 @@ class Packet { public:
      * before the current packet's data().  A copy of the packet data is made
      * if there isn't enough headroom() in the current packet, or if the
      * current packet is shared().  If no copy is made, this operation is
-     * quite efficient.
+     * quite efficient.  Only the first segment of a segmented() packet is
+     * copied; later segments stay shared.
      *
      * If a data copy would be required, but the copy fails because of lack of
      * memory, then the current packet is freed.
@@ -161,7 +176,8 @@ class Packet { public:
      * Ethernet header).  This operation is efficient: it just bumps a
      * pointer.
      *
-     * It is an error to attempt to pull more than length() bytes.
+     * It is an error to attempt to pull more than length() bytes.  For a
+     * segmented() packet, length() covers only the first segment.
      *
      * @post new data() == old data() + @a len
      * @post new length() == old length() - @a len
@@ -177,7 +193,8 @@ class Packet { public:
      * after the current packet's data (starting at end_data()).  A copy of
      * the packet data is made if there isn't enough tailroom() in the current
      * packet, or if the current packet is shared().  If no copy is made, this
-     * operation is quite efficient.
+     * operation is quite efficient.  A segmented() packet is linearized
+     * first, so the new space follows all of its data.
      *
      * If a data copy would be required, but the copy fails because of lack of
      * memory, then the current packet is freed.
@@ -216,9 +233,10 @@ class Packet { public:
      * @param len amount of space to remove
      *
      * Removes @a len bytes from the end of the packet.  This operation is
-     * efficient: it just bumps a pointer.
+     * efficient: it just bumps a pointer.  For a segmented() packet, the
+     * bytes come from the last segments, and segments left empty are freed.
      *
-     * It is an error to attempt to pull more than length() bytes.
+     * It is an error to attempt to take more than total_length() bytes.
      *
      * @post new data() == old data()
      * @post new end_data() == old end_data() - @a len
@@ -712,6 +730,8 @@ class Packet { public:
     unsigned char *_end;  /* one beyond end of allocated buffer */
 # if CLICK_USERLEVEL
     buffer_destructor_type _destructor;
+    Packet *_segment;	  /* next data segment, or null */
+    uint32_t _cow_length; /* header-only copy-on-write length, or 0 */
 # endif
 # if CLICK_BSDMODULE
     struct mbuf *_m;
@@ -743,6 +763,10 @@ class Packet { public:
     WritablePacket *expensive_uniqueify(int32_t extra_headroom, int32_t extra_tailroom, bool free_on_failure);
     WritablePacket *expensive_push(uint32_t nbytes);
     WritablePacket *expensive_put(uint32_t nbytes);
+#if CLICK_USERLEVEL
+    WritablePacket *expensive_linearize(uint32_t extra_tailroom);
+    void expensive_take(uint32_t nbytes);
+#endif
 
     friend class WritablePacket;
 
@@ -850,6 +874,8 @@ WritablePacket::initialize()
     _data_packet = 0;
 # if CLICK_USERLEVEL
     _destructor = 0;
+    _segment = 0;
+    _cow_length = 0;
 # elif CLICK_BSDMODULE
     _m = 0;
 # endif
@@ -920,7 +946,11 @@ Packet::end_buffer() const
 #endif
 }
 
-/** @brief Return the packet's length. */
+/** @brief Return the packet's length.
+ *
+ * For a segmented() packet, this is the length of the first segment only,
+ * which is the part of the packet reachable from data().  Use
+ * total_length() for the length of the whole packet. */
 inline uint32_t
 Packet::length() const
 {
@@ -962,6 +992,107 @@ Packet::buffer_length() const
     return end_buffer() - buffer();
 }
 
+/** @brief Test whether this packet has more than one data segment.
+ *
+ * At user level, a packet's data may be split over a chain of segments.
+ * The first segment is the packet itself: data() and length() refer to it,
+ * and it normally holds the packet's headers.  Later segments, returned by
+ * segment(), hold the rest of the data.  Segments let large packets, such
+ * as jumbo frames and TSO/GSO aggregates, be built from ordinary buffers,
+ * and let push() and uniqueify() copy only the first segment.  Segment
+ * data is always read-only; use linearize() to get a contiguous, writable
+ * copy.  Other drivers never create segmented packets. */
+inline bool
+Packet::segmented() const
+{
+#if CLICK_USERLEVEL
+    return _segment != 0;
+#else
+    return false;
+#endif
+}
+
+/** @brief Return the packet's second data segment, or null.
+ *
+ * The segment's data() and length() give its part of the packet data.  Its
+ * own segment() continues the chain.  Segments are owned by the packet;
+ * don't kill them or change their annotations.
+ * @sa segmented */
+inline Packet *
+Packet::segment() const
+{
+#if CLICK_USERLEVEL
+    return _segment;
+#else
+    return 0;
+#endif
+}
+
+/** @brief Return the length of the packet's data, including all segments.
+ * @invariant total_length() == length() if !segmented() */
+inline uint32_t
+Packet::total_length() const
+{
+#if CLICK_USERLEVEL
+    uint32_t len = length();
+    for (const Packet *s = _segment; s; s = s->_segment)
+	len += s->length();
+    return len;
+#else
+    return length();
+#endif
+}
+
+/** @brief Return a packet whose data is contiguous.
+ * @return the contiguous packet, or null on failure
+ *
+ * If the packet is not segmented(), returns the packet itself.  Otherwise
+ * copies all segments into one buffer and returns the result, which is
+ * unshared.  The input packet is freed if the copy fails.  As with
+ * uniqueify(), do not use the input pointer after the call. */
+inline Packet *
+Packet::linearize()
+{
+#if CLICK_USERLEVEL
+    if (_segment)
+	return expensive_linearize(0);
+#endif
+    return this;
+}
+
+/** @brief Return the packet's header-only copy-on-write length.
+ * @sa set_cow_header_length */
+inline uint32_t
+Packet::cow_header_length() const
+{
+#if CLICK_USERLEVEL
+    return _cow_length;
+#else
+    return 0;
+#endif
+}
+
+/** @brief Set the packet's header-only copy-on-write length.
+ * @param len header length, or 0 to turn header-only copy-on-write off
+ *
+ * Normally, uniqueify() on a shared() packet copies all of its data.  If
+ * @a len is nonzero, uniqueify(), push(), and similar functions instead
+ * copy only the first @a len bytes of data, plus the headroom and enough
+ * bytes to cover the network and transport headers.  The rest of the data
+ * stays shared as a read-only segment; see segmented().  This makes writing
+ * the headers of cloned packets cheap.  The setting is copied to clones.
+ *
+ * Only available at user level; elsewhere this function does nothing. */
+inline void
+Packet::set_cow_header_length(uint32_t len)
+{
+#if CLICK_USERLEVEL
+    _cow_length = len;
+#else
+    (void) len;
+#endif
+}
+
 inline Packet *
 Packet::next() const
 {
@@ -1509,7 +1640,10 @@ Packet::shared() const
  *
  * The input packet's headroom and tailroom areas are copied in addition to
  * its true contents.  The header annotations are shifted to point into the
- * new packet data if necessary.
+ * new packet data if necessary.  Only the first segment of a segmented()
+ * packet is copied: later segments are read-only, so they stay shared.
+ * With header-only copy-on-write (see set_cow_header_length()), only the
+ * packet's headers are copied, and the result is segmented().
  *
  * uniqueify() is usually used like this:
  * @code
@@ -1589,7 +1723,7 @@ Packet::pull(uint32_t len)
 inline WritablePacket *
 Packet::put(uint32_t len)
 {
-    if (tailroom() >= len && !shared()) {
+    if (tailroom() >= len && !shared() && !segmented()) {
 	WritablePacket *q = (WritablePacket *)this;
 #if CLICK_LINUXMODULE	/* Linux kernel module */
 	__skb_put(q->skb(), len);
@@ -1608,7 +1742,7 @@ Packet::put(uint32_t len)
 inline Packet *
 Packet::nonunique_put(uint32_t len)
 {
-    if (tailroom() >= len) {
+    if (tailroom() >= len && !segmented()) {
 #if CLICK_LINUXMODULE	/* Linux kernel module */
 	__skb_put(skb(), len);
 #else				/* User-space and BSD kernel module */
@@ -1626,6 +1760,12 @@ Packet::nonunique_put(uint32_t len)
 inline void
 Packet::take(uint32_t len)
 {
+#if CLICK_USERLEVEL
+    if (_segment) {
+	expensive_take(len);
+	return;
+    }
+#endif
     if (len > length()) {
 	click_chatter("Packet::take %d > length %d\n", len, length());
 	len = length();
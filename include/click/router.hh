@@ -127,7 +127,9 @@ class Router { public:
 
     inline Router* hotswap_router() const;
     void set_hotswap_router(Router* router);
+    Element* hotswap_unchanged_element(const Element* e) const;
 
+    void set_configure_threads(int nthreads);
     int initialize(ErrorHandler* errh);
     void activate(bool foreground, ErrorHandler* errh);
     inline void activate(ErrorHandler* errh);
@@ -135,6 +137,12 @@ class Router { public:
 
     int new_notifier_signal(const char *name, NotifierSignal &signal);
     String notifier_signal_name(const atomic_uint32_t *signal) const;
+
+    enum {
+	PHASE_LEX, PHASE_CHECK, PHASE_CONFIGURE, PHASE_INITIALIZE, NPHASES
+    };
+    inline const Timestamp &phase_time(int phase) const;
+    inline void set_phase_time(int phase, const Timestamp &duration);
     //@}
 
     /** @cond never */
@@ -295,6 +303,9 @@ class Router { public:
 
     Router* _next_router;
 
+    int _configure_nthreads;
+    Timestamp _phase_time[NPHASES];
+
 #if CLICK_LINUXMODULE
     Vector<struct module*> _modules;
 #endif
@@ -316,6 +327,12 @@ class Router { public:
     void set_connections();
     void sort_connections() const;
     int connindex_lower_bound(bool isoutput, const Port &port) const;
+    void element_connection_names(int eindex, Vector<String> &result) const;
+    bool configure_element(int eindex, ErrorHandler *errh, int &stage);
+#if CLICK_USERLEVEL && HAVE_MULTITHREAD
+    class ConfigureThreads;
+    bool configure_parallel(const Vector<int> &eindexes, ErrorHandler *errh, Vector<int> &element_stage);
+#endif
 
     void make_gports();
     inline int ngports(bool isout) const {
@@ -595,6 +612,27 @@ Router::hotswap_router() const
     return _hotswap_router;
 }
 
+/** @brief Return the time spent in initialization phase @a phase.
+ * @param phase one of PHASE_LEX, PHASE_CHECK, PHASE_CONFIGURE, or
+ * PHASE_INITIALIZE
+ *
+ * The PHASE_LEX time is set by the driver that parsed the configuration, if
+ * any; initialize() measures the others. */
+inline const Timestamp&
+Router::phase_time(int phase) const
+{
+    assert(phase >= 0 && phase < NPHASES);
+    return _phase_time[phase];
+}
+
+/** @brief Record @a duration as the time spent in phase @a phase. */
+inline void
+Router::set_phase_time(int phase, const Timestamp &duration)
+{
+    assert(phase >= 0 && phase < NPHASES);
+    _phase_time[phase] = duration;
+}
+
 inline
 Handler::Handler(const String &name)
     : _name(name), _read_user_data(0), _write_user_data(0), _flags(0),
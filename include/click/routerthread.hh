@@ -75,6 +75,11 @@ class RouterThread { public:
 
     inline void wake();
 
+    inline uint32_t quiescent_epoch() const;
+    static inline bool quiescent_since(uint32_t snapshot, uint32_t epoch);
+    inline void quiescent_pause();
+    inline void quiescent_resume();
+
 #if CLICK_USERLEVEL
     inline void run_signals();
 #endif
@@ -117,6 +122,7 @@ class RouterThread { public:
     // LOCAL STATE GROUP
     TaskLink _task_link;
     volatile int _stop_flag;
+    volatile uint32_t _quiescent_epoch;
 #if HAVE_TASK_HEAP
     Vector<task_heap_element> _task_heap;
 #endif
@@ -445,6 +451,50 @@ RouterThread::wake()
 #endif
 }
 
+/** @brief Return the thread's quiescent-state epoch.
+
+    The epoch is odd while the thread runs router code and even while it is
+    blocked or outside its driver loop.  It advances each time the thread
+    starts a pass through the driver loop.  Memory that no new caller can
+    reach may be freed once every thread's epoch is quiescent_since() a
+    snapshot taken after it became unreachable. */
+inline uint32_t
+RouterThread::quiescent_epoch() const
+{
+    return _quiescent_epoch;
+}
+
+/** @brief Test whether a thread has been quiescent since a snapshot.
+    @param snapshot the thread's quiescent_epoch() when the snapshot was taken
+    @param epoch the thread's current quiescent_epoch()
+
+    Returns true if the thread was blocked when the snapshot was taken, or
+    has since finished the driver pass it was running. */
+inline bool
+RouterThread::quiescent_since(uint32_t snapshot, uint32_t epoch)
+{
+    return !(snapshot & 1) || snapshot != epoch;
+}
+
+/** @brief Mark the thread as quiescent before it blocks.
+
+    Called by the driver; the thread must run no router code until
+    quiescent_resume(). */
+inline void
+RouterThread::quiescent_pause()
+{
+    click_fence();
+    _quiescent_epoch = _quiescent_epoch + 1;
+}
+
+/** @brief Mark the thread as running router code again. */
+inline void
+RouterThread::quiescent_resume()
+{
+    _quiescent_epoch = _quiescent_epoch + 1;
+    click_fence();
+}
+
 inline void
 RouterThread::add_pending()
 {
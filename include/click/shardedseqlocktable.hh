@@ -0,0 +1,315 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_SHARDEDSEQLOCKTABLE_HH
+#define CLICK_SHARDEDSEQLOCKTABLE_HH
+#include <click/glue.hh>
+#include <click/machine.hh>
+#include <click/sync.hh>
+#include <click/hashallocator.hh>
+CLICK_DECLS
+
+/** @class ShardedSeqlockTable
+  @brief Intrusive hash table with sharded locks and lock-free lookups.
+
+  ShardedSeqlockTable divides its entries into up to 256 shards, chosen by
+  the top byte of each entry's hash code.  Each shard has a lock that
+  serializes updates, a sequence counter that is odd while an update is in
+  progress, a bucket array, and an allocator for its entries.  read() takes
+  no lock: it copies what it needs out of an entry, then retries if the
+  shard's sequence counter changed meanwhile.
+
+  Bucket arrays are replaced, never resized, when a shard grows, and
+  replaced arrays stay allocated until the table is destroyed.  Entries come
+  from the shard's SizedHashAllocator, which never returns memory to the
+  system while the table exists.  A reader racing with an update may thus
+  read stale data, but never follows a dangling pointer.
+
+  The entry type T must:
+
+  <ul>
+  <li>Define "key_type" and "key_const_reference" types.</li>
+  <li>Contain a member "T *_hashnext".  Keep it out of the first word of T,
+  which the allocator overwrites when the entry is freed.</li>
+  <li>Define a "hashkey()" member function returning key_const_reference.</li>
+  <li>Define a static "hashcode(key_const_reference)" function returning a
+  well-mixed uint32_t, such as hash_mix32() of the key.</li>
+  </ul>
+
+  Shard derives from the type X, which holds any per-shard state of the
+  table's user, such as a list of entries in age order.  The user
+  allocates entries from Shard::alloc and calls link() and unlink() with
+  the shard locked by lock(). */
+template <typename T, typename X>
+class ShardedSeqlockTable { public:
+
+    typedef typename T::key_type key_type;
+    typedef typename T::key_const_reference key_const_reference;
+
+    struct Buckets {
+	T **b;
+	uint32_t mask;
+	Buckets *retired;
+    };
+
+    struct Shard : public X {
+	Spinlock lock;			// serializes updates
+	volatile uint32_t seq;		// odd while an update is in progress
+	Buckets * volatile buckets;
+	uint32_t count;
+	SizedHashAllocator<sizeof(T)> alloc;
+    } CLICK_ALIGNED(CLICK_CACHE_LINE_SIZE);
+
+    enum { max_shards = 256 };
+
+    ShardedSeqlockTable()
+	: _shards(0), _shard_mask(0) {
+    }
+    ~ShardedSeqlockTable();
+
+    /** @brief Allocate @a nshards shards of @a nbuckets buckets each.
+     * @return 0 on success, -ENOMEM if out of memory
+     *
+     * Both @a nshards and @a nbuckets must be powers of two, and @a nshards
+     * must be at most max_shards. */
+    int initialize(uint32_t nshards, uint32_t nbuckets);
+
+    bool initialized() const {
+	return _shards;
+    }
+    /** @brief Swap the contents of this table and @a x in constant time.
+     *
+     * Neither table may be in use by other threads. */
+    void swap(ShardedSeqlockTable<T, X> &x) {
+	click_swap(_shards, x._shards);
+	click_swap(_shard_mask, x._shard_mask);
+    }
+    uint32_t nshards() const {
+	return _shard_mask + 1;
+    }
+
+    /** @brief Return the shard for hash code @a h. */
+    Shard &shard(uint32_t h) const {
+	return _shards[(h >> 24) & _shard_mask];
+    }
+    /** @brief Return shard number @a i, for 0 <= @a i < nshards(). */
+    Shard &shard_at(uint32_t i) const {
+	return _shards[i];
+    }
+
+    /** @brief Lock @a sh for an update. */
+    static void lock(Shard &sh) {
+	sh.lock.acquire();
+	sh.seq = sh.seq + 1;
+	click_write_fence();
+    }
+    /** @brief Lock @a sh for an update if its lock is free.
+     * @return true iff @a sh was locked */
+    static bool try_lock(Shard &sh) {
+	if (!sh.lock.attempt())
+	    return false;
+	sh.seq = sh.seq + 1;
+	click_write_fence();
+	return true;
+    }
+    static void unlock(Shard &sh) {
+	click_write_fence();
+	sh.seq = sh.seq + 1;
+	sh.lock.release();
+    }
+
+    template <typename F> inline bool read(key_const_reference key, uint32_t h, F &f) const;
+    static inline T *find(Shard &sh, key_const_reference key, uint32_t h);
+    static void link(Shard &sh, T *e, uint32_t h);
+    static void unlink(Shard &sh, T *e);
+
+    template <typename F> bool read_chunk(uint32_t &pos, uint32_t max, F &f) const;
+
+  private:
+
+    enum { max_lockfree_chain = 32, lockfree_tries = 4 };
+
+    Shard *_shards;
+    uint32_t _shard_mask;
+
+    ShardedSeqlockTable(const ShardedSeqlockTable<T, X> &);
+    ShardedSeqlockTable<T, X> &operator=(const ShardedSeqlockTable<T, X> &);
+
+};
+
+template <typename T, typename X>
+ShardedSeqlockTable<T, X>::~ShardedSeqlockTable()
+{
+    if (_shards)
+	for (uint32_t i = 0; i <= _shard_mask; ++i)
+	    while (Buckets *bk = _shards[i].buckets) {
+		_shards[i].buckets = bk->retired;
+		delete[] bk->b;
+		delete bk;
+	    }
+    delete[] _shards;
+}
+
+template <typename T, typename X>
+int
+ShardedSeqlockTable<T, X>::initialize(uint32_t nshards, uint32_t nbuckets)
+{
+    assert(!_shards && nshards && nshards <= max_shards
+	   && !(nshards & (nshards - 1)) && nbuckets && !(nbuckets & (nbuckets - 1)));
+    if (!(_shards = new Shard[nshards]))
+	return -ENOMEM;
+    _shard_mask = nshards - 1;
+    for (uint32_t i = 0; i < nshards; ++i) {
+	Shard &sh = _shards[i];
+	sh.seq = 0;
+	sh.count = 0;
+	sh.buckets = 0;
+	Buckets *bk = new Buckets;
+	if (!bk || !(bk->b = new T *[nbuckets])) {
+	    delete bk;
+	    return -ENOMEM;
+	}
+	memset(bk->b, 0, sizeof(T *) * nbuckets);
+	bk->mask = nbuckets - 1;
+	bk->retired = 0;
+	sh.buckets = bk;
+    }
+    return 0;
+}
+
+/** @brief Call @a f on the entry for @a key without taking a lock.
+ * @param h the key's hash code
+ * @param f function object called as f(e), where e is the entry or null
+ * @return true if the values @a f copied are consistent, false if the
+ * caller must lock the shard and look again
+ *
+ * @a f may be called more than once, and must only copy out of the entry
+ * what the caller needs; the entry might be changing or freed meanwhile.
+ * The last call's copy is consistent when read() returns true. */
+template <typename T, typename X> template <typename F>
+inline bool
+ShardedSeqlockTable<T, X>::read(key_const_reference key, uint32_t h, F &f) const
+{
+    Shard &sh = shard(h);
+    for (int tries = 0; tries < lockfree_tries; ++tries) {
+	uint32_t seq = sh.seq;
+	click_read_fence();
+	if (seq & 1) {
+	    click_relax_fence();
+	    continue;
+	}
+	Buckets *bk = sh.buckets;
+	T *e = bk->b[h & bk->mask];
+	int steps = 0;
+	while (e && !(e->hashkey() == key) && ++steps < max_lockfree_chain)
+	    e = e->_hashnext;
+	if (steps == max_lockfree_chain)
+	    return false;
+	f(e);
+	click_read_fence();
+	if (sh.seq == seq)
+	    return true;
+    }
+    return false;
+}
+
+/** @brief Return the entry for @a key in @a sh, or null.
+ *
+ * The caller must hold @a sh's lock. */
+template <typename T, typename X>
+inline T *
+ShardedSeqlockTable<T, X>::find(Shard &sh, key_const_reference key, uint32_t h)
+{
+    Buckets *bk = sh.buckets;
+    T *e = bk->b[h & bk->mask];
+    while (e && !(e->hashkey() == key))
+	e = e->_hashnext;
+    return e;
+}
+
+/** @brief Add @a e, whose hash code is @a h, to @a sh.
+ *
+ * The caller must hold @a sh's lock.  Doubles the shard's buckets when it
+ * holds more than two entries per bucket. */
+template <typename T, typename X>
+void
+ShardedSeqlockTable<T, X>::link(Shard &sh, T *e, uint32_t h)
+{
+    Buckets *bk = sh.buckets;
+    if (++sh.count > 2 * (bk->mask + 1)) {
+	// Grow.  The old array stays valid for concurrent readers, which
+	// will notice the changed sequence number and retry.
+	uint32_t nb = 2 * (bk->mask + 1);
+	Buckets *nbk = new Buckets;
+	if (nbk && (nbk->b = new T *[nb])) {
+	    memset(nbk->b, 0, sizeof(T *) * nb);
+	    nbk->mask = nb - 1;
+	    nbk->retired = bk;
+	    for (uint32_t i = 0; i <= bk->mask; ++i)
+		while (T *x = bk->b[i]) {
+		    bk->b[i] = x->_hashnext;
+		    T **pprev = &nbk->b[T::hashcode(x->hashkey()) & nbk->mask];
+		    x->_hashnext = *pprev;
+		    *pprev = x;
+		}
+	    click_write_fence();
+	    sh.buckets = bk = nbk;
+	} else
+	    delete nbk;
+    }
+    T **pprev = &bk->b[h & bk->mask];
+    e->_hashnext = *pprev;
+    click_write_fence();
+    *pprev = e;
+}
+
+/** @brief Remove @a e from @a sh.
+ *
+ * The caller must hold @a sh's lock, and frees @a e itself. */
+template <typename T, typename X>
+void
+ShardedSeqlockTable<T, X>::unlink(Shard &sh, T *e)
+{
+    Buckets *bk = sh.buckets;
+    T **pprev = &bk->b[T::hashcode(e->hashkey()) & bk->mask];
+    while (*pprev != e)
+	pprev = &(*pprev)->_hashnext;
+    *pprev = e->_hashnext;
+    --sh.count;
+}
+
+/** @brief Call @a f on about @a max entries, starting at position @a pos.
+ * @param[in,out] pos position of the first entry; set to the position of
+ * the next chunk
+ * @return true if entries remain after this chunk
+ *
+ * Position 0 is the start of the table; other positions count the hash
+ * buckets of all shards in order.  Reads whole buckets, so may call @a f
+ * on a few more than @a max entries.  Takes each shard's lock in turn, but
+ * the table is not a snapshot: entries added, removed, or moved to a grown
+ * bucket array between chunks may be missed or repeated. */
+template <typename T, typename X> template <typename F>
+bool
+ShardedSeqlockTable<T, X>::read_chunk(uint32_t &pos, uint32_t max, F &f) const
+{
+    uint32_t b = pos, n = 0, base = 0;
+    bool more = false;
+    for (uint32_t i = 0; i <= _shard_mask; ++i) {
+	Shard &sh = _shards[i];
+	sh.lock.acquire();
+	Buckets *bk = sh.buckets;
+	uint32_t nb = bk->mask + 1;
+	for (; b < base + nb && n < max; ++b)
+	    for (T *e = bk->b[b - base]; e; e = e->_hashnext, ++n)
+		f(e);
+	sh.lock.release();
+	base += nb;
+	if (n >= max) {
+	    more = b < base || i < _shard_mask;
+	    break;
+	}
+    }
+    pos = b;
+    return more;
+}
+
+CLICK_ENDDECLS
+#endif
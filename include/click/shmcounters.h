@@ -0,0 +1,94 @@
+/* -*- c-basic-offset: 4 -*- */
+#ifndef CLICK_SHMCOUNTERS_H
+#define CLICK_SHMCOUNTERS_H
+#include <stdint.h>
+#include <string.h>
+
+/* Layout of the shared-memory counter region written by the ShmCounters
+   element.  This header is self-contained so that external readers can use
+   it without the rest of Click.
+
+   The region starts with a click_shmcounters_header.  It is followed by
+   ncounters fixed-size, NUL-terminated names (name_size bytes each) at
+   names_offset, and ncounters 64-bit values at values_offset.  Names and
+   layout never change while the region exists; values are rewritten every
+   update.
+
+   Updates are published with a sequence lock: the writer makes generation
+   odd, stores the values, then makes generation even again.  A reader
+   copies the values and retries if generation was odd or changed.  Use
+   click_shmcounters_read() to do this. */
+
+#define CLICK_SHMCOUNTERS_MAGIC		0x434C4B43U	/* "CLKC" */
+#define CLICK_SHMCOUNTERS_VERSION	1
+#define CLICK_SHMCOUNTERS_NAME_SIZE	64
+
+struct click_shmcounters_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t ncounters;
+    uint32_t name_size;
+    uint64_t names_offset;
+    uint64_t values_offset;
+    uint64_t interval_ns;	/* configured update interval */
+    volatile uint64_t generation;	/* odd while an update is in progress */
+    volatile uint64_t update_ns;	/* wall-clock time of last update */
+    uint32_t pid;		/* writer's process ID */
+    uint32_t reserved[5];
+};
+
+#define click_shmcounters_barrier()	__sync_synchronize()
+
+static inline const char *
+click_shmcounters_name(const struct click_shmcounters_header *h, uint32_t i)
+{
+    return (const char *) h + h->names_offset + (uint64_t) i * h->name_size;
+}
+
+static inline volatile uint64_t *
+click_shmcounters_values(const struct click_shmcounters_header *h)
+{
+    return (volatile uint64_t *) ((const char *) h + h->values_offset);
+}
+
+/* Check that the region at h, of size len bytes, is a valid counter region.
+   Returns 0 on success, -1 otherwise. */
+static inline int
+click_shmcounters_check(const struct click_shmcounters_header *h, uint64_t len)
+{
+    if (len < sizeof(*h) || h->magic != CLICK_SHMCOUNTERS_MAGIC
+	|| h->version != CLICK_SHMCOUNTERS_VERSION || h->name_size == 0
+	|| h->names_offset + (uint64_t) h->ncounters * h->name_size > len
+	|| h->values_offset + (uint64_t) h->ncounters * 8 > len)
+	return -1;
+    return 0;
+}
+
+/* Copy a consistent snapshot of the values into out[0..ncounters-1].
+   Returns the generation of the copied values, or 0 if no consistent copy
+   was made in tries attempts or the writer has not yet published any.
+   A generation of 0 in the header means nothing has been published. */
+static inline uint64_t
+click_shmcounters_read(const struct click_shmcounters_header *h, uint64_t *out,
+		       int tries)
+{
+    volatile uint64_t *v = click_shmcounters_values(h);
+    uint32_t i, n = h->ncounters;
+    while (tries-- > 0) {
+	uint64_t g1 = h->generation, g2;
+	click_shmcounters_barrier();
+	if (g1 == 0)
+	    return 0;
+	else if (g1 & 1)
+	    continue;
+	for (i = 0; i < n; ++i)
+	    out[i] = v[i];
+	click_shmcounters_barrier();
+	g2 = h->generation;
+	if (g1 == g2)
+	    return g1;
+    }
+    return 0;
+}
+
+#endif
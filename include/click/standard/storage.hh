@@ -37,9 +37,12 @@ class Storage { public:
 
   protected:
 
+    // The consumer writes _head and the producer writes _tail.  Keep them
+    // on separate cache lines so that a pusher and a puller running on
+    // different CPUs do not bounce a shared line on every packet.
     index_type _capacity;
-    volatile index_type _head;
-    volatile index_type _tail;
+    volatile index_type _head CLICK_ALIGNED(CLICK_CACHE_LINE_SIZE);
+    volatile index_type _tail CLICK_ALIGNED(CLICK_CACHE_LINE_SIZE);
 
 };
 
@@ -7,6 +7,7 @@ CLICK_DECLS
 class ErrorHandler;
 
 bool glob_match(const String &string, const String &pattern);
+bool has_glob(const String &pattern);
 
 String percent_substitute(const String &string, int format1, ...);
 
@@ -355,15 +355,31 @@ CLICK_DECLS
 namespace {
 
 class RequireLexerExtra : public LexerExtra { public:
-    RequireLexerExtra(const Vector<ArchiveElement> *a) : _archive(a) { }
+    RequireLexerExtra(const Vector<ArchiveElement> *a, Vector<String> *files)
+	: _archive(a), _files(files) { }
     void require(String type, String value, ErrorHandler *errh);
   private:
     const Vector<ArchiveElement> *_archive;
+    Vector<String> *_files;
 };
 
 void
 RequireLexerExtra::require(String type, String value, ErrorHandler *errh)
 {
+    if (_files && type.equals("library", 7))
+	_files->push_back(value);
+    else if (_files && type.equals("package", 7)) {
+	String fn = clickpath_find_file(value + ".uo", "lib", CLICK_LIBDIR);
+	if (!fn)
+	    fn = clickpath_find_file(value + ".o", "lib", CLICK_LIBDIR);
+	if (fn)
+	    _files->push_back(fn);
+	fn = clickpath_find_file("elementmap-" + value + ".xml", "share", CLICK_DATADIR);
+	if (!fn)
+	    fn = clickpath_find_file("elementmap." + value, "share", CLICK_DATADIR);
+	if (fn)
+	    _files->push_back(fn);
+    }
 # ifdef HAVE_DYNAMIC_LINKING
     if (type.equals("package", 7) && !click_has_provision(value.c_str()))
 	clickdl_load_requirement(value, _archive, errh);
@@ -483,8 +499,11 @@ click_static_cleanup()
 # endif /* HAVE_DYNAMIC_LINKING */
 }
 
+// If FILES is nonnull, append to it the library files the configuration
+// required, and the package and elementmap files found for its package
+// requirements.
 Router *
-click_read_router(String filename, bool is_expr, ErrorHandler *errh, bool initialize, Master *master)
+click_read_router(String filename, bool is_expr, ErrorHandler *errh, bool initialize, Master *master, Vector<String> *files)
 {
     if (!errh)
 	errh = ErrorHandler::silent_handler();
@@ -516,13 +535,15 @@ click_read_router(String filename, bool is_expr, ErrorHandler *errh, bool initia
     }
 
     // lex
+    Timestamp lex_start = Timestamp::now_steady_unwarped();
     Lexer *l = click_lexer();
-    RequireLexerExtra lextra(&archive);
+    RequireLexerExtra lextra(&archive, files);
     int cookie = l->begin_parse(config_str, filename, &lextra, errh);
     while (!l->ydone())
 	l->ystep();
     Router *router = l->create_router(master ? master : new Master(1));
     l->end_parse(cookie);
+    router->set_phase_time(Router::PHASE_LEX, Timestamp::now_steady_unwarped() - lex_start);
 
     // initialize if requested
     if (initialize)
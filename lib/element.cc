@@ -1214,6 +1214,21 @@ Element::processing_vector(int* in_v, int* out_v, ErrorHandler* errh) const
  * RoundRobinSched has 0 inputs, are idle rather than busy, and waste no
  * CPU time.</dd>
  *
+ * <dt><tt>C</tt></dt> <dd>This element's configure() method is safe to run
+ * concurrently with other elements' configure() methods.  It may change only
+ * the element's own state, and may query but not define names with NameInfo.
+ * When the router is asked to configure on several threads, it configures
+ * the elements of a configure phase in parallel if all of them are
+ * <tt>C</tt>-flagged; a phase that holds any other element is configured
+ * serially.</dd>
+ *
+ * <dt><tt>G</tt></dt> <dd>This element handles Packet::segmented() packets
+ * (user level only).  It measures packets with total_length(), reads data
+ * past the first segment with copy_data() or not at all, and linearizes
+ * packets itself before writing past the first segment.  Packets passed to
+ * elements without this flag are linearized first, so their data() and
+ * length() cover the whole packet.</dd>
+ *
  * </dl>
  */
 const char*
@@ -1232,7 +1247,10 @@ int
 Element::flag_value(int flag) const
 {
     assert(flag > 0 && flag < 256);
-    for (const unsigned char *data = reinterpret_cast<const unsigned char *>(flags()); *data; ++data)
+    const unsigned char *data = reinterpret_cast<const unsigned char *>(flags());
+    while (isspace(*data))
+	++data;
+    while (*data) {
 	if (*data == flag) {
 	    if (data[1] && isdigit(data[1])) {
 		int value = 0;
@@ -1241,9 +1259,13 @@ Element::flag_value(int flag) const
 		return value;
 	    } else
 		return 1;
-	} else
-	    while (isspace(*data))
-		++data;
+	}
+	// skip to the next flag setting
+	while (*data && !isspace(*data))
+	    ++data;
+	while (isspace(*data))
+	    ++data;
+    }
     return -1;
 }
 
@@ -1477,7 +1499,12 @@ Element::initialize(ErrorHandler *errh)
  * class.  Thus, most take_state() methods begin by attempting to cast() @a
  * old_element to a compatible class, and silently returning if the result is
  * null.  Alternatively, you can override hotswap_element() and put the check
- * there.
+ * there.  Elements that want to move expensive state, such as large tables
+ * or counters, only when their configuration did not change can compare @a
+ * old_element with router()->@link Router::hotswap_unchanged_element()
+ * hotswap_unchanged_element()@endlink(this).  Since take_state() runs while
+ * neither configuration is running, such elements should swap state in
+ * constant time rather than copying it.
  *
  * Errors and warnings should be reported to @a errh, but the router will be
  * installed whether or not there are errors.  take_state() should always
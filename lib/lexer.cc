@@ -1862,6 +1862,8 @@ Lexer::yrequire_library(const String &value)
 	if (*it == fn)
 	    return;
     _libraries.push_back(fn);
+    if (_lextra)
+	_lextra->require("library", fn, _errh);
 
     LandmarkErrorHandler lerrh(_errh, _file.landmark());
     int before = lerrh.nerrors();
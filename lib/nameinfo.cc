@@ -149,6 +149,11 @@ NameDB::revquery(const void *, size_t)
     return String();
 }
 
+void
+NameDB::prepare_concurrent_queries()
+{
+}
+
 bool
 StaticNameDB::query(const String &name, void *value, size_t vsize)
 {
@@ -265,6 +270,12 @@ DynamicNameDB::query(const String& name, void* value, size_t vsize)
 	return false;
 }
 
+void
+DynamicNameDB::prepare_concurrent_queries()
+{
+    sort();
+}
+
 bool
 DynamicNameDB::define(const String& name, const void* value, size_t vsize)
 {
@@ -449,6 +460,17 @@ NameInfo::installdb(NameDB *db, const Element *prefix)
 #endif
 }
 
+void
+NameInfo::prepare_concurrent_queries(Router *router)
+{
+    NameInfo *infos[2] = { the_name_info, router ? router->name_info() : 0 };
+    for (int i = 0; i < 2; ++i)
+	if (infos[i])
+	    for (NameDB **dbp = infos[i]->_namedbs.begin();
+		 dbp != infos[i]->_namedbs.end(); ++dbp)
+		(*dbp)->prepare_concurrent_queries();
+}
+
 void
 NameInfo::uninstalldb(NameDB *db)
 {
@@ -214,6 +214,8 @@ Packet::~Packet()
 	_destructor(_head, _end - _head);
     else
 	delete[] _head;
+    if (_segment)
+	_segment->kill();
 # elif CLICK_BSDMODULE
     if (_m)
 	m_freem(_m);
@@ -618,11 +620,19 @@ Packet::clone()
     p->_data_packet = this;
 # if CLICK_USERLEVEL
     p->_destructor = 0;
+    p->_segment = 0;
 # else
     p->_m = m;
 # endif
     // increment our reference count because of _data_packet reference
     _use_count++;
+# if CLICK_USERLEVEL
+    // segments are read-only, so the clone gets clones of them
+    if (_segment && !(p->_segment = _segment->clone())) {
+	p->kill();
+	return 0;
+    }
+# endif
     return p;
 
 #endif /* CLICK_LINUXMODULE */
@@ -698,6 +708,34 @@ Packet::expensive_uniqueify(int32_t extra_headroom, int32_t extra_tailroom,
 
 #else /* !CLICK_LINUXMODULE */
 
+# if CLICK_USERLEVEL
+    // Header-only copy-on-write: copy the headers into a new buffer and
+    // keep this packet, trimmed to the rest of the data, as its segment.
+    if (_cow_length && shared() && extra_tailroom <= 0) {
+	uint32_t hlen = _cow_length;
+	if (has_network_header() && network_header_offset() + 60 > (int) hlen)
+	    hlen = network_header_offset() + 60;
+	if (has_transport_header() && transport_header_offset() + 60 > (int) hlen)
+	    hlen = transport_header_offset() + 60;
+	if (length() >= 2 * hlen) {
+	    WritablePacket *q = make(headroom() + extra_headroom, 0, hlen, 0);
+	    if (!q) {
+		if (free_on_failure)
+		    kill();
+		return 0;
+	    }
+	    const unsigned char *start_copy = _head + (extra_headroom >= 0 ? 0 : -extra_headroom);
+	    memcpy(q->_head + (extra_headroom >= 0 ? extra_headroom : 0), start_copy, _data + hlen - start_copy);
+	    q->_aa = _aa;
+	    q->_cow_length = _cow_length;
+	    q->shift_header_annotations(_head, extra_headroom);
+	    _data += hlen;
+	    q->_segment = this;
+	    return q;
+	}
+    }
+# endif
+
     // If someone else has cloned this packet, then we need to leave its data
     // pointers around. Make a clone and uniqueify that.
     if (_use_count > 1) {
@@ -838,6 +876,14 @@ WritablePacket *
 Packet::expensive_put(uint32_t nbytes)
 {
   static int chatter = 0;
+#if CLICK_USERLEVEL
+  if (_segment) {
+    WritablePacket *q = expensive_linearize(nbytes);
+    if (q)
+      q->_tail += nbytes;
+    return q;
+  }
+#endif
   if (tailroom() < nbytes && chatter < 5) {
     click_chatter("expensive Packet::put; have %d wanted %d",
                   tailroom(), nbytes);
@@ -905,6 +951,138 @@ Packet::shift_data(int offset, bool free_on_failure)
 }
 
 
+//
+// SEGMENTS
+//
+
+#if CLICK_USERLEVEL
+/** @brief Create and return a new segmented packet (userlevel).
+ * @param headroom headroom in the new packet's first segment
+ * @param data data to be copied into the new packet
+ * @param length total length of packet
+ * @param segment_length maximum length of each segment
+ * @return new packet, or null if no packet could be created
+ *
+ * Like make(@a headroom, @a data, @a length, 0), but if @a length exceeds
+ * @a segment_length, the data is split over a chain of segments, each at
+ * most @a segment_length bytes long.  A @a segment_length of 0 means no
+ * limit.  The segments other than the first have no headroom.  If @a data
+ * is null, the packet's data is left uninitialized; the creator may fill in
+ * each segment's data before passing the packet on.
+ *
+ * @sa segmented */
+WritablePacket *
+Packet::make_segmented(uint32_t headroom, const void *data,
+		       uint32_t length, uint32_t segment_length)
+{
+    if (!segment_length || length <= segment_length)
+	return make(headroom, data, length, 0);
+    const unsigned char *d = reinterpret_cast<const unsigned char *>(data);
+    WritablePacket *p = make(headroom, d, segment_length, 0);
+    Packet *last = p;
+    for (uint32_t off = segment_length; last && off < length; off += segment_length) {
+	uint32_t n = (length - off < segment_length ? length - off : segment_length);
+	if (!(last->_segment = make(0, d ? d + off : 0, n, 0))) {
+	    p->kill();
+	    return 0;
+	}
+	last = last->_segment;
+    }
+    return p;
+}
+
+/** @brief Append @a p to this packet's data as a new segment (userlevel).
+ * @param p segment packet
+ *
+ * The data of @a p, including its segments, is added after all of this
+ * packet's data.  This packet takes ownership of @a p, which must not be
+ * used afterwards; @a p's annotations are ignored.
+ *
+ * @sa segmented */
+void
+Packet::append_segment(Packet *p)
+{
+    Packet *last = this;
+    while (last->_segment)
+	last = last->_segment;
+    last->_segment = p;
+}
+
+WritablePacket *
+Packet::expensive_linearize(uint32_t extra_tailroom)
+{
+    Packet *seg = _segment;
+    uint32_t seg_length = seg->total_length();
+    // Detach the segments first, so that expensive_uniqueify() doesn't
+    // clone them.
+    _segment = 0;
+    uint32_t want = seg_length + extra_tailroom;
+    WritablePacket *q;
+    if (!shared() && tailroom() >= want)
+	q = static_cast<WritablePacket *>(this);
+    else if (!(q = expensive_uniqueify(0, want > tailroom() ? want - tailroom() : 0, true))) {
+	seg->kill();
+	return 0;
+    }
+    seg->copy_data(0, q->_tail, seg_length);
+    q->_tail += seg_length;
+    seg->kill();
+    return q;
+}
+
+void
+Packet::expensive_take(uint32_t nbytes)
+{
+    uint32_t total = total_length();
+    if (nbytes > total) {
+	click_chatter("Packet::take %d > length %d\n", nbytes, total);
+	nbytes = total;
+    }
+    uint32_t keep = total - nbytes;
+    Packet *last = this;
+    while (keep > last->length() && last->_segment) {
+	keep -= last->length();
+	last = last->_segment;
+    }
+    last->_tail = last->_data + keep;
+    if (Packet *rest = last->_segment) {
+	last->_segment = 0;
+	rest->kill();
+    }
+}
+#endif
+
+/** @brief Copy packet data into a buffer.
+ * @param offset offset of first byte to copy, relative to data()
+ * @param dst destination buffer
+ * @param len maximum number of bytes to copy
+ * @return number of bytes copied
+ *
+ * Copies up to @a len bytes of packet data, starting @a offset bytes into
+ * the packet, into @a dst.  The copy continues across segment boundaries
+ * in a segmented() packet.  Returns less than @a len if the packet's
+ * total_length() is less than @a offset + @a len. */
+uint32_t
+Packet::copy_data(uint32_t offset, void *dst, uint32_t len) const
+{
+    unsigned char *d = reinterpret_cast<unsigned char *>(dst);
+    uint32_t copied = 0;
+    for (const Packet *p = this; p && len; p = p->segment()) {
+	uint32_t plen = p->length();
+	if (offset >= plen) {
+	    offset -= plen;
+	    continue;
+	}
+	uint32_t n = (plen - offset < len ? plen - offset : len);
+	memcpy(d + copied, p->data() + offset, n);
+	copied += n;
+	len -= n;
+	offset = 0;
+    }
+    return copied;
+}
+
+
 #if HAVE_CLICK_PACKET_POOL
 static void
 cleanup_pool(PacketPool *pp, int global)
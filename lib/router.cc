@@ -83,7 +83,8 @@ Router::Router(const String &configuration, Master *master)
       _configuration(configuration),
       _notifier_signals(0),
       _arena_factory(new HashMap_ArenaFactory),
-      _hotswap_router(0), _thread_sched(0), _name_info(0), _next_router(0)
+      _hotswap_router(0), _thread_sched(0), _name_info(0), _next_router(0),
+      _configure_nthreads(1)
 {
     _refcount = 0;
     _runcount = 0;
@@ -1066,6 +1067,123 @@ Router::initialize_handlers(bool defaults, bool specifics)
 	    _elements[i]->add_handlers();
 }
 
+/** @brief Set the number of threads used to configure elements.
+ *
+ * If @a nthreads is greater than 1, initialize() configures a configure
+ * phase on up to @a nthreads threads at once when every element in that
+ * phase declares the <tt>C</tt> flag (see Element::flags()).  A phase with
+ * any unflagged element is configured serially, in the usual order.
+ * Elements are still configured phase by phase, so an element never runs
+ * configure() before an element with an earlier configure_phase().  Only
+ * available at user level with multithreading; elsewhere the setting is
+ * ignored. */
+void
+Router::set_configure_threads(int nthreads)
+{
+    assert(_state == ROUTER_NEW);
+    _configure_nthreads = (nthreads > 1 ? nthreads : 1);
+}
+
+bool
+Router::configure_element(int i, ErrorHandler *errh, int &stage)
+{
+    RouterContextErrh cerrh(errh, "While configuring", element(i));
+    assert(!cerrh.nerrors());
+    Vector<String> conf;
+    cp_argvec(_element_configurations[i], conf);
+    int r = _elements[i]->configure(conf, &cerrh);
+    if (r < 0) {
+	stage = Element::CLEANUP_CONFIGURE_FAILED;
+	if (!cerrh.nerrors()) {
+	    if (r == -ENOMEM)
+		cerrh.error("out of memory");
+	    else
+		cerrh.error("unspecified error");
+	}
+	return false;
+    } else {
+	stage = Element::CLEANUP_CONFIGURED;
+	return true;
+    }
+}
+
+#if CLICK_USERLEVEL && HAVE_MULTITHREAD
+namespace {
+// Collects one element's configuration messages so they can be reported in
+// order once all threads are done.
+class ConfigureErrh : public ErrorHandler { public:
+    void *emit(const String &str, void *, bool) {
+	_lines.push_back(str);
+	return 0;
+    }
+    void replay(ErrorHandler *errh) {
+	for (String *it = _lines.begin(); it != _lines.end(); ++it)
+	    errh->xmessage(*it);
+    }
+  private:
+    Vector<String> _lines;
+};
+}
+
+class Router::ConfigureThreads { public:
+
+    ConfigureThreads(Router *router, const Vector<int> &eindexes)
+	: _router(router), _eindexes(eindexes),
+	  _errhs(new ConfigureErrh[eindexes.size()]),
+	  _stages(eindexes.size(), Element::CLEANUP_BEFORE_CONFIGURE) {
+	_next = 0;
+    }
+    ~ConfigureThreads() {
+	delete[] _errhs;
+    }
+
+    static void *thread_driver(void *user_data) {
+	ConfigureThreads *ct = static_cast<ConfigureThreads *>(user_data);
+	uint32_t k;
+	while ((k = ct->_next.fetch_and_add(1)) < (uint32_t) ct->_eindexes.size())
+	    ct->_router->configure_element(ct->_eindexes[k], &ct->_errhs[k], ct->_stages[k]);
+	return 0;
+    }
+
+    Router *_router;
+    const Vector<int> &_eindexes;
+    ConfigureErrh *_errhs;
+    Vector<int> _stages;
+    atomic_uint32_t _next;
+
+};
+
+bool
+Router::configure_parallel(const Vector<int> &eindexes, ErrorHandler *errh,
+			   Vector<int> &element_stage)
+{
+    // Name lookups must not reorganize databases under other threads.
+    NameInfo::prepare_concurrent_queries(this);
+
+    ConfigureThreads ct(this, eindexes);
+    int nthreads = (_configure_nthreads < eindexes.size() ? _configure_nthreads : eindexes.size());
+    Vector<pthread_t> threads;
+    for (int t = 1; t < nthreads; ++t) {
+	pthread_t p;
+	if (pthread_create(&p, 0, ConfigureThreads::thread_driver, &ct) != 0)
+	    break;
+	threads.push_back(p);
+    }
+    ConfigureThreads::thread_driver(&ct);
+    for (pthread_t *it = threads.begin(); it != threads.end(); ++it)
+	(void) pthread_join(*it, 0);
+
+    bool ok = true;
+    for (int k = 0; k < eindexes.size(); ++k) {
+	ct._errhs[k].replay(errh);
+	element_stage[eindexes[k]] = ct._stages[k];
+	if (ct._stages[k] != Element::CLEANUP_CONFIGURED)
+	    ok = false;
+    }
+    return ok;
+}
+#endif
+
 int
 Router::initialize(ErrorHandler *errh)
 {
@@ -1087,9 +1205,10 @@ Router::initialize(ErrorHandler *errh)
     _element_home_thread_ids.assign(nelements() + 1, ThreadSched::THREAD_UNKNOWN);
 
     // set up configuration order
+    Timestamp phase_start = Timestamp::now_steady_unwarped();
     _element_configure_order.assign(nelements(), 0);
+    Vector<int> configure_phase(nelements(), 0);
     if (_element_configure_order.size()) {
-	Vector<int> configure_phase(nelements(), 0);
 	for (int i = 0; i < _elements.size(); i++) {
 	    configure_phase[i] = _elements[i]->configure_phase();
 	    _element_configure_order[i] = i;
@@ -1118,35 +1237,55 @@ Router::initialize(ErrorHandler *errh)
     char dmalloc_buf[12];
 #endif
 
+    Timestamp now = Timestamp::now_steady_unwarped();
+    _phase_time[PHASE_CHECK] = now - phase_start;
+    phase_start = now;
+
     // Configure all elements in configure order. Remember the ones that failed
     if (all_ok) {
-	Vector<String> conf;
 	// Set the random seed to a "truly random" value by default.
 	click_random_srandom();
 	for (int ord = 0; ord < _elements.size(); ord++) {
-	    int i = _element_configure_order[ord], r;
+	    int i = _element_configure_order[ord];
+#if CLICK_USERLEVEL && HAVE_MULTITHREAD
+	    // Configure a configure phase in parallel only if all its elements
+	    // are 'C'-flagged.  Otherwise an unflagged element might rely on
+	    // an earlier element in the phase being configured already, so
+	    // keep the serial order.
+	    if (_configure_nthreads > 1
+		&& (ord == 0
+		    || configure_phase[_element_configure_order[ord - 1]] != configure_phase[i])) {
+		Vector<int> parallel;
+		for (int o = ord; o < _elements.size(); ++o) {
+		    int j = _element_configure_order[o];
+		    if (configure_phase[j] != configure_phase[i])
+			break;
+		    if (_elements[j]->flag_value('C') <= 0) {
+			parallel.clear();
+			break;
+		    }
+		    parallel.push_back(j);
+		}
+		if (parallel.size() > 1
+		    && !configure_parallel(parallel, errh, element_stage))
+		    all_ok = false;
+	    }
+	    if (element_stage[i] != Element::CLEANUP_BEFORE_CONFIGURE)
+		continue;
+#endif
 #if CLICK_DMALLOC
 	    sprintf(dmalloc_buf, "c%d  ", i);
 	    CLICK_DMALLOC_REG(dmalloc_buf);
 #endif
-	    RouterContextErrh cerrh(errh, "While configuring", element(i));
-	    assert(!cerrh.nerrors());
-	    conf.clear();
-	    cp_argvec(_element_configurations[i], conf);
-	    if ((r = _elements[i]->configure(conf, &cerrh)) < 0) {
-		element_stage[i] = Element::CLEANUP_CONFIGURE_FAILED;
+	    if (!configure_element(i, errh, element_stage[i]))
 		all_ok = false;
-		if (!cerrh.nerrors()) {
-		    if (r == -ENOMEM)
-			cerrh.error("out of memory");
-		    else
-			cerrh.error("unspecified error");
-		}
-	    } else
-		element_stage[i] = Element::CLEANUP_CONFIGURED;
 	}
     }
 
+    now = Timestamp::now_steady_unwarped();
+    _phase_time[PHASE_CONFIGURE] = now - phase_start;
+    phase_start = now;
+
 #if CLICK_DMALLOC
     CLICK_DMALLOC_REG("iHoo");
 #endif
@@ -1177,6 +1316,8 @@ Router::initialize(ErrorHandler *errh)
 	}
     }
 
+    _phase_time[PHASE_INITIALIZE] = Timestamp::now_steady_unwarped() - phase_start;
+
 #if CLICK_DMALLOC
     CLICK_DMALLOC_REG("iXXX");
 #endif
@@ -1259,6 +1400,60 @@ Router::set_hotswap_router(Router *r)
 	_hotswap_router->use();
 }
 
+void
+Router::element_connection_names(int eindex, Vector<String> &result) const
+{
+    sort_connections();
+    for (int isoutput = 0; isoutput < 2; ++isoutput) {
+	int ci = connindex_lower_bound(isoutput, Port(eindex, 0));
+	for (; ci < _conn.size(); ++ci) {
+	    const Connection &c = _conn[isoutput ? _conn_output_sorter[ci] : ci];
+	    if (c[isoutput].idx != eindex)
+		break;
+	    StringAccum sa;
+	    sa << (isoutput ? "o" : "i") << c[isoutput].port << ' '
+	       << _element_names[c[!isoutput].idx] << ' ' << c[!isoutput].port;
+	    result.push_back(sa.take_string());
+	}
+    }
+    click_qsort(result.begin(), result.size());
+}
+
+/** @brief Return the hotswap router's unchanged counterpart of @a e.
+ *
+ * Searches hotswap_router() for an element with the same name, class,
+ * static configuration string, and port counts as @a e, and connected to
+ * the same named neighbors on the same ports.  Returns that element, or 0 if
+ * there is no hotswap router or the element changed.
+ *
+ * Elements whose take_state() methods transfer expensive state wholesale,
+ * such as routing tables or counters, use this function to check that the
+ * old element is equivalent to the new one.  Only valid once the router's
+ * elements and connections are known; that is, from configure() onwards. */
+Element *
+Router::hotswap_unchanged_element(const Element *e) const
+{
+    if (!_hotswap_router || !e || e->router() != this || e->eindex() < 0)
+	return 0;
+    Element *old = _hotswap_router->find(ename(e->eindex()));
+    if (!old
+	|| strcmp(old->class_name(), e->class_name()) != 0
+	|| old->ninputs() != e->ninputs()
+	|| old->noutputs() != e->noutputs()
+	|| _hotswap_router->econfiguration(old->eindex()) != econfiguration(e->eindex()))
+	return 0;
+
+    Vector<String> new_conn, old_conn;
+    element_connection_names(e->eindex(), new_conn);
+    _hotswap_router->element_connection_names(old->eindex(), old_conn);
+    if (new_conn.size() != old_conn.size())
+	return 0;
+    for (int i = 0; i < new_conn.size(); ++i)
+	if (new_conn[i] != old_conn[i])
+	    return 0;
+    return old;
+}
+
 
 // HANDLERS
 
@@ -1343,6 +1538,42 @@ Handler::call_write(const String& value, Element* e, ErrorHandler* errh) const
     }
 }
 
+String
+Handler::call_read_chunk(Element* e, String& cursor, uint32_t max, ErrorHandler* errh) const
+{
+    if (!read_chunked()) {
+	cursor = String();
+	return call_read(e, String(), errh);
+    }
+    StringAccum sa;
+    sa << "CHUNK " << (max ? max : 1);
+    if (cursor)
+	sa << ' ' << cursor;
+    String s = call_read(e, sa.take_string(), errh);
+    const char* nl = find(s, '\n');
+    cursor = s.substring(s.begin(), nl);
+    return s.substring(nl == s.end() ? nl : nl + 1, s.end());
+}
+
+bool
+Handler::parse_chunk_param(const String& param, uint32_t& max, String& cursor)
+{
+    String rest = param;
+    if (cp_shift_spacevec(rest) != "CHUNK"
+	|| !cp_integer(cp_shift_spacevec(rest), &max) || max == 0)
+	return false;
+    cursor = cp_shift_spacevec(rest);
+    return !rest;
+}
+
+String
+Handler::chunk_value(const String& next_cursor, const String& data)
+{
+    StringAccum sa(next_cursor.length() + 1 + data.length());
+    sa << next_cursor << '\n' << data;
+    return sa.take_string();
+}
+
 String
 Handler::unparse_name(Element *e, const String &hname)
 {
@@ -2169,7 +2400,8 @@ Router::configuration_string() const
 enum { GH_VERSION, GH_CONFIG, GH_FLATCONFIG, GH_LIST, GH_REQUIREMENTS,
        GH_DRIVER, GH_ACTIVE_PORTS, GH_ACTIVE_PORT_STATS, GH_STRING_PROFILE,
        GH_STRING_PROFILE_LONG, GH_SCHEDULING_PROFILE, GH_STOP,
-       GH_ELEMENT_CYCLES, GH_CLASS_CYCLES, GH_RESET_CYCLES };
+       GH_ELEMENT_CYCLES, GH_CLASS_CYCLES, GH_RESET_CYCLES,
+       GH_PHASE_TIMES };
 
 #if CLICK_STATS >= 2
 struct stats_info {
@@ -2212,6 +2444,16 @@ Router::router_read_handler(Element *e, void *thunk)
 		sa << r->_requirements[i] << "\n";
 	break;
 
+      case GH_PHASE_TIMES:
+	if (r) {
+	    static const char * const phase_names[] = {
+		"lex", "check", "configure", "initialize"
+	    };
+	    for (int p = 0; p < NPHASES; ++p)
+		sa << phase_names[p] << '\t' << r->_phase_time[p] << '\n';
+	}
+	break;
+
       case GH_DRIVER:
 #if CLICK_NS
 	return String::make_stable("ns", 2);
@@ -2398,6 +2640,7 @@ Router::static_initialize()
 	add_read_handler(0, "requirements", router_read_handler, (void *)GH_REQUIREMENTS);
 	add_read_handler(0, "handlers", Element::read_handlers_handler, 0);
 	add_read_handler(0, "list", router_read_handler, (void *)GH_LIST);
+	add_read_handler(0, "phase_times", router_read_handler, (void *)GH_PHASE_TIMES);
 	add_write_handler(0, "stop", router_write_handler, (void *)GH_STOP);
 #if CLICK_STATS >= 1
 	add_read_handler(0, "active_ports", router_read_handler, (void *)GH_ACTIVE_PORTS);
@@ -70,6 +70,7 @@ RouterThread::RouterThread(Master *master, int id)
     : _stop_flag(0), _master(master), _id(id)
 {
     _pending_head.x = 0;
+    _quiescent_epoch = 0;
     _pending_tail = &_pending_head;
 
 #if !HAVE_TASK_HEAP
@@ -505,6 +506,7 @@ RouterThread::run_os()
 #if CLICK_USERLEVEL
     select_set().run_selects(this);
 #elif CLICK_LINUXMODULE		/* Linux kernel module */
+    quiescent_pause();
     if (_greedy) {
 	if (time_after(jiffies, greedy_schedule_jiffies + 5 * CLICK_HZ)) {
 	    greedy_schedule_jiffies = jiffies;
@@ -531,6 +533,7 @@ RouterThread::run_os()
     } else
 	goto block;
 #elif defined(CLICK_BSDMODULE)
+    quiescent_pause();
     if (_greedy)
 	/* do nothing */;
     else if (active()) {	// just schedule others for a moment
@@ -545,6 +548,9 @@ RouterThread::run_os()
 #else
 # error "Compiling for unknown target."
 #endif
+#if !CLICK_USERLEVEL
+    quiescent_resume();
+#endif
 
 #if HAVE_ADAPTIVE_SCHEDULER
     client_update_pass(C_KERNEL, t_before);
@@ -600,6 +606,7 @@ RouterThread::driver()
     }
 #endif
 
+    quiescent_resume();
     driver_lock_tasks();
 
 #if HAVE_ADAPTIVE_SCHEDULER
@@ -614,6 +621,9 @@ RouterThread::driver()
 #if CLICK_DEBUG_SCHEDULING
 	_driver_epoch++;
 #endif
+	// end the previous pass for quiescent_since()
+	quiescent_pause();
+	quiescent_resume();
 
 #if !BSD_NETISRSCHED
 	// check to see if driver is stopped
@@ -683,6 +693,7 @@ RouterThread::driver()
     }
 
     driver_unlock_tasks();
+    quiescent_pause();
 
 #if HAVE_ADAPTIVE_SCHEDULER
     _cur_click_share = 0;
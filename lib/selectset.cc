@@ -400,8 +400,12 @@ SelectSet::run_selects_kqueue(RouterThread *thread)
     thread->set_thread_state_for_blocking(delay_type);
 
     struct kevent kev[256];
+    if (delay_type != 0)
+	thread->quiescent_pause();
     int n = kevent(_kqueue, 0, 0, &kev[0], 256, wait_ptr);
     int was_errno = errno;
+    if (delay_type != 0)
+	thread->quiescent_resume();
 
     if (post_select(thread, true))
 	return;
@@ -450,8 +454,12 @@ SelectSet::run_selects_poll(RouterThread *thread)
 	timeout = -1;
     thread->set_thread_state_for_blocking(delay_type);
 
+    if (delay_type != 0)
+	thread->quiescent_pause();
     int n = poll(my_pollfds.begin(), my_pollfds.size(), timeout);
     int was_errno = errno;
+    if (delay_type != 0)
+	thread->quiescent_resume();
 
     if (post_select(thread, true))
 	return;
@@ -506,8 +514,12 @@ SelectSet::run_selects_select(RouterThread *thread)
 	wait_ptr = 0;
     thread->set_thread_state_for_blocking(delay_type);
 
+    if (delay_type != 0)
+	thread->quiescent_pause();
     int n = select(n_select_fd, &read_mask, &write_mask, (fd_set*) 0, wait_ptr);
     int was_errno = errno;
+    if (delay_type != 0)
+	thread->quiescent_resume();
 
     if (post_select(thread, true))
 	return;
@@ -44,6 +44,15 @@
 CLICK_DECLS
 
 
+bool
+has_glob(const String &pattern)
+{
+    for (const char *x = pattern.begin(); x != pattern.end(); ++x)
+	if (*x == '*' || *x == '?' || *x == '[')
+	    return true;
+    return false;
+}
+
 bool
 glob_match(const String &str, const String &pattern)
 {
@@ -584,14 +593,18 @@ path_find_file_2(const String &filename, const String &path,
     const char *begin = path.begin();
     const char *end = path.end();
     int before_size = results.size();
+    bool searched_default = false;
 
+    // an empty component, including a trailing one, means the default path
     do {
-	String dir = path.substring(begin, find(begin, end, ':'));
-	begin = dir.end() + 1;
+	const char *colon = find(begin, end, ':');
+	String dir = path.substring(begin, colon);
+	begin = colon + 1;
 
-	if (!dir && default_path) {
+	if (!dir && default_path && !searched_default) {
 	    // look in default path
-	    if (path_find_file_2(filename, default_path, "", 0, results, exit_early) && exit_early)
+	    searched_default = true;
+	    if (path_find_file_2(filename, default_path, "", String(), results, exit_early) && exit_early)
 		return true;
 
 	} else if (dir) {
@@ -616,9 +629,9 @@ path_find_file_2(const String &filename, const String &path,
 		    return true;
 	    }
 	}
-    } while (begin < end);
+    } while (begin <= end);
 
-    return results.size() == before_size;
+    return results.size() != before_size;
 }
 
 
@@ -634,13 +647,13 @@ clickpath_find_file(const String &filename, const char *subdir,
     if (!path && default_path)
 	path = ":";
     Vector<String> fns;
-    path_find_file_2(filename, path, default_path, subdir, fns, true);
+    path_find_file_2(filename, path, default_path, String(subdir ? subdir : ""), fns, true);
 
     // look in 'PATH' for binaries
     if (!fns.size() && subdir
 	&& (strcmp(subdir, "bin") == 0 || strcmp(subdir, "sbin") == 0))
 	if (const char *path_variable = getenv("PATH"))
-	    path_find_file_2(filename, path_variable, "", 0, fns, true);
+	    path_find_file_2(filename, path_variable, "", String(), fns, true);
 
     if (!fns.size() && errh) {
 	if (default_path) {
@@ -665,7 +678,7 @@ clickpath_expand_path(const char* subdir, const String& default_path, Vector<Str
     if (!path && default_path)
 	path = ":";
     int first = result.size();
-    path_find_file_2(".", path, default_path, subdir, result, false);
+    path_find_file_2(".", path, default_path, String(subdir ? subdir : ""), result, false);
     // remove trailing '/.'s
     for (String* x = result.begin() + first; x < result.end(); x++)
 	*x = x->substring(x->begin(), x->end() - 2);
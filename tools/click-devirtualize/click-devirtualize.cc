@@ -53,6 +53,7 @@
 #define DEVIRTUALIZE_OPT	311
 #define INSTRS_OPT		312
 #define REVERSE_OPT		313
+#define INLINE_OPT		314
 
 static const Clp_Option options[] = {
   { "clickpath", 'C', CLICKPATH_OPT, Clp_ValString, 0 },
@@ -61,6 +62,7 @@ static const Clp_Option options[] = {
   { "expression", 'e', EXPRESSION_OPT, Clp_ValString, 0 },
   { "file", 'f', ROUTER_OPT, Clp_ValString, 0 },
   { "help", 0, HELP_OPT, 0, 0 },
+  { "inline", 0, INLINE_OPT, 0, Clp_Negate },
   { 0, 'n', NO_DEVIRTUALIZE_OPT, Clp_ValString, 0 },
   { "kernel", 'k', KERNEL_OPT, 0, Clp_Negate }, // DEPRECATED
   { "linuxmodule", 'l', KERNEL_OPT, 0, Clp_Negate },
@@ -212,6 +214,7 @@ Options:\n\
   -r, --reverse                Reverse devirtualization.\n\
   -n, --no-devirtualize CLASS  Don't devirtualize element class CLASS.\n\
   -i, --instructions FILE      Read devirtualization instructions from FILE.\n\
+      --no-inline              Don't inline linear push and pull chains.\n\
   -C, --clickpath PATH         Use PATH for CLICKPATH.\n\
       --help                   Print this message and exit.\n\
   -v, --version                Print version number and exit.\n\
@@ -241,6 +244,7 @@ main(int argc, char **argv)
   int compile_kernel = 0;
   int compile_user = 0;
   int reverse = 0;
+  int inline_chains = 1;
   Vector<const char *> instruction_files;
   HashTable<String, int> specializing;
 
@@ -324,6 +328,10 @@ particular purpose.\n");
       reverse = !clp->negated;
       break;
 
+     case INLINE_OPT:
+      inline_chains = !clp->negated;
+      break;
+
      bad_option:
      case Clp_BadOption:
       short_usage();
@@ -420,6 +428,8 @@ particular purpose.\n");
   // initialize specializer
   Specializer specializer(router, full_elementmap);
   specializer.specialize(sigs, errh);
+  if (inline_chains)
+    specializer.inline_chains();
 
   // quit early if nothing was done
   if (specializer.nspecials() == 0) {
@@ -38,6 +38,7 @@ class CxxFunction {
   const String &clean_body() const	{ return _clean_body; }
 
   void set_body(const String &b)	{ _body = b; _clean_body = String(); }
+  inline void set_inline();
   void kill()				{ _alive = false; }
   void unkill()				{ _alive = true; }
 
@@ -46,6 +47,13 @@ class CxxFunction {
 
 };
 
+inline void
+CxxFunction::set_inline()
+{
+  if (!_in_header && _ret_type.substring(0, 7) != "inline ")
+    _ret_type = "inline " + _ret_type;
+}
+
 class CxxClass {
 
   String _name;
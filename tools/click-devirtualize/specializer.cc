@@ -31,7 +31,8 @@
 Specializer::Specializer(RouterT *router, const ElementMap &em)
   : _router(router), _nelements(router->nelements()),
     _ninputs(router->nelements(), 0), _noutputs(router->nelements(), 0),
-    _etinfo_map(0), _header_file_map(-1), _parsed_sources(-1)
+    _etinfo_map(0), _header_file_map(-1), _parsed_sources(-1),
+    _push_callers(0), _pull_callers(0)
 {
   _etinfo.push_back(ElementTypeInfo());
 
@@ -367,6 +368,7 @@ Specializer::create_connector_methods(SpecializedClass &spc)
 	sa << "if (i >= " << r1 << " && i <= " << r2 << ") ";
       sa << "return ((" << input_class[r1] << " *)input(i).element())->"
 	 << input_class[r1] << "::pull(" << input_port[r1] << ");";
+      _pull_callers[input_class[r1]]++;
     }
     if (_ninputs[eindex])
 	sa << "\n  return input(i).pull();\n";
@@ -399,6 +401,7 @@ Specializer::create_connector_methods(SpecializedClass &spc)
       sa << "{ ((" << output_class[r1] << " *)output(i).element())->"
 	 << output_class[r1] << "::push(" << output_port[r1]
 	 << ", p); return; }";
+      _push_callers[output_class[r1]]++;
     }
     if (_noutputs[eindex])
 	sa << "\n  output(i).push(p);\n";
@@ -439,6 +442,34 @@ Specializer::specialize(const Signatures &sigs, ErrorHandler *errh)
       create_connector_methods(_specials[s]);
 }
 
+int
+Specializer::inline_chains()
+{
+  // A specialized push (pull) function called directly from exactly one
+  // place in the generated code is part of a linear chain.  Declaring it
+  // inline lets the compiler fuse the whole chain into its first element's
+  // function without growing the package.  Upstream elements that were not
+  // specialized still reach it through the virtual function table.
+  int ninlined = 0;
+  for (int s = 0; s < _specials.size(); s++) {
+    SpecializedClass &spc = _specials[s];
+    if (!spc.special())
+      continue;
+    CxxFunction *fn;
+    if (_push_callers.get(spc.cxx_name) == 1
+	&& (fn = spc.cxxc->find("push")) && fn->alive()) {
+      fn->set_inline();
+      ninlined++;
+    }
+    if (_pull_callers.get(spc.cxx_name) == 1
+	&& (fn = spc.cxxc->find("pull")) && fn->alive()) {
+      fn->set_inline();
+      ninlined++;
+    }
+  }
+  return ninlined;
+}
+
 void
 Specializer::fix_elements()
 {
@@ -47,6 +47,7 @@ class Specializer { public:
 		     const String &header_file, const String &source_dir);
 
   void specialize(const Signatures &, ErrorHandler *);
+  int inline_chains();
   void fix_elements();
 
   int nspecials() const				{ return _specials.size(); }
@@ -73,6 +74,8 @@ class Specializer { public:
   HashTable<String, int> _parsed_sources;
 
   Vector<SpecializedClass> _specials;
+  HashTable<String, int> _push_callers;
+  HashTable<String, int> _pull_callers;
 
   CxxInfo _cxxinfo;
 
@@ -0,0 +1,200 @@
+/*
+ * click-shmcounters.cc -- print statistics exported by ShmCounters
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include <click/clp.h>
+#include <click/shmcounters.h>
+#include <click/vector.hh>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fnmatch.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define HELP_OPT		300
+#define VERSION_OPT		301
+#define WATCH_OPT		302
+#define COUNT_OPT		303
+#define DELTA_OPT		304
+
+static const Clp_Option options[] = {
+  { "count", 'n', COUNT_OPT, Clp_ValUnsigned, 0 },
+  { "delta", 'd', DELTA_OPT, 0, Clp_Negate },
+  { "help", 0, HELP_OPT, 0, 0 },
+  { "version", 'v', VERSION_OPT, 0, 0 },
+  { "watch", 'w', WATCH_OPT, Clp_ValDouble, 0 },
+};
+
+static const char *program_name;
+
+void
+short_usage()
+{
+  fprintf(stderr, "Usage: %s [OPTION]... FILE [PATTERN]...\n\
+Try '%s --help' for more information.\n",
+	  program_name, program_name);
+}
+
+void
+usage()
+{
+  printf("\
+'Click-shmcounters' prints the statistics a Click ShmCounters element exports\n\
+through the shared-memory region FILE, one 'NAME<tab>VALUE' line per\n\
+statistic. PATTERNs, if given, are shell-style patterns that select which\n\
+statistics to print. Reading the region does not involve the router.\n\
+\n\
+Usage: %s [OPTION]... FILE [PATTERN]...\n\
+\n\
+Options:\n\
+  -w, --watch SEC               Print statistics every SEC seconds.\n\
+  -n, --count N                 With --watch, stop after N samples.\n\
+  -d, --delta                   Print changes since the previous sample.\n\
+      --help                    Print this message and exit.\n\
+  -v, --version                 Print version number and exit.\n\
+\n\
+Report bugs to <click@pdos.lcs.mit.edu>.\n", program_name);
+}
+
+int
+main(int argc, char **argv)
+{
+  Clp_Parser *clp =
+    Clp_NewParser(argc, argv, sizeof(options) / sizeof(options[0]), options);
+  program_name = Clp_ProgramName(clp);
+
+  const char *filename = 0;
+  Vector<const char *> patterns;
+  double watch = 0;
+  unsigned count = 0;
+  bool delta = false;
+
+  while (1) {
+    int opt = Clp_Next(clp);
+    switch (opt) {
+
+     case HELP_OPT:
+      usage();
+      exit(0);
+      break;
+
+     case VERSION_OPT:
+      printf("click-shmcounters (Click) %s\n", CLICK_VERSION);
+      printf("This is free software; see the source for copying conditions.\n\
+There is NO warranty, not even for merchantability or fitness for a\n\
+particular purpose.\n");
+      exit(0);
+      break;
+
+     case WATCH_OPT:
+      if (clp->val.d <= 0) {
+	fprintf(stderr, "%s: --watch interval must be positive\n", program_name);
+	goto bad_option;
+      }
+      watch = clp->val.d;
+      break;
+
+     case COUNT_OPT:
+      count = clp->val.u;
+      break;
+
+     case DELTA_OPT:
+      delta = !clp->negated;
+      break;
+
+     case Clp_NotOption:
+      if (!filename)
+	filename = clp->vstr;
+      else
+	patterns.push_back(clp->vstr);
+      break;
+
+     bad_option:
+     case Clp_BadOption:
+      short_usage();
+      exit(1);
+      break;
+
+     case Clp_Done:
+      goto done;
+
+    }
+  }
+
+ done:
+  if (!filename) {
+    short_usage();
+    exit(1);
+  }
+
+  int fd = open(filename, O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) < 0) {
+    fprintf(stderr, "%s: %s: %s\n", program_name, filename, strerror(errno));
+    exit(1);
+  }
+  void *mem = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  const click_shmcounters_header *h = (const click_shmcounters_header *) mem;
+  if (mem == MAP_FAILED || click_shmcounters_check(h, st.st_size) < 0) {
+    fprintf(stderr, "%s: %s: not a Click counter region\n", program_name, filename);
+    exit(1);
+  }
+
+  // select statistics
+  Vector<uint32_t> selected;
+  for (uint32_t i = 0; i < h->ncounters; ++i) {
+    const char *name = click_shmcounters_name(h, i);
+    bool match = !patterns.size();
+    for (int j = 0; j < patterns.size() && !match; ++j)
+      match = (fnmatch(patterns[j], name, 0) == 0);
+    if (match)
+      selected.push_back(i);
+  }
+
+  // with --delta, the first sample is only a baseline
+  Vector<uint64_t> values(h->ncounters + 1, 0), last(h->ncounters + 1, 0);
+  bool baseline = delta && watch;
+  for (unsigned printed = 0; ; ) {
+    if (!click_shmcounters_read(h, values.begin(), 1000)) {
+      if (!h->generation)
+	fprintf(stderr, "%s: %s: no values published yet\n", program_name, filename);
+      else
+	fprintf(stderr, "%s: %s: no consistent values\n", program_name, filename);
+      exit(1);
+    }
+    if (!baseline) {
+      for (int j = 0; j < selected.size(); ++j) {
+	uint32_t i = selected[j];
+	uint64_t v = values[i] - (delta ? last[i] : 0);
+	printf("%s\t%llu\n", click_shmcounters_name(h, i), (unsigned long long) v);
+      }
+      if (watch)
+	printf("\n");
+      fflush(stdout);
+      ++printed;
+    }
+    baseline = false;
+    last.swap(values);
+    if (!watch || (count && printed >= count))
+      break;
+    usleep((useconds_t) (watch * 1000000));
+  }
+
+  exit(0);
+}
@@ -52,6 +52,7 @@
 #include <click/userutils.hh>
 #include <click/args.hh>
 #include <click/handlercall.hh>
+#include <click/md5.h>
 #include "elements/standard/quitwatcher.hh"
 #include "elements/userlevel/controlsocket.hh"
 CLICK_USING_DECLS
@@ -74,10 +75,14 @@ CLICK_USING_DECLS
 #define THREADS_OPT		316
 #define SIMTIME_OPT		317
 #define SOCKET_OPT		318
+#define CONFIGURE_THREADS_OPT	319
+#define CONFIG_CACHE_OPT	320
 
 static const Clp_Option options[] = {
     { "allow-reconfigure", 'R', ALLOW_RECONFIG_OPT, 0, Clp_Negate },
     { "clickpath", 'C', CLICKPATH_OPT, Clp_ValString, 0 },
+    { "config-cache", 0, CONFIG_CACHE_OPT, Clp_ValString, 0 },
+    { "configure-threads", 0, CONFIGURE_THREADS_OPT, Clp_ValInt, 0 },
     { "expression", 'e', EXPRESSION_OPT, Clp_ValString, 0 },
     { "file", 'f', ROUTER_OPT, Clp_ValString, 0 },
     { "handler", 'h', HANDLER_OPT, Clp_ValString, 0 },
@@ -121,6 +126,8 @@ Options:\n\
   -f, --file FILE               Read router configuration from FILE.\n\
   -e, --expression EXPR         Use EXPR as router configuration.\n\
   -j, --threads N               Start N threads (default 1).\n\
+      --configure-threads N     Configure independent elements on N threads.\n\
+      --config-cache DIR        Cache flattened configurations in DIR.\n\
   -p, --port PORT               Listen for control connections on TCP port.\n\
   -u, --unix-socket FILE        Listen for control connections on Unix socket.\n\
       --socket FD               Add a file descriptor control connection.\n\
@@ -296,6 +303,8 @@ static Vector<String> cs_ports;
 static Vector<String> cs_sockets;
 static bool warnings = true;
 static int nthreads = 1;
+static int configure_nthreads = 1;
+static const char *config_cache_dir = 0;
 
 static String
 click_driver_control_socket_name(int number)
@@ -306,6 +315,129 @@ click_driver_control_socket_name(int number)
 	return "click_driver@@ControlSocket@" + String(number);
 }
 
+// Flattened configurations are cached under a hash of everything known
+// before parsing that can change its result: Click's version, CLICKPATH,
+// command line definitions, the configuration file's name and text, and the
+// working directory, against which library names resolve.  A cache file
+// starts with a "// depends DIGEST FILE" line for every library, package,
+// and elementmap file that parsing read, and is used only while those files
+// are unchanged.  Line directives keep element landmarks pointing into the
+// original files.  Archives are never cached, since they can carry packages
+// and element code, nor is standard input, which can be read only once.
+static String
+config_cache_digest(const String &str)
+{
+    md5_state_t pms;
+    char buf[MD5_TEXT_DIGEST_MAX_SIZE];
+    md5_init(&pms);
+    md5_append(&pms, reinterpret_cast<const md5_byte_t *>(str.data()), str.length());
+    int buflen = md5_finish_text(&pms, buf, 0);
+    md5_free(&pms);
+    return String(buf, buflen);
+}
+
+static String
+config_cache_file_digest(const String &filename)
+{
+    ErrorHandler *errh = ErrorHandler::silent_handler();
+    int before = errh->nerrors();
+    String str = file_string(filename, errh);
+    return errh->nerrors() == before ? config_cache_digest(str) : String();
+}
+
+static String
+config_cache_filename(const String &text, bool text_is_expr)
+{
+    if (!text_is_expr && (!text || text == "-"))
+	return String();
+    String config_str = (text_is_expr ? text : file_string(text));
+    if (!config_str || config_str[0] == '!')
+	return String();
+
+    StringAccum sa;
+    sa << CLICK_VERSION << '\0' << (clickpath() ? clickpath() : "") << '\0';
+    char cwd[MAXPATHLEN];
+    if (!getcwd(cwd, sizeof(cwd)))
+	return String();
+    sa << cwd << '\0' << (text_is_expr ? String() : text) << '\0';
+    VariableEnvironment &scope = click_lexer()->global_scope();
+    for (int i = 0; i < scope.size(); ++i)
+	sa << scope.name(i) << '=' << scope.value(i) << '\0';
+    sa << config_str;
+    return String(config_cache_dir) + "/" + config_cache_digest(sa.take_string()) + ".click";
+}
+
+static bool
+config_cache_valid(const String &cache_file)
+{
+    if (access(cache_file.c_str(), R_OK) != 0)
+	return false;
+    String str = file_string(cache_file);
+    int pos = 0;
+    while (str.substring(pos, 11).equals("// depends ", 11)) {
+	int nl = str.find_left('\n', pos);
+	int sp = str.find_left(' ', pos + 11);
+	if (nl < 0 || sp < 0 || sp > nl
+	    || config_cache_file_digest(str.substring(sp + 1, nl - sp - 1))
+	       != str.substring(pos + 11, sp - pos - 11))
+	    return false;
+	pos = nl + 1;
+    }
+    return true;
+}
+
+static String
+unparse_cached_router(Router *r, const Vector<String> &files)
+{
+    StringAccum sa;
+    for (const String *it = files.begin(); it != files.end(); ++it)
+	sa << "// depends " << config_cache_file_digest(*it) << ' ' << *it << '\n';
+    r->unparse_requirements(sa);
+    for (int i = 0; i < r->nelements(); ++i) {
+	String landmark = r->elandmark(i);
+	int colon = landmark.find_right(':');
+	if (colon > 0 && colon + 1 < landmark.length()
+	    && isdigit((unsigned char) landmark[colon + 1]))
+	    sa << "# " << landmark.substring(colon + 1) << ' '
+	       << cp_quote(landmark.substring(0, colon)) << '\n';
+	sa << r->ename(i) << " :: " << r->element(i)->class_name();
+	if (String conf = r->econfiguration(i))
+	    sa << '(' << conf << ')';
+	sa << ";\n";
+    }
+    sa << '\n';
+    r->unparse_connections(sa);
+    return sa.take_string();
+}
+
+static Router *
+read_router(const String &text, bool text_is_expr, ErrorHandler *errh,
+	    Master *master)
+{
+    String cache_file;
+    if (config_cache_dir)
+	cache_file = config_cache_filename(text, text_is_expr);
+    if (cache_file && config_cache_valid(cache_file))
+	return click_read_router(cache_file, false, errh, false, master);
+
+    int before = errh->nerrors();
+    Vector<String> files;
+    Router *r = click_read_router(text, text_is_expr, errh, false, master, &files);
+    if (r && cache_file && errh->nerrors() == before) {
+	String str = unparse_cached_router(r, files);
+	String tmp_file = cache_file + ".tmp" + String(getpid());
+	FILE *f = fopen(tmp_file.c_str(), "w");
+	bool ok = f && fwrite(str.data(), 1, str.length(), f) == (size_t) str.length();
+	if (f && fclose(f) != 0)
+	    ok = false;
+	if (!ok || rename(tmp_file.c_str(), cache_file.c_str()) != 0) {
+	    errh->warning("%s: %s", cache_file.c_str(), strerror(errno));
+	    unlink(tmp_file.c_str());
+	}
+    }
+    return r;
+}
+
 static Router *
 parse_configuration(const String &text, bool text_is_expr, bool hotswap,
 		    ErrorHandler *errh)
@@ -316,7 +448,7 @@ parse_configuration(const String &text, bool text_is_expr, bool hotswap,
     else
 	master = new_master = new Master(nthreads);
 
-    Router *r = click_read_router(text, text_is_expr, errh, false, master);
+    Router *r = read_router(text, text_is_expr, errh, master);
     if (!r) {
 	delete new_master;
 	return 0;
@@ -357,6 +489,7 @@ parse_configuration(const String &text, bool text_is_expr, bool hotswap,
   // register hotswap router on new router
   if (hotswap && router && router->initialized())
     r->set_hotswap_router(router);
+  r->set_configure_threads(configure_nthreads);
 
   if (errh->nerrors() > 0 || r->initialize(errh) < 0) {
     delete r;
@@ -564,6 +697,20 @@ main(int argc, char **argv)
 #endif
       break;
 
+    case CONFIGURE_THREADS_OPT:
+      configure_nthreads = clp->val.i;
+#if !HAVE_MULTITHREAD
+      if (configure_nthreads > 1) {
+	  errh->warning("Click was built without multithread support, configuring single threaded");
+	  configure_nthreads = 1;
+      }
+#endif
+      break;
+
+    case CONFIG_CACHE_OPT:
+      config_cache_dir = clp->vstr;
+      break;
+
     case SIMTIME_OPT: {
 	Timestamp::warp_set_class(Timestamp::warp_simulation);
 	Timestamp simbegin(clp->have_val ? clp->val.d : 1000000000);